@@ -44,6 +44,20 @@ GidMapper::GidMapper(const QList<Tileset *> &tilesets)
     }
 }
 
+void GidMapper::insert(uint firstGid, Tileset *tileset)
+{
+    mFirstGidToTileset.insert(firstGid, tileset);
+
+    // Rebuilt each time since a tileset can be inserted more than once.
+    // Maps have at most a few hundred tilesets.
+    mTilesetToFirstGid.clear();
+    QMap<uint, Tileset*>::const_iterator i = mFirstGidToTileset.constEnd();
+    while (i != mFirstGidToTileset.constBegin()) {
+        --i;
+        mTilesetToFirstGid.insert(i.value(), i.key());
+    }
+}
+
 Cell GidMapper::gidToCell(uint gid, bool &ok) const
 {
     Cell result;
@@ -97,15 +111,11 @@ uint GidMapper::cellToGid(const Cell &cell) const
     const Tileset *tileset = cell.tile->tileset();
 
     // Find the first GID for the tileset
-    QMap<uint, Tileset*>::const_iterator i = mFirstGidToTileset.begin();
-    QMap<uint, Tileset*>::const_iterator i_end = mFirstGidToTileset.end();
-    while (i != i_end && i.value() != tileset)
-        ++i;
-
-    if (i == i_end) // tileset not found
+    QHash<const Tileset*, uint>::const_iterator i = mTilesetToFirstGid.find(tileset);
+    if (i == mTilesetToFirstGid.end()) // tileset not found
         return 0;
 
-    uint gid = i.key() + cell.tile->id();
+    uint gid = i.value() + cell.tile->id();
     if (cell.flippedHorizontally)
         gid |= FlippedHorizontallyFlag;
     if (cell.flippedVertically)
@@ -23,6 +23,7 @@
 
 #include "tilelayer.h"
 
+#include <QHash>
 #include <QMap>
 
 namespace Tiled {
@@ -47,13 +48,16 @@ public:
     /**
      * Insert the given \a tileset with \a firstGid as its first global ID.
      */
-    void insert(uint firstGid, Tileset *tileset)
-    { mFirstGidToTileset.insert(firstGid, tileset); }
+    void insert(uint firstGid, Tileset *tileset);
 
     /**
      * Clears the gid mapper, so that it can be reused.
      */
-    void clear() { mFirstGidToTileset.clear(); }
+    void clear()
+    {
+        mFirstGidToTileset.clear();
+        mTilesetToFirstGid.clear();
+    }
 
     /**
      * Returns true when no tilesets are known to this gid mapper.
@@ -81,6 +85,7 @@ public:
 
 private:
     QMap<uint, Tileset*> mFirstGidToTileset;
+    QHash<const Tileset*, uint> mTilesetToFirstGid; // the lowest, for cellToGid()
     QMap<const Tileset*, int> mTilesetColumnCounts;
 };
 
@@ -30,9 +30,11 @@
 
 #include "map.h"
 #include "mapobject.h"
+#include "spritebatch.h"
 #include "tile.h"
 #include "tilelayer.h"
 #include "tileset.h"
+#include "tracing.h"
 #include "imagelayer.h"
 #ifdef ZOMBOID
 #include "ztilelayergroup.h"
@@ -253,20 +255,24 @@ void IsometricRenderer::drawTileLayer(QPainter *painter,
     bool shifted = inUpperHalf ^ inLeftHalf;
 
     QTransform baseTransform = painter->transform();
+#ifdef ZOMBOID
+    SpriteBatch batch(painter);
+#endif
 
     for (int y = startPos.y(); y - tileHeight < rect.bottom();
          y += tileHeight / 2)
     {
+#ifdef ZOMBOID
+        // Multi-threading
+        if (mAbortDrawing && *mAbortDrawing) {
+            batch.clear();
+            painter->setTransform(baseTransform);
+            return;
+        }
+#endif
         QPoint columnItr = rowItr;
 
         for (int x = startPos.x(); x < rect.right(); x += tileWidth) {
-#ifdef ZOMBOID
-            // Multi-threading
-            if (mAbortDrawing && *mAbortDrawing) {
-                painter->setTransform(baseTransform);
-                return;
-            }
-#endif
             if (layer->contains(columnItr)) {
                 const Cell &cell = layer->cellAt(columnItr);
                 if (!cell.isEmpty()) {
@@ -308,11 +314,10 @@ void IsometricRenderer::drawTileLayer(QPainter *painter,
                     }
 
                     const QTransform transform(m11, m12, m21, m22, dx, dy);
-                    painter->setTransform(transform * baseTransform);
-
 #ifdef ZOMBOID
-                    painter->drawImage(0, 0, img);
+                    batch.add(&img, transform);
 #else
+                    painter->setTransform(transform * baseTransform);
                     painter->drawPixmap(0, 0, img);
 #endif
                 }
@@ -335,6 +340,9 @@ void IsometricRenderer::drawTileLayer(QPainter *painter,
         }
     }
 
+#ifdef ZOMBOID
+    batch.flush();
+#endif
     painter->setTransform(baseTransform);
 }
 
@@ -342,6 +350,7 @@ void IsometricRenderer::drawTileLayer(QPainter *painter,
 void IsometricRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *layerGroup,
                             const QRectF &exposed) const
 {
+    TRACE_ZONE("IsometricRenderer::drawTileLayerGroup");
     const int tileWidth = map()->tileWidth();
     const int tileHeight = map()->tileHeight();
 
@@ -403,22 +412,24 @@ void IsometricRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *l
 
     layerGroup->prepareDrawing(this, rect);
 
-    qreal opacity = painter->opacity();
+    SpriteBatch batch(painter);
 
     for (int y = startPos.y(); y - tileHeight < rect.bottom();
          y += tileHeight / 2)
     {
+        // Multi-threading
+        if (mAbortDrawing && *mAbortDrawing) {
+            batch.clear();
+            painter->setTransform(baseTransform);
+            return;
+        }
+
         QPoint columnItr = rowItr;
 
         for (int x = startPos.x(); x < rect.right(); x += tileWidth) {
             cells.resize(0);
             if (layerGroup->orderedCellsAt(columnItr, cells, opacities)) {
                 for (int i = 0; i < cells.size(); i++) {
-                    // Multi-threading
-                    if (mAbortDrawing && *mAbortDrawing) {
-                        painter->setTransform(baseTransform);
-                        return;
-                    }
                     const Cell *cell = cells[i];
                     if (!cell->isEmpty()) {
                         const QImage &img = cell->tile->image();
@@ -455,11 +466,7 @@ void IsometricRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *l
                         }
 
                         const QTransform transform(m11, m12, m21, m22, dx, dy);
-                        painter->setTransform(transform * baseTransform);
-
-                        painter->setOpacity(opacities[i] * opacity);
-
-                        painter->drawImage(0, 0, img);
+                        batch.add(&img, transform, opacities[i]);
                     }
                 }
             }
@@ -481,6 +488,7 @@ void IsometricRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *l
         }
     }
 
+    batch.flush();
     painter->setTransform(baseTransform);
 }
 #endif // ZOMBOID
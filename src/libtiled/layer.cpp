@@ -49,6 +49,7 @@ Layer::Layer(Type type, const QString &name, int x, int y,
     mHeight(height),
 #ifdef ZOMBOID
     mLevel(0),
+    mClassification(name),
 #endif
     mOpacity(1.0f),
     mVisible(true),
@@ -31,6 +31,9 @@
 #define LAYER_H
 
 #include "object.h"
+#ifdef ZOMBOID
+#include "layerclassification.h"
+#endif
 
 #include <QPixmap>
 #include <QRect>
@@ -78,7 +81,13 @@ public:
     /**
      * Sets the name of this layer.
      */
-    void setName(const QString &name) { mName = name; }
+    void setName(const QString &name)
+    {
+        mName = name;
+#ifdef ZOMBOID
+        mClassification = LayerClassification(name);
+#endif
+    }
 
     /**
      * Returns the opacity of this layer.
@@ -160,6 +169,11 @@ public:
 #ifdef ZOMBOID
     void setLevel(int level) { mLevel = level; }
     int level() const { return mLevel; }
+
+    /**
+     * Returns the level, base name and roles given by the name of this layer.
+     */
+    const LayerClassification &classification() const { return mClassification; }
 #endif
 
     virtual bool isEmpty() const = 0;
@@ -241,6 +255,7 @@ protected:
     int mHeight;
 #ifdef ZOMBOID
     int mLevel;
+    LayerClassification mClassification;
 #endif
     float mOpacity;
     bool mVisible;
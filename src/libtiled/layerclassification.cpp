@@ -0,0 +1,132 @@
+/*
+ * layerclassification.cpp
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "layerclassification.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+
+using namespace Tiled;
+
+namespace {
+
+class NameTable
+{
+public:
+    int id(const QString &name)
+    {
+        QMutexLocker locker(&mMutex);
+        QHash<QString,int>::const_iterator it = mIds.constFind(name);
+        if (it != mIds.constEnd())
+            return it.value();
+        const int id = mIds.size();
+        mIds.insert(name, id);
+        return id;
+    }
+
+    int find(const QString &name)
+    {
+        QMutexLocker locker(&mMutex);
+        return mIds.value(name, -1);
+    }
+
+private:
+    QMutex mMutex;
+    QHash<QString,int> mIds;
+};
+
+NameTable *names()
+{
+    static NameTable table;
+    return &table;
+}
+
+NameTable *baseNames()
+{
+    static NameTable table;
+    return &table;
+}
+
+} // namespace
+
+LayerClassification::LayerClassification() :
+    mNameId(-1),
+    mBaseNameId(-1),
+    mLevel(0),
+    mHasLevel(false)
+{
+}
+
+LayerClassification::LayerClassification(const QString &name) :
+    mNameId(idForName(name)),
+    mBaseNameId(idForBaseName(baseName(name))),
+    mLevel(0),
+    mHasLevel(levelForName(name, &mLevel))
+{
+    if (name == QLatin1String("0_Floor"))
+        mRoles |= FloorRole;
+    if (name.contains(QLatin1String("_AboveLot")))
+        mRoles |= AboveLotRole;
+    if (name.contains(QLatin1String("NoRender")))
+        mRoles |= NoRenderRole;
+}
+
+QString LayerClassification::baseName(const QString &name)
+{
+    int pos = name.indexOf(QLatin1Char('_')) + 1; // Could be "-1 + 1 == 0"
+    return name.mid(pos);
+}
+
+bool LayerClassification::levelForName(const QString &name, int *levelPtr)
+{
+    if (levelPtr) (*levelPtr) = 0;
+
+    // See if the layer name matches "0_foo" or "1_bar" etc.
+    QStringList sl = name.trimmed().split(QLatin1Char('_'));
+    if (sl.count() > 1 && !sl[1].isEmpty()) {
+        bool conversionOK;
+        uint level = sl[0].toUInt(&conversionOK);
+        if (levelPtr) (*levelPtr) = level;
+        return conversionOK;
+    }
+    return false;
+}
+
+int LayerClassification::idForName(const QString &name)
+{
+    return names()->id(name);
+}
+
+int LayerClassification::idForBaseName(const QString &baseName)
+{
+    return baseNames()->id(baseName);
+}
+
+int LayerClassification::findBaseNameId(const QString &baseName)
+{
+    return baseNames()->find(baseName);
+}
@@ -0,0 +1,112 @@
+/*
+ * layerclassification.h
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LAYERCLASSIFICATION_H
+#define LAYERCLASSIFICATION_H
+
+#include "tiled_global.h"
+
+#include <QFlags>
+#include <QString>
+
+namespace Tiled {
+
+/**
+ * What a layer's name says about it, worked out once when the layer is
+ * created or renamed instead of every time the layer is drawn.
+ *
+ * Names of the form "1_Walls" give the level (1) and the base name
+ * ("Walls"); layers with the same base name on different levels share a
+ * base name id.  Names and base names are turned into ids that stay the
+ * same for as long as the program runs, so layers can be matched by
+ * comparing integers.  The ids may be used from any thread.
+ */
+class TILEDSHARED_EXPORT LayerClassification
+{
+public:
+    enum Role {
+        NoRole = 0x00,
+        FloorRole = 0x01,       // named "0_Floor"
+        AboveLotRole = 0x02,    // has "_AboveLot" in the name
+        NoRenderRole = 0x04     // has "NoRender" in the name
+    };
+    Q_DECLARE_FLAGS(Roles, Role)
+
+    LayerClassification();
+    explicit LayerClassification(const QString &name);
+
+    /**
+     * Returns whether the name starts with a level, like "0_foo".
+     */
+    bool hasLevel() const { return mHasLevel; }
+
+    /**
+     * Returns the level at the start of the name, or 0.
+     */
+    int level() const { return mLevel; }
+
+    int nameId() const { return mNameId; }
+    int baseNameId() const { return mBaseNameId; }
+
+    Roles roles() const { return mRoles; }
+    bool hasRole(Role role) const { return mRoles.testFlag(role); }
+
+    /**
+     * Returns the part of \a name after the first '_', or the whole name if
+     * it has no '_'.
+     */
+    static QString baseName(const QString &name);
+
+    /**
+     * Returns whether \a name starts with a level and sets \a levelPtr to it.
+     */
+    static bool levelForName(const QString &name, int *levelPtr = nullptr);
+
+    /**
+     * Returns the id of \a name, or of \a baseName.  The id is created if
+     * nothing has used it yet.
+     */
+    static int idForName(const QString &name);
+    static int idForBaseName(const QString &baseName);
+
+    /**
+     * Returns the id of \a baseName, or -1 if no layer has had it.
+     */
+    static int findBaseNameId(const QString &baseName);
+
+private:
+    int mNameId;
+    int mBaseNameId;
+    int mLevel;
+    bool mHasLevel;
+    Roles mRoles;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(LayerClassification::Roles)
+
+} // namespace Tiled
+
+#endif // LAYERCLASSIFICATION_H
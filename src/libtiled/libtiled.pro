@@ -26,7 +26,9 @@ SOURCES += compression.cpp \
     imagelayer.cpp \
     isometricrenderer.cpp \
     layer.cpp \
+    layerclassification.cpp \
     map.cpp \
+    mipmapcache.cpp \
     mapobject.cpp \
     mapreader.cpp \
     maprenderer.cpp \
@@ -37,6 +39,8 @@ SOURCES += compression.cpp \
     staggeredrenderer.cpp \
     tilelayer.cpp \
     tileset.cpp \
+    spritebatch.cpp \
+    tracing.cpp \
     gidmapper.cpp \
     zlevelrenderer.cpp \
     ztilelayergroup.cpp \
@@ -45,7 +49,9 @@ HEADERS += compression.h \
     imagelayer.h \
     isometricrenderer.h \
     layer.h \
+    layerclassification.h \
     map.h \
+    mipmapcache.h \
     mapobject.h \
     mapreader.h \
     maprenderer.h \
@@ -59,6 +65,8 @@ HEADERS += compression.h \
     tiled_global.h \
     tilelayer.h \
     tileset.h \
+    spritebatch.h \
+    tracing.h \
     gidmapper.h \
     zlevelrenderer.h \
     ztilelayergroup.h
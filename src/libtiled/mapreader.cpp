@@ -39,6 +39,7 @@
 #include "tile.h"
 #include "tilelayer.h"
 #include "tileset.h"
+#include "tracing.h"
 
 #include <QCoreApplication>
 #include <QDebug>
@@ -1245,6 +1246,7 @@ MapReader::~MapReader()
 
 Map *MapReader::readMap(QIODevice *device, const QString &path)
 {
+    TRACE_ZONE("MapReader::readMap");
     return d->readMap(device, path);
 }
 
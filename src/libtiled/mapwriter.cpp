@@ -42,7 +42,12 @@
 
 #include <QCoreApplication>
 #include <QDir>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
 #include <QXmlStreamWriter>
+
+#include <functional>
 #ifdef ZOMBOID
 #include "qtlockedfile.h"
 using namespace SharedTools;
@@ -51,6 +56,73 @@ using namespace SharedTools;
 using namespace Tiled;
 using namespace Tiled::Internal;
 
+namespace {
+
+/**
+ * The encoded contents of a tile layer's <data>, a BMP image's <pixels> or a
+ * no-blend's <bits> element.
+ */
+struct Payload
+{
+    QString data;
+    QList<QRgb> colors; // BMP images only
+};
+
+/**
+ * Encodes and compresses the large parts of a map on a thread pool.  The
+ * jobs are added in the order the elements are written, and taken back in
+ * the same order.  They are run a batch at a time, so only the payloads of
+ * one batch are held in memory at once.
+ */
+class PayloadQueue
+{
+public:
+    PayloadQueue() :
+        mNext(0),
+        mDone(0),
+        mBatchSize(qMax(1, QThread::idealThreadCount() * 2))
+    {
+    }
+
+    void add(const std::function<Payload()> &encode)
+    { mJobs += encode; }
+
+    Payload takeNext();
+
+    void clear()
+    {
+        mJobs.clear();
+        mPayloads.clear();
+        mNext = mDone = 0;
+    }
+
+private:
+    class EncodeTask : public QRunnable
+    {
+    public:
+        EncodeTask(const std::function<Payload()> &encode, Payload *result) :
+            mEncode(encode),
+            mResult(result)
+        {
+        }
+
+        void run()
+        { *mResult = mEncode(); }
+
+    private:
+        std::function<Payload()> mEncode;
+        Payload *mResult;
+    };
+
+    QVector<std::function<Payload()> > mJobs;
+    QVector<Payload> mPayloads;
+    int mNext;
+    int mDone;
+    int mBatchSize;
+};
+
+} // namespace
+
 namespace Tiled {
 namespace Internal {
 
@@ -94,16 +166,147 @@ private:
     void writeBmpImage(QXmlStreamWriter &w, int index, const MapBmp &bmp);
     void writeNoBlend(QXmlStreamWriter &w, MapNoBlend *noBlend);
 #endif
+    void addPayloads(const Map *map);
 
     QDir mMapDir;     // The directory in which the map is being saved
     GidMapper mGidMapper;
     bool mUseAbsolutePaths;
+    PayloadQueue mPayloads;
 };
 
 } // namespace Internal
 } // namespace Tiled
 
 
+Payload PayloadQueue::takeNext()
+{
+    Q_ASSERT(mNext < mJobs.size());
+
+    if (mNext == mDone) {
+        const int count = qMin(mBatchSize, mJobs.size() - mDone);
+        mPayloads.resize(mJobs.size());
+        if (count == 1) {
+            mPayloads[mDone] = mJobs[mDone]();
+        } else {
+            Payload *payloads = mPayloads.data();
+            QThreadPool pool;
+            for (int i = mDone; i < mDone + count; ++i)
+                pool.start(new EncodeTask(mJobs[i], payloads + i));
+            pool.waitForDone();
+        }
+        mDone += count;
+    }
+
+    Payload payload = mPayloads[mNext];
+    mPayloads[mNext] = Payload();
+    ++mNext;
+    return payload;
+}
+
+static QString encodeTileLayer(const TileLayer *tileLayer,
+                               const GidMapper &gidMapper,
+                               MapWriter::LayerDataFormat format)
+{
+    if (format == MapWriter::CSV) {
+        QString tileData;
+
+        for (int y = 0; y < tileLayer->height(); ++y) {
+            for (int x = 0; x < tileLayer->width(); ++x) {
+                const uint gid = gidMapper.cellToGid(tileLayer->cellAt(x, y));
+                tileData.append(QString::number(gid));
+                if (x != tileLayer->width() - 1
+                    || y != tileLayer->height() - 1)
+                    tileData.append(QLatin1String(","));
+            }
+            tileData.append(QLatin1String("\n"));
+        }
+
+        return tileData;
+    }
+
+    QByteArray tileData;
+    tileData.reserve(tileLayer->height() * tileLayer->width() * 4);
+
+    for (int y = 0; y < tileLayer->height(); ++y) {
+        for (int x = 0; x < tileLayer->width(); ++x) {
+            const uint gid = gidMapper.cellToGid(tileLayer->cellAt(x, y));
+            tileData.append((char) (gid));
+            tileData.append((char) (gid >> 8));
+            tileData.append((char) (gid >> 16));
+            tileData.append((char) (gid >> 24));
+        }
+    }
+
+    if (format == MapWriter::Base64Gzip)
+        tileData = compress(tileData, Gzip);
+    else if (format == MapWriter::Base64Zlib)
+        tileData = compress(tileData, Zlib);
+
+    return QString::fromLatin1(tileData.toBase64());
+}
+
+#ifdef ZOMBOID
+static Payload encodeBmpImage(const MapBmp &bmp)
+{
+    Payload payload;
+    payload.colors = bmp.colors();
+    if (payload.colors.isEmpty())
+        return payload;
+
+    struct ColorCompare {
+        bool operator()(const QRgb& a, const QRgb& b) const {
+            if (qRed(a) < qRed(b)) return true;
+            if (qRed(a) > qRed(b)) return false;
+            if (qGreen(a) < qGreen(b)) return true;
+            if (qGreen(a) > qGreen(b)) return false;
+            return qBlue(a) < qBlue(b);
+        }
+    };
+    std::sort(payload.colors.begin(), payload.colors.end(), ColorCompare());
+
+    QHash<QRgb,quint32> colorIndex;
+    for (int i = 0; i < payload.colors.size(); ++i)
+        colorIndex.insert(payload.colors[i], i + 1);
+
+    QByteArray tileData;
+    tileData.reserve(bmp.height() * bmp.width() * 4);
+
+    const QRgb black = qRgb(0, 0, 0);
+    for (int y = 0; y < bmp.height(); ++y) {
+        for (int x = 0; x < bmp.width(); ++x) {
+            QRgb rgb = bmp.pixel(x, y);
+            quint32 n = (rgb == black) ? 0 : colorIndex.value(rgb);
+            tileData.append((unsigned char) (n)); // FIXME: big/little endian
+            tileData.append((unsigned char) (n >> 8));
+            tileData.append((unsigned char) (n >> 16));
+            tileData.append((unsigned char) (n >> 24));
+        }
+    }
+
+    tileData = compress(tileData, Gzip);
+    payload.data = QString::fromLatin1(tileData.toBase64());
+    return payload;
+}
+
+// Returns an empty string when no cells are set, nothing is written then.
+static QString encodeNoBlend(const MapNoBlend *noBlend)
+{
+    QByteArray data;
+    int numTrue = 0;
+    for (int y = 0; y < noBlend->width(); y++) {
+        for (int x = 0; x < noBlend->height(); x++) {
+            data.append(uchar(noBlend->get(x, y) ? 1 : 0));
+            if (noBlend->get(x, y)) numTrue++;
+        }
+    }
+
+    if (numTrue == 0)
+        return QString();
+
+    return QString::fromLatin1(compress(data, Gzip).toBase64());
+}
+#endif // ZOMBOID
+
 MapWriterPrivate::MapWriterPrivate()
     : mLayerDataFormat(MapWriter::Base64Gzip)
     , mDtdEnabled(false)
@@ -204,6 +407,8 @@ void MapWriterPrivate::writeMap(QXmlStreamWriter &w, const Map *map)
         firstGid += tileset->tileCount();
     }
 
+    addPayloads(map);
+
     foreach (const Layer *layer, map->layers()) {
         const Layer::Type type = layer->type();
         if (type == Layer::TileLayerType)
@@ -222,9 +427,49 @@ void MapWriterPrivate::writeMap(QXmlStreamWriter &w, const Map *map)
         writeNoBlend(w, noBlend);
 #endif
 
+    mPayloads.clear();
+
     w.writeEndElement();
 }
 
+/**
+ * Queues the encoding of everything writeMap() writes as one big block of
+ * text, in the order it is written.
+ */
+void MapWriterPrivate::addPayloads(const Map *map)
+{
+    mPayloads.clear();
+
+    const GidMapper &gidMapper = mGidMapper;
+    const MapWriter::LayerDataFormat format = mLayerDataFormat;
+    if (format != MapWriter::XML) {
+        foreach (const Layer *layer, map->layers()) {
+            if (layer->type() != Layer::TileLayerType)
+                continue;
+            const TileLayer *tileLayer = static_cast<const TileLayer*>(layer);
+            mPayloads.add([tileLayer, &gidMapper, format]() {
+                Payload payload;
+                payload.data = encodeTileLayer(tileLayer, gidMapper, format);
+                return payload;
+            });
+        }
+    }
+
+#ifdef ZOMBOID
+    const MapBmp bmpMain = map->bmpMain();
+    const MapBmp bmpVeg = map->bmpVeg();
+    mPayloads.add([bmpMain]() { return encodeBmpImage(bmpMain); });
+    mPayloads.add([bmpVeg]() { return encodeBmpImage(bmpVeg); });
+    foreach (const MapNoBlend *noBlend, map->noBlends()) {
+        mPayloads.add([noBlend]() {
+            Payload payload;
+            payload.data = encodeNoBlend(noBlend);
+            return payload;
+        });
+    }
+#endif
+}
+
 void MapWriterPrivate::writeTileset(QXmlStreamWriter &w, const Tileset *tileset,
                                     uint firstGid)
 {
@@ -358,42 +603,11 @@ void MapWriterPrivate::writeTileLayer(QXmlStreamWriter &w,
             }
         }
     } else if (mLayerDataFormat == MapWriter::CSV) {
-        QString tileData;
-
-        for (int y = 0; y < tileLayer->height(); ++y) {
-            for (int x = 0; x < tileLayer->width(); ++x) {
-                const uint gid = mGidMapper.cellToGid(tileLayer->cellAt(x, y));
-                tileData.append(QString::number(gid));
-                if (x != tileLayer->width() - 1
-                    || y != tileLayer->height() - 1)
-                    tileData.append(QLatin1String(","));
-            }
-            tileData.append(QLatin1String("\n"));
-        }
-
         w.writeCharacters(QLatin1String("\n"));
-        w.writeCharacters(tileData);
+        w.writeCharacters(mPayloads.takeNext().data);
     } else {
-        QByteArray tileData;
-        tileData.reserve(tileLayer->height() * tileLayer->width() * 4);
-
-        for (int y = 0; y < tileLayer->height(); ++y) {
-            for (int x = 0; x < tileLayer->width(); ++x) {
-                const uint gid = mGidMapper.cellToGid(tileLayer->cellAt(x, y));
-                tileData.append((char) (gid));
-                tileData.append((char) (gid >> 8));
-                tileData.append((char) (gid >> 16));
-                tileData.append((char) (gid >> 24));
-            }
-        }
-
-        if (mLayerDataFormat == MapWriter::Base64Gzip)
-            tileData = compress(tileData, Gzip);
-        else if (mLayerDataFormat == MapWriter::Base64Zlib)
-            tileData = compress(tileData, Zlib);
-
         w.writeCharacters(QLatin1String("\n   "));
-        w.writeCharacters(QString::fromLatin1(tileData.toBase64()));
+        w.writeCharacters(mPayloads.takeNext().data);
         w.writeCharacters(QLatin1String("\n  "));
     }
 
@@ -670,26 +884,15 @@ void MapWriterPrivate::writeBmpSettings(QXmlStreamWriter &w,
 void MapWriterPrivate::writeBmpImage(QXmlStreamWriter &w,
                                      int index, const MapBmp &bmp)
 {
-    QList<QRgb> colors = bmp.colors();
-    if (colors.isEmpty())
+    const Payload payload = mPayloads.takeNext();
+    if (payload.colors.isEmpty())
         return;
 
-    struct ColorCompare {
-        bool operator()(const QRgb& a, const QRgb& b) const {
-            if (qRed(a) < qRed(b)) return true;
-            if (qRed(a) > qRed(b)) return false;
-            if (qGreen(a) < qGreen(b)) return true;
-            if (qGreen(a) > qGreen(b)) return false;
-            return qBlue(a) < qBlue(b);
-        }
-    };
-    std::sort(colors.begin(), colors.end(), ColorCompare());
-
     w.writeStartElement(QLatin1String("bmp-image"));
     w.writeAttribute(QLatin1String("index"), QString::number(index));
     w.writeAttribute(QLatin1String("seed"), QString::number(bmp.rands().seed()));
 
-    foreach (QRgb rgb, colors) {
+    foreach (QRgb rgb, payload.colors) {
         w.writeStartElement(QLatin1String("color"));
         w.writeAttribute(QLatin1String("rgb"), tr("%1 %2 %3")
                          .arg(qRed(rgb))
@@ -699,27 +902,8 @@ void MapWriterPrivate::writeBmpImage(QXmlStreamWriter &w,
     }
 
     w.writeStartElement(QLatin1String("pixels"));
-    QString data;
-    QByteArray tileData;
-    tileData.reserve(bmp.height() * bmp.width() * 4);
-
-    const QRgb black = qRgb(0, 0, 0);
-    for (int y = 0; y < bmp.height(); ++y) {
-        for (int x = 0; x < bmp.width(); ++x) {
-            QRgb rgb = bmp.pixel(x, y);
-            quint32 n = (rgb == black) ? 0 : (colors.indexOf(rgb) + 1);
-            tileData.append((unsigned char) (n)); // FIXME: big/little endian
-            tileData.append((unsigned char) (n >> 8));
-            tileData.append((unsigned char) (n >> 16));
-            tileData.append((unsigned char) (n >> 24));
-        }
-    }
-
-    tileData = compress(tileData, Gzip);
-    data = QString::fromLatin1(tileData.toBase64());
-
     w.writeCharacters(QLatin1String("\n   "));
-    w.writeCharacters(data);
+    w.writeCharacters(payload.data);
     w.writeCharacters(QLatin1String("\n  "));
     w.writeEndElement();
 
@@ -728,16 +912,8 @@ void MapWriterPrivate::writeBmpImage(QXmlStreamWriter &w,
 
 void MapWriterPrivate::writeNoBlend(QXmlStreamWriter &w, MapNoBlend *noBlend)
 {
-    QByteArray data;
-    int numTrue = 0;
-    for (int y = 0; y < noBlend->width(); y++) {
-        for (int x = 0; x < noBlend->height(); x++) {
-            data.append(uchar(noBlend->get(x, y) ? 1 : 0));
-            if (noBlend->get(x, y)) numTrue++;
-        }
-    }
-
-    if (numTrue == 0)
+    const QString chars = mPayloads.takeNext().data;
+    if (chars.isEmpty())
         return;
 
     w.writeStartElement(QLatin1String("bmp-noblend"));
@@ -745,7 +921,6 @@ void MapWriterPrivate::writeNoBlend(QXmlStreamWriter &w, MapNoBlend *noBlend)
 
     w.writeStartElement(QLatin1String("bits"));
     w.writeCharacters(QLatin1String("\n   "));
-    QString chars = QString::fromLatin1(compress(data, Gzip).toBase64());
     w.writeCharacters(chars);
     w.writeCharacters(QLatin1String("\n  "));
     w.writeEndElement(); // bits
@@ -0,0 +1,105 @@
+/*
+ * mipmapcache.cpp
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mipmapcache.h"
+
+#include "tracing.h"
+
+#include <QMutexLocker>
+
+using namespace Tiled;
+
+// 64 MB
+static const int DEFAULT_MAX_KB = 64 * 1024;
+
+MipmapCache *MipmapCache::instance()
+{
+    // Initialized once, safely, by whichever thread gets here first.
+    static MipmapCache cache;
+    return &cache;
+}
+
+MipmapCache::MipmapCache()
+    : mImages(DEFAULT_MAX_KB)
+{
+}
+
+QImage MipmapCache::image(const QImage &source, int level)
+{
+    level = qMin(level, int(MAX_LEVEL));
+    while (level > 0 && (source.width() >> level == 0 || source.height() >> level == 0))
+        --level;
+    if (level == 0 || source.isNull())
+        return source;
+
+    const QPair<qint64,int> key(source.cacheKey(), level);
+    {
+        QMutexLocker locker(&mMutex);
+        if (QImage *image = mImages.object(key))
+            return *image;
+    }
+
+    TRACE_ZONE("MipmapCache::image");
+
+    // Each level is made from the one above it, which halves the work for
+    // the deeper levels and averages all the source pixels.
+    QImage larger = image(source, level - 1);
+    QImage *image = new QImage(larger.scaled((larger.width() + 1) / 2,
+                                             (larger.height() + 1) / 2,
+                                             Qt::IgnoreAspectRatio,
+                                             Qt::SmoothTransformation));
+    QImage result = *image;
+
+    QMutexLocker locker(&mMutex);
+    mImages.insert(key, image, qMax(1, image->bytesPerLine() * image->height() / 1024));
+    return result;
+}
+
+int MipmapCache::levelForScale(qreal scale)
+{
+    int level = 0;
+    while (level < MAX_LEVEL && scale <= 1.0 / (2 << level))
+        ++level;
+    return level;
+}
+
+void MipmapCache::setMaxBytes(int bytes)
+{
+    QMutexLocker locker(&mMutex);
+    mImages.setMaxCost(qMax(1, bytes / 1024));
+}
+
+int MipmapCache::maxBytes()
+{
+    QMutexLocker locker(&mMutex);
+    return mImages.maxCost() * 1024;
+}
+
+void MipmapCache::clear()
+{
+    QMutexLocker locker(&mMutex);
+    mImages.clear();
+}
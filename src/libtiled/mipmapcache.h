@@ -0,0 +1,83 @@
+/*
+ * mipmapcache.h
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MIPMAPCACHE_H
+#define MIPMAPCACHE_H
+
+#include "tiled_global.h"
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QPair>
+
+namespace Tiled {
+
+/**
+ * Keeps downscaled copies (1/2, 1/4 and 1/8 size) of tile images, so that
+ * drawing zoomed-out maps doesn't resample the full-size image every time.
+ *
+ * Images are identified by QImage::cacheKey(), so a tile whose image is
+ * replaced simply stops using its old copies, which are eventually evicted.
+ * The least recently used copies are thrown away once the total size
+ * exceeds the limit.  All the methods may be called from any thread.
+ */
+class TILEDSHARED_EXPORT MipmapCache
+{
+public:
+    enum { MAX_LEVEL = 3 };
+
+    static MipmapCache *instance();
+
+    /**
+     * Returns \a source reduced to 1/(2^level) of its size, creating it if
+     * needed.  Returns \a source itself for level 0 or when the image is
+     * too small to be reduced that much.
+     */
+    QImage image(const QImage &source, int level);
+
+    /**
+     * Returns the smallest level that still has at least as many pixels as
+     * are covered when drawing at \a scale.
+     */
+    static int levelForScale(qreal scale);
+
+    void setMaxBytes(int bytes);
+    int maxBytes();
+
+    void clear();
+
+private:
+    MipmapCache();
+
+    QMutex mMutex;
+    // QCache's cost is an int, so sizes are kept in kilobytes.
+    QCache<QPair<qint64,int>,QImage> mImages;
+};
+
+} // namespace Tiled
+
+#endif // MIPMAPCACHE_H
@@ -30,6 +30,7 @@
 
 #include "map.h"
 #include "mapobject.h"
+#include "spritebatch.h"
 #include "tile.h"
 #include "tilelayer.h"
 #include "tileset.h"
@@ -244,7 +245,11 @@ void OrthogonalRenderer::drawTileLayer(QPainter *painter,
         endY = qMin((int) std::ceil(rect.bottom()) / tileHeight + 1, endY);
     }
 
+#ifdef ZOMBOID
+    SpriteBatch batch(painter);
+#else
     QTransform baseTransform = painter->transform();
+#endif
 
     for (int y = startY; y < endY; ++y) {
         for (int x = startX; x < endX; ++x) {
@@ -288,16 +293,18 @@ void OrthogonalRenderer::drawTileLayer(QPainter *painter,
             }
 
             const QTransform transform(m11, m12, m21, m22, dx, dy);
-            painter->setTransform(transform * baseTransform);
-
 #ifdef ZOMBOID
-            painter->drawImage(0, 0, img);
+            batch.add(&img, transform);
 #else
+            painter->setTransform(transform * baseTransform);
             painter->drawPixmap(0, 0, img);
 #endif
         }
     }
 
+#ifdef ZOMBOID
+    batch.flush();
+#endif
     painter->setTransform(savedTransform);
 }
 
@@ -0,0 +1,111 @@
+/*
+ * spritebatch.cpp
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spritebatch.h"
+
+#include "mipmapcache.h"
+#include "tracing.h"
+
+#include <cmath>
+
+using namespace Tiled;
+
+SpriteBatch::SpriteBatch(QPainter *painter)
+    : mPainter(painter)
+    , mBaseTransform(painter->transform())
+    , mBaseOpacity(painter->opacity())
+{
+    mSprites.reserve(MAX_SPRITES);
+}
+
+SpriteBatch::~SpriteBatch()
+{
+    flush();
+}
+
+// The larger of the horizontal and vertical scale of a transform.
+static qreal transformScale(const QTransform &t)
+{
+    return qMax(std::sqrt(t.m11() * t.m11() + t.m12() * t.m12()),
+                std::sqrt(t.m21() * t.m21() + t.m22() * t.m22()));
+}
+
+void SpriteBatch::flush()
+{
+    if (mSprites.isEmpty())
+        return;
+
+    TRACE_ZONE("SpriteBatch::flush");
+
+    // Downscaled tile images only look the same as the full-size ones when
+    // the painter would have smoothed them anyway.
+    const bool useMipmaps = mPainter->renderHints() & QPainter::SmoothPixmapTransform;
+    const int baseLevel = useMipmaps ? MipmapCache::levelForScale(transformScale(mBaseTransform)) : 0;
+    MipmapCache *mipmaps = MipmapCache::instance();
+
+    // The painter may have been used by someone else since the last flush.
+    bool baseTransform = false;
+    qreal opacity = -1;
+
+    for (const Sprite &sprite : qAsConst(mSprites)) {
+        const QTransform &t = sprite.transform;
+        const QImage &source = *sprite.image;
+        if (sprite.opacity != opacity) {
+            opacity = sprite.opacity;
+            mPainter->setOpacity(opacity * mBaseOpacity);
+        }
+        if (t.type() <= QTransform::TxTranslate) {
+            if (!baseTransform) {
+                mPainter->setTransform(mBaseTransform);
+                baseTransform = true;
+            }
+            if (baseLevel > 0)
+                mPainter->drawImage(QRectF(t.dx(), t.dy(), source.width(), source.height()),
+                                    mipmaps->image(source, baseLevel));
+            else
+                mPainter->drawImage(QPointF(t.dx(), t.dy()), source);
+        } else {
+            const QTransform transform = t * mBaseTransform;
+            mPainter->setTransform(transform);
+            baseTransform = false;
+            int level = useMipmaps ? MipmapCache::levelForScale(transformScale(transform)) : 0;
+            if (level > 0)
+                mPainter->drawImage(QRectF(0, 0, source.width(), source.height()),
+                                    mipmaps->image(source, level));
+            else
+                mPainter->drawImage(0, 0, source);
+        }
+    }
+
+    mSprites.resize(0);
+
+    mPainter->setTransform(mBaseTransform);
+    mPainter->setOpacity(mBaseOpacity);
+}
+
+void SpriteBatch::clear()
+{
+    mSprites.resize(0);
+}
@@ -0,0 +1,104 @@
+/*
+ * spritebatch.h
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SPRITEBATCH_H
+#define SPRITEBATCH_H
+
+#include "tiled_global.h"
+
+#include <QImage>
+#include <QPainter>
+#include <QTransform>
+#include <QVector>
+
+namespace Tiled {
+
+/**
+ * Collects the tile images a renderer wants to draw and submits them to the
+ * painter in the same order, changing the painter's transform and opacity
+ * only when they actually differ from the previous image.
+ *
+ * Tiles that are neither flipped nor scaled, which is nearly all of them, are
+ * drawn with the painter's original transform at a translated position.  The
+ * painter's transform and opacity are restored by flush().
+ *
+ * When the painter smooths scaled images and is zoomed out to half size or
+ * less, the images are drawn from MipmapCache instead of the full-size ones.
+ *
+ * Only pointers to the images are kept, so the images must stay alive until
+ * the batch is flushed.  Tile images do.
+ */
+class TILEDSHARED_EXPORT SpriteBatch
+{
+public:
+    SpriteBatch(QPainter *painter);
+    ~SpriteBatch();
+
+    /**
+     * Adds an image drawn with \a transform (relative to the painter's
+     * transform when the batch was created) and \a opacity (multiplied with
+     * the painter's opacity when the batch was created).
+     */
+    void add(const QImage *image, const QTransform &transform, qreal opacity = 1.0)
+    {
+        Sprite sprite;
+        sprite.image = image;
+        sprite.transform = transform;
+        sprite.opacity = opacity;
+        mSprites.append(sprite);
+        if (mSprites.size() == MAX_SPRITES)
+            flush();
+    }
+
+    /**
+     * Draws everything added so far.
+     */
+    void flush();
+
+    /**
+     * Forgets everything added so far without drawing it, for when drawing
+     * is aborted.
+     */
+    void clear();
+
+private:
+    struct Sprite
+    {
+        const QImage *image;
+        QTransform transform;
+        qreal opacity;
+    };
+
+    enum { MAX_SPRITES = 1024 };
+
+    QPainter *mPainter;
+    QTransform mBaseTransform;
+    qreal mBaseOpacity;
+    QVector<Sprite> mSprites;
+};
+
+} // namespace Tiled
+
+#endif // SPRITEBATCH_H
@@ -22,6 +22,7 @@
 
 #include "map.h"
 #include "mapobject.h"
+#include "spritebatch.h"
 #include "tile.h"
 #include "tilelayer.h"
 #include "tileset.h"
@@ -192,6 +193,9 @@ void StaggeredRenderer::drawTileLayer(QPainter *painter,
     qDebug() << rect << startTile << startPos << layer->position();
 
     QTransform baseTransform = painter->transform();
+#ifdef ZOMBOID
+    SpriteBatch batch(painter);
+#endif
 
     for (; startPos.y() < rect.bottom() && startTile.y() < layer->height(); startTile.ry()++) {
         QPoint rowTile = startTile;
@@ -245,11 +249,10 @@ void StaggeredRenderer::drawTileLayer(QPainter *painter,
             }
 
             const QTransform transform(m11, m12, m21, m22, dx, dy);
-            painter->setTransform(transform * baseTransform);
-
 #ifdef ZOMBOID
-            painter->drawImage(0, 0, img);
+            batch.add(&img, transform);
 #else
+            painter->setTransform(transform * baseTransform);
             painter->drawPixmap(0, 0, img);
 #endif
 
@@ -259,6 +262,9 @@ void StaggeredRenderer::drawTileLayer(QPainter *painter,
         startPos.ry() += tileHeight / 2;
     }
 
+#ifdef ZOMBOID
+    batch.flush();
+#endif
     painter->setTransform(baseTransform);
 }
 
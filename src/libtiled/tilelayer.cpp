@@ -50,6 +50,9 @@ TileLayer::TileLayer(const QString &name, int x, int y, int width, int height):
 {
     Q_ASSERT(width >= 0);
     Q_ASSERT(height >= 0);
+#ifdef ZOMBOID
+    mChunkTilesets.resize(chunksWide() * chunksHigh());
+#endif
 }
 
 QRegion TileLayer::region() const
@@ -116,10 +119,14 @@ void TileLayer::setCell(int x, int y, const Cell &cell)
     }
 
 #ifdef ZOMBOID
-    if (Tile *tile = cellAt(x, y).tile)
+    if (Tile *tile = cellAt(x, y).tile) {
         removeReference(tile->tileset());
-    if (cell.tile)
+        removeChunkReference(x, y, tile->tileset());
+    }
+    if (cell.tile) {
         addReference(cell.tile->tileset());
+        addChunkReference(x, y, cell.tile->tileset());
+    }
 #endif
 
 #if SPARSE_TILELAYER
@@ -202,6 +209,7 @@ void TileLayer::erase()
     mGrid.fill(emptyCell);
 #endif
     mUsedTilesets.clear();
+    mChunkTilesets.fill(QMap<Tileset*,int>());
 }
 #endif
 
@@ -247,6 +255,9 @@ void TileLayer::flip(FlipDirection direction)
 #endif
 
     mGrid = newGrid;
+#ifdef ZOMBOID
+    recountChunkReferences();
+#endif
 }
 
 void TileLayer::rotate(RotateDirection direction)
@@ -301,6 +312,9 @@ void TileLayer::rotate(RotateDirection direction)
     mWidth = newWidth;
     mHeight = newHeight;
     mGrid = newGrid;
+#ifdef ZOMBOID
+    recountChunkReferences();
+#endif
 }
 
 
@@ -337,6 +351,41 @@ bool TileLayer::referencesTileset(const Tileset *tileset) const
 
 QRegion TileLayer::tilesetReferences(Tileset *tileset) const
 {
+#ifdef ZOMBOID
+    // One rectangle per run of cells in each row, built in the banded order
+    // that setRects() wants.
+    QVector<QRect> rects;
+    const int columns = chunksWide();
+    QVector<int> usedColumns;
+    for (int cy = 0, cy_end = chunksHigh(); cy < cy_end; ++cy) {
+        usedColumns.clear();
+        for (int cx = 0; cx < columns; ++cx)
+            if (mChunkTilesets[cy * columns + cx].contains(tileset))
+                usedColumns += cx;
+        if (usedColumns.isEmpty())
+            continue;
+        const int yEnd = qMin(mHeight, (cy + 1) * ChunkSize);
+        for (int y = cy * ChunkSize; y < yEnd; ++y) {
+            for (int cx : qAsConst(usedColumns)) {
+                const int xEnd = qMin(mWidth, (cx + 1) * ChunkSize);
+                for (int x = cx * ChunkSize; x < xEnd; ++x) {
+                    const Tile *tile = cellAt(x, y).tile;
+                    if (!tile || tile->tileset() != tileset)
+                        continue;
+                    if (!rects.isEmpty() && rects.last().top() == y + mY &&
+                            rects.last().right() == x + mX - 1)
+                        rects.last().setRight(x + mX);
+                    else
+                        rects += QRect(x + mX, y + mY, 1, 1);
+                }
+            }
+        }
+    }
+
+    QRegion region;
+    region.setRects(rects.constData(), rects.size());
+    return region;
+#else
     QRegion region;
 
     for (int y = 0; y < mHeight; ++y)
@@ -346,10 +395,28 @@ QRegion TileLayer::tilesetReferences(Tileset *tileset) const
                     region += QRegion(x + mX, y + mY, 1, 1);
 
     return region;
+#endif
 }
 
 void TileLayer::removeReferencesToTileset(Tileset *tileset)
 {
+#ifdef ZOMBOID
+    for (int i = 0, i_end = mChunkTilesets.size(); i < i_end; ++i) {
+        if (!mChunkTilesets.at(i).contains(tileset))
+            continue;
+        const QRect r = chunkBounds(i);
+        for (int y = r.top(); y <= r.bottom(); ++y) {
+            for (int x = r.left(); x <= r.right(); ++x) {
+                const Tile *tile = cellAt(x, y).tile;
+                if (tile && tile->tileset() == tileset) {
+                    removeReference(tileset);
+                    mGrid.replace(x, y, Cell());
+                }
+            }
+        }
+        mChunkTilesets[i].remove(tileset);
+    }
+#else
     for (int i = 0, i_end = mGrid.size(); i < i_end; ++i) {
         const Tile *tile = mGrid.at(i).tile;
 #ifdef ZOMBOID
@@ -362,11 +429,32 @@ void TileLayer::removeReferencesToTileset(Tileset *tileset)
             mGrid.replace(i, Cell());
 #endif
     }
+#endif
 }
 
 void TileLayer::replaceReferencesToTileset(Tileset *oldTileset,
                                            Tileset *newTileset)
 {
+#ifdef ZOMBOID
+    for (int i = 0, i_end = mChunkTilesets.size(); i < i_end; ++i) {
+        if (!mChunkTilesets.at(i).contains(oldTileset))
+            continue;
+        const QRect r = chunkBounds(i);
+        for (int y = r.top(); y <= r.bottom(); ++y) {
+            for (int x = r.left(); x <= r.right(); ++x) {
+                const Tile *tile = cellAt(x, y).tile;
+                if (tile && tile->tileset() == oldTileset) {
+                    removeReference(oldTileset);
+                    addReference(newTileset);
+                    mGrid.setTile(x + y * mWidth, newTileset->tileAt(tile->id()));
+                }
+            }
+        }
+        QMap<Tileset*,int> &counts = mChunkTilesets[i];
+        const int count = counts.take(oldTileset);
+        counts[newTileset] += count;
+    }
+#else
     for (int i = 0, i_end = mGrid.size(); i < i_end; ++i) {
         const Tile *tile = mGrid.at(i).tile;
 #ifdef ZOMBOID
@@ -382,6 +470,7 @@ void TileLayer::replaceReferencesToTileset(Tileset *oldTileset,
             mGrid[i].tile = newTileset->tileAt(tile->id());
 #endif
     }
+#endif
 }
 
 void TileLayer::resize(const QSize &size, const QPoint &offset)
@@ -419,6 +508,9 @@ void TileLayer::resize(const QSize &size, const QPoint &offset)
 
     mGrid = newGrid;
     Layer::resize(size, offset);
+#ifdef ZOMBOID
+    recountChunkReferences();
+#endif
 }
 
 void TileLayer::offset(const QPoint &offset,
@@ -493,6 +585,9 @@ void TileLayer::offset(const QPoint &offset,
     }
 
     mGrid = newGrid;
+#ifdef ZOMBOID
+    recountChunkReferences();
+#endif
 }
 
 bool TileLayer::canMergeWith(Layer *other) const
@@ -553,6 +648,50 @@ bool TileLayer::isEmpty() const
 #endif
 }
 
+#ifdef ZOMBOID
+qint64 TileLayer::memoryUsage() const
+{
+#if SPARSE_TILELAYER
+    return mGrid.memoryUsage();
+#else
+    return qint64(mGrid.size()) * sizeof(Cell);
+#endif
+}
+
+QRect TileLayer::chunkBounds(int index) const
+{
+    const int columns = chunksWide();
+    return QRect((index % columns) * ChunkSize, (index / columns) * ChunkSize,
+                 ChunkSize, ChunkSize) & QRect(0, 0, mWidth, mHeight);
+}
+
+void TileLayer::addChunkReference(int x, int y, Tileset *ts)
+{
+    mChunkTilesets[chunkIndex(x, y)][ts]++;
+}
+
+void TileLayer::removeChunkReference(int x, int y, Tileset *ts)
+{
+    QMap<Tileset*,int> &counts = mChunkTilesets[chunkIndex(x, y)];
+    QMap<Tileset*,int>::iterator it = counts.find(ts);
+    Q_ASSERT(it != counts.end());
+    if (it != counts.end() && --(*it) <= 0)
+        counts.erase(it);
+}
+
+// Called after the cells were moved around or the layer was resized.
+void TileLayer::recountChunkReferences()
+{
+    mChunkTilesets.fill(QMap<Tileset*,int>(), chunksWide() * chunksHigh());
+    if (mGrid.isEmpty())
+        return;
+    for (int y = 0; y < mHeight; ++y)
+        for (int x = 0; x < mWidth; ++x)
+            if (Tile *tile = cellAt(x, y).tile)
+                addChunkReference(x, y, tile->tileset());
+}
+#endif
+
 /**
  * Returns a duplicate of this TileLayer.
  *
@@ -571,6 +710,7 @@ TileLayer *TileLayer::initializeClone(TileLayer *clone) const
     clone->mOffsetMargins = mOffsetMargins;
 #ifdef ZOMBOID
     /* don't clone the group! */
+    clone->mChunkTilesets = mChunkTilesets;
 #endif
     return clone;
 }
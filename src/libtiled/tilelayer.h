@@ -161,6 +161,18 @@ public:
     bool isEmpty() const
     { return !mUseVector && mCells.isEmpty(); }
 
+    /**
+     * Returns the approximate number of bytes used to store the cells.
+     * For the hash, each node is assumed to cost a key, a next pointer and
+     * the cached hash value on top of the cell itself.
+     */
+    qint64 memoryUsage() const
+    {
+        if (mUseVector)
+            return qint64(mCellsVector.size()) * sizeof(Cell);
+        return qint64(mCells.size()) * (sizeof(Cell) + sizeof(int) * 2 + sizeof(void*));
+    }
+
     void clear()
     {
         if (mUseVector)
@@ -379,12 +391,38 @@ public:
 #ifdef ZOMBOID
     void setGroup(ZTileLayerGroup *group) { mTileLayerGroup = group; }
     ZTileLayerGroup *group() const { return mTileLayerGroup; }
+
+    /**
+     * Returns the approximate number of bytes used by this layer's cells.
+     */
+    qint64 memoryUsage() const;
 #endif
 
 protected:
     TileLayer *initializeClone(TileLayer *clone) const;
 
 private:
+#ifdef ZOMBOID
+    // The cells are split into square chunks, and each chunk counts the tiles
+    // it has from each tileset.  The per-tileset queries and edits above then
+    // only visit the chunks that use the tileset.
+    enum { ChunkSize = 16 };
+
+    int chunksWide() const
+    { return (mWidth + ChunkSize - 1) / ChunkSize; }
+
+    int chunksHigh() const
+    { return (mHeight + ChunkSize - 1) / ChunkSize; }
+
+    int chunkIndex(int x, int y) const
+    { return (y / ChunkSize) * chunksWide() + x / ChunkSize; }
+
+    QRect chunkBounds(int index) const;
+    void addChunkReference(int x, int y, Tileset *ts);
+    void removeChunkReference(int x, int y, Tileset *ts);
+    void recountChunkReferences();
+#endif
+
     QSize mMaxTileSize;
     QMargins mOffsetMargins;
     ZTileLayerGroup *mTileLayerGroup;
@@ -393,6 +431,9 @@ private:
 #else
     QVector<Cell> mGrid;
 #endif
+#ifdef ZOMBOID
+    QVector<QMap<Tileset*,int> > mChunkTilesets;
+#endif
 };
 
 } // namespace Tiled
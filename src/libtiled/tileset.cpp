@@ -209,6 +209,19 @@ bool Tileset::loadFromNothing(const QSize &imageSize, const QString &fileName)
     return true;
 }
 
+static Tileset::ImageRequestHandler gImageRequestHandler = 0;
+
+void Tileset::requestImage()
+{
+    if (gImageRequestHandler)
+        gImageRequestHandler(this);
+}
+
+void Tileset::setImageRequestHandler(ImageRequestHandler handler)
+{
+    gImageRequestHandler = handler;
+}
+
 #endif // ZOMBOID
 
 Tileset *Tileset::findSimilarTileset(const QList<Tileset*> &tilesets) const
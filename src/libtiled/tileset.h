@@ -265,6 +265,16 @@ public:
     bool isLoaded() const
     { return mLoaded; }
 
+    /**
+     * Asks for this tileset's image to be read.  Renderers call this when
+     * they draw a tile from a tileset that isn't loaded yet, and draw a
+     * placeholder until it is.  May be called from any thread.
+     */
+    void requestImage();
+
+    typedef void (*ImageRequestHandler)(Tileset *tileset);
+    static void setImageRequestHandler(ImageRequestHandler handler);
+
     void setImageSource2x(const QString &source)
     { mImageSource2x = source; }
 
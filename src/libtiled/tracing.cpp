@@ -0,0 +1,342 @@
+/*
+ * tracing.cpp
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tracing.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QThread>
+
+#include <atomic>
+#include <vector>
+
+using namespace Tiled;
+
+namespace {
+
+// Number of events kept per thread.  Older events are overwritten.
+const int RING_BUFFER_SIZE = 64 * 1024;
+
+// Number of frame times kept for the live view.
+const int FRAME_HISTORY_SIZE = 300;
+
+struct Event
+{
+    const char *name;
+    qint64 start;
+    qint64 value; // duration for zones, new total for counters
+    char phase; // 'X' (zone) or 'C' (counter), as in the Chrome trace format
+};
+
+// Set while a trace is being written out or the buffers are cleared.  Events
+// recorded meanwhile are dropped.
+std::atomic<bool> gPaused(false);
+
+// Each thread writes only to its own buffer, without locking.  Readers set
+// gPaused and then wait for a writer that is in the middle of adding an event,
+// see PauseWriters.
+struct ThreadBuffer
+{
+    ThreadBuffer(int id, const QString &name)
+        : id(id)
+        , name(name)
+        , events(RING_BUFFER_SIZE)
+        , count(0)
+        , busy(false)
+    {
+    }
+
+    void add(const Event &event)
+    {
+        busy.store(true);
+        if (!gPaused.load()) {
+            quint64 n = count.load(std::memory_order_relaxed);
+            events[n % RING_BUFFER_SIZE] = event;
+            count.store(n + 1, std::memory_order_relaxed);
+        }
+        busy.store(false);
+    }
+
+    // Returns the events still in the buffer, oldest first.  Writers must be
+    // paused.
+    QVector<Event> snapshot() const
+    {
+        quint64 n = count.load(std::memory_order_relaxed);
+        quint64 first = (n > quint64(RING_BUFFER_SIZE)) ? n - RING_BUFFER_SIZE : 0;
+        QVector<Event> result;
+        result.reserve(int(n - first));
+        for (quint64 i = first; i < n; ++i)
+            result += events[i % RING_BUFFER_SIZE];
+        return result;
+    }
+
+    int id;
+    QString name; // protected by Globals::mutex
+    std::vector<Event> events;
+    std::atomic<quint64> count; // number of events ever added
+    std::atomic<bool> busy;
+};
+
+struct Globals
+{
+    Globals()
+    {
+        timer.start();
+    }
+
+    QElapsedTimer timer;
+    QMutex mutex; // protects everything below
+    QList<ThreadBuffer*> buffers;
+    // Buffers of threads that have finished, for the next new thread.  Thread
+    // pools start and retire threads all the time, so this keeps the number
+    // of buffers down to the most threads that were ever running at once.
+    QList<ThreadBuffer*> freeBuffers;
+    QMap<QString,qint64> counters;
+    QVector<qint64> frameTimes;
+};
+
+std::atomic<bool> gEnabled(true);
+
+Globals *globals()
+{
+    static Globals g;
+    return &g;
+}
+
+// Stops the threads from adding events while the buffers are read or
+// cleared.  Must be used with Globals::mutex locked.
+class PauseWriters
+{
+public:
+    PauseWriters(const QList<ThreadBuffer*> &buffers)
+    {
+        gPaused.store(true);
+        for (const ThreadBuffer *buffer : buffers) {
+            while (buffer->busy.load())
+                QThread::yieldCurrentThread();
+        }
+    }
+
+    ~PauseWriters()
+    {
+        gPaused.store(false);
+    }
+};
+
+// Gives the calling thread's buffer back when the thread finishes.
+struct ThreadBufferOwner
+{
+    ThreadBuffer *buffer = nullptr;
+
+    ~ThreadBufferOwner()
+    {
+        if (buffer) {
+            Globals *g = globals();
+            QMutexLocker locker(&g->mutex);
+            g->freeBuffers += buffer;
+        }
+    }
+};
+
+thread_local ThreadBuffer *tThreadBuffer = nullptr;
+thread_local ThreadBufferOwner tThreadBufferOwner;
+
+ThreadBuffer *threadBuffer()
+{
+    if (!tThreadBuffer) {
+        Globals *g = globals();
+        QMutexLocker locker(&g->mutex);
+        QString name = QThread::currentThread()->objectName();
+        if (name.isEmpty() && QCoreApplication::instance() &&
+                QThread::currentThread() == QCoreApplication::instance()->thread())
+            name = QLatin1String("Main");
+        if (!g->freeBuffers.isEmpty()) {
+            // The events of the thread that had it stay in the buffer, and
+            // unnamed threads keep showing up under its name.
+            tThreadBuffer = g->freeBuffers.takeLast();
+            if (!name.isEmpty())
+                tThreadBuffer->name = name;
+        } else {
+            if (name.isEmpty())
+                name = QString(QLatin1String("Thread %1")).arg(g->buffers.size());
+            tThreadBuffer = new ThreadBuffer(g->buffers.size() + 1, name);
+            g->buffers += tThreadBuffer;
+        }
+        tThreadBufferOwner.buffer = tThreadBuffer;
+    }
+    return tThreadBuffer;
+}
+
+QString escaped(const QString &s)
+{
+    QString result = s;
+    result.replace(QLatin1Char('\\'), QLatin1String("\\\\"));
+    result.replace(QLatin1Char('"'), QLatin1String("\\\""));
+    return result;
+}
+
+} // namespace
+
+qint64 Tracing::now()
+{
+    return globals()->timer.nsecsElapsed();
+}
+
+bool Tracing::isEnabled()
+{
+    return gEnabled.load(std::memory_order_relaxed);
+}
+
+void Tracing::setEnabled(bool enabled)
+{
+    gEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Tracing::recordZone(const char *name, qint64 start, qint64 duration)
+{
+    Event event = { name, start, duration, 'X' };
+    threadBuffer()->add(event);
+}
+
+void Tracing::addToCounter(const char *name, qint64 delta)
+{
+    Globals *g = globals();
+    qint64 value;
+    {
+        QMutexLocker locker(&g->mutex);
+        value = (g->counters[QLatin1String(name)] += delta);
+    }
+    if (!isEnabled())
+        return;
+    Event event = { name, now(), value, 'C' };
+    threadBuffer()->add(event);
+}
+
+QList<QPair<QString,qint64> > Tracing::counters()
+{
+    Globals *g = globals();
+    QMutexLocker locker(&g->mutex);
+    QList<QPair<QString,qint64> > result;
+    QMap<QString,qint64>::const_iterator it = g->counters.constBegin();
+    for (; it != g->counters.constEnd(); ++it)
+        result += qMakePair(it.key(), it.value());
+    return result;
+}
+
+void Tracing::recordFrame(qint64 duration)
+{
+    Globals *g = globals();
+    QMutexLocker locker(&g->mutex);
+    if (g->frameTimes.size() == FRAME_HISTORY_SIZE)
+        g->frameTimes.remove(0);
+    g->frameTimes += duration;
+}
+
+QVector<qint64> Tracing::frameTimes()
+{
+    Globals *g = globals();
+    QMutexLocker locker(&g->mutex);
+    return g->frameTimes;
+}
+
+void Tracing::clear()
+{
+    Globals *g = globals();
+    QMutexLocker locker(&g->mutex);
+    {
+        PauseWriters pause(g->buffers);
+        for (ThreadBuffer *buffer : qAsConst(g->buffers))
+            buffer->count.store(0, std::memory_order_relaxed);
+    }
+    g->frameTimes.clear();
+}
+
+bool Tracing::writeChromeTrace(const QString &fileName, QString *error)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        if (error)
+            *error = file.errorString();
+        return false;
+    }
+
+    QTextStream ts(&file);
+    ts << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    // Copy the events out first, so the threads are only held up for as long
+    // as that takes and not while the file is written.
+    struct Thread
+    {
+        int id;
+        QString name;
+        QVector<Event> events;
+    };
+    QVector<Thread> threads;
+    {
+        Globals *g = globals();
+        QMutexLocker locker(&g->mutex);
+        PauseWriters pause(g->buffers);
+        for (const ThreadBuffer *buffer : qAsConst(g->buffers)) {
+            Thread thread = { buffer->id, buffer->name, buffer->snapshot() };
+            threads += thread;
+        }
+    }
+
+    bool first = true;
+    for (const Thread &thread : qAsConst(threads)) {
+        if (!first)
+            ts << ",\n";
+        first = false;
+        ts << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.id
+           << ",\"args\":{\"name\":\"" << escaped(thread.name) << "\"}}";
+
+        for (const Event &event : thread.events) {
+            QString name = escaped(QLatin1String(event.name));
+            // Chrome trace timestamps are in microseconds.
+            ts << ",\n{\"name\":\"" << name << "\",\"ph\":\"" << QLatin1Char(event.phase)
+               << "\",\"pid\":1,\"tid\":" << thread.id
+               << ",\"ts\":" << QString::number(event.start / 1000.0, 'f', 3);
+            if (event.phase == 'X')
+                ts << ",\"dur\":" << QString::number(event.value / 1000.0, 'f', 3) << "}";
+            else
+                ts << ",\"args\":{\"value\":" << event.value << "}}";
+        }
+    }
+
+    ts << "\n]}\n";
+    ts.flush();
+
+    if (file.error() != QFile::NoError) {
+        if (error)
+            *error = file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,151 @@
+/*
+ * tracing.h
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TRACING_H
+#define TRACING_H
+
+#include "tiled_global.h"
+
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+namespace Tiled {
+namespace Tracing {
+
+/**
+ * Returns the number of nanoseconds since tracing was first used.
+ */
+TILEDSHARED_EXPORT qint64 now();
+
+/**
+ * Recording can be switched on and off at runtime.  It is on by default
+ * when ZOMBOID_TRACING is defined.
+ */
+TILEDSHARED_EXPORT bool isEnabled();
+TILEDSHARED_EXPORT void setEnabled(bool enabled);
+
+/**
+ * Adds a completed zone to the calling thread's ring buffer.  The name must
+ * be a string literal, only the pointer is stored.
+ */
+TILEDSHARED_EXPORT void recordZone(const char *name, qint64 start, qint64 duration);
+
+/**
+ * Changes a named counter, for example the number of jobs queued in a
+ * worker thread.  Every change is also recorded so it shows up in the
+ * exported trace.
+ */
+TILEDSHARED_EXPORT void addToCounter(const char *name, qint64 delta);
+TILEDSHARED_EXPORT QList<QPair<QString,qint64> > counters();
+
+/**
+ * Remembers how long the last frame took to paint.
+ */
+TILEDSHARED_EXPORT void recordFrame(qint64 duration);
+
+/**
+ * Returns the most recent frame durations in nanoseconds, oldest first.
+ */
+TILEDSHARED_EXPORT QVector<qint64> frameTimes();
+
+/**
+ * Discards all recorded zones, counter changes and frame times.
+ */
+TILEDSHARED_EXPORT void clear();
+
+/**
+ * Writes everything still in the ring buffers as a Chrome trace (the JSON
+ * format read by chrome://tracing and Perfetto).
+ */
+TILEDSHARED_EXPORT bool writeChromeTrace(const QString &fileName, QString *error = 0);
+
+class ScopedZone
+{
+public:
+    ScopedZone(const char *name)
+        : mName(name)
+        , mStart(isEnabled() ? now() : -1)
+    {
+    }
+
+    ~ScopedZone()
+    {
+        if (mStart >= 0)
+            recordZone(mName, mStart, now() - mStart);
+    }
+
+private:
+    const char *mName;
+    qint64 mStart;
+};
+
+class ScopedFrame
+{
+public:
+    ScopedFrame(const char *name)
+        : mName(name)
+        , mStart(isEnabled() ? now() : -1)
+    {
+    }
+
+    ~ScopedFrame()
+    {
+        if (mStart >= 0) {
+            qint64 duration = now() - mStart;
+            recordZone(mName, mStart, duration);
+            recordFrame(duration);
+        }
+    }
+
+private:
+    const char *mName;
+    qint64 mStart;
+};
+
+} // namespace Tracing
+} // namespace Tiled
+
+/*
+ * The macros below are what the rest of the code uses.  Without
+ * ZOMBOID_TRACING (qmake CONFIG+=tracing) they expand to nothing.
+ */
+#ifdef ZOMBOID_TRACING
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) \
+    Tiled::Tracing::ScopedZone TRACE_CONCAT(traceZone_, __LINE__)(name)
+#define TRACE_FRAME(name) \
+    Tiled::Tracing::ScopedFrame TRACE_CONCAT(traceFrame_, __LINE__)(name)
+#define TRACE_COUNTER_ADD(name, delta) \
+    Tiled::Tracing::addToCounter(name, delta)
+#else
+#define TRACE_ZONE(name) do { } while (0)
+#define TRACE_FRAME(name) do { } while (0)
+#define TRACE_COUNTER_ADD(name, delta) do { } while (0)
+#endif
+
+#endif // TRACING_H
@@ -28,15 +28,18 @@
 #include "map.h"
 #include "mapobject.h"
 #include "objectgroup.h"
+#include "spritebatch.h"
 #include "tile.h"
 #include "tilelayer.h"
 #include "tileset.h"
+#include "tracing.h"
 #include "imagelayer.h"
 #include "ztilelayergroup.h"
 
 #include <cmath>
 
 #include <QPainterPath>
+#include <QSet>
 
 using namespace Tiled;
 
@@ -193,6 +196,15 @@ void ZLevelRenderer::drawGrid(QPainter *painter, const QRectF &rect,
 
 static Tile *g_missing_tile = 0;
 
+// Asks once per draw for the image of a tileset that isn't loaded yet.
+static void requestImage(Tileset *tileset, QSet<Tileset*> &requested)
+{
+    if (tileset->isLoaded() || tileset->isMissing() || requested.contains(tileset))
+        return;
+    requested += tileset;
+    tileset->requestImage();
+}
+
 void ZLevelRenderer::drawTileLayer(QPainter *painter,
                                       const TileLayer *layer,
                                       const QRectF &exposed) const
@@ -253,22 +265,28 @@ void ZLevelRenderer::drawTileLayer(QPainter *painter,
     bool shifted = inUpperHalf ^ inLeftHalf;
 
     QTransform baseTransform = painter->transform();
+    SpriteBatch batch(painter);
+    QSet<Tileset*> requested;
 
     for (int y = startPos.y(); y - tileHeight < rect.bottom();
          y += tileHeight / 2)
     {
+        // Multi-threading
+        if (mAbortDrawing && *mAbortDrawing) {
+            batch.clear();
+            painter->setTransform(baseTransform);
+            return;
+        }
+
         QPoint columnItr = rowItr;
 
         for (int x = startPos.x(); x < rect.right(); x += tileWidth) {
-            // Multi-threading
-            if (mAbortDrawing && *mAbortDrawing) {
-                painter->setTransform(baseTransform);
-                return;
-            }
             if (layer->contains(columnItr)) {
                 const Cell &cell = layer->cellAt(columnItr);
                 if (!cell.isEmpty()) {
-                    QImage img = cell.tile->image();
+                    const QImage &img = cell.tile->image();
+                    if (img.isNull())
+                        requestImage(cell.tile->tileset(), requested);
                     const QPoint offset = cell.tile->tileset()->tileOffset() + cell.tile->offset();
 
                     qreal m11 = 1;      // Horizontal scaling factor
@@ -314,9 +332,7 @@ void ZLevelRenderer::drawTileLayer(QPainter *painter,
                     }
 
                     const QTransform transform(m11, m12, m21, m22, dx, dy);
-                    painter->setTransform(transform * baseTransform);
-
-                    painter->drawImage(0, 0, img);
+                    batch.add(&img, transform);
                 }
             }
 
@@ -337,6 +353,7 @@ void ZLevelRenderer::drawTileLayer(QPainter *painter,
         }
     }
 
+    batch.flush();
     painter->setTransform(baseTransform);
 }
 
@@ -344,6 +361,7 @@ void ZLevelRenderer::drawTileLayer(QPainter *painter,
 void ZLevelRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *layerGroup,
                             const QRectF &exposed) const
 {
+    TRACE_ZONE("ZLevelRenderer::drawTileLayerGroup");
     const int tileWidth = DISPLAY_TILE_WIDTH;
     const int tileHeight = DISPLAY_TILE_HEIGHT;
 
@@ -402,26 +420,31 @@ void ZLevelRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *laye
 
     layerGroup->prepareDrawing(this, rect);
 
-    qreal opacity = painter->opacity();
+    SpriteBatch batch(painter);
+    QSet<Tileset*> requested;
 
     for (int y = startPos.y(); y - tileHeight < rect.bottom();
          y += tileHeight / 2)
     {
+        // Multi-threading
+        if (mAbortDrawing && *mAbortDrawing) {
+            batch.clear();
+            painter->setTransform(baseTransform);
+            return;
+        }
+
         QPoint columnItr = rowItr;
 
         for (int x = startPos.x(); x < rect.right(); x += tileWidth) {
             cells.resize(0);
             if (layerGroup->orderedCellsAt(columnItr, cells, opacities)) {
                 for (int i = 0; i < cells.size(); i++) {
-                    // Multi-threading
-                    if (mAbortDrawing && *mAbortDrawing) {
-                        painter->setTransform(baseTransform);
-                        return;
-                    }
                     const Cell *cell = cells[i];
                     if (!cell->isEmpty()) {
                         Tile *tile = cell->tile;
                         if (tile->image().isNull()) {
+                            // Draw a placeholder until the image is loaded.
+                            requestImage(tile->tileset(), requested);
                             if (g_missing_tile == 0) {
                                 Tileset *ts = new Tileset(QLatin1String("MISSING"), 64, 128);
                                 if (ts->loadFromImage(QImage(QLatin1String(":/images/missing-tile.png")), QLatin1String(":/images/missing-tile.png"))) {
@@ -431,7 +454,7 @@ void ZLevelRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *laye
                             if (g_missing_tile)
                                 tile = g_missing_tile;
                         }
-                        QImage img = tile->image();
+                        const QImage &img = tile->image();
                         const QPoint offset = tile->tileset()->tileOffset() + tile->offset();
 
                         qreal m11 = 1;      // Horizontal scaling factor
@@ -480,11 +503,7 @@ void ZLevelRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *laye
                         }
 
                         const QTransform transform(m11, m12, m21, m22, dx, dy);
-                        painter->setTransform(transform * baseTransform);
-
-                        painter->setOpacity(opacities[i] * opacity);
-
-                        painter->drawImage(0, 0, img);
+                        batch.add(&img, transform, opacities[i]);
                     }
                 }
             }
@@ -506,6 +525,7 @@ void ZLevelRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *laye
         }
     }
 
+    batch.flush();
     painter->setTransform(baseTransform);
 }
 #endif // ZOMBOID
@@ -1332,6 +1332,7 @@ void BuildingEditorWindow::exportNewBinary()
     MapComposite mapComposite(mapInfo);
 
     NewMapBinaryFile file;
+    file.setIncremental(true);
     file.write(&mapComposite, fileName);
 }
 
@@ -59,7 +59,8 @@ BuildingTilesMgr::BuildingTilesMgr() :
     mNoneTiledTile(0),
     mNoneBuildingTile(0),
     mNoneCategory(0),
-    mNoneTileEntry(0)
+    mNoneTileEntry(0),
+    mTilesetRevision(0)
 {
     mCatCurtains = new BTC_Curtains(QLatin1String("Curtains"));
     mCatDoors = new BTC_Doors(QLatin1String("Doors"));
@@ -123,6 +124,13 @@ BuildingTilesMgr::BuildingTilesMgr() :
     mNoneCategory = new NoneBuildingTileCategory();
     mNoneTileEntry = new NoneBuildingTileEntry(mNoneCategory);
 
+    // Connected before the forwarded signals so the cached tile lookups are
+    // already cleared when anyone else hears about the change.
+    connect(TileMetaInfoMgr::instance(), &TileMetaInfoMgr::tilesetAdded,
+            this, &BuildingTilesMgr::tilesetsChanged);
+    connect(TileMetaInfoMgr::instance(), &TileMetaInfoMgr::tilesetRemoved,
+            this, &BuildingTilesMgr::tilesetsChanged);
+
     // Forward these signals (backwards compatibility).
     connect(TileMetaInfoMgr::instance(), &TileMetaInfoMgr::tilesetAdded,
             this, &BuildingTilesMgr::tilesetAdded);
@@ -130,6 +138,7 @@ BuildingTilesMgr::BuildingTilesMgr() :
             this, &BuildingTilesMgr::tilesetAboutToBeRemoved);
     connect(TileMetaInfoMgr::instance(), &TileMetaInfoMgr::tilesetRemoved,
              this, &BuildingTilesMgr::tilesetRemoved);
+
 }
 
 BuildingTilesMgr::~BuildingTilesMgr()
@@ -146,9 +155,10 @@ BuildingTile *BuildingTilesMgr::add(const QString &tileName)
     int tileIndex;
     parseTileName(tileName, tilesetName, tileIndex);
     BuildingTile *btile = new BuildingTile(tilesetName, tileIndex);
-    Q_ASSERT(!mTileByName.contains(btile->name()));
-    mTileByName[btile->name()] = btile;
-    mTiles = mTileByName.values(); // sorted by increasing tileset name and tile index!
+    QString name = btile->name();
+    Q_ASSERT(!mTileByName.contains(name));
+    mTileByName[name] = btile;
+    mTileByAnyName[name] = btile;
     return btile;
 }
 
@@ -157,11 +167,19 @@ BuildingTile *BuildingTilesMgr::get(const QString &tileName, int offset)
     if (tileName.isEmpty())
         return noneTile();
 
+    if (offset == 0) {
+        if (BuildingTile *btile = mTileByAnyName.value(tileName))
+            return btile;
+    }
+
     QString adjustedName = adjustTileNameIndex(tileName, offset); // also normalized
 
-    if (!mTileByName.contains(adjustedName))
-        add(adjustedName);
-    return mTileByName[adjustedName];
+    BuildingTile *btile = mTileByName.value(adjustedName);
+    if (!btile)
+        btile = add(adjustedName);
+    if (offset == 0)
+        mTileByAnyName[tileName] = btile;
+    return btile;
 }
 
 QString BuildingTilesMgr::nameForTile(const QString &tilesetName, int index)
@@ -187,19 +205,10 @@ bool BuildingTilesMgr::parseTileName(const QString &tileName, QString &tilesetNa
     int n = tileName.lastIndexOf(QLatin1Char('_'));
     if (n == -1)
         return false;
-    tilesetName = tileName.mid(0, n);
-    QString indexString = tileName.mid(n + 1);
-    // Strip leading zeroes from the tile index
-#if 1
-    int i = 0;
-    while (i < indexString.length() - 1 && indexString[i] == QLatin1Char('0'))
-        i++;
-    indexString.remove(0, i);
-#else
-    indexString.remove( QRegExp(QLatin1String("^[0]*")) );
-#endif
+    tilesetName = tileName.left(n);
+    // Leading zeroes in the tile index are fine, toUInt() uses base 10.
     bool ok;
-    index = indexString.toUInt(&ok);
+    index = QStringView(tileName).mid(n + 1).toUInt(&ok);
     return !tilesetName.isEmpty() && ok;
 }
 
@@ -627,22 +636,35 @@ bool BuildingTilesMgr::mergeTxt()
 
 Tiled::Tile *BuildingTilesMgr::tileFor(const QString &tileName)
 {
-    QString tilesetName;
-    int index;
-    parseTileName(tileName, tilesetName, index);
-    Tileset *tileset = TileMetaInfoMgr::instance()->tileset(tilesetName);
+    QHash<QString,ResolvedTileName>::const_iterator it = mResolvedTileNames.constFind(tileName);
+    if (it == mResolvedTileNames.constEnd()) {
+        QString tilesetName;
+        int index = 0;
+        parseTileName(tileName, tilesetName, index);
+        ResolvedTileName resolved;
+        resolved.mTileset = TileMetaInfoMgr::instance()->tileset(tilesetName);
+        resolved.mIndex = index;
+        it = mResolvedTileNames.insert(tileName, resolved);
+    }
+    // The tile count is checked every time, it changes when a tileset's
+    // image is loaded.
+    Tileset *tileset = it->mTileset;
     if (!tileset)
         return mMissingTile;
-    if (index >= tileset->tileCount())
+    if (it->mIndex >= tileset->tileCount())
         return mMissingTile;
-    return tileset->tileAt(index);
+    return tileset->tileAt(it->mIndex);
 }
 
 Tile *BuildingTilesMgr::tileFor(BuildingTile *tile, int offset)
 {
     if (tile->isNone())
         return mNoneTiledTile;
-    Tileset *tileset = TileMetaInfoMgr::instance()->tileset(tile->mTilesetName);
+    if (tile->mTilesetRevision != mTilesetRevision) {
+        tile->mTileset = TileMetaInfoMgr::instance()->tileset(tile->mTilesetName);
+        tile->mTilesetRevision = mTilesetRevision;
+    }
+    Tileset *tileset = tile->mTileset;
     if (!tileset)
         return mMissingTile;
     if (tile->mIndex + offset >= tileset->tileCount())
@@ -650,6 +672,12 @@ Tile *BuildingTilesMgr::tileFor(BuildingTile *tile, int offset)
     return tileset->tileAt(tile->mIndex + offset);
 }
 
+void BuildingTilesMgr::tilesetsChanged()
+{
+    mResolvedTileNames.clear();
+    ++mTilesetRevision;
+}
+
 BuildingTile *BuildingTilesMgr::fromTiledTile(Tile *tile)
 {
     if (tile == mNoneTiledTile)
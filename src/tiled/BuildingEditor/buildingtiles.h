@@ -18,6 +18,7 @@
 #ifndef BUILDINGTILES_H
 #define BUILDINGTILES_H
 
+#include <QHash>
 #include <QImage>
 #include <QMap>
 #include <QObject>
@@ -40,7 +41,9 @@ class BuildingTile
 public:
     BuildingTile(const QString &tilesetName, int index) :
         mTilesetName(tilesetName),
-        mIndex(index)
+        mIndex(index),
+        mTileset(0),
+        mTilesetRevision(-1)
     {}
     virtual ~BuildingTile() {}
 
@@ -51,6 +54,11 @@ public:
 
     QString mTilesetName;
     int mIndex;
+
+    // The tileset named mTilesetName, looked up by BuildingTilesMgr::tileFor()
+    // and valid while mTilesetRevision matches the manager's.
+    Tiled::Tileset *mTileset;
+    int mTilesetRevision;
 };
 
 class NoneBuildingTile : public BuildingTile
@@ -792,6 +800,9 @@ private:
     bool upgradeTxt();
     bool mergeTxt();
 
+private slots:
+    void tilesetsChanged();
+
 signals:
     void tilesetAdded(Tiled::Tileset *tileset);
     void tilesetAboutToBeRemoved(Tiled::Tileset *tileset);
@@ -805,9 +816,22 @@ private:
     QList<BuildingTileCategory*> mCategories;
     QMap<QString,BuildingTileCategory*> mCategoryByName;
 
-    QList<BuildingTile*> mTiles;
+    // Sorted by increasing tileset name and tile index.
     QMap<QString,BuildingTile*> mTileByName;
 
+    // Every spelling passed to get(), e.g. "walls_01_5" and "walls_01_005".
+    QHash<QString,BuildingTile*> mTileByAnyName;
+
+    // Tile names passed to tileFor(), parsed once.  Cleared whenever
+    // TileMetaInfoMgr adds or removes a tileset.
+    struct ResolvedTileName
+    {
+        Tiled::Tileset *mTileset;
+        int mIndex;
+    };
+    QHash<QString,ResolvedTileName> mResolvedTileNames;
+    int mTilesetRevision;
+
     Tiled::Tile *mMissingTile;
     Tiled::Tile *mNoneTiledTile;
     BuildingTile *mNoneBuildingTile;
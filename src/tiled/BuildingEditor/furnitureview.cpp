@@ -22,6 +22,7 @@
 
 #include "tilemetainfomgr.h"
 #include "tilesetmanager.h"
+#include "tilethumbnailcache.h"
 #include "zoomable.h"
 
 #include "tile.h"
@@ -118,8 +119,8 @@ void FurnitureTileDelegate::paint(QPainter *painter,
     if (m->showResolved())
         ftile = ftile->resolved();
 
-    if (mView->zoomable()->smoothTransform())
-        painter->setRenderHint(QPainter::SmoothPixmapTransform);
+    const bool smooth = mView->zoomable()->smoothTransform();
+    TileThumbnailCache *thumbnails = TilesetManager::instance()->thumbnailCache();
 
     qreal scale = this->scale();
     int extra = 2;
@@ -145,7 +146,13 @@ void FurnitureTileDelegate::paint(QPainter *painter,
                     if (tile->image().isNull())
                         tile = TilesetManager::instance()->missingTile();
                     const QMargins margins = tile->drawMargins(scale);
-                    painter->drawImage(r.adjusted(margins.left(), margins.top(), -margins.right(), -margins.bottom()), tile->image());
+                    const QRect imageRect = r.adjusted(margins.left(), margins.top(), -margins.right(), -margins.bottom());
+                    const QPixmap thumb = thumbnails->thumbnail(tile, imageRect.size(), smooth);
+                    // Until the thumbnail is ready draw the full image, unsmoothed.
+                    if (thumb.isNull())
+                        painter->drawImage(imageRect, tile->image());
+                    else
+                        painter->drawPixmap(imageRect.topLeft(), thumb);
                 }
             }
         }
@@ -490,6 +497,8 @@ void FurnitureView::init()
 
     connect(TilesetManager::instance(), &TilesetManager::tilesetChanged,
             this, &FurnitureView::tilesetChanged);
+    connect(TilesetManager::instance()->thumbnailCache(), &TileThumbnailCache::thumbnailsReady,
+            viewport(), qOverload<>(&QWidget::update));
 
     connect(TileMetaInfoMgr::instance(), &TileMetaInfoMgr::tilesetAdded,
             this, &FurnitureView::tilesetAdded);
@@ -21,6 +21,7 @@
 #include "tile.h"
 #include "tileset.h"
 #include "tilesetmanager.h"
+#include "tilethumbnailcache.h"
 #include "zoomable.h"
 
 #include <QApplication>
@@ -56,6 +57,9 @@ public:
     QSize sizeHint(const QStyleOptionViewItem &option,
                    const QModelIndex &index) const;
 
+    QRect imageRect(const QRect &cellRect, Tile *tile,
+                    const QFontMetrics &fm) const;
+
 private:
     MixedTilesetView *mView;
 };
@@ -154,16 +158,17 @@ void TileDelegate::paint(QPainter *painter,
 //    const QPixmap tileImage = display.value<QPixmap>();
     const int tileWidth = tile->tileset()->tileWidth() * mView->zoomable()->scale();
 
-    if (mView->zoomable()->smoothTransform())
-        painter->setRenderHint(QPainter::SmoothPixmapTransform);
-
     const QFontMetrics fm = painter->fontMetrics();
     const int labelHeight = m->showLabels() ? fm.lineSpacing() : 0;
     const int dw = option.rect.width() - tileWidth;
-    const QMargins margins = tile->drawMargins(mView->zoomable()->scale());
-    QRect imageRect = option.rect.adjusted(dw/2 + margins.left(), extra + margins.top(),
-                                           -(dw - dw/2) - margins.right(), -extra - labelHeight - margins.bottom());
-    painter->drawImage(imageRect, tile->image());
+    QRect imageRect = this->imageRect(option.rect, tile, fm);
+    const QPixmap thumb = TilesetManager::instance()->thumbnailCache()->thumbnail(
+                tile, imageRect.size(), mView->zoomable()->smoothTransform());
+    // Until the thumbnail is ready draw the full image, unsmoothed.
+    if (thumb.isNull())
+        painter->drawImage(imageRect, tile->image());
+    else
+        painter->drawPixmap(imageRect.topLeft(), thumb);
 
     if (m->showLabels()) {
         QString name = fm.elidedText(label, Qt::ElideRight, option.rect.width());
@@ -248,6 +253,20 @@ QSize TileDelegate::sizeHint(const QStyleOptionViewItem &option,
                  tileset->tileHeight() * zoom + extra + labelHeight);
 }
 
+QRect TileDelegate::imageRect(const QRect &cellRect, Tile *tile,
+                              const QFontMetrics &fm) const
+{
+    const int extra = 2;
+    const qreal scale = mView->zoomable()->scale();
+    const int tileWidth = tile->tileset()->tileWidth() * scale;
+    const int labelHeight = mView->model()->showLabels() ? fm.lineSpacing() : 0;
+    const int dw = cellRect.width() - tileWidth;
+    const QMargins margins = tile->drawMargins(scale);
+    return cellRect.adjusted(dw/2 + margins.left(), extra + margins.top(),
+                             -(dw - dw/2) - margins.right(),
+                             -extra - labelHeight - margins.bottom());
+}
+
 } // namepace Internal
 } // namespace Tiled
 
@@ -409,6 +428,39 @@ void MixedTilesetView::tilesetBackgroundColorChanged(const QColor &color)
     setStyleSheet(QStringLiteral("QTableView { alternate-background-color: %1; background-color: %1; }").arg(color.name()));
 }
 
+/**
+ * Starts scaling the thumbnails of the rows up to a page above and below the
+ * visible ones, so they are ready by the time they are scrolled to.
+ */
+void MixedTilesetView::prefetchThumbnails()
+{
+    if (!mModel->rowCount())
+        return;
+
+    const TileDelegate *delegate = static_cast<TileDelegate*>(itemDelegate());
+    TileThumbnailCache *thumbnails = TilesetManager::instance()->thumbnailCache();
+    const bool smooth = mZoomable->smoothTransform();
+    const int page = viewport()->height();
+    int first = rowAt(-page);
+    int last = rowAt(2 * page - 1);
+    if (first == -1)
+        first = 0;
+    if (last == -1)
+        last = mModel->rowCount() - 1;
+    for (int row = first; row <= last; row++) {
+        for (int column = 0; column < mModel->columnCount(); column++) {
+            const QModelIndex index = mModel->index(row, column);
+            Tile *tile = mModel->tileAt(index);
+            if (!tile)
+                continue;
+            if (mModel->showEmptyTilesAsMissing() && tile->image().isNull())
+                tile = TilesetManager::instance()->missingTile();
+            const QRect r = delegate->imageRect(visualRect(index), tile, fontMetrics());
+            thumbnails->prefetch(tile, r.size(), smooth);
+        }
+    }
+}
+
 void MixedTilesetView::init()
 {
     setHorizontalScrollMode(QAbstractItemView::ScrollPerPixel);
@@ -449,6 +501,11 @@ void MixedTilesetView::init()
 
     mMousePressed = false;
 
+    connect(TilesetManager::instance()->thumbnailCache(), &TileThumbnailCache::thumbnailsReady,
+            viewport(), qOverload<>(&QWidget::update));
+    connect(verticalScrollBar(), &QScrollBar::valueChanged,
+            this, &MixedTilesetView::prefetchThumbnails);
+
     tilesetBackgroundColorChanged(Preferences::instance()->tilesetBackgroundColor());
     connect(Preferences::instance(), &Preferences::tilesetBackgroundColorChanged, this, &MixedTilesetView::tilesetBackgroundColorChanged);
 }
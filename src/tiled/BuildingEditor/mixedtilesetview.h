@@ -228,6 +228,9 @@ public slots:
     void scaleChanged(qreal scale);
     void tilesetBackgroundColorChanged(const QColor& color);
 
+private slots:
+    void prefetchThumbnails();
+
 private:
     void init();
 
@@ -106,7 +106,6 @@ ZomboidScene::ZomboidScene(QObject *parent)
     , mMapBordersItem(new QGraphicsPolygonItem)
     , mMapBordersItem2(new QGraphicsPolygonItem)
     , mMapBuildings(new MapBuildings)
-    , mMapBuildingsInvalid(true)
 {
     connect(&mLotManager, qOverload<MapComposite*,Tiled::MapObject*>(&ZLotManager::lotAdded),
         this, qOverload<MapComposite*,Tiled::MapObject*>(&ZomboidScene::onLotAdded));
@@ -161,11 +160,11 @@ void ZomboidScene::setMapDocument(MapDocument *mapDoc)
                 this, &ZomboidScene::mapCompositeChanged);
 
         connect(mMapDocument, &MapDocument::objectsAdded,
-                this, &ZomboidScene::invalidateMapBuildings);
+                this, &ZomboidScene::objectsChangedForBuildings);
         connect(mMapDocument, &MapDocument::objectsRemoved,
-                this, &ZomboidScene::invalidateMapBuildings);
+                this, &ZomboidScene::objectsChangedForBuildings);
         connect(mMapDocument, &MapDocument::objectsChanged,
-                this, &ZomboidScene::invalidateMapBuildings);
+                this, &ZomboidScene::objectsChangedForBuildings);
 
         connect(mMapDocument->mapComposite()->bmpBlender(), &BmpBlender::layersRecreated,
                 this, &ZomboidScene::bmpBlenderLayersRecreated);
@@ -371,7 +370,7 @@ void ZomboidScene::layerAdded(int index)
         }
     }
 
-    mMapBuildingsInvalid = true;
+    mMapBuildings->invalidate();
 
     doLater(ZOrder);
 }
@@ -380,7 +379,7 @@ void ZomboidScene::layerRemoved(int index)
 {
     MapScene::layerRemoved(index);
 
-    mMapBuildingsInvalid = true;
+    mMapBuildings->invalidate();
 
     doLater(ZOrder);
 }
@@ -424,7 +423,7 @@ void ZomboidScene::layerChanged(int index)
             layerItem->setVisible(og->isVisible()
                                   && (og->level() == mMapDocument->currentLevel()));
         }
-        mMapBuildingsInvalid = true;
+        mMapBuildings->invalidate();
         if (synch)
             updateLayerGroupsLater(Synch | Bounds);
     }
@@ -582,10 +581,8 @@ void ZomboidScene::setGraphicsSceneZOrder()
 
 QRegion ZomboidScene::getBuildingRegion(const QPoint &tilePos, QRegion &roomRgn)
 {
-    if (mMapBuildingsInvalid) {
+    if (!mMapBuildings->isValid())
         mMapBuildings->calculate(mMapDocument->mapComposite());
-        mMapBuildingsInvalid = false;
-    }
     if (MapBuildingsNS::Room *room = mMapBuildings->roomAt(tilePos,
                                                            mMapDocument->currentLevel())) {
         roomRgn = room->region();
@@ -625,7 +622,7 @@ void ZomboidScene::onLotAdded(MapComposite *lot, MapObject *mapObject)
         item->setMapImage(mapImage);
     }
 
-    mMapBuildingsInvalid = true;
+    mMapBuildings->invalidate();
 
     updateLayerGroupsLater(Synch | Bounds);
 }
@@ -641,7 +638,7 @@ void ZomboidScene::onLotRemoved(MapComposite *lot, MapObject *mapObject)
     }
     mMapObjectToLot.remove(mapObject);
 
-    mMapBuildingsInvalid = true;
+    mMapBuildings->invalidate();
 
     updateLayerGroupsLater(Synch | Bounds);
 }
@@ -655,7 +652,7 @@ void ZomboidScene::onLotUpdated(MapComposite *lot, MapObject *mapObject)
         item->resize(lot->map()->size());
     }
 
-    mMapBuildingsInvalid = true;
+    mMapBuildings->invalidate();
 
     updateLayerGroupsLater(Synch | Bounds);
 }
@@ -664,13 +661,21 @@ void ZomboidScene::onLotUpdated(MapComposite *mc, WorldCellLot *lot)
 {
     Q_UNUSED(mc)
     Q_UNUSED(lot)
-    mMapBuildingsInvalid = true;
+    mMapBuildings->invalidate();
     updateLayerGroupsLater(Synch | Bounds);
 }
 
-void ZomboidScene::invalidateMapBuildings()
+// Only this map's RoomDefs need reading again, the sub-maps are unchanged.
+// Removed objects have no object group any more, so assume they were RoomDefs.
+void ZomboidScene::objectsChangedForBuildings(const QList<MapObject*> &objects)
 {
-    mMapBuildingsInvalid = true;
+    for (MapObject *mapObject : objects) {
+        ObjectGroup *og = mapObject->objectGroup();
+        if (!og || og->name().endsWith(QLatin1String("_RoomDefs"))) {
+            mMapBuildings->invalidateMap(mMapDocument->mapComposite());
+            return;
+        }
+    }
 }
 
 // Called when a map file displayed as a Lot is changed on disk.
@@ -685,7 +690,7 @@ void ZomboidScene::mapCompositeChanged()
         if (MapObjectItem *item = itemForObject(mapObject))
             item->resize(lot->map()->size());
     }
-    mMapBuildingsInvalid = true;
+    mMapBuildings->invalidate();
     updateLayerGroupsLater(Synch | Bounds);
 }
 
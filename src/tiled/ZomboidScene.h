@@ -103,7 +103,7 @@ private slots:
 
     void onLotUpdated(MapComposite *mc, WorldCellLot *lot);
 
-    void invalidateMapBuildings();
+    void objectsChangedForBuildings(const QList<Tiled::MapObject*> &objects);
 
     void mapCompositeChanged();
 
@@ -169,7 +169,6 @@ private:
 
     QPoint mHighlightRoomPosition;
     MapBuildings *mMapBuildings;
-    bool mMapBuildingsInvalid;
 };
 
 } // namespace Internal
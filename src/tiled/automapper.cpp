@@ -23,6 +23,7 @@
 #include "addremovelayer.h"
 #include "addremovemapobject.h"
 #include "addremovetileset.h"
+#include "automappingmatcher.h"
 #include "automappingutils.h"
 #include "changeproperties.h"
 #include "layermodel.h"
@@ -515,9 +516,6 @@ void AutoMapper::autoMap(QRegion *where)
     QRegion ret;
     for (const QRect &rect : *where)
         for (int i = 0; i < mRulesInput.size(); ++i) {
-            // at the moment the parallel execution does not work yet
-            // TODO: make multithreading available!
-            // either by dividing the rules or the region to multiple threads
             ret = ret.united(applyRule(i, rect));
         }
     *where = where->united(ret);
@@ -536,11 +534,6 @@ const QRegion AutoMapper::getSetLayersRegion()
     return result;
 }
 
-static bool compareLayerTo(const TileLayer *setLayer,
-                           const QVector<TileLayer*> &listYes,
-                           const QVector<TileLayer*> &listNo,
-                           const QRegion &ruleRegion, const QPoint &offset);
-
 QRect AutoMapper::applyRule(const int ruleIndex, const QRect &where)
 {
     QRect ret;
@@ -561,6 +554,39 @@ QRect AutoMapper::applyRule(const int ruleIndex, const QRect &where)
     const int maxX = where.right() - rbr.left() + rbr.width() - 1;
     const int maxY = where.bottom() - rbr.top() + rbr.height() - 1;
 
+    if (minX > maxX || minY > maxY)
+        return ret;
+
+    AutoMappingMatcher matcher(ruleInput);
+    QSet<int> inputLayers;
+    foreach (const QString &index, mInputRules.indexes) {
+        const InputIndex &ii = mInputRules[index];
+        matcher.addIndex();
+        foreach (const QString &name, ii.names) {
+            const int layerIndex = mMapWork->indexOfLayer(name,
+                                                          Layer::TileLayerType);
+            const TileLayer *setLayer = mMapWork->layerAt(layerIndex)->asTileLayer();
+            matcher.addCondition(setLayer, ii[name].listYes, ii[name].listNo);
+            inputLayers += layerIndex;
+        }
+    }
+
+    // The matching runs on all the offsets up front, in parallel.  Applying
+    // the rule in order afterwards gives the same result as checking each
+    // offset just before applying it, unless the rule writes to a layer it
+    // reads.  Then offsets that overlap the earlier output are checked again.
+    const QRect offsets(QPoint(minX, minY), QPoint(maxX, maxY));
+    const QVector<uchar> matches = matcher.findMatches(offsets);
+
+    bool outputIsInput = false;
+    foreach (const RuleOutput *translationTable, mLayerList) {
+        foreach (int layerIndex, translationTable->values()) {
+            if (inputLayers.contains(layerIndex))
+                outputIsInput = true;
+        }
+    }
+    QRegion altered;
+
     // In this list of regions it is stored which parts or the map have already
     // been altered by exactly this rule. We store all the altered parts to
     // make sure there are no overlaps of the same rule applied to
@@ -572,27 +598,12 @@ QRect AutoMapper::applyRule(const int ruleIndex, const QRect &where)
 
     QRandomGenerator randomGenerator;
 
+    const uchar *match = matches.constData();
     for (int y = minY; y <= maxY; ++y)
     for (int x = minX; x <= maxX; ++x) {
-        bool anymatch = false;
-        foreach (const QString &index, mInputRules.indexes) {
-            const InputIndex &ii = mInputRules[index];
-
-            bool allLayerNamesMatch = true;
-            foreach (const QString &name, mInputRules[index].names) {
-                const int index = mMapWork->indexOfLayer(name,
-                                                         Layer::TileLayerType);
-                const TileLayer *setLayer = mMapWork->layerAt(index)->asTileLayer();
-                allLayerNamesMatch &= compareLayerTo(setLayer,
-                                                     ii[name].listYes,
-                                                     ii[name].listNo,
-                                                     ruleInput, QPoint(x, y));
-            }
-            if (allLayerNamesMatch) {
-                anymatch = true;
-                break;
-            }
-        }
+        bool anymatch = *match++;
+        if (outputIsInput && altered.intersects(rbr.translated(x, y)))
+            anymatch = matcher.matches(x, y);
 
         if (anymatch) {
             int r = 0;
@@ -603,6 +614,8 @@ QRect AutoMapper::applyRule(const int ruleIndex, const QRect &where)
             if (!mNoOverlappingRules) {
                 copyMapRegion(ruleOutput, QPoint(x, y), mLayerList.at(r));
                 ret = ret.united(rbr.translated(QPoint(x, y)));
+                if (outputIsInput)
+                    altered += ruleOutput.translated(x, y);
                 continue;
             }
 
@@ -634,6 +647,8 @@ QRect AutoMapper::applyRule(const int ruleIndex, const QRect &where)
 
             copyMapRegion(ruleOutput, QPoint(x, y), mLayerList.at(r));
             ret = ret.united(rbr.translated(QPoint(x, y)));
+            if (outputIsInput)
+                altered += ruleOutput.translated(x, y);
             for (int i = 0; i < translationTable->size(); ++i) {
                 appliedRegions[i] +=
                         ruleRegionInLayer[i].translated(x, y);
@@ -644,189 +659,6 @@ QRect AutoMapper::applyRule(const int ruleIndex, const QRect &where)
     return ret;
 }
 
-/**
- * Returns a list of all cells which can be found within all tile layers
- * within the given region.
- */
-static QVector<Cell> cellsInRegion(const QVector<TileLayer*> &list,
-                                   const QRegion &r)
-{
-    QVector<Cell> cells;
-    foreach (const TileLayer *tilelayer, list) {
-        for (const QRect &rect : r) {
-            for (int x = rect.left(); x <= rect.right(); ++x) {
-                for (int y = rect.top(); y <= rect.bottom(); ++y) {
-                    const Cell &cell = tilelayer->cellAt(x, y);
-                    if (!cells.contains(cell))
-                        cells.append(cell);
-                }
-            }
-        }
-    }
-    return cells;
-}
-
-/**
- * This function is one of the core functions for understanding the
- * automapping.
- * In this function a certain region (of the set layer) is compared to
- * several other layers (ruleSet and ruleNotSet).
- * This comparision will determine if a rule of automapping matches,
- * so if this rule is applied at this region given
- * by a QRegion and Offset given by a QPoint.
- *
- * This compares the tile layer setLayer to several others given
- * in the QList listYes (ruleSet) and OList listNo (ruleNotSet).
- * The tile layer setLayer is examined at QRegion ruleRegion + offset
- * The tile layers within listYes and listNo are examined at QRegion ruleRegion.
- *
- * Basically all matches between setLayer and a layer of listYes are considered
- * good, while all matches between setLayer and listNo are considered bad and
- * lead to canceling the comparison, returning false.
- *
- * The comparison is done for each position within the QRegion ruleRegion.
- * If all positions of the region are considered "good" return true.
- *
- * Now there are several cases to distinguish:
- * - setLayer is 0:
- *      obviously there should be no automapping.
- *      So here no rule should be applied. return false
- * - setLayer is not 0:
- *      - both listYes and listNo are empty:
- *          This should not happen, because with that configuration, absolutely
- *          no condition is given.
- *          return false, assuming this is an errornous rule being applied
- *
- *      - both listYes and listNo are not empty:
- *          When comparing a tile at a certain position of tile layer setLayer
- *          to all available tiles in listYes, there must be at least
- *          one layer, in which there is a match of tiles of setLayer and
- *           listYes to consider this position good.
- *          In listNo there must not be a match to consider this position
- *          good.
- *          If there are no tiles within all available tiles within all layers
- *          of one list, all tiles in setLayer are considered good,
- *          while inspecting this list.
- *          All available tiles are all tiles within the whole rule region in
- *          all tile layers of the list.
- *
- *      - either of both lists are not empty
- *          When comparing a certain position of tile layer setLayer
- *          to all Tiles at the corresponding position this can happen:
- *          A tile of setLayer matches a tile of a layer in the list. Then this
- *          is considered as good, if the layer is from the listYes.
- *          Otherwise it is considered bad.
- *
- *          Exception, when having only the listYes:
- *          if at the examined position there are no tiles within all Layers
- *          of the listYes, all tiles except all used tiles within
- *          the layers of that list are considered good.
- *
- *          This exception was added to have a better functionality
- *          (need of less layers.)
- *          It was not added to the case, when having only listNo layers to
- *          avoid total symmetrie between those lists.
- *
- * If all positions are considered good, return true.
- * return false otherwise.
- *
- * @return bool, if the tile layer matches the given list of layers.
- */
-static bool compareLayerTo(const TileLayer *setLayer,
-                           const QVector<TileLayer*> &listYes,
-                           const QVector<TileLayer*> &listNo,
-                           const QRegion &ruleRegion, const QPoint &offset)
-{
-    if (listYes.isEmpty() && listNo.isEmpty())
-        return false;
-
-    QVector<Cell> cells;
-    if (listYes.isEmpty())
-        cells = cellsInRegion(listNo, ruleRegion);
-    if (listNo.isEmpty())
-        cells = cellsInRegion(listYes, ruleRegion);
-
-    for (const QRect &rect : ruleRegion) {
-        for (int x = rect.left(); x <= rect.right(); ++x) {
-            for (int y = rect.top(); y <= rect.bottom(); ++y) {
-                // this is only used in the case where only one list has layers
-                // it is needed for the exception mentioned above
-                bool ruleDefinedListYes = false;
-
-                bool matchListYes = false;
-                bool matchListNo  = false;
-
-                if (!setLayer->contains(x + offset.x(), y + offset.y()))
-                    return false;
-
-                const Cell &c1 = setLayer->cellAt(x + offset.x(),
-                                                  y + offset.y());
-
-                // when there is no tile in setLayer,
-                // there should be no rule at all
-                if (c1.isEmpty())
-                    return false;
-
-                // ruleDefined will be set when there is a tile in at least
-                // one layer. if there is a tile in at least one layer, only
-                // the given tiles in the different listYes layers are valid.
-                // if there is given no tile at all in the listYes layers,
-                // consider all tiles valid.
-
-                foreach (const TileLayer *comparedTileLayer, listYes) {
-
-                    if (!comparedTileLayer->contains(x, y))
-                        return false;
-
-                    const Cell &c2 = comparedTileLayer->cellAt(x, y);
-                    if (!c2.isEmpty())
-                        ruleDefinedListYes = true;
-
-                    if (!c2.isEmpty() && c1 == c2)
-                        matchListYes = true;
-                }
-                foreach (const TileLayer *comparedTileLayer, listNo) {
-
-                    if (!comparedTileLayer->contains(x, y))
-                        return false;
-
-                    const Cell &c2 = comparedTileLayer->cellAt(x, y);
-
-                    if (!c2.isEmpty() && c1 == c2)
-                        matchListNo = true;
-                }
-
-                // when there are only layers in the listNo
-                // check only if these layers are unmatched
-                // no need to check explicitly the exception in this case.
-                if (listYes.isEmpty()) {
-                    if (matchListNo)
-                        return false;
-                    else
-                        continue;
-                }
-                // when there are only layers in the listYes
-                // check if these layers are matched, or if the exception works
-                if (listNo.isEmpty()) {
-                    if (matchListYes)
-                        continue;
-                    if (!ruleDefinedListYes && !cells.contains(c1))
-                        continue;
-                    return false;
-                }
-
-                // there are layers in both lists:
-                // no need to consider ruleDefinedListXXX
-                if ((matchListYes || !ruleDefinedListYes) && !matchListNo)
-                    continue;
-                else
-                    return false;
-            }
-        }
-    }
-    return true;
-}
-
 void AutoMapper::copyMapRegion(const QRegion &region, QPoint offset,
                                const RuleOutput *layerTranslation)
 {
@@ -0,0 +1,333 @@
+/*
+ * automappingmatcher.cpp
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "automappingmatcher.h"
+
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+namespace {
+
+// Areas with fewer offsets than this are checked on the calling thread.
+const int MIN_OFFSETS_FOR_THREADS = 64 * 64;
+
+/**
+ * Returns a list of all cells which can be found within all tile layers
+ * within the given region.
+ */
+QVector<Cell> cellsInRegion(const QVector<TileLayer*> &list,
+                            const QRegion &r)
+{
+    QVector<Cell> cells;
+    foreach (const TileLayer *tilelayer, list) {
+        for (const QRect &rect : r) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
+                for (int y = rect.top(); y <= rect.bottom(); ++y) {
+                    const Cell &cell = tilelayer->cellAt(x, y);
+                    if (!cells.contains(cell))
+                        cells.append(cell);
+                }
+            }
+        }
+    }
+    return cells;
+}
+
+class MatchBandTask : public QRunnable
+{
+public:
+    MatchBandTask(const AutoMappingMatcher &matcher, const QRect &offsets,
+                  int top, int bottom, uchar *matches) :
+        mMatcher(matcher),
+        mOffsets(offsets),
+        mTop(top),
+        mBottom(bottom),
+        mMatches(matches)
+    {
+    }
+
+    void run()
+    {
+        uchar *match = mMatches + (mTop - mOffsets.top()) * mOffsets.width();
+        for (int y = mTop; y < mBottom; ++y)
+            for (int x = mOffsets.left(); x <= mOffsets.right(); ++x)
+                *match++ = mMatcher.matches(x, y);
+    }
+
+private:
+    const AutoMappingMatcher &mMatcher;
+    QRect mOffsets;
+    int mTop;
+    int mBottom;
+    uchar *mMatches;
+};
+
+} // namespace
+
+AutoMappingMatcher::AutoMappingMatcher(const QRegion &ruleRegion) :
+    mRuleRegion(ruleRegion)
+{
+    for (const QRect &rect : ruleRegion)
+        mRects += rect;
+    if (!mRects.isEmpty())
+        mAnchor = mRects.first().topLeft();
+}
+
+void AutoMappingMatcher::addIndex()
+{
+    mIndexes += QVector<Condition>();
+}
+
+void AutoMappingMatcher::addCondition(const TileLayer *setLayer,
+                                      const QVector<TileLayer*> &listYes,
+                                      const QVector<TileLayer*> &listNo)
+{
+    Q_ASSERT(!mIndexes.isEmpty());
+
+    Condition condition;
+    condition.setLayer = setLayer;
+    condition.listYes = listYes;
+    condition.listNo = listNo;
+    // Only needed for the exception when there are just listYes layers.
+    if (listNo.isEmpty())
+        condition.cells = cellsInRegion(listYes, mRuleRegion);
+    mIndexes.last() += condition;
+}
+
+bool AutoMappingMatcher::matches(int x, int y) const
+{
+    const QPoint offset(x, y);
+    for (const QVector<Condition> &conditions : mIndexes) {
+        // Most offsets fail on the first cell, so try that for every
+        // condition before comparing whole regions.
+        bool allMatch = true;
+        if (!mRects.isEmpty()) {
+            for (const Condition &condition : conditions) {
+                if (!conditionMatches(condition, mAnchor.x(), mAnchor.y(), offset)) {
+                    allMatch = false;
+                    break;
+                }
+            }
+        }
+        if (!allMatch)
+            continue;
+
+        for (const Condition &condition : conditions) {
+            if (!conditionMatches(condition, offset)) {
+                allMatch = false;
+                break;
+            }
+        }
+        if (allMatch)
+            return true;
+    }
+    return false;
+}
+
+QVector<uchar> AutoMappingMatcher::findMatches(const QRect &offsets) const
+{
+    QVector<uchar> matches(offsets.width() * offsets.height(), 0);
+    if (matches.isEmpty())
+        return matches;
+
+    int bandCount = 1;
+    if (matches.size() >= MIN_OFFSETS_FOR_THREADS)
+        bandCount = qBound(1, QThread::idealThreadCount() * 4, offsets.height());
+    const int rowsPerBand = (offsets.height() + bandCount - 1) / bandCount;
+
+    uchar *data = matches.data();
+    if (bandCount == 1) {
+        MatchBandTask(*this, offsets, offsets.top(), offsets.bottom() + 1, data).run();
+    } else {
+        QThreadPool pool;
+        for (int top = offsets.top(); top <= offsets.bottom(); top += rowsPerBand) {
+            const int bottom = qMin(top + rowsPerBand, offsets.bottom() + 1);
+            pool.start(new MatchBandTask(*this, offsets, top, bottom, data));
+        }
+        pool.waitForDone();
+    }
+    return matches;
+}
+
+/**
+ * Compares one position (x, y) of the rule region.  This is the heart of the
+ * automapping, see conditionMatches() below for the rules.
+ */
+bool AutoMappingMatcher::conditionMatches(const Condition &condition,
+                                          int x, int y,
+                                          const QPoint &offset) const
+{
+    const TileLayer *setLayer = condition.setLayer;
+    const QVector<TileLayer*> &listYes = condition.listYes;
+    const QVector<TileLayer*> &listNo = condition.listNo;
+
+    if (listYes.isEmpty() && listNo.isEmpty())
+        return false;
+
+    // this is only used in the case where only one list has layers
+    // it is needed for the exception mentioned below
+    bool ruleDefinedListYes = false;
+
+    bool matchListYes = false;
+    bool matchListNo  = false;
+
+    if (!setLayer->contains(x + offset.x(), y + offset.y()))
+        return false;
+
+    const Cell &c1 = setLayer->cellAt(x + offset.x(),
+                                      y + offset.y());
+
+    // when there is no tile in setLayer,
+    // there should be no rule at all
+    if (c1.isEmpty())
+        return false;
+
+    // ruleDefined will be set when there is a tile in at least
+    // one layer. if there is a tile in at least one layer, only
+    // the given tiles in the different listYes layers are valid.
+    // if there is given no tile at all in the listYes layers,
+    // consider all tiles valid.
+
+    foreach (const TileLayer *comparedTileLayer, listYes) {
+
+        if (!comparedTileLayer->contains(x, y))
+            return false;
+
+        const Cell &c2 = comparedTileLayer->cellAt(x, y);
+        if (!c2.isEmpty())
+            ruleDefinedListYes = true;
+
+        if (!c2.isEmpty() && c1 == c2)
+            matchListYes = true;
+    }
+    foreach (const TileLayer *comparedTileLayer, listNo) {
+
+        if (!comparedTileLayer->contains(x, y))
+            return false;
+
+        const Cell &c2 = comparedTileLayer->cellAt(x, y);
+
+        if (!c2.isEmpty() && c1 == c2)
+            matchListNo = true;
+    }
+
+    // when there are only layers in the listNo
+    // check only if these layers are unmatched
+    // no need to check explicitly the exception in this case.
+    if (listYes.isEmpty())
+        return !matchListNo;
+
+    // when there are only layers in the listYes
+    // check if these layers are matched, or if the exception works
+    if (listNo.isEmpty()) {
+        if (matchListYes)
+            return true;
+        if (!ruleDefinedListYes && !condition.cells.contains(c1))
+            return true;
+        return false;
+    }
+
+    // there are layers in both lists:
+    // no need to consider ruleDefinedListXXX
+    return (matchListYes || !ruleDefinedListYes) && !matchListNo;
+}
+
+/**
+ * This function is one of the core functions for understanding the
+ * automapping.
+ * In this function a certain region (of the set layer) is compared to
+ * several other layers (ruleSet and ruleNotSet).
+ * This comparision will determine if a rule of automapping matches,
+ * so if this rule is applied at this region given
+ * by a QRegion and Offset given by a QPoint.
+ *
+ * This compares the tile layer setLayer to several others given
+ * in the QList listYes (ruleSet) and OList listNo (ruleNotSet).
+ * The tile layer setLayer is examined at QRegion ruleRegion + offset
+ * The tile layers within listYes and listNo are examined at QRegion ruleRegion.
+ *
+ * Basically all matches between setLayer and a layer of listYes are considered
+ * good, while all matches between setLayer and listNo are considered bad and
+ * lead to canceling the comparison, returning false.
+ *
+ * The comparison is done for each position within the QRegion ruleRegion.
+ * If all positions of the region are considered "good" return true.
+ *
+ * Now there are several cases to distinguish:
+ * - setLayer is 0:
+ *      obviously there should be no automapping.
+ *      So here no rule should be applied. return false
+ * - setLayer is not 0:
+ *      - both listYes and listNo are empty:
+ *          This should not happen, because with that configuration, absolutely
+ *          no condition is given.
+ *          return false, assuming this is an errornous rule being applied
+ *
+ *      - both listYes and listNo are not empty:
+ *          When comparing a tile at a certain position of tile layer setLayer
+ *          to all available tiles in listYes, there must be at least
+ *          one layer, in which there is a match of tiles of setLayer and
+ *           listYes to consider this position good.
+ *          In listNo there must not be a match to consider this position
+ *          good.
+ *          If there are no tiles within all available tiles within all layers
+ *          of one list, all tiles in setLayer are considered good,
+ *          while inspecting this list.
+ *          All available tiles are all tiles within the whole rule region in
+ *          all tile layers of the list.
+ *
+ *      - either of both lists are not empty
+ *          When comparing a certain position of tile layer setLayer
+ *          to all Tiles at the corresponding position this can happen:
+ *          A tile of setLayer matches a tile of a layer in the list. Then this
+ *          is considered as good, if the layer is from the listYes.
+ *          Otherwise it is considered bad.
+ *
+ *          Exception, when having only the listYes:
+ *          if at the examined position there are no tiles within all Layers
+ *          of the listYes, all tiles except all used tiles within
+ *          the layers of that list are considered good.
+ *
+ *          This exception was added to have a better functionality
+ *          (need of less layers.)
+ *          It was not added to the case, when having only listNo layers to
+ *          avoid total symmetrie between those lists.
+ *
+ * If all positions are considered good, return true.
+ * return false otherwise.
+ *
+ * @return bool, if the tile layer matches the given list of layers.
+ */
+bool AutoMappingMatcher::conditionMatches(const Condition &condition,
+                                          const QPoint &offset) const
+{
+    if (condition.listYes.isEmpty() && condition.listNo.isEmpty())
+        return false;
+
+    for (const QRect &rect : mRects)
+        for (int x = rect.left(); x <= rect.right(); ++x)
+            for (int y = rect.top(); y <= rect.bottom(); ++y)
+                if (!conditionMatches(condition, x, y, offset))
+                    return false;
+    return true;
+}
@@ -0,0 +1,94 @@
+/*
+ * automappingmatcher.h
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AUTOMAPPINGMATCHER_H
+#define AUTOMAPPINGMATCHER_H
+
+#include "tilelayer.h"
+
+#include <QRect>
+#include <QRegion>
+#include <QVector>
+
+namespace Tiled {
+namespace Internal {
+
+/**
+ * Decides where the input of one automapping rule matches the working map.
+ *
+ * A rule has one or more input indexes, and each index has one condition per
+ * set layer name.  The rule matches at an offset when all the conditions of
+ * any one index match there.  Everything that only depends on the rule, like
+ * the tiles used in the rule layers, is worked out once up front.
+ */
+class AutoMappingMatcher
+{
+public:
+    AutoMappingMatcher(const QRegion &ruleRegion);
+
+    /**
+     * Starts a new input index.  An index without conditions matches
+     * everywhere.
+     */
+    void addIndex();
+
+    /**
+     * Adds a condition to the last index: \a setLayer of the working map has
+     * to match the rule layers \a listYes and \a listNo.
+     */
+    void addCondition(const TileLayer *setLayer,
+                      const QVector<TileLayer*> &listYes,
+                      const QVector<TileLayer*> &listNo);
+
+    /**
+     * Returns whether the rule matches with its region moved by (x, y).
+     */
+    bool matches(int x, int y) const;
+
+    /**
+     * Checks every offset in \a offsets, and returns one byte per offset,
+     * row by row, set to 1 where the rule matches.  Large areas are checked
+     * in bands on several threads.  The layers must not change meanwhile.
+     */
+    QVector<uchar> findMatches(const QRect &offsets) const;
+
+private:
+    struct Condition
+    {
+        const TileLayer *setLayer;
+        QVector<TileLayer*> listYes;
+        QVector<TileLayer*> listNo;
+        QVector<Cell> cells; // every cell in listYes, see cellsInRegion()
+    };
+
+    bool conditionMatches(const Condition &condition, int x, int y,
+                          const QPoint &offset) const;
+    bool conditionMatches(const Condition &condition,
+                          const QPoint &offset) const;
+
+    QRegion mRuleRegion;
+    QVector<QRect> mRects;
+    QPoint mAnchor;
+    QVector<QVector<Condition> > mIndexes;
+};
+
+} // namespace Internal
+} // namespace Tiled
+
+#endif // AUTOMAPPINGMATCHER_H
@@ -28,14 +28,18 @@
 #include "maprenderer.h"
 #include "tilelayer.h"
 #include "tileset.h"
+#include "tracing.h"
 
 #include <QApplication>
 #include <QDebug>
 #include <QDir>
 #include <QFile>
 #include <QImage>
+#include <QRunnable>
 #include <QSet>
+#include <QSharedPointer>
 #include <QTextStream>
+#include <QThreadPool>
 
 using namespace Tiled;
 using namespace Tiled::Internal;
@@ -48,7 +52,12 @@ BmpBlender::BmpBlender(QObject *parent) :
     mFakeTileGrid(nullptr),
     mInitTilesLater(true),
     mHack(false),
-    mBlendEdgesEverywhere(false)
+    mBlendEdgesEverywhere(false),
+    mAsyncRecreate(false),
+    mRebuildPool(nullptr),
+    mRebuildBlender(nullptr),
+    mRebuildCancelled(false),
+    mRebuildGeneration(0)
 {
 }
 
@@ -58,13 +67,19 @@ BmpBlender::BmpBlender(Map *map, QObject *parent) :
     mFakeTileGrid(nullptr),
     mInitTilesLater(true),
     mHack(false),
-    mBlendEdgesEverywhere(false)
+    mBlendEdgesEverywhere(false),
+    mAsyncRecreate(false),
+    mRebuildPool(nullptr),
+    mRebuildBlender(nullptr),
+    mRebuildCancelled(false),
+    mRebuildGeneration(0)
 {
     fromMap();
 }
 
 BmpBlender::~BmpBlender()
 {
+    cancelRebuild();
     qDeleteAll(mAliases);
     qDeleteAll(mRules);
     qDeleteAll(mBlendList);
@@ -83,6 +98,11 @@ void BmpBlender::setMap(Map *map)
 void BmpBlender::recreate()
 {
     if (mFakeTileGrid) {
+        if (mAsyncRecreate) {
+            startRebuild();
+            return;
+        }
+
         qDeleteAll(mTileGrids);
         mTileGrids.clear();
         delete mFakeTileGrid;
@@ -97,23 +117,297 @@ void BmpBlender::recreate()
     }
 }
 
+/////
+
+namespace {
+
+// Rows handed back to the GUI thread at a time during a rebuild.
+const int REBUILD_BAND_ROWS = 16;
+
+QVector<Tile*> tilesInRect(const SparseTileGrid *grid, const QRect &r)
+{
+    QVector<Tile*> tiles;
+    tiles.reserve(r.width() * r.height());
+    for (int y = r.top(); y <= r.bottom(); y++)
+        for (int x = r.left(); x <= r.right(); x++)
+            tiles += grid->at(x, y).tile;
+    return tiles;
+}
+
+void replaceTilesInRect(SparseTileGrid *grid, const QRect &r,
+                        const QVector<Tile*> &tiles, const QRegion &skip)
+{
+    int i = 0;
+    for (int y = r.top(); y <= r.bottom(); y++) {
+        for (int x = r.left(); x <= r.right(); x++, i++) {
+            if (!skip.isEmpty() && skip.contains(QPoint(x, y)))
+                continue;
+            grid->replace(x, y, Cell(tiles[i]));
+        }
+    }
+}
+
+} // namespace
+
+// The tiles the worker came up with for one band of rows.
+class BmpBlender::RebuildChunk
+{
+public:
+    QRect mRect;
+    QMap<QString,QVector<Tile*> > mGrids;
+    QVector<Tile*> mFakeGrid;
+    QMap<QString,QVector<int> > mBlends; // index into mBlendList, or -1
+};
+
+class BmpBlender::RebuildTask : public QRunnable
+{
+public:
+    RebuildTask(BmpBlender *owner, BmpBlender *worker, int generation) :
+        mOwner(owner),
+        mWorker(worker),
+        mGeneration(generation)
+    {
+    }
+
+    void run()
+    {
+        TRACE_ZONE("BmpBlender::RebuildTask");
+
+        BmpBlender *w = mWorker;
+        BmpBlender *owner = mOwner;
+        const int generation = mGeneration;
+
+        // Both blenders were built from the same rules, so a blend is sent
+        // back as its position in mBlendList.
+        QHash<BlendWrapper*,int> blendIndex;
+        for (int i = 0; i < w->mBlendList.size(); i++)
+            blendIndex[w->mBlendList[i]] = i;
+
+        const int width = w->mMap->width();
+        const int height = w->mMap->height();
+        for (int top = 0; top < height; top += REBUILD_BAND_ROWS) {
+            if (owner->mRebuildCancelled.load())
+                return;
+
+            const QRect r(0, top, width, qMin(REBUILD_BAND_ROWS, height - top));
+            // Edge tiles depend on the neighbouring cells.
+            w->imagesToTileGrids(r.left() - 2, r.top() - 2, r.right() + 2, r.bottom() + 2);
+            w->addEdgeTiles(r.left() - 2, r.top() - 2, r.right() + 2, r.bottom() + 2);
+
+            QSharedPointer<RebuildChunk> chunk(new RebuildChunk);
+            chunk->mRect = r;
+            for (auto it = w->mTileGrids.constBegin(); it != w->mTileGrids.constEnd(); ++it)
+                chunk->mGrids[it.key()] = tilesInRect(it.value(), r);
+            chunk->mFakeGrid = tilesInRect(w->mFakeTileGrid, r);
+            foreach (QString layerName, w->mBlendLayers) {
+                const BlendGrid blendGrid = w->mBlendGrids.value(layerName);
+                QVector<int> blends(r.width() * r.height(), -1);
+                if (!blendGrid.isEmpty()) {
+                    int i = 0;
+                    for (int y = r.top(); y <= r.bottom(); y++) {
+                        for (int x = r.left(); x <= r.right(); x++, i++) {
+                            auto it = blendGrid.constFind(x + y * width);
+                            if (it != blendGrid.constEnd())
+                                blends[i] = blendIndex.value(it.value(), -1);
+                        }
+                    }
+                }
+                chunk->mBlends[layerName] = blends;
+            }
+
+            QMetaObject::invokeMethod(owner, [owner, generation, chunk]() {
+                owner->applyRebuildChunk(generation, *chunk);
+            }, Qt::QueuedConnection);
+        }
+
+        QMetaObject::invokeMethod(owner, [owner, generation]() {
+            owner->rebuildFinished(generation);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    BmpBlender *mOwner;
+    BmpBlender *mWorker;
+    int mGeneration;
+};
+
+// Copies what the worker needs: the images, the rules and the layers whose
+// tiles affect the result.
+Map *BmpBlender::createSnapshot()
+{
+    Map *snapshot = new Map(mMap->orientation(), mMap->width(), mMap->height(),
+                            mMap->tileWidth(), mMap->tileHeight());
+    snapshot->rbmpSettings()->clone(*mMap->bmpSettings());
+    snapshot->rbmpMain() = mMap->rbmpMain();
+    snapshot->rbmpVeg() = mMap->rbmpVeg();
+    foreach (Tileset *ts, mMap->tilesets())
+        snapshot->addTileset(ts);
+
+    QSet<QString> layerNames = mBlendExclude2Layers;
+    layerNames += STR_0Floor;
+    foreach (QString layerName, layerNames) {
+        int n = mMap->indexOfLayer(layerName, Layer::TileLayerType);
+        if (n != -1)
+            snapshot->addLayer(mMap->layerAt(n)->clone());
+    }
+    return snapshot;
+}
+
+void BmpBlender::startRebuild()
+{
+    cancelRebuild();
+
+    if (mInitTilesLater) {
+        initTiles();
+        mInitTilesLater = false;
+    }
+
+    // Leave the old tiles on screen until the new ones arrive, unless the
+    // rules changed which layers there are or the map was resized.
+    QStringList layerNames = mRuleLayers + mBlendLayers;
+    layerNames.removeDuplicates();
+    layerNames.sort();
+    const QStringList oldNames = mTileLayers.keys(); // sorted
+    if (layerNames != oldNames || mTileLayers.isEmpty() ||
+            mTileLayers.first()->bounds().size() != mMap->size()) {
+        qDeleteAll(mTileGrids);
+        mTileGrids.clear();
+        delete mFakeTileGrid;
+        qDeleteAll(mTileLayers);
+        mTileLayers.clear();
+        foreach (QString layerName, layerNames) {
+            mTileGrids[layerName] = new SparseTileGrid(mMap->width(), mMap->height());
+            mTileLayers[layerName] = new TileLayer(layerName, 0, 0,
+                                                   mMap->width(), mMap->height());
+        }
+        mFakeTileGrid = new SparseTileGrid(mMap->width(), mMap->height());
+        mBlendGrids.clear();
+        emit layersRecreated();
+        updateWarnings();
+    }
+
+    mDirtyRegion = QRegion();
+    mRebuildRegion = QRect(QPoint(), mMap->size());
+    mEditedDuringRebuild = QRegion();
+    mRebuildCancelled = false;
+    ++mRebuildGeneration;
+
+    // Tile lookups use the tileset managers, so do those here.
+    mRebuildBlender = new BmpBlender(createSnapshot());
+    mRebuildBlender->initTiles();
+    mRebuildBlender->mInitTilesLater = false;
+
+    if (!mRebuildPool) {
+        mRebuildPool = new QThreadPool(this);
+        mRebuildPool->setMaxThreadCount(1);
+    }
+    mRebuildPool->start(new RebuildTask(this, mRebuildBlender, mRebuildGeneration));
+}
+
+void BmpBlender::cancelRebuild()
+{
+    if (!mRebuildBlender)
+        return;
+
+    mRebuildCancelled = true;
+    mRebuildPool->waitForDone();
+
+    Map *snapshot = mRebuildBlender->mMap;
+    delete mRebuildBlender;
+    mRebuildBlender = nullptr;
+    delete snapshot;
+
+    // Chunks still in the event queue are dropped, flush() does those rows.
+    ++mRebuildGeneration;
+    mDirtyRegion += mRebuildRegion;
+    mRebuildRegion = QRegion();
+    mEditedDuringRebuild = QRegion();
+    mRebuildCancelled = false;
+}
+
+void BmpBlender::applyRebuildChunk(int generation, const RebuildChunk &chunk)
+{
+    if (generation != mRebuildGeneration)
+        return;
+
+    TRACE_ZONE("BmpBlender::applyRebuildChunk");
+
+    const QRect &r = chunk.mRect;
+    const QRegion edited = mEditedDuringRebuild & r;
+
+    for (auto it = chunk.mGrids.constBegin(); it != chunk.mGrids.constEnd(); ++it) {
+        if (SparseTileGrid *grid = mTileGrids.value(it.key()))
+            replaceTilesInRect(grid, r, it.value(), edited);
+    }
+    replaceTilesInRect(mFakeTileGrid, r, chunk.mFakeGrid, edited);
+
+    for (auto it = chunk.mBlends.constBegin(); it != chunk.mBlends.constEnd(); ++it) {
+        BlendGrid &blendGrid = mBlendGrids[it.key()];
+        const QVector<int> &blends = it.value();
+        int i = 0;
+        for (int y = r.top(); y <= r.bottom(); y++) {
+            for (int x = r.left(); x <= r.right(); x++, i++) {
+                if (!edited.isEmpty() && edited.contains(QPoint(x, y)))
+                    continue;
+                const int index = x + y * mMap->width();
+                if (blends[i] >= 0 && blends[i] < mBlendList.size())
+                    blendGrid[index] = mBlendList[blends[i]];
+                else
+                    blendGrid.remove(index);
+            }
+        }
+    }
+
+    // The snapshot is out of date where the user painted since it was taken.
+    mDirtyRegion += edited;
+    mRebuildRegion -= r;
+
+    tileGridsToLayers(r.left(), r.top(), r.right(), r.bottom());
+}
+
+void BmpBlender::rebuildFinished(int generation)
+{
+    if (generation != mRebuildGeneration)
+        return;
+
+    mRebuildPool->waitForDone();
+
+    Map *snapshot = mRebuildBlender->mMap;
+    delete mRebuildBlender;
+    mRebuildBlender = nullptr;
+    delete snapshot;
+
+    mDirtyRegion += mRebuildRegion; // should be empty
+    mRebuildRegion = QRegion();
+    mEditedDuringRebuild = QRegion();
+}
+
+/////
+
 void BmpBlender::markDirty(const QRegion &rgn)
 {
     mDirtyRegion += rgn;
+    if (mRebuildBlender) {
+        for (const QRect &r : rgn)
+            mEditedDuringRebuild += r.adjusted(-2, -2, 2, 2);
+    }
 }
 
 void BmpBlender::markDirty(const QRect &r)
 {
     mDirtyRegion += r;
+    if (mRebuildBlender)
+        mEditedDuringRebuild += r.adjusted(-2, -2, 2, 2);
 }
 
 void BmpBlender::markDirty(int x1, int y1, int x2, int y2)
 {
-    mDirtyRegion += QRect(x1, y1, x2 - x1 + 1, y2 - y1 + 1);
+    markDirty(QRect(x1, y1, x2 - x1 + 1, y2 - y1 + 1));
 }
 
 void BmpBlender::flush(const MapRenderer *renderer, const QRect &rect, const QPoint &mapPos)
 {
+    TRACE_ZONE("BmpBlender::flush");
     if (mDirtyRegion.isEmpty())
         return;
 
@@ -149,6 +443,7 @@ void BmpBlender::flush(const MapRenderer *renderer, const QRect &rect, const QPo
 
 void BmpBlender::flush(const QRect &rect)
 {
+    TRACE_ZONE("BmpBlender::flush");
     QRegion dirty = mDirtyRegion & rect;
     if (dirty.isEmpty())
         return;
@@ -173,6 +468,7 @@ void BmpBlender::flush(const QRect &rect)
 void BmpBlender::tilesetAdded(Tileset *ts)
 {
     if (mTilesetNames.contains(ts->name())) {
+        cancelRebuild();
         mInitTilesLater = true;
         mDirtyRegion = QRegion(0, 0, mMap->width(), mMap->height());
     }
@@ -181,6 +477,7 @@ void BmpBlender::tilesetAdded(Tileset *ts)
 void BmpBlender::tilesetRemoved(const QString &tilesetName)
 {
     if (mTilesetNames.contains(tilesetName)) {
+        cancelRebuild();
         mInitTilesLater = true;
         mDirtyRegion = QRegion(0, 0, mMap->width(), mMap->height());
     }
@@ -232,12 +529,14 @@ bool BmpBlender::expectTile(const QString &layerName, int x, int y, Tile *tile)
 
 void BmpBlender::setBlendEdgesEverywhere(bool enabled)
 {
+    cancelRebuild();
     mBlendEdgesEverywhere = enabled;
     markDirty(0, 0, mMap->width() - 1, mMap->height() - 1);
 }
 
 void BmpBlender::testBlendEdgesEverywhere(bool enabled, QRegion& tileSelection)
 {
+    cancelRebuild();
     if (mInitTilesLater) {
         initTiles();
         mInitTilesLater = false;
@@ -309,6 +608,8 @@ static QStringList normalizeTileNames(const QStringList &tileNames)
 
 void BmpBlender::fromMap()
 {
+    cancelRebuild();
+
     QSet<QString> tileNames;
 
     // We have to take care that any alias references exist, because when
@@ -362,6 +663,7 @@ void BmpBlender::fromMap()
 
     qDeleteAll(mBlendList);
     mBlendList.clear();
+    mBlendGrids.clear();
     mBlendsByLayer.clear();
     mBlendLayers.clear();
     QSet<QString> layers;
@@ -547,7 +849,7 @@ void BmpBlender::imagesToTileGrids(int x1, int y1, int x2, int y2)
                     Tiled::SparseTileGrid *tileGrid = it.value();
                     if (!ruleW->mTiles.size())
                         continue;
-                    Tile *tile = ruleW->mTiles[mMap->bmp(0).rand(x, y) % ruleW->mTiles.size()];
+                    Tile *tile = ruleW->mTiles[mMap->rbmp(0).rand(x, y) % ruleW->mTiles.size()];
                     tileGrid->replace(x, y, Cell(tile));
                 }
             }
@@ -559,7 +861,7 @@ void BmpBlender::imagesToTileGrids(int x1, int y1, int x2, int y2)
                     if (mFloorTileToRule.contains(tile)) {
                         RuleWrapper *ruleW = mFloorTileToRule[tile];
                         if (ruleW->mTiles.size()) {
-                            Tile *tile = ruleW->mTiles[mMap->bmp(0).rand(x, y) % ruleW->mTiles.count()];
+                            Tile *tile = ruleW->mTiles[mMap->rbmp(0).rand(x, y) % ruleW->mTiles.count()];
                             mFakeTileGrid->replace(x, y, Cell(tile));
                         }
                         col = ruleW->mRule->color;
@@ -579,7 +881,7 @@ void BmpBlender::imagesToTileGrids(int x1, int y1, int x2, int y2)
                     Tiled::SparseTileGrid *tileGrid = it.value();
                     if (!ruleW->mTiles.size())
                         continue;
-                    Tile *tile = ruleW->mTiles[mMap->bmp(1).rand(x, y) % ruleW->mTiles.size()];
+                    Tile *tile = ruleW->mTiles[mMap->rbmp(1).rand(x, y) % ruleW->mTiles.size()];
                     tileGrid->replace(x, y, Cell(tile)); /*mTileGrids[ruleW->mRule->targetLayer]->replace(x, y, Cell(tile))*/
                 }
             }
@@ -646,7 +948,7 @@ void BmpBlender::addEdgeTiles(int x1, int y1, int x2, int y2)
                 }
                 const QVector<Tile*> tiles = blendW->mBlendTiles;
                 if (tiles.size()) {
-                    Tile *tile = tiles[mMap->bmp(0).rand(x, y) % tiles.size()];
+                    Tile *tile = tiles[mMap->rbmp(0).rand(x, y) % tiles.size()];
                     mTileGrids[layerName]->replace(x, y, Cell(tile));
                 }
                 if (true/*mHack*/) {
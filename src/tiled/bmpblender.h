@@ -26,6 +26,10 @@
 #include <QStringList>
 #include <QVector>
 
+#include <atomic>
+
+class QThreadPool;
+
 namespace Tiled {
 class BmpAlias;
 class BmpBlend;
@@ -120,6 +124,20 @@ public:
 
     void fromMap();
     void recreate();
+
+    /**
+     * When enabled, recreate() rebuilds the whole map on a background thread
+     * from a snapshot of the BMP images and layers, instead of leaving it all
+     * for the next flush() to do while painting.  The new tiles are swapped in
+     * a band of rows at a time.  A later fromMap() or recreate() cancels a
+     * rebuild that hasn't finished.  Only for blenders used on the GUI thread.
+     */
+    void setAsyncRecreate(bool async)
+    { mAsyncRecreate = async; }
+
+    bool isRecreating() const
+    { return mRebuildBlender != nullptr; }
+
     void markDirty(const QRegion &rgn);
     void markDirty(const QRect &r);
     void markDirty(int x1, int y1, int x2, int y2);
@@ -172,6 +190,15 @@ private:
     void tileGridsToLayers(int x1, int y1, int x2, int y2);
     QString resolveAlias(const QString &tileName, int randForPos) const;
 
+    class RebuildChunk;
+    class RebuildTask;
+    friend class RebuildTask;
+    Map *createSnapshot();
+    void startRebuild();
+    void cancelRebuild();
+    void applyRebuildChunk(int generation, const RebuildChunk &chunk);
+    void rebuildFinished(int generation);
+
     Map *mMap;
     QMap<QString,SparseTileGrid*> mTileGrids;
     SparseTileGrid *mFakeTileGrid;
@@ -244,6 +271,14 @@ private:
 
     QRegion mDirtyRegion;
 
+    bool mAsyncRecreate;
+    QThreadPool *mRebuildPool;
+    BmpBlender *mRebuildBlender; // works on the snapshot on mRebuildPool
+    std::atomic<bool> mRebuildCancelled;
+    int mRebuildGeneration;
+    QRegion mRebuildRegion; // not received from the worker yet
+    QRegion mEditedDuringRebuild; // the worker's snapshot is out of date here
+
     QSet<QString> mWarnings;
 
     QString mError;
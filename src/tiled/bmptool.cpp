@@ -36,10 +36,13 @@
 #include <QApplication>
 #include <QDebug>
 #include <QPainter>
+#include <QSet>
 #include <QUndoCommand>
 #include <QVector2D>
 #include <qmath.h>
 
+#include <algorithm>
+
 using namespace Tiled;
 using namespace Tiled::Internal;
 
@@ -1330,18 +1333,19 @@ void BmpWandTool::tilePositionChanged(const QPoint &tilePos)
 
     if (!QRect(QPoint(), mapDocument()->map()->size()).contains(tilePos)) {
         brushItem()->setTileRegion(QRegion());
-        mFloodFill.mRegion = QRegion();
+        mFillRegion = QRegion();
         return;
     }
-    if (mFloodFill.mRegion.contains(tilePos))
+    if (mFillRegion.contains(tilePos))
         return;
     int bmpIndex = BmpBrushTool::instance()->bmpIndex();
-    mFloodFill.mImage = mapDocument()->map()->bmp(bmpIndex).image().copy();
-    mFloodFill.mRegion = QRegion();
-    mFloodFill.floodFillScanlineStack(tilePos.x(), tilePos.y(),
-                                      qRgba(0, 0, 0, 0),
-                                      mFloodFill.mImage.pixel(tilePos.x(), tilePos.y()));
-    brushItem()->setTileRegion(mFloodFill.mRegion);
+    const QRgb pixel = mapDocument()->map()->bmp(bmpIndex).pixel(tilePos);
+    // Transparent areas can't be selected.
+    if (pixel == qRgba(0, 0, 0, 0))
+        mFillRegion = QRegion();
+    else
+        mFillRegion = mFillRegions.regions(mapDocument(), bmpIndex).region(tilePos.x(), tilePos.y());
+    brushItem()->setTileRegion(mFillRegion);
 }
 
 void BmpWandTool::updateStatusInfo()
@@ -1493,13 +1497,15 @@ void BmpWandTool::mapDocumentChanged(MapDocument *oldDocument,
                 this, &BmpWandTool::bmpImageChanged);
     }
 
-    mFloodFill.mRegion = QRegion();
+    mFillRegions.clear();
+    mFillRegion = QRegion();
 }
 
 void BmpWandTool::bmpImageChanged()
 {
     // Recompute the fill region if the BMP or tool settings change.
-    mFloodFill.mRegion = QRegion();
+    mFillRegions.clear();
+    mFillRegion = QRegion();
     if (scene()) {
         tilePositionChanged(tilePosition());
     }
@@ -1702,42 +1708,45 @@ void BmpBucketTool::tilePositionChanged(const QPoint &tilePos)
 {
     if (!QRect(QPoint(), mapDocument()->map()->size()).contains(tilePos)) {
         brushItem()->setTileRegion(QRegion());
-        mFloodFill.mRegion = QRegion();
+        mFillRegion = QRegion();
         return;
     }
-    if (mFloodFill.mRegion.contains(tilePos))
+    if (mFillRegion.contains(tilePos))
         return;
     int bmpIndex = BmpBrushTool::instance()->bmpIndex();
+    const QRgb pixel = mapDocument()->map()->bmp(bmpIndex).pixel(tilePos);
+    // Nothing to fill if the area is already the brush color.
+    if (pixel == BmpBrushTool::instance()->color()) {
+        mFillRegion = QRegion();
+        brushItem()->setTileRegion(mFillRegion);
+        return;
+    }
+    const ConnectedRegions &regions = mFillRegions.regions(mapDocument(), bmpIndex);
     const QRegion selection = mapDocument()->bmpSelection();
     if ((selection.isEmpty() == false) && BmpBrushTool::instance()->restrictToSelection() && BmpBrushTool::instance()->fillAllInSelection()) {
-        QImage bmpImage = mapDocument()->map()->bmp(bmpIndex).image().copy();
-        const QRgb pixel = bmpImage.pixel(tilePos);
-        mFloodFill.mImage = mapDocument()->map()->bmp(bmpIndex).image().copy();
-        QRegion tileRgn;
-        for (const QRect& rect : selection) {
+        // Every area of this color that is at least partly selected.
+        const QImage bmpImage = mapDocument()->map()->bmp(bmpIndex).image();
+        const QRegion imageSelection = selection & bmpImage.rect();
+        QSet<int> labels;
+        for (const QRect& rect : imageSelection) {
             for (int y = rect.y(); y <= rect.bottom(); y++) {
                 for (int x = rect.x(); x <= rect.right(); x++) {
-                    if (tileRgn.contains(QPoint(x, y)))
-                        continue;
-                    if (bmpImage.pixel(x, y) != pixel)
-                        continue;
-                    mFloodFill.mRegion = QRegion();
-                    mFloodFill.floodFillScanlineStack(x, y, BmpBrushTool::instance()->color(), pixel);
-                    mFloodFill.mRegion &= selection;
-                    tileRgn |= mFloodFill.mRegion;
+                    if (bmpImage.pixel(x, y) == pixel)
+                        labels.insert(regions.label(x, y));
                 }
             }
         }
+        QRegion tileRgn;
+        for (int label : qAsConst(labels))
+            tileRgn |= regions.regionForLabel(label);
+        tileRgn &= selection;
+        mFillRegion = tileRgn;
         brushItem()->setTileRegion(tileRgn);
         return;
     }
-    mFloodFill.mImage = mapDocument()->map()->bmp(bmpIndex).image().copy();
-    mFloodFill.mRegion = QRegion();
-    mFloodFill.floodFillScanlineStack(tilePos.x(), tilePos.y(),
-                                      BmpBrushTool::instance()->color(),
-                                      mFloodFill.mImage.pixel(tilePos.x(), tilePos.y()));
+    mFillRegion = regions.region(tilePos.x(), tilePos.y());
 
-    QRegion tileRgn = mFloodFill.mRegion;
+    QRegion tileRgn = mFillRegion;
     if (BmpBrushTool::instance()->restrictToSelection()) {
         if (!selection.isEmpty())
             tileRgn &= selection;
@@ -1760,16 +1769,19 @@ void BmpBucketTool::mousePressed(QGraphicsSceneMouseEvent *event)
     const Qt::MouseButton button = event->button();
 
     if (button == Qt::LeftButton) {
-        if (mFloodFill.mRegion.isEmpty())
+        if (mFillRegion.isEmpty())
             return;
         int bmpIndex = BmpBrushTool::instance()->bmpIndex();
         QRegion region = brushItem()->tileRegion();
+        // PaintBMP only copies the pixels inside the region.
+        QImage source = mapDocument()->map()->bmp(bmpIndex).image().copy(region.boundingRect());
+        source.fill(QColor::fromRgba(BmpBrushTool::instance()->color()));
         mapDocument()->undoStack()->push(
                     new PaintBMP(mapDocument(),
                                  bmpIndex,
                                  region.boundingRect().x(),
                                  region.boundingRect().y(),
-                                 mFloodFill.mImage.copy(region.boundingRect()),
+                                 source,
                                  region));
     }
 }
@@ -1800,13 +1812,15 @@ void BmpBucketTool::mapDocumentChanged(MapDocument *oldDocument,
                 this, &BmpBucketTool::bmpImageChanged);
     }
 
-    mFloodFill.mRegion = QRegion();
+    mFillRegions.clear();
+    mFillRegion = QRegion();
 }
 
 void BmpBucketTool::bmpImageChanged()
 {
     // Recompute the fill region if the BMP changes.
-    mFloodFill.mRegion = QRegion();
+    mFillRegions.clear();
+    mFillRegion = QRegion();
     if (scene()) {
         tilePositionChanged(tilePosition());
     }
@@ -2116,108 +2130,26 @@ void NoBlendTool::clearNoBlend()
 
 /////
 
-// Taken from http://lodev.org/cgtutor/floodfill.html#Recursive_Scanline_Floodfill_Algorithm
-// Copyright (c) 2004-2007 by Lode Vandevenne. All rights reserved.
-void BmpFloodFill::floodFillScanlineStack(int x, int y, QRgb newColor, QRgb oldColor)
-{
-    if (oldColor == newColor) return;
-    emptyStack();
-
-    int y1;
-    bool spanLeft, spanRight;
-
-    if (!push(x, y)) return;
-
-    while (pop(x, y)) {
-        y1 = y;
-        while (y1 >= 0 && pixel(x, y1) == oldColor) y1--;
-        y1++;
-        spanLeft = spanRight = false;
-        QRect r;
-        while (y1 < mImage.height() && pixel(x, y1) == oldColor ) {
-            setPixel(x, y1, newColor);
-#if 1 // This seems a lot faster (in Debug mode at least) than mRegion += QRect(x, y, 1, 1) each setPixel()
-            if (r.isEmpty()) {
-                r = QRect(x, y1, 1, 1);
-            } else if (r.bottom() + 1 != y1) {
-                mRegion += r;
-                r = QRect();
-            } else {
-                r.setBottom(y1);
-            }
-#else
-            mRegion += QRect(x, y1, 1, 1);
-#endif
-            if (!spanLeft && x > 0 && pixel(x - 1, y1) == oldColor) {
-                if (!push(x - 1, y1)) return;
-                spanLeft = true;
-            }
-            else if (spanLeft && x > 0 && pixel(x - 1, y1) != oldColor) {
-                spanLeft = false;
-            }
-#if 1 // For visually-vertical columns of tiles, test square to the northwest.
-            if (!spanLeft && x > 0 && y > 0 && pixel(x - 1, y1 - 1) == oldColor) {
-                if (!push(x - 1, y1 - 1)) return;
-                spanLeft = true;
-            }
-#endif
-            if (!spanRight && x < mImage.width() - 1 && pixel(x + 1, y1) == oldColor) {
-                if (!push(x + 1, y1)) return;
-                spanRight = true;
-            }
-            else if (spanRight && x < mImage.width() - 1 && pixel(x + 1, y1) != oldColor) {
-                spanRight = false;
-            }
-#if 1 // For visually-vertical columns of tiles, test square to the southeast.
-            if (!spanRight && x < mImage.width() - 1 && y < mImage.height() - 1 && pixel(x + 1, y1 + 1) == oldColor) {
-                if (!push(x + 1, y1 + 1)) return;
-                spanRight = true;
-            }
-#endif
-            y1++;
-        }
-        if (!r.isEmpty())
-            mRegion += r;
-    }
-}
-
-QRgb BmpFloodFill::pixel(int x, int y)
+const ConnectedRegions &BmpFillRegions::regions(MapDocument *mapDocument, int bmpIndex)
 {
-    return mImage.pixel(x, y);
-}
+    if (bmpIndex == mBmpIndex && !mRegions.isEmpty())
+        return mRegions;
 
-void BmpFloodFill::setPixel(int x, int y, QRgb pixel)
-{
-    mImage.setPixel(x, y, pixel);
-}
-
-bool BmpFloodFill::push(int x, int y)
-{
-    if (stackPointer < STACK_SIZE - 1) {
-        stackPointer++;
-        stack[stackPointer] = mImage.height() * x + y;
-        return true;
-    } else {
-        return false;
-    }
-}
+    QImage image = mapDocument->map()->bmp(bmpIndex).image();
+    if (image.format() != QImage::Format_ARGB32)
+        image = image.convertToFormat(QImage::Format_ARGB32);
 
-bool BmpFloodFill::pop(int &x, int &y)
-{
-    if (stackPointer > 0) {
-        int p = stack[stackPointer];
-        x = p / mImage.height();
-        y = p % mImage.height();
-        stackPointer--;
-        return true;
-    } else {
-        return false;
+    const int width = image.width();
+    const int height = image.height();
+    QVector<quint32> values(width * height);
+    for (int y = 0; y < height; ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        std::copy(line, line + width, values.begin() + y * width);
     }
-}
 
-void BmpFloodFill::emptyStack()
-{
-    stackPointer = 0;
+    mRegions.compute(values, width, height, ConnectedRegions::SixWay);
+    mBmpIndex = bmpIndex;
+    return mRegions;
 }
 
 /////
@@ -19,6 +19,7 @@
 #define BMPTOOL_H
 
 #include "abstracttool.h"
+#include "connectedregions.h"
 
 #include "map.h" // for MapRands
 
@@ -278,21 +279,27 @@ private:
     bool mSelecting;
 };
 
-class BmpFloodFill
+// The connected areas of one color in a BMP image, used by the fill and
+// fuzzy select tools.  Recomputed after clear() or when the BMP index changes.
+class BmpFillRegions
 {
 public:
-    void floodFillScanlineStack(int x, int y, QRgb newColor, QRgb oldColor);
-    QRgb pixel(int x, int y);
-    void setPixel(int x, int y, QRgb pixel);
-    bool push(int x, int y);
-    bool pop(int &x, int &y);
-    void emptyStack();
-
-    QImage mImage;
-    QRegion mRegion;
-    enum { STACK_SIZE = 300 * 300 };
-    int stack[STACK_SIZE];
-    int stackPointer;
+    BmpFillRegions() :
+        mBmpIndex(-1)
+    {
+    }
+
+    const ConnectedRegions &regions(MapDocument *mapDocument, int bmpIndex);
+
+    void clear()
+    {
+        mRegions.clear();
+        mBmpIndex = -1;
+    }
+
+private:
+    ConnectedRegions mRegions;
+    int mBmpIndex;
 };
 
 // This tool is for selecting and moving pixels in a map's BMP images.
@@ -345,7 +352,8 @@ private:
     bool mMouseDown;
     bool mMouseMoved;
 
-    BmpFloodFill mFloodFill;
+    BmpFillRegions mFillRegions;
+    QRegion mFillRegion;
 };
 
 // This tool is for drawing rectangles in a map's BMP images.
@@ -426,7 +434,8 @@ private:
     QPointF mStartScenePos;
     QPoint mStartTilePos;
     bool mErasing;
-    BmpFloodFill mFloodFill;
+    BmpFillRegions mFillRegions;
+    QRegion mFillRegion;
 };
 
 // This tool is for baking auto-generated tiles to tile layers.
@@ -0,0 +1,398 @@
+/*
+ * bmptotmxconverter.cpp
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bmptotmxconverter.h"
+
+#include "bmpblender.h"
+#include "tilesetmanager.h"
+
+#include "worlded/world.h"
+
+#include "map.h"
+#include "mapreader.h"
+#include "mapwriter.h"
+#include "tilelayer.h"
+#include "tileset.h"
+#include "tracing.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QScopedPointer>
+#include <QTextStream>
+#include <QThreadPool>
+
+#include <algorithm>
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+namespace {
+
+const int CELL_SIZE = 300;
+
+// Bump this when the output for the same pixels and rules changes, so every
+// cell is converted again.
+const int HASH_VERSION = 1;
+
+const char *HASHES_FILE = "bmptotmx.sha1";
+
+} // namespace
+
+class BmpToTmxConverter::CellTask : public QRunnable
+{
+public:
+    CellTask(BmpToTmxConverter *owner, const CellPos &pos, const QRect &rect,
+             const QImage &bmpMain, const QImage &bmpVeg) :
+        mOwner(owner),
+        mPos(pos),
+        mRect(rect),
+        mBmpMain(bmpMain),
+        mBmpVeg(bmpVeg)
+    {
+    }
+
+    void run()
+    {
+        TRACE_ZONE("BmpToTmxConverter::CellTask");
+
+        const QImage bmpMain = mBmpMain.copy(mRect);
+        const QImage bmpVeg = mBmpVeg.copy(mRect);
+
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(mOwner->mRulesHash);
+        hash.addData(QByteArray::fromRawData(reinterpret_cast<const char*>(bmpMain.constBits()),
+                                             int(bmpMain.sizeInBytes())));
+        hash.addData(QByteArray::fromRawData(reinterpret_cast<const char*>(bmpVeg.constBits()),
+                                             int(bmpVeg.sizeInBytes())));
+        const QByteArray digest = hash.result();
+
+        const QString fileName = mOwner->tmxFileName(mPos);
+        if (mOwner->mOldHashes.value(mPos) == digest && QFileInfo::exists(fileName)) {
+            mOwner->cellDone(mPos, digest, false, QString());
+            return;
+        }
+
+        QScopedPointer<Map> map(mOwner->mMapBase->clone());
+        map->rbmpMain().rimage() = bmpMain;
+        map->rbmpVeg().rimage() = bmpVeg;
+        // The same cell always gets the same random tile choices.
+        const uint seed = uint(mPos.second) * 1000 + uint(mPos.first);
+        map->rbmpMain().rrands().setSeed(seed);
+        map->rbmpVeg().rrands().setSeed(seed);
+
+        QString warning;
+        if (!mOwner->mCopyPixels) {
+            // Put the tiles in the map.  Otherwise TileZed does the blending
+            // when the map is opened.
+            warning = blend(map.data());
+            map->rbmpMain().rimage().fill(Qt::black);
+            map->rbmpVeg().rimage().fill(Qt::black);
+        }
+
+        QSaveFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            mOwner->cellDone(mPos, QByteArray(), false,
+                             BmpToTmxConverter::tr("Error writing %1.\n%2")
+                             .arg(QDir::toNativeSeparators(fileName), file.errorString()));
+            return;
+        }
+        MapWriter writer;
+        writer.setLayerDataFormat(mOwner->mCompress ? MapWriter::Base64Gzip
+                                                    : MapWriter::Base64);
+        writer.writeMap(map.data(), &file, QFileInfo(fileName).absolutePath());
+        if (!file.commit()) {
+            mOwner->cellDone(mPos, QByteArray(), false,
+                             BmpToTmxConverter::tr("Error writing %1.\n%2")
+                             .arg(QDir::toNativeSeparators(fileName), file.errorString()));
+            return;
+        }
+
+        mOwner->cellDone(mPos, digest, true, warning);
+    }
+
+private:
+    QString blend(Map *map)
+    {
+        QString warning;
+
+        BmpBlender blender(map);
+        blender.flush(QRect(QPoint(), map->size()));
+        foreach (TileLayer *tl, blender.tileLayers()) {
+            int index = map->indexOfLayer(tl->name(), Layer::TileLayerType);
+            if (index == -1) {
+                warning = BmpToTmxConverter::tr("The map base has no %1 layer.")
+                        .arg(tl->name());
+                continue;
+            }
+            TileLayer *mapLayer = map->layerAt(index)->asTileLayer();
+            for (int y = 0; y < tl->height(); y++) {
+                for (int x = 0; x < tl->width(); x++) {
+                    Tile *tile = tl->cellAt(x, y).tile;
+                    // Tiles the rules name but the map base doesn't have are
+                    // the missing tile, which can't be written.
+                    if (tile && map->indexOfTileset(tile->tileset()) != -1)
+                        mapLayer->setCell(x, y, Cell(tile));
+                }
+            }
+        }
+
+        return warning;
+    }
+
+    BmpToTmxConverter *mOwner;
+    CellPos mPos;
+    QRect mRect;
+    QImage mBmpMain;
+    QImage mBmpVeg;
+};
+
+BmpToTmxConverter::BmpToTmxConverter() :
+    mMapBase(nullptr),
+    mCopyPixels(false),
+    mCompress(true),
+    mConverted(0),
+    mSkipped(0)
+{
+}
+
+BmpToTmxConverter::~BmpToTmxConverter()
+{
+    if (mMapBase) {
+        qDeleteAll(mMapBase->tilesets());
+        delete mMapBase;
+    }
+}
+
+bool BmpToTmxConverter::convert(World *world)
+{
+    return convert(world, world->bmps());
+}
+
+bool BmpToTmxConverter::convert(World *world, const QList<WorldBMP *> &bmps)
+{
+    TRACE_ZONE("BmpToTmxConverter::convert");
+
+    mConverted = mSkipped = 0;
+    mHashes.clear();
+    mWarnings.clear();
+    mError.clear();
+
+    if (!readSettings(world))
+        return false;
+    readHashes();
+
+    // Tiles the rules name that aren't in the map base become the missing
+    // tile.  Make sure the tileset manager exists before the threads ask.
+    (void) TilesetManager::instance()->missingTile();
+
+    foreach (WorldBMP *bmp, bmps)
+        convertBmp(bmp);
+
+    return writeHashes();
+}
+
+bool BmpToTmxConverter::readSettings(World *world)
+{
+    const BMPToTMXSettings &settings = world->getBMPToTMXSettings();
+
+    if (settings.exportDir.isEmpty() || !QFileInfo(settings.exportDir).isDir()) {
+        mError = tr("The export directory doesn't exist.\n%1")
+                .arg(QDir::toNativeSeparators(settings.exportDir));
+        return false;
+    }
+    mExportDir = settings.exportDir;
+    mCopyPixels = settings.copyPixels;
+    mCompress = settings.compress;
+
+    BmpRulesFile rulesFile;
+    if (!rulesFile.read(settings.rulesFile)) {
+        mError = tr("Error reading %1.\n%2")
+                .arg(QDir::toNativeSeparators(settings.rulesFile), rulesFile.errorString());
+        return false;
+    }
+
+    BmpBlendsFile blendsFile;
+    if (!blendsFile.read(settings.blendsFile, rulesFile.aliases())) {
+        mError = tr("Error reading %1.\n%2")
+                .arg(QDir::toNativeSeparators(settings.blendsFile), blendsFile.errorString());
+        return false;
+    }
+
+    if (mMapBase) {
+        qDeleteAll(mMapBase->tilesets());
+        delete mMapBase;
+    }
+    MapReader reader;
+    mMapBase = reader.readMap(settings.mapbaseFile);
+    if (!mMapBase) {
+        mError = tr("Error reading %1.\n%2")
+                .arg(QDir::toNativeSeparators(settings.mapbaseFile), reader.errorString());
+        return false;
+    }
+    if (mMapBase->size() != QSize(CELL_SIZE, CELL_SIZE)) {
+        mError = tr("The map base must be %1x%1.\n%2").arg(CELL_SIZE)
+                .arg(QDir::toNativeSeparators(settings.mapbaseFile));
+        return false;
+    }
+
+    // Every cell gets a copy of these, the files aren't read again.
+    BmpSettings *bmpSettings = mMapBase->rbmpSettings();
+    bmpSettings->setRulesFile(settings.rulesFile);
+    bmpSettings->setBlendsFile(settings.blendsFile);
+    bmpSettings->setAliases(rulesFile.aliasesCopy());
+    bmpSettings->setRules(rulesFile.rulesCopy());
+    bmpSettings->setBlends(blendsFile.blendsCopy());
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(HASH_VERSION));
+    hash.addData(QByteArray::number(int(mCopyPixels)));
+    hash.addData(QByteArray::number(int(mCompress)));
+    const QStringList fileNames = QStringList() << settings.rulesFile
+                                                << settings.blendsFile
+                                                << settings.mapbaseFile;
+    foreach (const QString &fileName, fileNames) {
+        QFile file(fileName);
+        if (file.open(QIODevice::ReadOnly))
+            hash.addData(&file);
+    }
+    mRulesHash = hash.result();
+
+    return true;
+}
+
+bool BmpToTmxConverter::convertBmp(WorldBMP *bmp)
+{
+    TRACE_ZONE("BmpToTmxConverter::convertBmp");
+
+    const QFileInfo info(bmp->filePath());
+    const QString vegPath = info.absolutePath() + QLatin1Char('/')
+            + info.completeBaseName() + QLatin1String("_veg.") + info.suffix();
+
+    QImage bmpMain(bmp->filePath());
+    if (bmpMain.isNull()) {
+        mWarnings += tr("Couldn't read %1.").arg(QDir::toNativeSeparators(bmp->filePath()));
+        return false;
+    }
+    QImage bmpVeg(vegPath);
+    if (bmpVeg.isNull()) {
+        mWarnings += tr("Couldn't read %1.").arg(QDir::toNativeSeparators(vegPath));
+        return false;
+    }
+    if (bmpMain.size() != bmpVeg.size()) {
+        mWarnings += tr("%1 and %2 aren't the same size.")
+                .arg(info.fileName(), QFileInfo(vegPath).fileName());
+        return false;
+    }
+    if (bmpMain.width() % CELL_SIZE || bmpMain.height() % CELL_SIZE) {
+        mWarnings += tr("The size of %1 isn't a multiple of %2, the partial cells are ignored.")
+                .arg(info.fileName()).arg(CELL_SIZE);
+    }
+
+    // The rules compare the pixels with qRgb() colors.
+    bmpMain = bmpMain.convertToFormat(QImage::Format_RGB32);
+    bmpVeg = bmpVeg.convertToFormat(QImage::Format_RGB32);
+
+    QThreadPool pool;
+    for (int cy = 0; cy < bmpMain.height() / CELL_SIZE; cy++) {
+        for (int cx = 0; cx < bmpMain.width() / CELL_SIZE; cx++) {
+            const CellPos pos(bmp->x() + cx, bmp->y() + cy);
+            const QRect rect(cx * CELL_SIZE, cy * CELL_SIZE, CELL_SIZE, CELL_SIZE);
+            pool.start(new CellTask(this, pos, rect, bmpMain, bmpVeg));
+        }
+    }
+    pool.waitForDone();
+
+    return true;
+}
+
+// Each line is "x y hash".
+void BmpToTmxConverter::readHashes()
+{
+    mOldHashes.clear();
+
+    QFile file(QDir(mExportDir).filePath(QLatin1String(HASHES_FILE)));
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return;
+
+    QTextStream ts(&file);
+    while (!ts.atEnd()) {
+        const QStringList words = ts.readLine().split(QLatin1Char(' '));
+        if (words.size() != 3)
+            continue;
+        bool okX, okY;
+        const CellPos pos(words[0].toInt(&okX), words[1].toInt(&okY));
+        if (okX && okY)
+            mOldHashes[pos] = QByteArray::fromHex(words[2].toLatin1());
+    }
+}
+
+bool BmpToTmxConverter::writeHashes()
+{
+    // Cells of other BMPs keep their hashes, cells that failed lose theirs.
+    QHash<CellPos,QByteArray> hashes = mOldHashes;
+    for (auto it = mHashes.constBegin(); it != mHashes.constEnd(); ++it) {
+        if (it.value().isEmpty())
+            hashes.remove(it.key());
+        else
+            hashes[it.key()] = it.value();
+    }
+
+    QList<CellPos> positions = hashes.keys();
+    std::sort(positions.begin(), positions.end());
+
+    QSaveFile file(QDir(mExportDir).filePath(QLatin1String(HASHES_FILE)));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        mError = file.errorString();
+        return false;
+    }
+    QTextStream ts(&file);
+    foreach (const CellPos &pos, positions) {
+        ts << pos.first << ' ' << pos.second << ' '
+           << QString::fromLatin1(hashes[pos].toHex()) << '\n';
+    }
+    ts.flush();
+    if (!file.commit()) {
+        mError = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+QString BmpToTmxConverter::tmxFileName(const CellPos &pos) const
+{
+    return QDir(mExportDir).filePath(QString::fromLatin1("%1_%2.tmx")
+                                     .arg(pos.first).arg(pos.second));
+}
+
+void BmpToTmxConverter::cellDone(const CellPos &pos, const QByteArray &hash,
+                                 bool written, const QString &warning)
+{
+    QMutexLocker locker(&mMutex);
+    mHashes[pos] = hash;
+    if (written)
+        ++mConverted;
+    else if (!hash.isEmpty())
+        ++mSkipped;
+    if (!warning.isEmpty() && !mWarnings.contains(warning))
+        mWarnings += warning;
+}
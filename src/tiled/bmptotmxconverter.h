@@ -0,0 +1,107 @@
+/*
+ * bmptotmxconverter.h
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BMPTOTMXCONVERTER_H
+#define BMPTOTMXCONVERTER_H
+
+#include <QCoreApplication>
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QStringList>
+
+class World;
+class WorldBMP;
+
+namespace Tiled {
+
+class Map;
+
+namespace Internal {
+
+/**
+ * Converts the .bmp files of a WorldEd project into one .tmx file per cell,
+ * without any user interface.
+ *
+ * Rules.txt, Blends.txt and the map base are read once and only read after
+ * that.  Each 300x300 cell is then blended and written on a thread of its
+ * own.  The hash of every cell's pixels and of the rules is remembered in
+ * the export directory, so a cell whose pixels and rules haven't changed
+ * since the last conversion is skipped.
+ */
+class BmpToTmxConverter
+{
+    Q_DECLARE_TR_FUNCTIONS(BmpToTmxConverter)
+
+public:
+    BmpToTmxConverter();
+    ~BmpToTmxConverter();
+
+    /**
+     * Converts every BMP in \a world with the world's BMP To TMX settings.
+     * Returns false and sets errorString() if nothing could be converted.
+     */
+    bool convert(World *world);
+    bool convert(World *world, const QList<WorldBMP*> &bmps);
+
+    QString errorString() const
+    { return mError; }
+
+    QStringList warnings() const
+    { return mWarnings; }
+
+    int convertedCount() const
+    { return mConverted; }
+
+    int skippedCount() const
+    { return mSkipped; }
+
+private:
+    typedef QPair<int,int> CellPos;
+
+    class CellTask;
+    friend class CellTask;
+
+    bool readSettings(World *world);
+    bool convertBmp(WorldBMP *bmp);
+    void readHashes();
+    bool writeHashes();
+
+    QString tmxFileName(const CellPos &pos) const;
+    void cellDone(const CellPos &pos, const QByteArray &hash, bool written,
+                  const QString &warning);
+
+    Map *mMapBase;
+    QString mExportDir;
+    bool mCopyPixels;
+    bool mCompress;
+    QByteArray mRulesHash;
+    QHash<CellPos,QByteArray> mOldHashes;
+    QHash<CellPos,QByteArray> mHashes;
+    QMutex mMutex; // guards the members the cell tasks write to
+    int mConverted;
+    int mSkipped;
+    QStringList mWarnings;
+    QString mError;
+};
+
+} // namespace Internal
+} // namespace Tiled
+
+#endif // BMPTOTMXCONVERTER_H
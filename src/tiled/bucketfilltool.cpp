@@ -43,6 +43,7 @@ BucketFillTool::BucketFillTool(QObject *parent)
                        parent)
     , mStamp(0)
     , mFillOverlay(0)
+    , mFillRegionsLayer(0)
     , mIsRandom(false)
 #ifdef ZOMBOID
     , mIsActive(false)
@@ -117,7 +118,7 @@ void BucketFillTool::tilePositionChanged(const QPoint &tilePos)
         // Get the new fill region
         if (!shiftPressed) {
             // If not holding shift, a region is generated from the current pos
-            mFillRegion = regionComputer.computeFillRegion(tilePos);
+            mFillRegion = fillRegionAt(regionComputer, tileLayer, tilePos);
         } else {
             // If holding shift, the region is the selection bounds
             mFillRegion = mapDocument()->tileSelection();
@@ -219,6 +220,52 @@ void BucketFillTool::mapDocumentChanged(MapDocument *oldDocument,
 
     clearConnections(oldDocument);
 
+    if (oldDocument) {
+#ifdef ZOMBOID
+        disconnect(oldDocument, &MapDocument::regionChanged,
+                   this, &BucketFillTool::layerRegionChanged);
+        disconnect(oldDocument, &MapDocument::regionAltered,
+                   this, &BucketFillTool::layerRegionChanged);
+#else
+        disconnect(oldDocument, SIGNAL(regionChanged(QRegion)),
+                   this, SLOT(invalidateFillRegions()));
+#endif
+        disconnect(oldDocument, &MapDocument::tileSelectionChanged,
+                   this, &BucketFillTool::invalidateFillRegions);
+        disconnect(oldDocument, &MapDocument::mapChanged,
+                   this, &BucketFillTool::invalidateFillRegions);
+        disconnect(oldDocument, &MapDocument::layerChanged,
+                   this, &BucketFillTool::invalidateFillRegions);
+        disconnect(oldDocument, &MapDocument::layerAboutToBeRemoved,
+                   this, &BucketFillTool::invalidateFillRegions);
+        disconnect(oldDocument, &MapDocument::tilesetRemoved,
+                   this, &BucketFillTool::invalidateFillRegions);
+    }
+
+    if (newDocument) {
+#ifdef ZOMBOID
+        connect(newDocument, &MapDocument::regionChanged,
+                this, &BucketFillTool::layerRegionChanged);
+        connect(newDocument, &MapDocument::regionAltered,
+                this, &BucketFillTool::layerRegionChanged);
+#else
+        connect(newDocument, SIGNAL(regionChanged(QRegion)),
+                this, SLOT(invalidateFillRegions()));
+#endif
+        connect(newDocument, &MapDocument::tileSelectionChanged,
+                this, &BucketFillTool::invalidateFillRegions);
+        connect(newDocument, &MapDocument::mapChanged,
+                this, &BucketFillTool::invalidateFillRegions);
+        connect(newDocument, &MapDocument::layerChanged,
+                this, &BucketFillTool::invalidateFillRegions);
+        connect(newDocument, &MapDocument::layerAboutToBeRemoved,
+                this, &BucketFillTool::invalidateFillRegions);
+        connect(newDocument, &MapDocument::tilesetRemoved,
+                this, &BucketFillTool::invalidateFillRegions);
+    }
+
+    invalidateFillRegions();
+
     // Reset things that are probably invalid now
     setStamp(0);
     clearOverlay();
@@ -252,6 +299,35 @@ void BucketFillTool::clearOverlay()
     brushItem()->setTileRegion(QRegion());
 }
 
+void BucketFillTool::invalidateFillRegions()
+{
+    mFillRegions.clear();
+    mFillRegionsLayer = 0;
+}
+
+#ifdef ZOMBOID
+void BucketFillTool::layerRegionChanged(const QRegion &region, Layer *layer)
+{
+    Q_UNUSED(region)
+    // Painting the overlay also reports changes, but to a different layer.
+    if (layer == mFillRegionsLayer)
+        invalidateFillRegions();
+}
+#endif
+
+QRegion BucketFillTool::fillRegionAt(const TilePainter &painter,
+                                     TileLayer *tileLayer,
+                                     const QPoint &tilePos)
+{
+    if (tileLayer != mFillRegionsLayer || mFillRegions.size() != tileLayer->bounds().size()) {
+        painter.computeFillRegions(mFillRegions);
+        mFillRegionsLayer = tileLayer;
+    }
+    const QPoint offset(tileLayer->x(), tileLayer->y());
+    return mFillRegions.region(tilePos.x() - offset.x(),
+                               tilePos.y() - offset.y()).translated(offset);
+}
+
 void BucketFillTool::makeConnections()
 {
     if (!mapDocument())
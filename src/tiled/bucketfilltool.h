@@ -25,12 +25,14 @@
 
 #include "abstracttiletool.h"
 
+#include "connectedregions.h"
 #include "tilelayer.h"
 
 namespace Tiled {
 namespace Internal {
 
 class MapDocument;
+class TilePainter;
 
 /**
  * Implements a tool that bucket fills (flood fills) a region with a repeatable
@@ -77,15 +79,30 @@ protected:
 
 private slots:
     void clearOverlay();
+    void invalidateFillRegions();
+#ifdef ZOMBOID
+    void layerRegionChanged(const QRegion &region, Tiled::Layer *layer);
+#endif
 
 private:
     void makeConnections();
     void clearConnections(MapDocument *mapDocument);
 
+    QRegion fillRegionAt(const TilePainter &painter, TileLayer *tileLayer,
+                         const QPoint &tilePos);
+
     TileLayer *mStamp;
     TileLayer *mFillOverlay;
     QRegion mFillRegion;
 
+    /**
+     * Every fill region of mFillRegionsLayer, so moving the mouse doesn't
+     * flood fill again.  Thrown away whenever that layer, the selection or
+     * the map changes.
+     */
+    ConnectedRegions mFillRegions;
+    TileLayer *mFillRegionsLayer;
+
     bool mLastShiftStatus;
 
     /**
@@ -0,0 +1,242 @@
+/*
+ * connectedregions.cpp
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "connectedregions.h"
+
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+namespace {
+
+// Grids smaller than this are labelled on the calling thread.
+const int MIN_CELLS_FOR_THREADS = 128 * 128;
+
+// Union-find over cell indices.  A root is always the smallest index in its
+// set, so the roots are met first when scanning the grid in order.
+int findRoot(int *parent, int i)
+{
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+void unite(int *parent, int a, int b)
+{
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if (a < b)
+        parent[b] = a;
+    else if (b < a)
+        parent[a] = b;
+}
+
+struct Grid
+{
+    const quint32 *values;
+    const QBitArray *excluded;
+    int *parent;
+    int width;
+    bool sixWay;
+
+    bool joins(int a, int b) const
+    {
+        return values[a] == values[b] &&
+                (excluded->isEmpty() || !excluded->testBit(b));
+    }
+
+    // Joins cell (x, y) to its neighbours above.
+    void joinAbove(int x, int y) const
+    {
+        const int i = y * width + x;
+        if (joins(i, i - width))
+            unite(parent, i, i - width);
+        if (sixWay && x > 0 && joins(i, i - width - 1))
+            unite(parent, i, i - width - 1);
+    }
+};
+
+// Labels rows [top, bottom) without looking outside them, so bands can run
+// at the same time.  The rows either side of a band boundary are joined
+// afterwards.
+class LabelBandTask : public QRunnable
+{
+public:
+    LabelBandTask(const Grid &grid, int top, int bottom) :
+        mGrid(grid),
+        mTop(top),
+        mBottom(bottom)
+    {
+    }
+
+    void run()
+    {
+        const Grid &g = mGrid;
+        for (int y = mTop; y < mBottom; ++y) {
+            for (int x = 0; x < g.width; ++x) {
+                const int i = y * g.width + x;
+                g.parent[i] = i;
+                if (!g.excluded->isEmpty() && g.excluded->testBit(i))
+                    continue;
+                if (x > 0 && g.joins(i, i - 1))
+                    unite(g.parent, i, i - 1);
+                if (y > mTop)
+                    g.joinAbove(x, y);
+            }
+        }
+    }
+
+private:
+    Grid mGrid;
+    int mTop;
+    int mBottom;
+};
+
+} // namespace
+
+ConnectedRegions::ConnectedRegions() :
+    mWidth(0),
+    mHeight(0)
+{
+}
+
+void ConnectedRegions::compute(const QVector<quint32> &values,
+                               int width, int height,
+                               Connectivity connectivity,
+                               const QBitArray &excluded)
+{
+    clear();
+
+    const int count = width * height;
+    Q_ASSERT(values.size() == count);
+    Q_ASSERT(excluded.isEmpty() || excluded.size() == count);
+    if (count <= 0)
+        return;
+
+    QVector<int> parent(count);
+
+    Grid grid;
+    grid.values = values.constData();
+    grid.excluded = &excluded;
+    grid.parent = parent.data();
+    grid.width = width;
+    grid.sixWay = connectivity == SixWay;
+
+    int bandCount = 1;
+    if (count >= MIN_CELLS_FOR_THREADS)
+        bandCount = qBound(1, QThread::idealThreadCount(), qMin(8, height));
+    const int rowsPerBand = (height + bandCount - 1) / bandCount;
+
+    if (bandCount == 1) {
+        LabelBandTask(grid, 0, height).run();
+    } else {
+        QThreadPool pool;
+        for (int top = 0; top < height; top += rowsPerBand)
+            pool.start(new LabelBandTask(grid, top, qMin(top + rowsPerBand, height)));
+        pool.waitForDone();
+
+        for (int top = rowsPerBand; top < height; top += rowsPerBand) {
+            if (excluded.isEmpty()) {
+                for (int x = 0; x < width; ++x)
+                    grid.joinAbove(x, top);
+            } else {
+                for (int x = 0; x < width; ++x) {
+                    if (!excluded.testBit(top * width + x))
+                        grid.joinAbove(x, top);
+                }
+            }
+        }
+    }
+
+    mWidth = width;
+    mHeight = height;
+    mLabels.resize(count);
+
+    QVector<int> labelForRoot(count, -1);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const int i = y * width + x;
+            if (!excluded.isEmpty() && excluded.testBit(i)) {
+                mLabels[i] = -1;
+                continue;
+            }
+            const int root = findRoot(grid.parent, i);
+            int &label = labelForRoot[root];
+            if (label == -1) {
+                label = mBounds.size();
+                mBounds += QRect(x, y, 1, 1);
+            } else {
+                QRect &bounds = mBounds[label];
+                if (x < bounds.left())
+                    bounds.setLeft(x);
+                else if (x > bounds.right())
+                    bounds.setRight(x);
+                bounds.setBottom(y);
+            }
+            mLabels[i] = label;
+        }
+    }
+}
+
+void ConnectedRegions::clear()
+{
+    mWidth = mHeight = 0;
+    mLabels.clear();
+    mBounds.clear();
+    mRegions.clear();
+}
+
+QRegion ConnectedRegions::regionForLabel(int label) const
+{
+    if (label < 0 || label >= mBounds.size())
+        return QRegion();
+
+    QHash<int,QRegion>::const_iterator it = mRegions.constFind(label);
+    if (it != mRegions.constEnd())
+        return it.value();
+
+    // One rectangle per run of cells in each row.  The rows are in order and
+    // each is one cell high, which is the banded form setRects() wants.
+    const QRect &bounds = mBounds[label];
+    QVector<QRect> rects;
+    for (int y = bounds.top(); y <= bounds.bottom(); ++y) {
+        const int *row = mLabels.constData() + y * mWidth;
+        int x = bounds.left();
+        while (x <= bounds.right()) {
+            if (row[x] != label) {
+                ++x;
+                continue;
+            }
+            const int start = x;
+            while (x <= bounds.right() && row[x] == label)
+                ++x;
+            rects += QRect(start, y, x - start, 1);
+        }
+    }
+
+    QRegion region;
+    region.setRects(rects.constData(), rects.size());
+    mRegions.insert(label, region);
+    return region;
+}
@@ -0,0 +1,98 @@
+/*
+ * connectedregions.h
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONNECTEDREGIONS_H
+#define CONNECTEDREGIONS_H
+
+#include <QBitArray>
+#include <QHash>
+#include <QRect>
+#include <QRegion>
+#include <QVector>
+
+namespace Tiled {
+namespace Internal {
+
+/**
+ * Labels every group of connected cells that have the same value, so a
+ * flood fill from any cell becomes a lookup.  The bucket fill tools keep one
+ * of these for the layer or BMP under the mouse and recompute it only when
+ * that changes.
+ */
+class ConnectedRegions
+{
+public:
+    enum Connectivity {
+        FourWay,
+        // Also joins a cell to the cells above-left and below-right of it.
+        // The BMP fill tools use this so visually-vertical columns of
+        // isometric tiles are filled together.
+        SixWay
+    };
+
+    ConnectedRegions();
+
+    /**
+     * Labels the \a width x \a height grid of \a values, stored row by row.
+     * Cells whose bit is set in \a excluded (when not empty) are not part of
+     * any region.  Large grids are labelled in bands on several threads.
+     */
+    void compute(const QVector<quint32> &values, int width, int height,
+                 Connectivity connectivity,
+                 const QBitArray &excluded = QBitArray());
+
+    void clear();
+
+    bool isEmpty() const
+    { return mLabels.isEmpty(); }
+
+    QSize size() const
+    { return QSize(mWidth, mHeight); }
+
+    /**
+     * Returns the label of the region containing (x, y), or -1 if that cell
+     * is outside the grid or excluded.
+     */
+    int label(int x, int y) const
+    {
+        if (x < 0 || y < 0 || x >= mWidth || y >= mHeight)
+            return -1;
+        return mLabels[y * mWidth + x];
+    }
+
+    /**
+     * Returns the cells connected to (x, y), including (x, y) itself.
+     */
+    QRegion region(int x, int y) const
+    { return regionForLabel(label(x, y)); }
+
+    QRegion regionForLabel(int label) const;
+
+private:
+    int mWidth;
+    int mHeight;
+    QVector<int> mLabels;
+    QVector<QRect> mBounds; // indexed by label
+    mutable QHash<int,QRegion> mRegions;
+};
+
+} // namespace Internal
+} // namespace Tiled
+
+#endif // CONNECTEDREGIONS_H
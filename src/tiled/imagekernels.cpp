@@ -0,0 +1,257 @@
+/*
+ * imagekernels.cpp
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "imagekernels.h"
+
+#include "tracing.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGEKERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+// The AVX2 versions are always compiled when SSE2 is, and only called after
+// checking the CPU, so the rest of the program doesn't need -mavx2.
+#if defined(IMAGEKERNELS_SSE2) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define IMAGEKERNELS_AVX2
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#else
+#define AVX2_FUNCTION
+#include <intrin.h>
+#endif
+#endif
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+using namespace Tiled::Internal::ImageKernels;
+
+namespace {
+
+// Each row function starts at pixel x and returns the first pixel it didn't
+// do, which the next simpler version picks up.
+
+int saturateRowScalar(quint32 *pixels, int x, int width)
+{
+    for (; x < width; x++) {
+        if (pixels[x] & 0xFF000000)
+            pixels[x] |= 0xFF000000;
+    }
+    return x;
+}
+
+int toArgb4444RowScalar(const quint32 *src, quint16 *dst, int x, int width)
+{
+    for (; x < width; x++) {
+        quint32 pixel = src[x];
+        dst[x] = (pixel & 0xFF000000) ? quint16(0xF000 | ((pixel >> 12) & 0x0F00) |
+                                                ((pixel >> 8) & 0x00F0) |
+                                                ((pixel >> 4) & 0x000F))
+                                      : quint16(0);
+    }
+    return x;
+}
+
+#ifdef IMAGEKERNELS_SSE2
+int saturateRowSSE2(quint32 *pixels, int x, int width)
+{
+    const __m128i alphaMask = _mm_set1_epi32(0xFF000000);
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 4 <= width; x += 4) {
+        __m128i *p = reinterpret_cast<__m128i*>(pixels + x);
+        __m128i px = _mm_loadu_si128(p);
+        __m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(px, alphaMask), zero);
+        px = _mm_or_si128(px, _mm_andnot_si128(transparent, alphaMask));
+        _mm_storeu_si128(p, px);
+    }
+    return x;
+}
+
+int toArgb4444RowSSE2(const quint32 *src, quint16 *dst, int x, int width)
+{
+    const __m128i alphaMask = _mm_set1_epi32(0xFF000000);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i redMask = _mm_set1_epi32(0x0F00);
+    const __m128i greenMask = _mm_set1_epi32(0x00F0);
+    const __m128i blueMask = _mm_set1_epi32(0x000F);
+    const __m128i opaque = _mm_set1_epi32(0xF000);
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16(short(0x8000));
+    for (; x + 8 <= width; x += 8) {
+        __m128i out[2];
+        for (int i = 0; i < 2; i++) {
+            __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x + i * 4));
+            __m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(px, alphaMask), zero);
+            __m128i v = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(px, 12), redMask),
+                                     _mm_and_si128(_mm_srli_epi32(px, 8), greenMask));
+            v = _mm_or_si128(v, _mm_and_si128(_mm_srli_epi32(px, 4), blueMask));
+            v = _mm_andnot_si128(transparent, _mm_or_si128(v, opaque));
+            // There is no unsigned 32->16 bit pack in SSE2, so shift
+            // into the signed range and back.
+            out[i] = _mm_sub_epi32(v, bias32);
+        }
+        __m128i packed = _mm_add_epi16(_mm_packs_epi32(out[0], out[1]), bias16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), packed);
+    }
+    return x;
+}
+#endif // IMAGEKERNELS_SSE2
+
+#ifdef IMAGEKERNELS_AVX2
+AVX2_FUNCTION int saturateRowAVX2(quint32 *pixels, int x, int width)
+{
+    const __m256i alphaMask = _mm256_set1_epi32(0xFF000000);
+    const __m256i zero = _mm256_setzero_si256();
+    for (; x + 8 <= width; x += 8) {
+        __m256i *p = reinterpret_cast<__m256i*>(pixels + x);
+        __m256i px = _mm256_loadu_si256(p);
+        __m256i transparent = _mm256_cmpeq_epi32(_mm256_and_si256(px, alphaMask), zero);
+        px = _mm256_or_si256(px, _mm256_andnot_si256(transparent, alphaMask));
+        _mm256_storeu_si256(p, px);
+    }
+    return x;
+}
+
+AVX2_FUNCTION int toArgb4444RowAVX2(const quint32 *src, quint16 *dst, int x, int width)
+{
+    const __m256i alphaMask = _mm256_set1_epi32(0xFF000000);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i redMask = _mm256_set1_epi32(0x0F00);
+    const __m256i greenMask = _mm256_set1_epi32(0x00F0);
+    const __m256i blueMask = _mm256_set1_epi32(0x000F);
+    const __m256i opaque = _mm256_set1_epi32(0xF000);
+    for (; x + 16 <= width; x += 16) {
+        __m256i out[2];
+        for (int i = 0; i < 2; i++) {
+            __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x + i * 8));
+            __m256i transparent = _mm256_cmpeq_epi32(_mm256_and_si256(px, alphaMask), zero);
+            __m256i v = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(px, 12), redMask),
+                                        _mm256_and_si256(_mm256_srli_epi32(px, 8), greenMask));
+            v = _mm256_or_si256(v, _mm256_and_si256(_mm256_srli_epi32(px, 4), blueMask));
+            out[i] = _mm256_andnot_si256(transparent, _mm256_or_si256(v, opaque));
+        }
+        // The unsigned pack works within each 128-bit half, so the four
+        // groups of pixels come out as 0 2 1 3 and are swapped back.
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(out[0], out[1]),
+                                                  _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), packed);
+    }
+    return x;
+}
+
+bool cpuHasAVX2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    // The OS must also save the YMM registers on a context switch.
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)))
+        return false;
+    if ((_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif // IMAGEKERNELS_AVX2
+
+} // namespace
+
+InstructionSet ImageKernels::bestInstructionSet()
+{
+#if defined(IMAGEKERNELS_AVX2)
+    static const InstructionSet best = cpuHasAVX2() ? AVX2 : SSE2;
+    return best;
+#elif defined(IMAGEKERNELS_SSE2)
+    return SSE2;
+#else
+    return Scalar;
+#endif
+}
+
+bool ImageKernels::isSupported(InstructionSet set)
+{
+    return set <= bestInstructionSet();
+}
+
+void ImageKernels::saturateAlpha(QImage &image, InstructionSet set)
+{
+    TRACE_ZONE("ImageKernels::saturateAlpha");
+    Q_ASSERT(image.format() == QImage::Format_ARGB32 ||
+             image.format() == QImage::Format_ARGB32_Premultiplied);
+    if (!isSupported(set))
+        set = bestInstructionSet();
+
+    const int width = image.width();
+    for (int y = 0; y < image.height(); y++) {
+        quint32 *pixels = reinterpret_cast<quint32*>(image.scanLine(y));
+        int x = 0;
+#ifdef IMAGEKERNELS_AVX2
+        if (set == AVX2)
+            x = saturateRowAVX2(pixels, x, width);
+#endif
+#ifdef IMAGEKERNELS_SSE2
+        if (set >= SSE2)
+            x = saturateRowSSE2(pixels, x, width);
+#endif
+        saturateRowScalar(pixels, x, width);
+    }
+}
+
+QImage ImageKernels::saturateAlphaToArgb4444(const QImage &image, InstructionSet set)
+{
+    TRACE_ZONE("ImageKernels::saturateAlphaToArgb4444");
+    if (image.isNull() || image.format() == QImage::Format_ARGB4444_Premultiplied)
+        return image;
+    if (!isSupported(set))
+        set = bestInstructionSet();
+
+    // Images read from disk may be in any format.  RGB32 has its alpha set to
+    // 255 already, so it can be read like ARGB32.
+    QImage source = image;
+    if (source.format() != QImage::Format_ARGB32 &&
+            source.format() != QImage::Format_ARGB32_Premultiplied &&
+            source.format() != QImage::Format_RGB32)
+        source = source.convertToFormat(QImage::Format_ARGB32);
+
+    QImage result(source.size(), QImage::Format_ARGB4444_Premultiplied);
+    const int width = source.width();
+    for (int y = 0; y < source.height(); y++) {
+        const quint32 *src = reinterpret_cast<const quint32*>(source.constScanLine(y));
+        quint16 *dst = reinterpret_cast<quint16*>(result.scanLine(y));
+        int x = 0;
+#ifdef IMAGEKERNELS_AVX2
+        if (set == AVX2)
+            x = toArgb4444RowAVX2(src, dst, x, width);
+#endif
+#ifdef IMAGEKERNELS_SSE2
+        if (set >= SSE2)
+            x = toArgb4444RowSSE2(src, dst, x, width);
+#endif
+        toArgb4444RowScalar(src, dst, x, width);
+    }
+    return result;
+}
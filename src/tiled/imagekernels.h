@@ -0,0 +1,74 @@
+/*
+ * imagekernels.h
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMAGEKERNELS_H
+#define IMAGEKERNELS_H
+
+#include <QImage>
+
+namespace Tiled {
+namespace Internal {
+
+/**
+ * Per-pixel passes over the map thumbnails and the minimap.
+ *
+ * Those images are painted with antialiased tile edges and then made opaque
+ * wherever anything was drawn.  WorldEd also keeps thousands of them in memory
+ * at 16 bits per pixel, so there the alpha fix-up, premultiplying and the
+ * conversion are done together in a single pass over each scanline.
+ *
+ * Each pass has an SSE2, an AVX2 and a plain C++ version.  AVX2 is only used
+ * when the CPU supports it, which is checked once at runtime.
+ */
+namespace ImageKernels {
+
+enum InstructionSet {
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+/**
+ * Returns the fastest instruction set this build and CPU both support.
+ */
+InstructionSet bestInstructionSet();
+
+bool isSupported(InstructionSet set);
+
+/**
+ * Makes every pixel that isn't fully transparent fully opaque, keeping its
+ * color.  \a image must be Format_ARGB32 or Format_ARGB32_Premultiplied.
+ */
+void saturateAlpha(QImage &image, InstructionSet set = bestInstructionSet());
+
+/**
+ * Like saturateAlpha(), but returns the result as
+ * Format_ARGB4444_Premultiplied and leaves \a image alone.  With every pixel
+ * either opaque or transparent, premultiplying only has to clear the
+ * transparent ones.  Images already in that format are returned as they are.
+ */
+QImage saturateAlphaToArgb4444(const QImage &image,
+                               InstructionSet set = bestInstructionSet());
+
+} // namespace ImageKernels
+
+} // namespace Internal
+} // namespace Tiled
+
+#endif // IMAGEKERNELS_H
@@ -0,0 +1,415 @@
+/*
+ * lotbenchmarks.cpp
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lotbenchmarks.h"
+
+#include "bmpblender.h"
+#include "mapcomposite.h"
+#include "mapmanager.h"
+#include "newmapbinaryfile.h"
+
+#include "map.h"
+#include "mapobject.h"
+#include "objectgroup.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonObject>
+#include <QScopedPointer>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QVector>
+
+#include <algorithm>
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+namespace {
+
+// The same generator as tests/benchmarks, so runs are repeatable.
+class Random
+{
+public:
+    explicit Random(quint32 seed) : mState(seed) {}
+
+    int bounded(int n)
+    {
+        mState = mState * 1664525u + 1013904223u;
+        return int((mState >> 8) % quint32(n));
+    }
+
+private:
+    quint32 mState;
+};
+
+const QRgb GRASS = qRgb(90, 100, 35);
+const QRgb DIRT = qRgb(120, 70, 20);
+const QRgb WATER = qRgb(0, 138, 255);
+const QRgb TREES = qRgb(255, 0, 0);
+const QRgb BUSHES = qRgb(127, 0, 0);
+
+// Tiles per tileset image, 8 columns and 8 rows.
+const int TILESET_TILES = 8;
+
+QString tileName(const char *tileset, int index)
+{
+    return QString(QLatin1String("%1_%2")).arg(QLatin1String(tileset)).arg(index);
+}
+
+QStringList tileNames(const char *tileset, int first, int count)
+{
+    QStringList names;
+    for (int i = 0; i < count; i++)
+        names += tileName(tileset, first + i);
+    return names;
+}
+
+} // namespace
+
+LotBenchmarks::LotBenchmarks() :
+    mSize(300),
+    mIterations(5)
+{
+}
+
+LotBenchmarks::~LotBenchmarks()
+{
+    qDeleteAll(mMapInfos);
+    qDeleteAll(mMaps);
+    qDeleteAll(mTilesets);
+}
+
+bool LotBenchmarks::run()
+{
+    // generateHouse() picks tilesets by their index here.
+    createTileset(QLatin1String("blends_natural_01"));
+    createTileset(QLatin1String("vegetation_trees_01"));
+    createTileset(QLatin1String("floors_interior_01"));
+    createTileset(QLatin1String("walls_exterior_01"));
+    createTileset(QLatin1String("furniture_01"));
+    createTileset(QLatin1String("vegetation_foliage_01"));
+
+    benchmarkBmpBlender();
+    benchmarkLotExport();
+    return mFailures.isEmpty();
+}
+
+QJsonDocument LotBenchmarks::report() const
+{
+    QJsonObject parameters;
+    parameters[QLatin1String("size")] = mSize;
+    parameters[QLatin1String("iterations")] = mIterations;
+
+    QJsonObject root;
+    root[QLatin1String("qt")] = QLatin1String(qVersion());
+    root[QLatin1String("parameters")] = parameters;
+    root[QLatin1String("results")] = mResults;
+    return QJsonDocument(root);
+}
+
+// Runs body once to warm up, then times it mIterations times.
+void LotBenchmarks::time(const QString &name, const std::function<void()> &body)
+{
+    body();
+
+    QVector<qint64> samples;
+    QElapsedTimer timer;
+    for (int i = 0; i < mIterations; ++i) {
+        timer.start();
+        body();
+        samples += timer.nsecsElapsed();
+    }
+    std::sort(samples.begin(), samples.end());
+
+    qint64 total = 0;
+    for (qint64 ns : qAsConst(samples))
+        total += ns;
+
+    QJsonObject result;
+    result[QLatin1String("name")] = name;
+    result[QLatin1String("iterations")] = samples.size();
+    result[QLatin1String("min_ms")] = samples.first() / 1e6;
+    result[QLatin1String("median_ms")] = samples[samples.size() / 2] / 1e6;
+    result[QLatin1String("mean_ms")] = total / 1e6 / samples.size();
+    mResults.append(result);
+
+    QTextStream(stderr) << name << ": median "
+                        << QString::number(samples[samples.size() / 2] / 1e6, 'f', 3)
+                        << " ms\n";
+}
+
+void LotBenchmarks::fail(const QString &message)
+{
+    QTextStream(stderr) << "FAIL: " << message << "\n";
+    mFailures += message;
+}
+
+Tileset *LotBenchmarks::createTileset(const QString &name)
+{
+    Tileset *tileset = new Tileset(name, 64, 128);
+    tileset->loadFromNothing(QSize(64 * TILESET_TILES, 128 * TILESET_TILES),
+                             name + QLatin1String(".png"));
+    mTilesets += tileset;
+    return tileset;
+}
+
+Map *LotBenchmarks::createMap(int width, int height)
+{
+    Map *map = new Map(Map::LevelIsometric, width, height, 64, 32);
+    for (Tileset *tileset : qAsConst(mTilesets))
+        map->addTileset(tileset);
+    mMaps += map;
+    return map;
+}
+
+// A cell whose BMP is covered with patches of grass, dirt and water, and
+// trees and bushes on much of the grass, so nearly every square gets a floor
+// tile and many get blends and vegetation.
+Map *LotBenchmarks::generateBmpMap()
+{
+    Map *map = createMap(mSize, mSize);
+
+    QList<BmpRule*> rules;
+    rules += new BmpRule(QLatin1String("grass"), 0, GRASS,
+                         tileNames("blends_natural_01", 16, 4),
+                         QLatin1String("0_Floor"), qRgb(0, 0, 0));
+    rules += new BmpRule(QLatin1String("dirt"), 0, DIRT,
+                         tileNames("blends_natural_01", 32, 4),
+                         QLatin1String("0_Floor"), qRgb(0, 0, 0));
+    rules += new BmpRule(QLatin1String("water"), 0, WATER,
+                         tileNames("blends_natural_01", 48, 1),
+                         QLatin1String("0_Floor"), qRgb(0, 0, 0));
+    rules += new BmpRule(QLatin1String("trees"), 1, TREES,
+                         tileNames("vegetation_trees_01", 0, 8),
+                         QLatin1String("0_Vegetation"), GRASS);
+    rules += new BmpRule(QLatin1String("bushes"), 1, BUSHES,
+                         tileNames("vegetation_foliage_01", 0, 8),
+                         QLatin1String("0_Vegetation"), GRASS);
+    map->rbmpSettings()->setRules(rules);
+
+    // Dirt edges blended over the grass, and grass edges over the water.
+    const BmpBlend::Direction dirs[] = {
+        BmpBlend::N, BmpBlend::S, BmpBlend::E, BmpBlend::W,
+        BmpBlend::NW, BmpBlend::NE, BmpBlend::SW, BmpBlend::SE
+    };
+    QList<BmpBlend*> blends;
+    for (int i = 0; i < 8; i++) {
+        blends += new BmpBlend(QLatin1String("0_FloorOverlay"),
+                               tileName("blends_natural_01", 16),
+                               tileName("blends_natural_01", 40 + i),
+                               dirs[i], QStringList(), QStringList());
+        blends += new BmpBlend(QLatin1String("0_FloorOverlay2"),
+                               tileName("blends_natural_01", 48),
+                               tileName("blends_natural_01", 56 + i),
+                               dirs[i], QStringList(), QStringList());
+    }
+    map->rbmpSettings()->setBlends(blends);
+
+    Random random(0x424D50);
+    const QRgb grounds[] = { GRASS, GRASS, GRASS, DIRT, WATER };
+    const int PATCH = 6;
+    for (int py = 0; py < mSize; py += PATCH) {
+        for (int px = 0; px < mSize; px += PATCH) {
+            QRgb ground = grounds[random.bounded(5)];
+            for (int y = py; y < qMin(py + PATCH, mSize); y++) {
+                for (int x = px; x < qMin(px + PATCH, mSize); x++) {
+                    map->rbmpMain().setPixel(x, y, ground);
+                    if (ground == GRASS && random.bounded(3) == 0)
+                        map->rbmpVeg().setPixel(x, y, random.bounded(4) ? BUSHES : TREES);
+                }
+            }
+        }
+    }
+
+    return map;
+}
+
+// A small house with two rooms on the ground floor and one above, as a
+// building exported to a TMX and placed as a lot would have.
+Map *LotBenchmarks::generateHouse(int variant)
+{
+    const int width = 8 + 2 * (variant % 3);
+    const int height = 8 + 2 * (variant / 3);
+    Map *map = createMap(width, height);
+
+    const char *layerNames[] = { "0_Floor", "0_Walls", "0_Furniture", "1_Floor", "1_Walls" };
+    QList<TileLayer*> layers;
+    for (const char *name : layerNames) {
+        TileLayer *tl = new TileLayer(QLatin1String(name), 0, 0, width, height);
+        map->addLayer(tl);
+        layers += tl;
+    }
+
+    Tileset *floors = mTilesets[2];
+    Tileset *walls = mTilesets[3];
+    Tileset *furniture = mTilesets[4];
+    Random random(quint32(variant + 1));
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            bool kitchen = x < width / 2;
+            layers[0]->setCell(x, y, Cell(floors->tileAt(kitchen ? variant % TILESET_TILES : 8 + variant % TILESET_TILES)));
+            layers[3]->setCell(x, y, Cell(floors->tileAt(16 + variant % TILESET_TILES)));
+            if (x == 0 || y == 0 || x == width / 2) {
+                Tile *wall = walls->tileAt((x == 0 || x == width / 2) ? 0 : 1);
+                layers[1]->setCell(x, y, Cell(wall));
+                layers[4]->setCell(x, y, Cell(wall));
+            } else if (random.bounded(5) == 0) {
+                layers[2]->setCell(x, y, Cell(furniture->tileAt(random.bounded(furniture->tileCount()))));
+            }
+        }
+    }
+
+    ObjectGroup *roomDefs0 = new ObjectGroup(QLatin1String("0_RoomDefs"), 0, 0, width, height);
+    map->addLayer(roomDefs0);
+    roomDefs0->addObject(new MapObject(QLatin1String("kitchen"), QString(),
+                                       QPointF(0, 0), QSizeF(width / 2, height)));
+    roomDefs0->addObject(new MapObject(QLatin1String("livingroom"), QString(),
+                                       QPointF(width / 2, 0), QSizeF(width - width / 2, height)));
+
+    ObjectGroup *roomDefs1 = new ObjectGroup(QLatin1String("1_RoomDefs"), 0, 0, width, height);
+    map->addLayer(roomDefs1);
+    roomDefs1->addObject(new MapObject(QLatin1String("bedroom"), QString(),
+                                       QPointF(0, 0), QSizeF(width, height)));
+
+    return map;
+}
+
+// A cell with a dense BMP and a grid of houses placed as lots, with a shed
+// drawn straight onto the cell.
+Map *LotBenchmarks::generateTown()
+{
+    Map *map = generateBmpMap();
+
+    ObjectGroup *roomDefs = new ObjectGroup(QLatin1String("0_RoomDefs"), 0, 0, mSize, mSize);
+    map->addLayer(roomDefs);
+    roomDefs->addObject(new MapObject(QLatin1String("shed"), QString(),
+                                      QPointF(17, 2), QSizeF(4, 4)));
+    return map;
+}
+
+MapInfo *LotBenchmarks::addMapInfo(Map *map, bool beingEdited)
+{
+    MapInfo *mapInfo = MapManager::instance()->newFromMap(map);
+    mapInfo->setBeingEdited(beingEdited);
+    // The MapInfo owns nothing, the maps are deleted by the destructor.
+    mMapInfos += mapInfo;
+    return mapInfo;
+}
+
+void LotBenchmarks::benchmarkBmpBlender()
+{
+    Map *map = generateBmpMap();
+    BmpBlender blender(map);
+    const QRect bounds(QPoint(), map->size());
+
+    time(QLatin1String("bmpblender/recreate"), [&] {
+        blender.recreate();
+        blender.flush(bounds);
+    });
+
+    int tiles = 0;
+    for (TileLayer *tl : blender.tileLayers()) {
+        for (int y = 0; y < tl->height(); y++)
+            for (int x = 0; x < tl->width(); x++)
+                if (!tl->cellAt(x, y).isEmpty())
+                    ++tiles;
+    }
+    if (tiles < mSize * mSize)
+        fail(QString(QLatin1String("bmpblender/recreate: only %1 tiles for a %2x%2 BMP"))
+             .arg(tiles).arg(mSize));
+}
+
+void LotBenchmarks::benchmarkLotExport()
+{
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        fail(QLatin1String("lotexport: can't create a temporary directory"));
+        return;
+    }
+
+    QList<MapInfo*> houses;
+    for (int variant = 0; variant < 6; variant++)
+        houses += addMapInfo(generateHouse(variant), false);
+
+    QScopedPointer<MapComposite> town(new MapComposite(addMapInfo(generateTown(), true)));
+    Random random(0x4C4F54);
+    for (int y = 8; y + 14 <= mSize; y += 20) {
+        for (int x = 22; x + 14 <= mSize; x += 20)
+            town->addMap(houses[random.bounded(houses.size())], QPoint(x, y), 0);
+    }
+
+    const QString fileName = dir.filePath(QLatin1String("0_0.lotpack"));
+
+    time(QLatin1String("lotexport/write"), [&] {
+        NewMapBinaryFile file;
+        if (!file.write(town.data(), fileName))
+            fail(QLatin1String("lotexport/write: ") + file.errorString());
+    });
+
+    // The shed drawn on the cell.  Renaming it changes the size of the
+    // header, and widening it changes one chunk.
+    MapObject *shed = town->map()->objectGroups().last()->objects().first();
+    bool garage = false;
+    auto changeRoom = [&] {
+        garage = !garage;
+        shed->setName(QLatin1String(garage ? "garage" : "shed"));
+        shed->setWidth(garage ? 5 : 4);
+    };
+
+    int reusedChunks = 0;
+    auto writeIncremental = [&](const QString &name) {
+        NewMapBinaryFile file;
+        file.setIncremental(true);
+        if (!file.write(town.data(), fileName))
+            fail(name + QLatin1String(": ") + file.errorString());
+        reusedChunks = file.reusedChunkCount();
+    };
+
+    // An incremental write must give the same bytes as a full one.
+    auto checkIncremental = [&](const QString &name) {
+        const QString fullFileName = dir.filePath(QLatin1String("full.lotpack"));
+        NewMapBinaryFile full;
+        if (!full.write(town.data(), fullFileName)) {
+            fail(name + QLatin1String(": ") + full.errorString());
+            return;
+        }
+        QFile file(fileName), fullFile(fullFileName);
+        if (!file.open(QIODevice::ReadOnly) || !fullFile.open(QIODevice::ReadOnly) ||
+                file.readAll() != fullFile.readAll())
+            fail(name + QLatin1String(": the file differs from a full write"));
+        if (reusedChunks == 0)
+            fail(name + QLatin1String(": no chunks were reused"));
+    };
+
+    const QString unchanged = QLatin1String("lotexport/write incremental unchanged");
+    time(unchanged, [&] {
+        writeIncremental(unchanged);
+    });
+    checkIncremental(unchanged);
+
+    const QString roomChanged = QLatin1String("lotexport/write incremental room changed");
+    time(roomChanged, [&] {
+        changeRoom();
+        writeIncremental(roomChanged);
+    });
+    checkIncremental(roomChanged);
+}
@@ -0,0 +1,100 @@
+/*
+ * lotbenchmarks.h
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOTBENCHMARKS_H
+#define LOTBENCHMARKS_H
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QList>
+#include <QStringList>
+
+#include <functional>
+
+class MapInfo;
+
+namespace Tiled {
+
+class Map;
+class Tileset;
+
+namespace Internal {
+
+/**
+ * Times BMP blending and lot export on generated maps, without any user
+ * interface.  These need the tileset, map and tile properties managers, so
+ * unlike tests/benchmarks they are run by TileZed itself, with
+ * "TileZed --benchmark [results.json]".
+ *
+ * The maps are a cell with a dense BMP, and a cell with a town of houses
+ * placed as lots, each house with a few levels of RoomDefs.  Incremental lot
+ * export is timed with nothing changed and with one room changed, and checked
+ * against a full export.  The results are written in the same JSON format as
+ * tests/benchmarks.
+ */
+class LotBenchmarks
+{
+public:
+    LotBenchmarks();
+    ~LotBenchmarks();
+
+    void setSize(int size)
+    { mSize = size; }
+
+    void setIterations(int iterations)
+    { mIterations = iterations; }
+
+    /**
+     * Runs every benchmark.  Returns false if any of them produced wrong
+     * results, see failures().
+     */
+    bool run();
+
+    const QStringList &failures() const
+    { return mFailures; }
+
+    QJsonDocument report() const;
+
+private:
+    void time(const QString &name, const std::function<void()> &body);
+    void fail(const QString &message);
+
+    Tileset *createTileset(const QString &name);
+    Map *createMap(int width, int height);
+    Map *generateBmpMap();
+    Map *generateHouse(int variant);
+    Map *generateTown();
+    MapInfo *addMapInfo(Map *map, bool beingEdited);
+
+    void benchmarkBmpBlender();
+    void benchmarkLotExport();
+
+    int mSize;
+    int mIterations;
+    QList<Tileset*> mTilesets;
+    QList<Map*> mMaps;
+    QList<MapInfo*> mMapInfos;
+    QJsonArray mResults;
+    QStringList mFailures;
+};
+
+} // namespace Internal
+} // namespace Tiled
+
+#endif // LOTBENCHMARKS_H
@@ -32,6 +32,7 @@
 #include "maprenderer.h"
 #include "tilelayer.h"
 #include "tileset.h"
+#include "tracing.h"
 
 #include <qmath.h>
 #include <QApplication>
@@ -112,6 +113,7 @@ LuaTileTool::~LuaTileTool()
 
 void LuaTileTool::loadScript()
 {
+    TRACE_ZONE("LuaTileTool::loadScript");
     MapScene *scene = mScene;
     if (mScene) deactivate(scene);
 
@@ -153,6 +155,7 @@ void LuaTileTool::loadScript()
 
 void LuaTileTool::activate(MapScene *scene)
 {
+    TRACE_ZONE("LuaTileTool::activate");
     AbstractTileTool::activate(scene);
     mScene = scene;
 
@@ -215,6 +218,7 @@ void LuaTileTool::activate(MapScene *scene)
 
 void LuaTileTool::deactivate(MapScene *scene)
 {
+    TRACE_ZONE("LuaTileTool::deactivate");
     LuaToolDialog::instancePtr()->disconnect(this);
     LuaToolDialog::instancePtr()->setToolOptions(0);
 //    LuaToolDialog::instancePtr()->setWindowTitle(tr("Lua Tool"));
@@ -305,6 +309,7 @@ void LuaTileTool::mouseReleased(QGraphicsSceneMouseEvent *event)
 
 void LuaTileTool::modifiersChanged(Qt::KeyboardModifiers modifiers)
 {
+    TRACE_ZONE("LuaTileTool::modifiersChanged");
     if (!L) return;
 
     checkMap();
@@ -372,6 +377,7 @@ void LuaTileTool::tilePositionChanged(const QPoint &tilePos)
 
 void LuaTileTool::setOption(LuaToolOption *option, const QVariant &value)
 {
+    TRACE_ZONE("LuaTileTool::setOption");
     if (!L) return;
 
     if (mSaveOptionValue) {
@@ -431,6 +437,7 @@ LuaTileLayer *LuaTileTool::currentLayer() const
 void LuaTileTool::mouseEvent(const char *func, Qt::MouseButtons buttons,
                              const QPointF &scenePos, Qt::KeyboardModifiers modifiers)
 {
+    TRACE_ZONE("LuaTileTool::mouseEvent");
     if (!L) return;
 
     checkMap();
@@ -583,6 +590,7 @@ static bool getStringsFromTable(lua_State *L, QStringList &strings)
 
 void LuaTileTool::setToolOptions()
 {
+    TRACE_ZONE("LuaTileTool::setToolOptions");
     LuaToolDialog::instancePtr()->setToolOptions(0);
     mOptions.clear();
 
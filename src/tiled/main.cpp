@@ -26,9 +26,15 @@
 #include "preferences.h"
 #include "tiledapplication.h"
 #ifdef ZOMBOID
+#include "bmptotmxconverter.h"
+#include "lotbenchmarks.h"
+#include "worlded/world.h"
 #include "worlded/worldedmgr.h"
+#include "worlded/worldreader.h"
 #include "zprogress.h"
+#include <QFile>
 #include <QFileInfo>
+#include <QScopedPointer>
 #endif
 
 #include <QDebug>
@@ -59,11 +65,19 @@ public:
     bool quit;
     bool showedVersion;
     bool disableOpenGL;
+#ifdef ZOMBOID
+    bool bmpToTmx;
+    bool benchmark;
+#endif
 
 private:
     void showVersion();
     void justQuit();
     void setDisableOpenGL();
+#ifdef ZOMBOID
+    void setBmpToTmx();
+    void setBenchmark();
+#endif
 
     // Convenience wrapper around registerOption
     template <void (CommandLineHandler::*memberFunction)()>
@@ -85,6 +99,10 @@ CommandLineHandler::CommandLineHandler()
     : quit(false)
     , showedVersion(false)
     , disableOpenGL(false)
+#ifdef ZOMBOID
+    , bmpToTmx(false)
+    , benchmark(false)
+#endif
 {
     option<&CommandLineHandler::showVersion>(
                 QLatin1Char('v'),
@@ -101,6 +119,21 @@ CommandLineHandler::CommandLineHandler()
                 QChar(),
                 QLatin1String("--disable-opengl"),
                 QLatin1String("Disable hardware accelerated rendering"));
+
+#ifdef ZOMBOID
+    option<&CommandLineHandler::setBmpToTmx>(
+                QChar(),
+                QLatin1String("--bmp-to-tmx"),
+                QLatin1String("Convert the BMP images of the given WorldEd "
+                              "projects to TMX files and quit"));
+
+    option<&CommandLineHandler::setBenchmark>(
+                QChar(),
+                QLatin1String("--benchmark"),
+                QLatin1String("Time BMP blending and lot export on generated "
+                              "maps, write the results as JSON to the given "
+                              "file, and quit"));
+#endif
 }
 
 void CommandLineHandler::showVersion()
@@ -123,6 +156,59 @@ void CommandLineHandler::setDisableOpenGL()
     disableOpenGL = true;
 }
 
+#ifdef ZOMBOID
+void CommandLineHandler::setBmpToTmx()
+{
+    bmpToTmx = true;
+}
+
+void CommandLineHandler::setBenchmark()
+{
+    benchmark = true;
+}
+
+static int convertBmpToTmx(const QStringList &fileNames)
+{
+    int result = 0;
+    foreach (const QString &fileName, fileNames) {
+        WorldReader reader;
+        QScopedPointer<World> world(reader.readWorld(fileName));
+        if (!world) {
+            qWarning() << qPrintable(fileName) << qPrintable(reader.errorString());
+            result = 1;
+            continue;
+        }
+        BmpToTmxConverter converter;
+        bool ok = converter.convert(world.data());
+        foreach (const QString &warning, converter.warnings())
+            qWarning() << qPrintable(warning);
+        if (!ok) {
+            qWarning() << qPrintable(fileName) << qPrintable(converter.errorString());
+            result = 1;
+            continue;
+        }
+        qWarning() << qPrintable(fileName) << converter.convertedCount()
+                   << "cells written," << converter.skippedCount() << "unchanged";
+    }
+    return result;
+}
+
+static int runBenchmarks(const QStringList &fileNames)
+{
+    LotBenchmarks benchmarks;
+    bool ok = benchmarks.run();
+    if (!fileNames.isEmpty()) {
+        QFile file(fileNames.first());
+        if (!file.open(QIODevice::WriteOnly)) {
+            qWarning() << qPrintable(fileNames.first()) << qPrintable(file.errorString());
+            return 1;
+        }
+        file.write(benchmarks.report().toJson());
+    }
+    return ok ? 0 : 1;
+}
+#endif
+
 #if !defined(QT_NO_DEBUG) && defined(ZOMBOID) && defined(_MSC_VER)
 static void __cdecl invalid_parameter_handler(
    const wchar_t * expression,
@@ -180,6 +266,12 @@ int main(int argc, char *argv[])
         return 0;
     if (commandLine.disableOpenGL)
         Preferences::instance()->setUseOpenGL(false);
+#ifdef ZOMBOID
+    if (commandLine.bmpToTmx)
+        return convertBmpToTmx(commandLine.filesToOpen());
+    if (commandLine.benchmark)
+        return runBenchmarks(commandLine.filesToOpen());
+#endif
 
 #ifdef ZOMBOID
     if (a.isRunning()) {
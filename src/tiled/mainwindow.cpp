@@ -72,6 +72,9 @@
 #include "tmxmapreader.h"
 #include "tmxmapwriter.h"
 #include "undodock.h"
+#ifdef ZOMBOID_TRACING
+#include "tracingdock.h"
+#endif
 #include "utils.h"
 #include "zoomable.h"
 #include "commandbutton.h"
@@ -94,6 +97,7 @@
 #include "luatooldialog.h"
 #include "mapcomposite.h"
 #include "mapimagemanager.h"
+#include "mipmapcache.h"
 #include "mapmanager.h"
 #include "mapsdock.h"
 #include "packcompare.h"
@@ -276,6 +280,10 @@ MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags flags)
     tabifyDockWidget(mObjectsDock, mWorldEdDock);
     tabifyDockWidget(mWorldEdDock, mMapsDock);
     tabifyDockWidget(undoDock, mTilesetDock);
+#ifdef ZOMBOID_TRACING
+    TracingDock *tracingDock = new TracingDock(this);
+    addDockWidget(Qt::BottomDockWidgetArea, tracingDock);
+#endif
 
     setStatusBar(nullptr);
 
@@ -416,6 +424,13 @@ MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags flags)
             preferences, &Preferences::setShowMiniMap);
     connect(mUi->actionShowTileLayersPanel, &QAction::toggled,
             preferences, &Preferences::setShowTileLayersPanel);
+
+    // The cache's limit is an int number of bytes.
+    auto setMipmapCacheSize = [](int megabytes) {
+        MipmapCache::instance()->setMaxBytes(qBound(1, megabytes, 2047) * 1024 * 1024);
+    };
+    setMipmapCacheSize(preferences->mipmapCacheSize());
+    connect(preferences, &Preferences::mipmapCacheSizeChanged, this, setMipmapCacheSize);
 #endif
     connect(mUi->actionZoomIn, &QAction::triggered, this, &MainWindow::zoomIn);
     connect(mUi->actionZoomOut, &QAction::triggered, this, &MainWindow::zoomOut);
@@ -614,6 +629,9 @@ MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags flags)
     mUi->menuView->addAction(mLevelsDock->toggleViewAction());
     mUi->menuView->addAction(mWorldEdDock->toggleViewAction());
     mUi->menuView->addAction(mMapsDock->toggleViewAction());
+#ifdef ZOMBOID_TRACING
+    mUi->menuView->addAction(tracingDock->toggleViewAction());
+#endif
 #endif
 
     connect(mClipboardManager, &ClipboardManager::hasMapChanged, this, &MainWindow::updateActions);
@@ -709,6 +727,7 @@ MainWindow::~MainWindow()
     BuildingPreferences::deleteInstance();
 #endif
     MapImageManager::deleteInstance();
+    MipmapCache::instance()->clear();
     MapManager::deleteInstance();
     TileMetaInfoMgr::deleteInstance();
     TileDefDialog::deleteInstance();
@@ -1309,6 +1328,7 @@ void MainWindow::exportNewBinary()
     if (fileName.isEmpty())
         return;
     NewMapBinaryFile file;
+    file.setIncremental(true);
     MapComposite* mapComposite = mMapDocument->mapComposite();
     file.write(mapComposite, fileName);
 }
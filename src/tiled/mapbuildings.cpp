@@ -32,12 +32,14 @@
 using namespace Tiled;
 
 MapBuildings::MapBuildings()
+    : mValid(false)
 {
 }
 
 MapBuildings::~MapBuildings()
 {
-    qDeleteAll(mRoomRectsByLevel);
+    for (const QList<MapBuildingsNS::RoomRect*> &rects : mRoomRectsByMap)
+        qDeleteAll(rects);
     qDeleteAll(mBuildings);
     qDeleteAll(mRooms);
 }
@@ -45,213 +47,143 @@ MapBuildings::~MapBuildings()
 #include <QDebug>
 #include <QElapsedTimer>
 
-void MapBuildings::calculate(MapComposite *mc)
+namespace {
+    bool isAdjacentMap(MapComposite* mc)
+    {
+        if (mc == nullptr)
+            return false;
+        if (mc->isAdjacentMap())
+            return true;
+        return isAdjacentMap(mc->parent());
+    };
+}
+
+void MapBuildings::calculate(MapComposite *mapComposite)
 {
     QElapsedTimer elapsed;
 
     elapsed.start();
-    extractRoomRects(mc);
-    qDebug() << "MapBuildings: extractRoomRects took" << elapsed.elapsed() << "ms";
-
-    qDeleteAll(mRooms);
-    mRooms.clear();
 
-    elapsed.restart();
+    if (!mValid) {
+        for (const QList<MapBuildingsNS::RoomRect*> &rects : mRoomRectsByMap)
+            qDeleteAll(rects);
+        mRoomRectsByMap.clear();
+    }
 
-    // Merge adjacent RoomRects on the same level into rooms.
-    // Only RoomRects with matching names and with # in the name are merged.
-    QList<MapBuildingsNS::RoomRect*> overlapping;
-    for (MapBuildingsNS::RoomRectsForLevel* rr4L : mRoomRectsByLevel) {
-        const QList<MapBuildingsNS::RoomRect*>& rrList = rr4L->mRects;
-        for (MapBuildingsNS::RoomRect *rr : rrList) {
-            if (rr->room == nullptr) {
-                rr->room = new MapBuildingsNS::Room(rr->nameWithoutSuffix(),
-                                                    rr->floor);
-                rr->room->rects += rr;
-                mRooms += rr->room;
-            }
-            if (!rr->name.contains(QLatin1Char('#')))
-                continue;
-            overlapping.clear();
-            rr4L->overlapping(rr->bounds().adjusted(-1, -1, 1, 1), overlapping);
-            for (MapBuildingsNS::RoomRect *comp : overlapping) {
-                if (comp == rr)
-                    continue;
-                if (comp->room == rr->room)
-                    continue;
-                if (rr->inSameRoom(comp)) {
-                    if (comp->room != nullptr) {
-                        MapBuildingsNS::Room *room = comp->room;
-                        for (MapBuildingsNS::RoomRect *rr2 : room->rects) {
-                            Q_ASSERT(rr2->room == room);
-                            Q_ASSERT(!rr->room->rects.contains(rr2));
-                            rr2->room = rr->room;
-                        }
-                        rr->room->rects += room->rects;
-                        mRooms.removeOne(room);
-                        delete room;
-                    } else {
-                        comp->room = rr->room;
-                        rr->room->rects += comp;
-                        Q_ASSERT(rr->room->rects.count(comp) == 1);
-                    }
-                }
-            }
+    // Read the RoomDefs of maps that changed or weren't shown before.  Maps
+    // that are no longer shown are dropped.
+    QMap<MapComposite*,QList<MapBuildingsNS::RoomRect*> > rectsByMap;
+    QList<MapComposite*> maps;
+    for (MapComposite *mc : mapComposite->maps()) {
+        if (isAdjacentMap(mc))
+            continue;
+        if (!mc->isGroupVisible() || !mc->isVisible())
+            continue;
+        const bool cached = mRoomRectsByMap.contains(mc) && !mInvalidMaps.contains(mc);
+        QList<MapBuildingsNS::RoomRect*> rects = mRoomRectsByMap.take(mc);
+        if (!cached) {
+            qDeleteAll(rects);
+            rects.clear();
+            extractRoomRects(mc, rects);
         }
+        rectsByMap[mc] = rects;
+        maps += mc;
     }
+    for (const QList<MapBuildingsNS::RoomRect*> &rects : mRoomRectsByMap)
+        qDeleteAll(rects);
+    mRoomRectsByMap = rectsByMap;
+    mInvalidMaps.clear();
+    mValid = true;
 
-    qDebug() << "MapBuildings: merge took" << elapsed.elapsed() << "ms";
+    qDebug() << "MapBuildings: extractRoomRects took" << elapsed.elapsed() << "ms";
     elapsed.restart();
 
-    mRoomLookup.clear();
-    for (MapBuildingsNS::Room* r : mRooms) {
-        mRoomLookup.addRoom(r);
+    mGraph.clear();
+    mRoomRects.clear();
+    for (MapComposite *mc : maps) {
+        for (MapBuildingsNS::RoomRect *rr : mRoomRectsByMap[mc]) {
+            mGraph.addRect(rr->bounds(), rr->floor, rr->name);
+            mRoomRects += rr;
+        }
     }
+    mGraph.build();
 
-    qDebug() << "MapBuildings: mRoomLookup.addRoom() took" << elapsed.elapsed() << "ms";
+    qDebug() << "MapBuildings: merge took" << elapsed.elapsed() << "ms";
     elapsed.restart();
 
+    qDeleteAll(mRooms);
+    mRooms.clear();
     qDeleteAll(mBuildings);
     mBuildings.clear();
 
-    // Merge adjacent rooms into buildings.
-    // Rooms on different levels that overlap in x/y are merged into the
-    // same buliding.
-    QList<MapBuildingsNS::Room*> overlappingRooms;
-    for (MapBuildingsNS::Room *r : mRooms) {
-        if (r->building == nullptr) {
-            r->building = new MapBuildingsNS::Building();
-            mBuildings += r->building;
-            r->building->RoomList += r;
+    for (int i = 0; i < mGraph.roomCount(); i++) {
+        const QVector<int> &rects = mGraph.roomRects(i);
+        MapBuildingsNS::RoomRect *first = mRoomRects[rects.first()];
+        MapBuildingsNS::Room *room = new MapBuildingsNS::Room(first->nameWithoutSuffix(),
+                                                              first->floor);
+        for (int rect : rects) {
+            mRoomRects[rect]->room = room;
+            room->rects += mRoomRects[rect];
         }
-        overlappingRooms.clear();
-        mRoomLookup.overlapping(r->bounds().adjusted(-1, -1, 1, 1), overlappingRooms);
-        for (MapBuildingsNS::Room *comp : overlappingRooms) {
-            if (comp == r)
-                continue;
-            if (r->building == comp->building)
-                continue;
+        mRooms += room;
+    }
 
-            if (r->inSameBuilding(comp)) {
-                if (comp->building != nullptr) {
-                    MapBuildingsNS::Building *b = comp->building;
-                    for (MapBuildingsNS::Room *r2 : b->RoomList) {
-                        Q_ASSERT(r2->building == b);
-                        Q_ASSERT(!r->building->RoomList.contains(r2));
-                        r2->building = r->building;
-                    }
-                    r->building->RoomList += b->RoomList;
-                    mBuildings.removeOne(b);
-                    delete b;
-                } else {
-                    comp->building = r->building;
-                    r->building->RoomList += comp;
-                    Q_ASSERT(r->building->RoomList.count(comp) == 1);
-                }
-            }
+    for (int i = 0; i < mGraph.buildingCount(); i++) {
+        MapBuildingsNS::Building *building = new MapBuildingsNS::Building();
+        for (int room : mGraph.buildingRooms(i)) {
+            mRooms[room]->building = building;
+            building->RoomList += mRooms[room];
         }
+        mBuildings += building;
     }
 
-    qDebug() << "MapBuildings: merge rooms into buildings took" << elapsed.elapsed() << "ms";
-    elapsed.restart();
+    qDebug() << "MapBuildings: creating rooms and buildings took" << elapsed.elapsed() << "ms";
 }
 
-namespace {
-    bool isAdjacentMap(MapComposite* mc)
-    {
-        if (mc == nullptr)
-            return false;
-        if (mc->isAdjacentMap())
-            return true;
-        return isAdjacentMap(mc->parent());
-    };
+void MapBuildings::invalidate()
+{
+    mValid = false;
 }
 
-void MapBuildings::extractRoomRects(MapComposite *mapComposite)
+void MapBuildings::invalidateMap(MapComposite *mc)
 {
-    qDeleteAll(mRoomRectsByLevel);
-    mRoomRectsByLevel.clear();
+    mInvalidMaps += mc;
+}
 
-    for (MapComposite *mc : mapComposite->maps()) {
-        if (isAdjacentMap(mc))
-            continue;
-        if (!mc->isGroupVisible() || !mc->isVisible())
-            continue;
-        int ox = mc->originRecursive().x();
-        int oy = mc->originRecursive().y();
-        int rootLevel = mc->levelRecursive();
-        for (int level = 0; level <= mc->maxLevel(); level++) {
-            QString layerName = QString::fromLatin1("%1_RoomDefs").arg(level);
-            int index = mc->map()->indexOfLayer(layerName, Layer::ObjectGroupType);
-            if (index >= 0) {
-                const QList<MapObject*> mapObjects = mc->map()->layerAt(index)->asObjectGroup()->objects();
-                for (MapObject *mapObject : mapObjects) {
-                    if (BuildingEditor::RoofHiding::isEmptyOutside(mapObject->name()))
-                        continue;
-                    int x = qFloor(mapObject->x());
-                    int y = qFloor(mapObject->y());
-                    int w = qCeil(mapObject->x() + mapObject->width()) - x;
-                    int h = qCeil(mapObject->y() + mapObject->height()) - y;
-                    x += mc->orientAdjustTiles().x() * level;
-                    y += mc->orientAdjustTiles().y() * level;
-                    MapBuildingsNS::RoomRect *rr =
-                            new MapBuildingsNS::RoomRect(
-                                mapObject->name(),
-                                x + ox, y + oy,
-                                level + rootLevel,
-                                w, h);
-                    rr->buildingName = QFileInfo(mc->mapInfo()->path()).fileName();
-                    if (mRoomRectsByLevel[level + rootLevel] == nullptr) {
-                        mRoomRectsByLevel[level + rootLevel] = new MapBuildingsNS::RoomRectsForLevel();
-                    }
-                    mRoomRectsByLevel[level + rootLevel]->mRects += rr;
-                }
+void MapBuildings::extractRoomRects(MapComposite *mc, QList<MapBuildingsNS::RoomRect*> &rects)
+{
+    int ox = mc->originRecursive().x();
+    int oy = mc->originRecursive().y();
+    int rootLevel = mc->levelRecursive();
+    for (int level = 0; level <= mc->maxLevel(); level++) {
+        QString layerName = QString::fromLatin1("%1_RoomDefs").arg(level);
+        int index = mc->map()->indexOfLayer(layerName, Layer::ObjectGroupType);
+        if (index >= 0) {
+            const QList<MapObject*> mapObjects = mc->map()->layerAt(index)->asObjectGroup()->objects();
+            for (MapObject *mapObject : mapObjects) {
+                if (BuildingEditor::RoofHiding::isEmptyOutside(mapObject->name()))
+                    continue;
+                int x = qFloor(mapObject->x());
+                int y = qFloor(mapObject->y());
+                int w = qCeil(mapObject->x() + mapObject->width()) - x;
+                int h = qCeil(mapObject->y() + mapObject->height()) - y;
+                x += mc->orientAdjustTiles().x() * level;
+                y += mc->orientAdjustTiles().y() * level;
+                MapBuildingsNS::RoomRect *rr =
+                        new MapBuildingsNS::RoomRect(
+                            mapObject->name(),
+                            x + ox, y + oy,
+                            level + rootLevel,
+                            w, h);
+                rr->buildingName = QFileInfo(mc->mapInfo()->path()).fileName();
+                rects += rr;
             }
         }
     }
-
-    for (MapBuildingsNS::RoomRectsForLevel* rr4L : mRoomRectsByLevel) {
-        for (MapBuildingsNS::RoomRect *rr : rr4L->mRects) {
-            rr4L->addRect(rr);
-        }
-    }
 }
 
 MapBuildingsNS::Room *MapBuildings::roomAt(const QPoint &pos, int level)
 {
-    int x = pos.x() / 10;
-    int y = pos.y() / 10;
-    x = clamp(x, 0, 30-1);
-    y = clamp(y, 0, 30-1);
-
-    for (MapBuildingsNS::Room* r : mRoomLookup.mGrid[x + y * 30]) {
-        if ((r->floor == level) && r->contains(pos)) {
-            return r;
-        }
-    }
-    /*
-    for (MapBuildingsNS::Room *r : mRooms) {
-        if (r->floor != level) {
-            continue;
-        }
-        for (MapBuildingsNS::RoomRect *rr : r->rects) {
-            if (rr->bounds().contains(pos)) {
-                return rr->room;
-            }
-        }
-    }
-    */
-    /*
-    MapBuildingsNS::RoomRectsForLevel* rr4L = mRoomRectsByLevel[level];
-    if (rr4L == nullptr) {
-        return nullptr;
-    }
-
-    for (MapBuildingsNS::RoomRect *rr : mRoomRectsByLevel[level]->mRects) {
-        if (rr->bounds().contains(pos)) {
-            return rr->room;
-        }
-    }
-    */
-    return nullptr;
+    int room = mGraph.roomAt(pos, level);
+    return (room == -1) ? nullptr : mRooms[room];
 }
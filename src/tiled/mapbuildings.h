@@ -18,19 +18,15 @@
 #ifndef MAPBUILDINGS_H
 #define MAPBUILDINGS_H
 
+#include "roomgraph.h"
+
 #include <QList>
 #include <QMap>
 #include <QRegion>
-#include <qmath.h>
+#include <QSet>
 
 class MapComposite;
 
-template<typename T>
-T clamp(T v, T min, T max)
-{
-    return qMin(qMax(v, min), max);
-};
-
 namespace MapBuildingsNS {
 
 class Building;
@@ -180,103 +176,6 @@ public:
     QList<Room*> RoomList;
 };
 
-class RoomRectsForLevel
-{
-public:
-    void addRect(RoomRect* rr)
-    {
-        int xMin = rr->x / 10;
-        int yMin = rr->y / 10;
-        int xMax = qCeil((rr->x + rr->w) / 10.0);
-        int yMax = qCeil((rr->y + rr->h) / 10.0);
-        xMin = clamp(xMin, 0, 30-1);
-        yMin = clamp(yMin, 0, 30-1);
-        xMax = clamp(xMax, 0, 30-1);
-        yMax = clamp(yMax, 0, 30-1);
-        for (int y = yMin; y <= yMax; y++) {
-            for (int x = xMin; x <= xMax; x++) {
-                mLookup[x + y * 30] += rr;
-            }
-        }
-    }
-
-    void overlapping(const QRect& rect, QList<RoomRect*>& rects)
-    {
-        int xMin = rect.x() / 10;
-        int yMin = rect.y() / 10;
-        int xMax = qCeil((rect.x() + rect.width()) / 10.0);
-        int yMax = qCeil((rect.y() + rect.height()) / 10.0);
-        xMin = clamp(xMin, 0, 30-1);
-        yMin = clamp(yMin, 0, 30-1);
-        xMax = clamp(xMax, 0, 30-1);
-        yMax = clamp(yMax, 0, 30-1);
-        for (int y = yMin; y <= yMax; y++) {
-            for (int x = xMin; x <= xMax; x++) {
-                for (RoomRect* rr : mLookup[x + y * 30]) {
-                    if (rects.contains(rr) == false) {
-                        rects += rr;
-                    }
-                }
-            }
-        }
-    }
-
-    QList<RoomRect*> mRects;
-    QList<RoomRect*> mLookup[30 * 30];
-};
-
-class RoomLookup
-{
-public:
-    void clear()
-    {
-        for (int i = 0; i < 30 * 30; i++) {
-            mGrid[i].clear();
-        }
-    }
-
-    void addRoom(Room* r)
-    {
-        QRect bounds = r->bounds();
-        int xMin = bounds.x() / 10;
-        int yMin = bounds.y() / 10;
-        int xMax = qCeil((bounds.x() + bounds.width()) / 10.0);
-        int yMax = qCeil((bounds.y() + bounds.height()) / 10.0);
-        xMin = clamp(xMin, 0, 30-1);
-        yMin = clamp(yMin, 0, 30-1);
-        xMax = clamp(xMax, 0, 30-1);
-        yMax = clamp(yMax, 0, 30-1);
-        for (int y = yMin; y <= yMax; y++) {
-            for (int x = xMin; x <= xMax; x++) {
-                mGrid[x + y * 30] += r;
-            }
-        }
-    }
-
-    void overlapping(const QRect& rect, QList<Room*>& rooms)
-    {
-        int xMin = rect.x() / 10;
-        int yMin = rect.y() / 10;
-        int xMax = qCeil((rect.x() + rect.width()) / 10.0);
-        int yMax = qCeil((rect.y() + rect.height()) / 10.0);
-        xMin = clamp(xMin, 0, 30-1);
-        yMin = clamp(yMin, 0, 30-1);
-        xMax = clamp(xMax, 0, 30-1);
-        yMax = clamp(yMax, 0, 30-1);
-        for (int y = yMin; y <= yMax; y++) {
-            for (int x = xMin; x <= xMax; x++) {
-                for (Room* r : mGrid[x + y * 30]) {
-                    if (rooms.contains(r) == false) {
-                        rooms += r;
-                    }
-                }
-            }
-        }
-    }
-
-    QList<MapBuildingsNS::Room*> mGrid[30 * 30];
-};
-
 } // MapBuildingsNS
 
 class MapBuildings
@@ -285,8 +184,27 @@ public:
     MapBuildings();
     ~MapBuildings();
 
+    /**
+     * Brings the rooms and buildings up to date with the RoomDefs of
+     * \a mc and its sub-maps.  Only maps invalidated since the last call
+     * have their RoomDefs read again.
+     */
     void calculate(MapComposite *mc);
-    void extractRoomRects(MapComposite *mapComposite);
+
+    /**
+     * Forgets the RoomDefs of every map, for when sub-maps were added,
+     * removed, moved or hidden.
+     */
+    void invalidate();
+
+    /**
+     * Forgets the RoomDefs of \a mc only, for when its RoomDef objects
+     * changed.
+     */
+    void invalidateMap(MapComposite *mc);
+
+    bool isValid() const
+    { return mValid && mInvalidMaps.isEmpty(); }
 
     const QList<MapBuildingsNS::Building*> &buildings()
     { return mBuildings; }
@@ -294,10 +212,16 @@ public:
     MapBuildingsNS::Room *roomAt(const QPoint &pos, int level);
 
 private:
+    void extractRoomRects(MapComposite *mc, QList<MapBuildingsNS::RoomRect*> &rects);
+
     QList<MapBuildingsNS::Building*> mBuildings;
     QList<MapBuildingsNS::Room*> mRooms;
-    MapBuildingsNS::RoomLookup mRoomLookup;
-    QMap<int, MapBuildingsNS::RoomRectsForLevel*> mRoomRectsByLevel;
+    // Indexed like the rectangles in mGraph.
+    QVector<MapBuildingsNS::RoomRect*> mRoomRects;
+    QMap<MapComposite*,QList<MapBuildingsNS::RoomRect*> > mRoomRectsByMap;
+    QSet<MapComposite*> mInvalidMaps;
+    bool mValid;
+    Tiled::Internal::RoomGraph mGraph;
 };
 
 #endif // MAPBUILDINGS_H
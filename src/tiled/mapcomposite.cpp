@@ -25,6 +25,7 @@
 #include "maprenderer.h"
 #include "objectgroup.h"
 #include "tilelayer.h"
+#include "tracing.h"
 
 #include <QDebug>
 #include <QDir>
@@ -68,8 +69,7 @@ static void unionSceneRects(const QRectF &a,
 
 QString MapComposite::layerNameWithoutPrefix(const QString &name)
 {
-    int pos = name.indexOf(QLatin1Char('_')) + 1; // Could be "-1 + 1 == 0"
-    return name.mid(pos);
+    return LayerClassification::baseName(name);
 }
 
 QString MapComposite::layerNameWithoutPrefix(Layer *layer)
@@ -79,6 +79,16 @@ QString MapComposite::layerNameWithoutPrefix(Layer *layer)
 
 ///// ///// ///// ///// /////
 
+#ifdef BUILDINGED
+// Only writes to the vector when it has to, so placements of a lot that
+// share it keep doing so.
+static void clearLayers(QVector<TileLayer*> &layers)
+{
+    if (layers.count(nullptr) != layers.size())
+        layers.fill(nullptr);
+}
+#endif
+
 CompositeLayerGroup::SubMapLayers::SubMapLayers(MapComposite *subMap,
                                                 CompositeLayerGroup *layerGroup)
     : mSubMap(subMap)
@@ -103,6 +113,33 @@ CompositeLayerGroup::CompositeLayerGroup(MapComposite *owner, int level)
 
 }
 
+CompositeLayerGroup::CompositeLayerGroup(MapComposite *owner, const CompositeLayerGroup &resolved)
+    : ZTileLayerGroup(owner->map(), resolved.level())
+    , mOwner(owner)
+    , mAnyVisibleLayers(false)
+    , mNeedsSynch(true)
+    , mVisibleLayers(resolved.mVisibleLayers)
+    , mEmptyLayers(resolved.mEmptyLayers)
+    , mLayerOpacity(resolved.mLayerOpacity)
+    , mLayersByName(resolved.mLayersByName)
+    , mBmpBlendLayers(resolved.mBmpBlendLayers)
+    , mNoBlends(resolved.mNoBlends)
+    , mNoBlendCell(resolved.mNoBlendCell)
+#ifdef BUILDINGED
+    , mBlendOverLayers(resolved.mBlendOverLayers)
+    , mToolLayers(resolved.mToolLayers)
+    , mToolNoBlends(resolved.mToolNoBlends)
+    , mForceNonEmpty(resolved.mForceNonEmpty)
+#endif // BUILDINGED
+#if 1 // ROAD_CRUD
+    , mRoadLayer0(resolved.mRoadLayer0)
+    , mRoadLayer1(resolved.mRoadLayer1)
+#endif // ROAD_CRUD
+{
+    mLayers = resolved.mLayers;
+    mIndices = resolved.mIndices;
+}
+
 void CompositeLayerGroup::addTileLayer(TileLayer *layer, int index)
 {
 #ifndef WORLDED
@@ -116,8 +153,7 @@ void CompositeLayerGroup::addTileLayer(TileLayer *layer, int index)
 #endif
 
     // Remember the names of layers (without the N_ prefix)
-    const QString name = MapComposite::layerNameWithoutPrefix(layer);
-    mLayersByName[name].append(layer);
+    mLayersByName[layer->classification().baseNameId()].append(layer);
 
     index = mLayers.indexOf(layer);
     mVisibleLayers.insert(index, layer->isVisible());
@@ -129,7 +165,7 @@ void CompositeLayerGroup::addTileLayer(TileLayer *layer, int index)
     // TileLayer::isEmpty() is SLOW, it's why I'm caching it.
     bool empty = mOwner->mapInfo()->isBeingEdited()
             ? false
-            : layer->isEmpty() || layer->name().contains(QLatin1String("NoRender"));
+            : layer->isEmpty() || layer->classification().hasRole(LayerClassification::NoRenderRole);
     mEmptyLayers.insert(index, empty);
 
     mBmpBlendLayers.insert(index, nullptr);
@@ -166,13 +202,14 @@ void CompositeLayerGroup::removeTileLayer(TileLayer *layer)
         layer->setGroup(oldGroup);
 #endif
 
-    const QString name = MapComposite::layerNameWithoutPrefix(layer);
-    index = mLayersByName[name].indexOf(layer);
-    mLayersByName[name].remove(index);
+    const int nameId = layer->classification().baseNameId();
+    index = mLayersByName[nameId].indexOf(layer);
+    mLayersByName[nameId].remove(index);
 }
 
 void CompositeLayerGroup::prepareDrawing(const MapRenderer *renderer, const QRect &rect)
 {
+    TRACE_ZONE("CompositeLayerGroup::prepareDrawing");
     mPreparedSubMapLayers.resize(0);
     if (mAnyVisibleLayers == false)
         return;
@@ -190,13 +227,11 @@ void CompositeLayerGroup::prepareDrawing(const MapRenderer *renderer, const QRec
         mOwner->bmpBlender()->flush(renderer, rect, mOwner->originRecursive());
 }
 
-static QLatin1String sFloor("0_Floor"); // FIXME: thread safe?
-static QLatin1String sAboveLot("_AboveLot");
-
 bool CompositeLayerGroup::orderedCellsAt(const QPoint &pos,
                                          QVector<const Cell *> &cells,
                                          QVector<qreal> &opacities) const
 {
+    TRACE_ZONE("CompositeLayerGroup::orderedCellsAt");
     MapComposite *root = mOwner->rootOrAdjacent();
     if (root == mOwner)
         root->mKeepFloorLayerCount = 0;
@@ -234,8 +269,9 @@ bool CompositeLayerGroup::orderedCellsAt(const QPoint &pos,
         if (!mOwner->parent() && !mOwner->showMapTiles())
             cell = &emptyCell;
         if (mOwner->parent() != nullptr && mOwner->parent()->showLotFloorsOnly()) {
-            bool isFloor = !mLevel && !index && (tl->name() == sFloor);
-            if (!isFloor && !tl->name().contains(sAboveLot)) {
+            const LayerClassification &classification = tl->classification();
+            bool isFloor = !mLevel && !index && classification.hasRole(LayerClassification::FloorRole);
+            if (!isFloor && !classification.hasRole(LayerClassification::AboveLotRole)) {
                 cell = &emptyCell;
             }
         }
@@ -254,14 +290,14 @@ bool CompositeLayerGroup::orderedCellsAt(const QPoint &pos,
 #endif // BUILDINGED
         if (index && suppressRgn.contains(rootPos))
             cell = &emptyCell;
-        if (!cell->isEmpty() && (root == mOwner) && tl->name().contains(sAboveLot)) {
+        if (!cell->isEmpty() && (root == mOwner) && tl->classification().hasRole(LayerClassification::AboveLotRole)) {
             aboveLotCells += cell;
             aboveLotOpacities += mLayerOpacity[index];
             cell = &emptyCell;
         }
         if (!cell->isEmpty()) {
             if (!cleared) {
-                bool isFloor = !mLevel && !index && (tl->name() == sFloor);
+                bool isFloor = !mLevel && !index && tl->classification().hasRole(LayerClassification::FloorRole);
                 if (isFloor) root->mKeepFloorLayerCount = 0;
                 cells.resize(root->mKeepFloorLayerCount);
                 opacities.resize(root->mKeepFloorLayerCount);
@@ -281,9 +317,9 @@ bool CompositeLayerGroup::orderedCellsAt(const QPoint &pos,
         }
 
         // Draw the no-blend tile.
-        if (noBlend && tl->name() == mOwner->mNoBlendLayer && noBlend->get(subPos - nbPos)) {
+        if (noBlend && tl->classification().nameId() == mOwner->mNoBlendLayerId && noBlend->get(subPos - nbPos)) {
             if (!cleared) {
-                bool isFloor = !mLevel && !index && (tl->name() == sFloor);
+                bool isFloor = !mLevel && !index && tl->classification().hasRole(LayerClassification::FloorRole);
                 if (isFloor) root->mKeepFloorLayerCount = 0;
                 cells.resize(root->mKeepFloorLayerCount);
                 opacities.resize(root->mKeepFloorLayerCount);
@@ -334,6 +370,7 @@ void CompositeLayerGroup::prepareDrawing2()
 // layers (so NoRender layers are included) and visibility of sub-maps.
 bool CompositeLayerGroup::orderedCellsAt2(const QPoint &pos, QVector<const Cell *> &cells) const
 {
+    TRACE_ZONE("CompositeLayerGroup::orderedCellsAt2");
     MapComposite *root = mOwner->root();
     if (root == mOwner)
         root->mKeepFloorLayerCount = 0;
@@ -358,7 +395,7 @@ bool CompositeLayerGroup::orderedCellsAt2(const QPoint &pos, QVector<const Cell
                         : &mOwner->roadLayer1()->cellAt(subPos);
                 if (!cell->isEmpty()) {
                     if (!cleared) {
-                        bool isFloor = !mLevel && !index && (tl->name() == sFloor);
+                        bool isFloor = !mLevel && !index && tl->classification().hasRole(LayerClassification::FloorRole);
                         if (isFloor) root->mKeepFloorLayerCount = 0;
                         cells.resize(root->mKeepFloorLayerCount);
                         cleared = true;
@@ -381,13 +418,13 @@ bool CompositeLayerGroup::orderedCellsAt2(const QPoint &pos, QVector<const Cell
                 cell = &tlBlendOver->cellAt(subPos);
             }
 #endif // BUILDINGED
-            if (!cell->isEmpty() && (root == mOwner) && tl->name().contains(sAboveLot)) {
+            if (!cell->isEmpty() && (root == mOwner) && tl->classification().hasRole(LayerClassification::AboveLotRole)) {
                 aboveLotCells += cell;
                 continue;
             }
             if (!cell->isEmpty()) {
                 if (!cleared) {
-                    bool isFloor = !mLevel && !index && (tl->name() == sFloor);
+                    bool isFloor = !mLevel && !index && tl->classification().hasRole(LayerClassification::FloorRole);
                     if (isFloor) root->mKeepFloorLayerCount = 0;
                     cells.resize(root->mKeepFloorLayerCount);
                     cleared = true;
@@ -452,7 +489,7 @@ void CompositeLayerGroup::synch()
         mDrawMargins = QMargins(0, mOwner->map()->tileHeight(), mOwner->map()->tileWidth(), 0);
         mVisibleSubMapLayers.clear();
 #ifdef BUILDINGED
-        mBlendOverLayers.fill(nullptr);
+        clearLayers(mBlendOverLayers);
 #endif
         mNeedsSynch = false;
         return;
@@ -483,7 +520,7 @@ void CompositeLayerGroup::synch()
 
 #ifdef BUILDINGED
     // Do this before the isLayerEmpty() call below.
-    mBlendOverLayers.fill(nullptr);
+    clearLayers(mBlendOverLayers);
     if (MapComposite *blendOverMap = mOwner->blendOverMap()) {
         if (CompositeLayerGroup *layerGroup = blendOverMap->tileLayersForLevel(mLevel)) {
             for (int i = 0; i < mLayers.size(); i++) {
@@ -520,11 +557,10 @@ void CompositeLayerGroup::synch()
         if (rootGroup) {
             // FIXME: this doesn't properly handle multiple layers with the same name.
             for (int rootIndex = 0; rootIndex < rootGroup->mLayers.size(); rootIndex++) {
-                QString layerName = rootGroup->mLayers[rootIndex]->name();
-                const QString name = MapComposite::layerNameWithoutPrefix(layerName);
-                if (!mLayersByName.contains(name))
+                const int nameId = rootGroup->mLayers[rootIndex]->classification().baseNameId();
+                if (!mLayersByName.contains(nameId))
                     continue;
-                foreach (Layer *layer, mLayersByName[name]) {
+                foreach (Layer *layer, mLayersByName[nameId]) {
                     int index = mLayers.indexOf(layer->asTileLayer());
                     Q_ASSERT(index != -1);
                     mVisibleLayers[index] = rootGroup->mVisibleLayers[rootIndex];
@@ -602,29 +638,36 @@ void CompositeLayerGroup::restoreOpacity()
 
 bool CompositeLayerGroup::setBmpBlendLayers(const QList<TileLayer *> &layers)
 {
-    QVector<TileLayer*> old = mBmpBlendLayers;
-
-    mBmpBlendLayers.fill(nullptr);
+    // Worked out on the side, so placements of a lot that share these
+    // vectors keep sharing them when nothing changed.
+    QVector<TileLayer*> bmpBlendLayers(mLayers.size(), nullptr);
+    QVector<MapNoBlend*> noBlends = mNoBlends;
     foreach (TileLayer *tl, layers) {
         for (int i = 0; i < mLayers.size(); i++) {
-            if (mLayers[i]->name() == tl->name()) {
-                mBmpBlendLayers[i] = tl;
+            if (mLayers[i]->classification().nameId() == tl->classification().nameId()) {
+                bmpBlendLayers[i] = tl;
                 if (mOwner->bmpBlender()->blendLayers().contains(tl->name()))
-                    mNoBlends[i] = mMap->noBlend(tl->name());
+                    noBlends[i] = mMap->noBlend(tl->name());
             }
         }
     }
 
-    return old != mBmpBlendLayers;
+    if (noBlends != mNoBlends)
+        mNoBlends = noBlends;
+    if (bmpBlendLayers == mBmpBlendLayers)
+        return false;
+    mBmpBlendLayers = bmpBlendLayers;
+    return true;
 }
 
 #ifdef BUILDINGED
 bool CompositeLayerGroup::setLayerNonEmpty(const QString &layerName, bool force)
 {
-    const QString name = MapComposite::layerNameWithoutPrefix(layerName);
-    if (!mLayersByName.contains(name))
+    const int nameId = LayerClassification::findBaseNameId(
+                MapComposite::layerNameWithoutPrefix(layerName));
+    if (!mLayersByName.contains(nameId))
         return false;
-    foreach (Layer *layer, mLayersByName[name])
+    foreach (Layer *layer, mLayersByName[nameId])
         setLayerNonEmpty(layer->asTileLayer(), force);
     return mNeedsSynch;
 }
@@ -655,10 +698,11 @@ QMargins CompositeLayerGroup::drawMargins() const
 
 bool CompositeLayerGroup::setLayerVisibility(const QString &layerName, bool visible)
 {
-    const QString name = MapComposite::layerNameWithoutPrefix(layerName);
-    if (!mLayersByName.contains(name))
+    const int nameId = LayerClassification::findBaseNameId(
+                MapComposite::layerNameWithoutPrefix(layerName));
+    if (!mLayersByName.contains(nameId))
         return false;
-    foreach (Layer *layer, mLayersByName[name])
+    foreach (Layer *layer, mLayersByName[nameId])
         setLayerVisibility(layer->asTileLayer(), visible);
     return mNeedsSynch;
 }
@@ -683,7 +727,7 @@ bool CompositeLayerGroup::isLayerVisible(TileLayer *tl)
 
 void CompositeLayerGroup::layerRenamed(TileLayer *layer)
 {
-    QMapIterator<QString,QVector<Layer*> > it(mLayersByName);
+    QHashIterator<int,QVector<Layer*> > it(mLayersByName);
     while (it.hasNext()) {
         it.next();
         int index = it.value().indexOf(layer);
@@ -694,17 +738,17 @@ void CompositeLayerGroup::layerRenamed(TileLayer *layer)
         }
     }
 
-    const QString name = MapComposite::layerNameWithoutPrefix(layer);
-    mLayersByName[name].append(layer);
+    mLayersByName[layer->classification().baseNameId()].append(layer);
 }
 
 bool CompositeLayerGroup::setLayerOpacity(const QString &layerName, qreal opacity)
 {
-    const QString name = MapComposite::layerNameWithoutPrefix(layerName);
-    if (!mLayersByName.contains(name))
+    const int nameId = LayerClassification::findBaseNameId(
+                MapComposite::layerNameWithoutPrefix(layerName));
+    if (!mLayersByName.contains(nameId))
         return false;
     bool changed = false;
-    foreach (Layer *layer, mLayersByName[name]) {
+    foreach (Layer *layer, mLayersByName[nameId]) {
         if (setLayerOpacity(layer->asTileLayer(), opacity))
             changed = true;
     }
@@ -813,8 +857,11 @@ MapComposite::MapComposite(MapInfo *mapInfo, Map::Orientation orientRender,
     , mShowBMPTiles(true)
     , mShowMapTiles(true)
     , mIsAdjacentMap(false)
-    , mBmpBlender(new Tiled::Internal::BmpBlender(mMap, this))
+    , mBmpBlender(nullptr)
+    , mIsSharedLot(false)
+    , mResolved(false)
     , mSuppressLevel(0)
+    , mNoBlendLayerId(-1)
 {
 #ifdef WORLDED
     MapManager::instance()->addReferenceToMap(mMapInfo);
@@ -829,23 +876,8 @@ MapComposite::MapComposite(MapInfo *mapInfo, Map::Orientation orientRender,
             mOrientAdjustPos = mOrientAdjustTiles = QPoint(-3, -3);
     }
 
-    int index = 0;
-    foreach (Layer *layer, mMap->layers()) {
-        int level;
-        if (levelForLayer(layer, &level)) {
-            // FIXME: no changing of mMap should happen after it is loaded!
-            layer->setLevel(level); // for ObjectGroup,ImageLayer as well
-
-            if (TileLayer *tl = layer->asTileLayer()) {
-                if (!mLayerGroups.contains(level))
-                    mLayerGroups[level] = new CompositeLayerGroup(this, level);
-                mLayerGroups[level]->addTileLayer(tl, index);
-                if (!mapInfo->isBeingEdited())
-                    mLayerGroups[level]->setLayerVisibility(tl, !layer->name().contains(QLatin1String("NoRender")));
-            }
-        }
-        ++index;
-    }
+    mIsSharedLot = mParent && !mMapInfo->isBeingEdited();
+    createLayerGroups();
 
     // Load lots, but only if this is not the map being edited (that is handled
     // by the LotManager).
@@ -936,15 +968,26 @@ MapComposite::MapComposite(MapInfo *mapInfo, Map::Orientation orientRender,
         mSortedLayerGroups.append(mLayerGroups[level]);
     }
 
+    // A building placed as a lot many times only needs its BMP blended once.
+    // Every placement that isn't being edited reads the blended tiles from
+    // the same BmpBlender, offset by its own position.
+    if (mIsSharedLot) {
+        mBmpBlender = acquireSharedLot();
+    } else {
+        mBmpBlender = new Tiled::Internal::BmpBlender(mMap, this);
+        mBmpBlender->markDirty(0, 0, mMap->width() - 1, mMap->height() - 1);
+    }
     connect(mBmpBlender, &Internal::BmpBlender::layersRecreated, this, &MapComposite::bmpBlenderLayersRecreated);
-    mBmpBlender->markDirty(0, 0, mMap->width() - 1, mMap->height() - 1);
     mLayerGroups[0]->setBmpBlendLayers(mBmpBlender->tileLayers());
+    mResolved = true;
 }
 
 MapComposite::~MapComposite()
 {
     qDeleteAll(mSubMaps);
     qDeleteAll(mLayerGroups);
+    if (mIsSharedLot)
+        releaseSharedLot();
 #ifdef WORLDED
     if (mMapInfo)
         MapManager::instance()->removeReferenceToMap(mMapInfo);
@@ -953,22 +996,14 @@ MapComposite::~MapComposite()
 
 bool MapComposite::levelForLayer(const QString &layerName, int *levelPtr)
 {
-    if (levelPtr) (*levelPtr) = 0;
-
-    // See if the layer name matches "0_foo" or "1_bar" etc.
-    QStringList sl = layerName.trimmed().split(QLatin1Char('_'));
-    if (sl.count() > 1 && !sl[1].isEmpty()) {
-        bool conversionOK;
-        uint level = sl[0].toUInt(&conversionOK);
-        if (levelPtr) (*levelPtr) = level;
-        return conversionOK;
-    }
-    return false;
+    return LayerClassification::levelForName(layerName, levelPtr);
 }
 
 bool MapComposite::levelForLayer(Layer *layer, int *levelPtr)
 {
-    return levelForLayer(layer->name(), levelPtr);
+    const LayerClassification &classification = layer->classification();
+    if (levelPtr) (*levelPtr) = classification.level();
+    return classification.hasLevel();
 }
 
 MapComposite *MapComposite::addMap(MapInfo *mapInfo, const QPoint &pos,
@@ -1186,6 +1221,11 @@ QRectF MapComposite::boundingRect(MapRenderer *renderer, bool forceMapBounds) co
         unionSceneRects(bounds,
                         renderer->boundingRect(mapTileBounds, minLevel),
                         bounds);
+        if (!mReservedTileBounds.isEmpty()) {
+            unionSceneRects(bounds,
+                            renderer->boundingRect(mReservedTileBounds.translated(mPos), minLevel),
+                            bounds);
+        }
         // When setting the bounds of the scene, make sure the highest level is included
         // in the sceneRect() so the grid won't be cut off.
         int maxLevel = levelRecursive() + mMaxLevel;
@@ -1336,6 +1376,8 @@ bool MapComposite::mapAboutToChange(MapInfo *mapInfo)
             while (layerGroup->layerCount())
                 layerGroup->removeTileLayer(layerGroup->layers().first());
         }
+        // Other placements mustn't copy the emptied groups.
+        mResolved = false;
         affected = true;
     }
     foreach (MapComposite *subMap, mSubMaps) {
@@ -1387,7 +1429,7 @@ bool MapComposite::isTilesetUsed(Tileset *tileset, bool recurse)
         if (mc->map()->isTilesetUsed(tileset))
             return true;
         foreach (TileLayer *tl, mc->tileLayersForLevel(0)->bmpBlendLayers()) {
-            if (tl && tl->usedTilesets().contains(tileset))
+            if (tl && tl->referencesTileset(tileset))
                 return true;
         }
     }
@@ -1464,6 +1506,7 @@ bool MapComposite::waitingForMapsToLoad() const
 
 void MapComposite::recreate()
 {
+    mResolved = false;
     qDeleteAll(mSubMaps);
     qDeleteAll(mLayerGroups);
     mSubMaps.clear();
@@ -1484,23 +1527,7 @@ void MapComposite::recreate()
             mOrientAdjustPos = mOrientAdjustTiles = QPoint(-3, -3);
     }
 
-    int index = 0;
-    foreach (Layer *layer, mMap->layers()) {
-        int level;
-        if (levelForLayer(layer, &level)) {
-            // FIXME: no changing of mMap should happen after it is loaded!
-            layer->setLevel(level); // for ObjectGroup,ImageLayer as well
-
-            if (TileLayer *tl = layer->asTileLayer()) {
-                if (!mLayerGroups.contains(level))
-                    mLayerGroups[level] = new CompositeLayerGroup(this, level);
-                mLayerGroups[level]->addTileLayer(tl, index);
-                if (!mMapInfo->isBeingEdited())
-                    mLayerGroups[level]->setLayerVisibility(tl, !layer->name().contains(QLatin1String("NoRender")));
-            }
-        }
-        ++index;
-    }
+    createLayerGroups();
 
     // Load lots, but only if this is not the map being edited (that is handled
     // by the LotManager).
@@ -1571,7 +1598,18 @@ void MapComposite::recreate()
         mSortedLayerGroups.append(mLayerGroups[level]);
     }
 
-    mBmpBlender->setMap(mMap);
+    if (mIsSharedLot) {
+        // Only the first placement to see the new map updates the shared
+        // blender, the others just pick up its layers.
+        SharedLot &shared = root()->mSharedLots[mMapInfo];
+        if (shared.map != mMap) {
+            shared.map = mMap;
+            mBmpBlender->setMap(mMap);
+        }
+        mLayerGroups[0]->setBmpBlendLayers(mBmpBlender->tileLayers());
+    } else
+        mBmpBlender->setMap(mMap);
+    mResolved = true;
 
 #ifndef WORLDED
     /////
@@ -1610,6 +1648,87 @@ QStringList MapComposite::getMapFileNames() const
     return result;
 }
 
+void MapComposite::createLayerGroups()
+{
+    // Every placement of a lot resolves to the same layer groups, so copy
+    // them from one that has done the work already.
+    if (MapComposite *resolved = resolvedPlacement()) {
+        foreach (CompositeLayerGroup *layerGroup, resolved->mLayerGroups) {
+            if (layerGroup->layerCount())
+                mLayerGroups[layerGroup->level()] = new CompositeLayerGroup(this, *layerGroup);
+        }
+        return;
+    }
+
+    int index = 0;
+    foreach (Layer *layer, mMap->layers()) {
+        int level;
+        if (levelForLayer(layer, &level)) {
+            // FIXME: no changing of mMap should happen after it is loaded!
+            layer->setLevel(level); // for ObjectGroup,ImageLayer as well
+
+            if (TileLayer *tl = layer->asTileLayer()) {
+                if (!mLayerGroups.contains(level))
+                    mLayerGroups[level] = new CompositeLayerGroup(this, level);
+                mLayerGroups[level]->addTileLayer(tl, index);
+                if (!mMapInfo->isBeingEdited())
+                    mLayerGroups[level]->setLayerVisibility(tl, !layer->classification().hasRole(LayerClassification::NoRenderRole));
+            }
+        }
+        ++index;
+    }
+}
+
+// Returns another placement of this lot whose layer groups were created from
+// the current map, or null if there is none.
+MapComposite *MapComposite::resolvedPlacement()
+{
+    if (!mIsSharedLot)
+        return nullptr;
+    QHash<MapInfo*,SharedLot>::const_iterator it = root()->mSharedLots.constFind(mMapInfo);
+    if (it == root()->mSharedLots.constEnd())
+        return nullptr;
+    foreach (MapComposite *placement, it->placements) {
+        if (placement != this && placement->mResolved && placement->mMap == mMap)
+            return placement;
+    }
+    return nullptr;
+}
+
+Internal::BmpBlender *MapComposite::acquireSharedLot()
+{
+    MapComposite *root = this->root();
+    SharedLot &shared = root->mSharedLots[mMapInfo];
+    if (!shared.blender) {
+        // Owned by the root so moveToThread() on the root moves it too.
+        shared.blender = new Internal::BmpBlender(mMap, root);
+        shared.blender->markDirty(0, 0, mMap->width() - 1, mMap->height() - 1);
+        shared.map = mMap;
+    }
+    shared.placements += this;
+    return shared.blender;
+}
+
+void MapComposite::releaseSharedLot()
+{
+    MapComposite *root = this->root();
+    QHash<MapInfo*,SharedLot>::iterator it = root->mSharedLots.find(mMapInfo);
+    if (it == root->mSharedLots.end())
+        return;
+    it->placements.removeOne(this);
+    if (it->placements.isEmpty()) {
+        delete it->blender;
+        root->mSharedLots.erase(it);
+    }
+}
+
+QList<MapComposite *> MapComposite::sharedLotPlacements()
+{
+    if (!mIsSharedLot)
+        return QList<MapComposite*>();
+    return root()->mSharedLots.value(mMapInfo).placements;
+}
+
 void MapComposite::bmpBlenderLayersRecreated()
 {
     mLayerGroups[0]->setBmpBlendLayers(mBmpBlender->tileLayers());
@@ -26,6 +26,7 @@
 #include "ztilelayergroup.h"
 
 #include <QObject>
+#include <QHash>
 #include <QMap>
 #include <QString>
 #include <QStringList>
@@ -47,6 +48,16 @@ class CompositeLayerGroup : public Tiled::ZTileLayerGroup
 public:
     CompositeLayerGroup(MapComposite *owner, int level);
 
+    /**
+     * Makes a layer group for another placement of the same lot.  Everything
+     * that only depends on the map, like the layers, which of them are empty
+     * and the blend layers, is shared with \a resolved (Qt's containers copy
+     * on write, and a placement never changes these).  Only the visibility
+     * and opacity of the layers become this placement's own, once synch()
+     * sets them.
+     */
+    CompositeLayerGroup(MapComposite *owner, const CompositeLayerGroup &resolved);
+
     void addTileLayer(Tiled::TileLayer *layer, int index);
     void removeTileLayer(Tiled::TileLayer *layer);
 
@@ -134,7 +145,8 @@ private:
     QVector<bool> mEmptyLayers;
     QVector<qreal> mLayerOpacity;
     int mMaxFloorLayer;
-    QMap<QString,QVector<Tiled::Layer*> > mLayersByName;
+    // Layers by LayerClassification::baseNameId().
+    QHash<int,QVector<Tiled::Layer*> > mLayersByName;
     QVector<bool> mSavedVisibleLayers;
     QVector<qreal> mSavedOpacity;
 
@@ -254,6 +266,16 @@ public:
 
     QRectF boundingRect(Tiled::MapRenderer *renderer, bool forceMapBounds = true) const;
 
+    /**
+      * Tile area (relative to this map) that is always included in
+      * boundingRect() when forceMapBounds is true.  Used to keep the scene
+      * bounds stable while adjacent maps are streamed in and out.
+      */
+    void setReservedTileBounds(const QRect &bounds)
+    { mReservedTileBounds = bounds; }
+    QRect reservedTileBounds() const
+    { return mReservedTileBounds; }
+
     /**
       * Used when generating map images.
       */
@@ -290,6 +312,12 @@ public:
     Tiled::Internal::BmpBlender *bmpBlender() const
     { return mBmpBlender; }
 
+    /**
+     * Returns every placement sharing this lot's BmpBlender, including this
+     * one, or an empty list if this map has a BmpBlender of its own.
+     */
+    QList<MapComposite*> sharedLotPlacements();
+
     void setShowBMPTiles(bool show)
     { mShowBMPTiles = show; }
     bool showBMPTiles() const
@@ -306,7 +334,10 @@ public:
     { return mShowMapTiles; }
 
     void setNoBlendLayer(const QString &layerName)
-    { mNoBlendLayer = layerName; }
+    {
+        mNoBlendLayer = layerName;
+        mNoBlendLayerId = Tiled::LayerClassification::idForName(layerName);
+    }
     QString noBlendLayer() const
     { return mNoBlendLayer; }
 
@@ -348,8 +379,13 @@ private:
     void addLayerToGroup(int index);
     void removeLayerFromGroup(int index);
 
+    void createLayerGroups();
     void recreate();
 
+    MapComposite *resolvedPlacement();
+    Tiled::Internal::BmpBlender *acquireSharedLot();
+    void releaseSharedLot();
+
 private:
     MapInfo *mMapInfo;
     Tiled::Map *mMap;
@@ -381,6 +417,21 @@ private:
     bool mIsAdjacentMap;
 
     Tiled::Internal::BmpBlender *mBmpBlender;
+    // True for a lot that isn't being edited, see SharedLot.
+    bool mIsSharedLot;
+    // False until the layer groups have been created from the current map.
+    bool mResolved;
+
+    // Lots placed many times are only resolved once per MapInfo.  The
+    // placements share one BmpBlender, and all but the first copy their
+    // layer groups from one that is already resolved.  Only the root
+    // MapComposite uses this.
+    struct SharedLot {
+        Tiled::Internal::BmpBlender *blender = nullptr;
+        Tiled::Map *map = nullptr;
+        QList<MapComposite*> placements;
+    };
+    QHash<MapInfo*,SharedLot> mSharedLots;
 
     QVector<MapComposite*> mAdjacentMaps;
 
@@ -397,6 +448,8 @@ private:
     QRegion mSuppressRgn;
     int mSuppressLevel;
 
+    QRect mReservedTileBounds;
+
 #if 1 // ROAD_CRUD
     Tiled::TileLayer *mRoadLayer1;
     Tiled::TileLayer *mRoadLayer0;
@@ -408,6 +461,7 @@ public:
     int mKeepFloorLayerCount;
 
     QString mNoBlendLayer;
+    int mNoBlendLayerId;
 };
 
 #endif // MAPCOMPOSITE_H
@@ -60,6 +60,7 @@
 
 #include <QFileInfo>
 #include <QRect>
+#include <QSet>
 #include <QUndoStack>
 #ifdef ZOMBOID
 #include <QDir>
@@ -68,6 +69,22 @@
 using namespace Tiled;
 using namespace Tiled::Internal;
 
+#ifdef ZOMBOID
+// Adjacent cells and lots closer than this many tiles to the visible area are
+// loaded and kept in memory.  Anything farther away may be released when the
+// memory budget is exceeded.
+static const int STREAMING_MARGIN = 60;
+
+static MapManager::LoadPriority streamingPriority(int distance)
+{
+    if (distance == 0)
+        return MapManager::PriorityHigh;
+    if (distance <= STREAMING_MARGIN / 2)
+        return MapManager::PriorityMedium;
+    return MapManager::PriorityLow;
+}
+#endif
+
 MapDocument::MapDocument(Map *map, const QString &fileName):
     mFileName(fileName),
     mMap(map),
@@ -82,6 +99,8 @@ MapDocument::MapDocument(Map *map, const QString &fileName):
 {
 #ifdef ZOMBOID
     mMapComposite = new MapComposite(MapManager::instance()->newFromMap(map, fileName));
+    // Changing Rules.txt or Blends.txt rebuilds the whole map.
+    mMapComposite->bmpBlender()->setAsyncRecreate(true);
     connect(mMapComposite->bmpBlender(), &BmpBlender::regionAltered,
             this, &MapDocument::bmpBlenderRegionAltered);
     connect(this, &MapDocument::layerAdded,
@@ -100,8 +119,16 @@ MapDocument::MapDocument(Map *map, const QString &fileName):
                 this, &MapDocument::mapLoaded);
         connect(MapManager::instance(), &MapManager::mapFailedToLoad,
                 this, &MapDocument::mapFailedToLoad);
+        connect(WorldEd::WorldEdMgr::instance(), &WorldEd::WorldEdMgr::beforeWorldChanged,
+                this, &MapDocument::beforeWorldChanged);
         connect(WorldEd::WorldEdMgr::instance(), &WorldEd::WorldEdMgr::afterWorldChanged,
                 this, &MapDocument::initAdjacentMaps);
+        connect(WorldEd::WorldEdMgr::instance(), &WorldEd::WorldEdMgr::beforeCellChanged,
+                this, &MapDocument::beforeCellChanged);
+        connect(WorldEd::WorldEdMgr::instance(), &WorldEd::WorldEdMgr::afterCellChanged,
+                this, &MapDocument::afterCellChanged);
+        connect(Preferences::instance(), &Preferences::adjacentMapsMemoryBudgetChanged,
+                this, &MapDocument::streamAdjacentMaps);
         initAdjacentMaps();
     }
 #endif
@@ -935,24 +962,15 @@ void MapDocument::onMapChanged(MapInfo *mapInfo)
 
     // If an adjacent map was just reloaded, all the WorldEd lots in it will
     // have been deleted.
-    for (int y = -1; y <= 1; y++) {
-        for (int x = -1; x <= 1; x++) {
-            if (x == 0 && y == 0) continue;
-            if (MapComposite *adjacentMap = mMapComposite->adjacentMap(x, y)) {
-                if (adjacentMap->mapInfo() == mapInfo) {
-                    int cx = mWorldCell->x(), cy = mWorldCell->y();
-                    if (WorldCell *cell = mWorldCell->world()->cellAt(cx + x, cy + y)) {
-                        foreach (WorldCellLot *lot, cell->lots()) {
-                            MapInfo *subMapInfo = MapManager::instance()->loadMap(
-                                        lot->mapName(), QString(), true, MapManager::PriorityLow);
-                            if (subMapInfo) {
-                                if (subMapInfo->isLoading())
-                                    mAdjacentSubMapsLoading.insert(subMapInfo, LoadingSubMap(lot, subMapInfo));
-                                else
-                                    adjacentMap->addMap(subMapInfo, lot->pos(), lot->level());
-                            }
-                        }
-                    }
+    if (mWorldCell) {
+        for (int y = -1; y <= 1; y++) {
+            for (int x = -1; x <= 1; x++) {
+                if (x == 0 && y == 0) continue;
+                MapComposite *adjacentMap = mMapComposite->adjacentMap(x, y);
+                if (adjacentMap && adjacentMap->mapInfo() == mapInfo) {
+                    forgetAdjacentLots(mAdjacentCells[(x + 1) + (y + 1) * 3]);
+                    if (streamAdjacentLots(x, y))
+                        changed = true;
                 }
             }
         }
@@ -1008,32 +1026,37 @@ void MapDocument::handleMapsLoadedNow()
         MapInfo *info = mMapsLoaded.takeFirst();
 
         foreach (const AdjacentMap &am, mAdjacentMapsLoading.values(info)) {
+            MapComposite *adjacentMap = mMapComposite->adjacentMap(am.pos.x(), am.pos.y());
+            if (adjacentMap && adjacentMap->mapInfo() == am.info)
+                continue;
+            // The view may have moved away while the map was loading.
+            if (distanceFromView(adjacentCellBounds(am.pos.x(), am.pos.y())) > STREAMING_MARGIN)
+                continue;
+            forgetAdjacentLots(mAdjacentCells[(am.pos.x() + 1) + (am.pos.y() + 1) * 3]);
             mMapComposite->setAdjacentMap(am.pos.x(), am.pos.y(), am.info);
-
-            MapComposite *adjacentMap = mMapComposite->adjacentMap(am.pos.x(),
-                                                                   am.pos.y());
-            WorldCell *cell2 = cell->world()->cellAt(am.pos + cell->pos());
-            foreach (WorldCellLot *lot, cell2->lots()) {
-                MapInfo *subMapInfo = MapManager::instance()->loadMap(
-                            lot->mapName(), QString(), true, MapManager::PriorityLow);
-                if (subMapInfo && !subMapInfo->isLoading() && !mAdjacentSubMapsLoading.contains(subMapInfo))
-                    adjacentMap->addMap(subMapInfo, lot->pos(), lot->level());
-            }
-
+            streamAdjacentLots(am.pos.x(), am.pos.y());
             changed = true;
         }
         mAdjacentMapsLoading.remove(info);
 
         foreach (const LoadingSubMap &sm, mAdjacentSubMapsLoading.values(info)) {
-            int x = sm.lot->cell()->x(), y = sm.lot->cell()->y();
-            if (MapComposite *adjacentMap = mMapComposite->adjacentMap(x - cell->x(),
-                                                                       y - cell->y()))
-                adjacentMap->addMap(info, sm.lot->pos(), sm.lot->level());
+            if (mAdjacentLots.contains(sm.lot))
+                continue;
+            int x = sm.lot->cell()->x() - cell->x(), y = sm.lot->cell()->y() - cell->y();
+            MapComposite *adjacentMap = mMapComposite->adjacentMap(x, y);
+            if (!adjacentMap)
+                continue;
+            if (distanceFromView(sm.lot->bounds().translated(adjacentMap->origin())) > STREAMING_MARGIN)
+                continue;
+            mAdjacentLots[sm.lot] = adjacentMap->addMap(info, sm.lot->pos(), sm.lot->level());
             changed = true;
         }
         mAdjacentSubMapsLoading.remove(info);
     }
 
+    if (evictAdjacentMaps())
+        changed = true;
+
     // This lets ZomboidScene update itself (syncing and repainting).
     if (changed)
         emit mapCompositeChanged(); ///////
@@ -1046,6 +1069,11 @@ void MapDocument::beforeWorldChanged(const QString &fileName)
 {
     Q_UNUSED(fileName);
     mWorldCell = 0;
+
+    // The cells and lots are about to be deleted.
+    mAdjacentCells.clear();
+    mAdjacentLots.clear();
+    mAdjacentSubMapsLoading.clear();
 }
 
 void MapDocument::afterWorldChanged(const QString &fileName)
@@ -1054,6 +1082,22 @@ void MapDocument::afterWorldChanged(const QString &fileName)
     mWorldCell = WorldEd::WorldEdMgr::instance()->cellForMap(mFileName);
 }
 
+// Changes to cells that aren't this map's cell or next to it are ignored.
+void MapDocument::beforeCellChanged(WorldCell *cell)
+{
+    if (cell == mWorldCell || mAdjacentCells.contains(cell))
+        beforeWorldChanged(QString());
+}
+
+void MapDocument::afterCellChanged(WorldCell *cell)
+{
+    Q_UNUSED(cell);
+    // The cell may also have been given this map, or lost it.
+    if (mAdjacentCells.isEmpty() ||
+            WorldEd::WorldEdMgr::instance()->cellForMap(mFileName) != mWorldCell)
+        initAdjacentMaps();
+}
+
 #endif // ZOMBOID
 
 void MapDocument::deselectObjects(const QList<MapObject *> &objects)
@@ -1069,7 +1113,11 @@ void MapDocument::deselectObjects(const QList<MapObject *> &objects)
 #ifdef ZOMBOID
 void MapDocument::initAdjacentMaps()
 {
-    QVector<MapInfo*> adjacentMaps(9);
+    mWorldCell = 0;
+    mAdjacentCells.fill(0, 9);
+    mAdjacentLots.clear();
+    mAdjacentMapsLoading.clear();
+    mAdjacentSubMapsLoading.clear();
 
     if (WorldCell *cell = WorldEd::WorldEdMgr::instance()->cellForMap(mFileName)) {
         mWorldCell = cell;
@@ -1081,46 +1129,243 @@ void MapDocument::initAdjacentMaps()
                 if (x == 0 && y == 0) continue;
                 if (WorldCell *cell2 = cell->world()->cellAt(cx + x, cy + y)) {
                     if (cell2->mapFilePath().isEmpty()) continue;
-                    QFileInfo info(cell2->mapFilePath());
-                    if (info.exists()) {
-                        MapInfo *mapInfo = MapManager::instance()->loadMap(
-                                    info.absoluteFilePath(), QString(), true,
-                                    MapManager::PriorityMedium);
-                        if (mapInfo) {
-                            if (mapInfo->isLoading())
-                                mAdjacentMapsLoading.insert(mapInfo, AdjacentMap(x, y, mapInfo));
-                            else
-                                mMapComposite->setAdjacentMap(x, y, mapInfo);
-
-                            MapComposite *adjacentMap = mMapComposite->adjacentMap(x, y);
-                            foreach (WorldCellLot *lot, cell2->lots()) {
-                                MapInfo *subMapInfo = MapManager::instance()->loadMap(
-                                            lot->mapName(), QString(), true, MapManager::PriorityLow);
-                                if (subMapInfo) {
-                                    if (subMapInfo->isLoading())
-                                        mAdjacentSubMapsLoading.insert(subMapInfo, LoadingSubMap(lot, subMapInfo));
-                                    else if (adjacentMap)
-                                        adjacentMap->addMap(subMapInfo, lot->pos(), lot->level());
-                                }
-                            }
-                            adjacentMaps[(x + 1) + (y + 1) * 3] = mapInfo;
-                        }
-                    }
+                    if (QFileInfo(cell2->mapFilePath()).exists())
+                        mAdjacentCells[(x + 1) + (y + 1) * 3] = cell2;
                 }
             }
         }
     }
 
+    // Lots in adjacent maps are recreated by streamAdjacentMaps() so they
+    // can be tracked in mAdjacentLots.
+    QRect reserved(QPoint(0, 0), mMap->size());
     for (int y = -1; y <= 1; y++) {
         for (int x = -1; x <= 1; x++) {
             if (x == 0 && y == 0) continue;
-            if (MapComposite *mc = mMapComposite->adjacentMap(x, y)) {
-                int index = (x + 1) + (y + 1) * 3;
-                if (mc->mapInfo() != adjacentMaps[index])
-                    mMapComposite->setAdjacentMap(x, y, 0);
+            WorldCell *cell2 = mAdjacentCells[(x + 1) + (y + 1) * 3];
+            if (mMapComposite->adjacentMap(x, y))
+                mMapComposite->setAdjacentMap(x, y, 0);
+            if (cell2)
+                reserved |= adjacentCellBounds(x, y);
+        }
+    }
+
+    // Reserve room in the scene for every adjacent cell, so the scene doesn't
+    // resize as adjacent maps are loaded and evicted.
+    mMapComposite->setReservedTileBounds(mWorldCell ? reserved : QRect());
+
+    streamAdjacentMaps();
+}
+
+void MapDocument::setVisibleTileRect(const QRect &tileRect)
+{
+    if (tileRect == mVisibleTileRect)
+        return;
+    mVisibleTileRect = tileRect;
+    streamAdjacentMaps();
+}
+
+void MapDocument::streamAdjacentMaps()
+{
+    if (!mWorldCell || mAdjacentCells.isEmpty())
+        return;
+
+    bool changed = false;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            if (x == 0 && y == 0) continue;
+            WorldCell *cell2 = mAdjacentCells[(x + 1) + (y + 1) * 3];
+            if (!cell2) continue;
+            if (!mMapComposite->adjacentMap(x, y)) {
+                int distance = distanceFromView(adjacentCellBounds(x, y));
+                if (distance > STREAMING_MARGIN) continue;
+                // If the map is already loading, this raises its priority.
+                MapInfo *mapInfo = MapManager::instance()->loadMap(
+                            QFileInfo(cell2->mapFilePath()).absoluteFilePath(),
+                            QString(), true, streamingPriority(distance));
+                if (!mapInfo) continue;
+                if (mapInfo->isLoading()) {
+                    bool queued = false;
+                    foreach (const AdjacentMap &am, mAdjacentMapsLoading.values(mapInfo))
+                        queued |= (am.pos == QPoint(x, y));
+                    if (!queued)
+                        mAdjacentMapsLoading.insert(mapInfo, AdjacentMap(x, y, mapInfo));
+                    continue;
+                }
+                mMapComposite->setAdjacentMap(x, y, mapInfo);
+                changed = true;
             }
+            if (streamAdjacentLots(x, y))
+                changed = true;
         }
     }
+
+    if (evictAdjacentMaps())
+        changed = true;
+
+    if (changed)
+        emit mapCompositeChanged();
+}
+
+bool MapDocument::streamAdjacentLots(int x, int y)
+{
+    MapComposite *adjacentMap = mMapComposite->adjacentMap(x, y);
+    WorldCell *cell2 = mAdjacentCells.isEmpty() ? 0 : mAdjacentCells[(x + 1) + (y + 1) * 3];
+    if (!adjacentMap || !cell2)
+        return false;
+
+    bool changed = false;
+    foreach (WorldCellLot *lot, cell2->lots()) {
+        if (mAdjacentLots.contains(lot))
+            continue;
+        int distance = distanceFromView(lot->bounds().translated(adjacentMap->origin()));
+        if (distance > STREAMING_MARGIN)
+            continue;
+        MapInfo *subMapInfo = MapManager::instance()->loadMap(
+                    lot->mapName(), QString(), true, streamingPriority(distance));
+        if (!subMapInfo)
+            continue;
+        if (subMapInfo->isLoading()) {
+            bool queued = false;
+            foreach (const LoadingSubMap &sm, mAdjacentSubMapsLoading.values(subMapInfo))
+                queued |= (sm.lot == lot);
+            if (!queued)
+                mAdjacentSubMapsLoading.insert(subMapInfo, LoadingSubMap(lot, subMapInfo));
+            continue;
+        }
+        mAdjacentLots[lot] = adjacentMap->addMap(subMapInfo, lot->pos(), lot->level());
+        changed = true;
+    }
+    return changed;
+}
+
+// Estimates the memory freed by removing the given maps and their lots.
+// MapManager keeps every Map it loaded, so only the tiles blended from the
+// BMPs are freed.  A BmpBlender shared by several placements of a lot is
+// freed with the last of them, so it is counted once and only if all of its
+// placements are removed.
+static qint64 estimateMemoryFreed(const QList<MapComposite*> &removed)
+{
+    QSet<MapComposite*> maps;
+    foreach (MapComposite *mapComposite, removed) {
+        foreach (MapComposite *mc, mapComposite->maps())
+            maps += mc;
+    }
+
+    QSet<BmpBlender*> blenders;
+    qint64 bytes = 0;
+    foreach (MapComposite *mc, maps) {
+        BmpBlender *blender = mc->bmpBlender();
+        if (!blender || blenders.contains(blender))
+            continue;
+        blenders += blender;
+        bool freed = true;
+        foreach (MapComposite *placement, mc->sharedLotPlacements())
+            freed &= maps.contains(placement);
+        if (!freed)
+            continue;
+        foreach (TileLayer *tl, blender->tileLayers())
+            bytes += tl->memoryUsage();
+    }
+    return bytes;
+}
+
+// Releases the adjacent cells and lots farthest from the view until the
+// estimated memory that releasing them would free fits in the budget.  Anything within
+// STREAMING_MARGIN of the view is never released.
+bool MapDocument::evictAdjacentMaps()
+{
+    if (!mWorldCell || mVisibleTileRect.isNull())
+        return false;
+
+    qint64 budget = qint64(Preferences::instance()->adjacentMapsMemoryBudget()) * 1024 * 1024;
+    QList<MapComposite*> adjacentMaps;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            if (x == 0 && y == 0) continue;
+            if (MapComposite *adjacentMap = mMapComposite->adjacentMap(x, y))
+                adjacentMaps += adjacentMap;
+        }
+    }
+    qint64 used = estimateMemoryFreed(adjacentMaps);
+
+    bool changed = false;
+    while (used > budget) {
+        int farthest = STREAMING_MARGIN;
+        QPoint farthestCell(0, 0);
+        WorldCellLot *farthestLot = 0;
+        for (int y = -1; y <= 1; y++) {
+            for (int x = -1; x <= 1; x++) {
+                if (x == 0 && y == 0) continue;
+                MapComposite *adjacentMap = mMapComposite->adjacentMap(x, y);
+                if (!adjacentMap) continue;
+                int distance = distanceFromView(adjacentCellBounds(x, y));
+                if (distance > farthest) {
+                    farthest = distance;
+                    farthestCell = QPoint(x, y);
+                    farthestLot = 0;
+                }
+            }
+        }
+        QMap<WorldCellLot*,MapComposite*>::const_iterator it = mAdjacentLots.constBegin();
+        for (; it != mAdjacentLots.constEnd(); ++it) {
+            MapComposite *lotMap = it.value();
+            int distance = distanceFromView(it.key()->bounds().translated(lotMap->parent()->origin()));
+            if (distance > farthest) {
+                farthest = distance;
+                farthestLot = it.key();
+            }
+        }
+
+        if (farthestLot) {
+            MapComposite *lotMap = mAdjacentLots.take(farthestLot);
+            used -= estimateMemoryFreed(QList<MapComposite*>() << lotMap);
+            lotMap->parent()->removeMap(lotMap);
+        } else if (farthestCell != QPoint(0, 0)) {
+            int x = farthestCell.x(), y = farthestCell.y();
+            used -= estimateMemoryFreed(QList<MapComposite*>() << mMapComposite->adjacentMap(x, y));
+            forgetAdjacentLots(mAdjacentCells[(x + 1) + (y + 1) * 3]);
+            mMapComposite->setAdjacentMap(x, y, 0);
+        } else
+            break;
+        changed = true;
+    }
+
+    return changed;
+}
+
+void MapDocument::forgetAdjacentLots(WorldCell *cell)
+{
+    if (!cell)
+        return;
+    foreach (WorldCellLot *lot, cell->lots())
+        mAdjacentLots.remove(lot);
+}
+
+// Returns the tile bounds of an adjacent cell relative to this map.  Cells
+// that haven't been loaded yet are assumed to be the standard cell size.
+QRect MapDocument::adjacentCellBounds(int x, int y)
+{
+    if (MapComposite *adjacentMap = mMapComposite->adjacentMap(x, y))
+        return QRect(adjacentMap->origin(), adjacentMap->map()->size());
+    const int cellSize = 300;
+    return QRect(x < 0 ? -cellSize : (x > 0 ? mMap->width() : 0),
+                 y < 0 ? -cellSize : (y > 0 ? mMap->height() : 0),
+                 x ? cellSize : mMap->width(),
+                 y ? cellSize : mMap->height());
+}
+
+// Returns the distance in tiles between the visible area and the given tile
+// bounds, or zero if they overlap.  If the view hasn't reported its visible
+// area yet, everything is considered visible.
+int MapDocument::distanceFromView(const QRect &tileBounds) const
+{
+    if (mVisibleTileRect.isNull())
+        return 0;
+    const QRect &r = mVisibleTileRect;
+    int dx = qMax(0, qMax(tileBounds.left() - r.right(), r.left() - tileBounds.right()));
+    int dy = qMax(0, qMax(tileBounds.top() - r.bottom(), r.top() - tileBounds.bottom()));
+    return qMax(dx, dy);
 }
 #endif // ZOMBOID
 
@@ -123,6 +123,14 @@ public:
 
 #ifdef ZOMBOID
     MapComposite *mapComposite() const { return mMapComposite; }
+
+    /**
+     * Tells the document which tiles (level 0, relative to this map) are
+     * currently visible in the view.  Adjacent cells and their lots are
+     * loaded, prioritized and released based on their distance from this
+     * area.
+     */
+    void setVisibleTileRect(const QRect &tileRect);
 #endif
 
     /**
@@ -432,12 +440,22 @@ private slots:
 
     void beforeWorldChanged(const QString &fileName);
     void afterWorldChanged(const QString &fileName);
+    void beforeCellChanged(WorldCell *cell);
+    void afterCellChanged(WorldCell *cell);
 
     void initAdjacentMaps();
 #endif
 
 private:
     void deselectObjects(const QList<MapObject*> &objects);
+#ifdef ZOMBOID
+    void streamAdjacentMaps();
+    bool streamAdjacentLots(int x, int y);
+    bool evictAdjacentMaps();
+    void forgetAdjacentLots(WorldCell *cell);
+    QRect adjacentCellBounds(int x, int y);
+    int distanceFromView(const QRect &tileBounds) const;
+#endif
 
     QString mFileName;
     Map *mMap;
@@ -477,6 +495,10 @@ private:
     QMultiMap<MapInfo*,LoadingSubMap> mAdjacentSubMapsLoading;
 
     QList<MapInfo*> mMapsLoaded;
+
+    QVector<WorldCell*> mAdjacentCells;
+    QMap<WorldCellLot*,MapComposite*> mAdjacentLots;
+    QRect mVisibleTileRect;
 #endif // ZOMBOID
     QUndoStack *mUndoStack;
 };
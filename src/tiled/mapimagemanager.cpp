@@ -18,6 +18,7 @@
 #include "mapimagemanager.h"
 
 #include "bmpblender.h"
+#include "imagekernels.h"
 #include "imagelayer.h"
 #include "isometricrenderer.h"
 #include "mainwindow.h"
@@ -30,6 +31,7 @@
 #include "staggeredrenderer.h"
 #include "tilelayer.h"
 #include "tilesetmanager.h"
+#include "tracing.h"
 #include "zprogress.h"
 #include "zlevelrenderer.h"
 
@@ -41,6 +43,7 @@
 #include <QImageReader>
 #include <QMessageBox>
 #include <QPainterPath>
+#include <QThread>
 
 #ifdef QT_NO_DEBUG
 inline QNoDebug noise() { return QNoDebug(); }
@@ -57,8 +60,7 @@ MapImageManager *MapImageManager::mInstance = NULL;
 
 MapImageManager::MapImageManager() :
     QObject(),
-    mExpectMapImage(0),
-    mRenderMapComposite(0),
+    mNextRenderThreadForJob(0),
     mDeferralDepth(0),
     mDeferralQueued(false)
 {
@@ -74,20 +76,25 @@ MapImageManager::MapImageManager() :
         mImageReaderThreads[i]->start();
     }
 
-    mImageRenderThread = new InterruptibleThread;
-    mImageRenderWorker = new MapImageRenderWorker(mImageRenderThread);
-    mImageRenderWorker->moveToThread(mImageRenderThread);
-    connect(mImageRenderWorker, &MapImageRenderWorker::mapNeeded,
-            this, &MapImageManager::renderThreadNeedsMap);
     qRegisterMetaType<MapImageData>("MapImageData");
     qRegisterMetaType<MapImage*>("MapImage*");
     qRegisterMetaType<MapComposite*>("MapComposite*");
-    connect(mImageRenderWorker,
-            &MapImageRenderWorker::imageRendered,
-            this, &MapImageManager::imageRenderedByThread);
-    connect(mImageRenderWorker, &MapImageRenderWorker::jobDone,
-            this, &MapImageManager::renderJobDone);
-    mImageRenderThread->start();
+
+    // Leave one core for the GUI thread and MapManager's readers.
+    mRenderThreads.resize(qBound(1, QThread::idealThreadCount() - 1, 8));
+    for (int i = 0; i < mRenderThreads.size(); i++) {
+        RenderThread &rt = mRenderThreads[i];
+        rt.thread = new InterruptibleThread;
+        rt.worker = new MapImageRenderWorker(rt.thread);
+        rt.worker->moveToThread(rt.thread);
+        connect(rt.worker, &MapImageRenderWorker::mapNeeded,
+                this, &MapImageManager::renderThreadNeedsMap);
+        connect(rt.worker, &MapImageRenderWorker::imageRendered,
+                this, &MapImageManager::imageRenderedByThread);
+        connect(rt.worker, &MapImageRenderWorker::jobDone,
+                this, &MapImageManager::renderJobDone);
+        rt.thread->start();
+    }
 
     connect(MapManager::instance(), &MapManager::mapAboutToChange,
             this, &MapImageManager::mapAboutToChange);
@@ -111,11 +118,14 @@ MapImageManager::~MapImageManager()
         delete mImageReaderThreads[i];
     }
 
-    mImageRenderThread->interrupt();
-    mImageRenderThread->quit();
-    mImageRenderThread->wait();
-    delete mImageRenderWorker;
-    delete mImageRenderThread;
+    for (int i = 0; i < mRenderThreads.size(); i++) {
+        RenderThread &rt = mRenderThreads[i];
+        rt.thread->interrupt();
+        rt.thread->quit();
+        rt.thread->wait();
+        delete rt.worker;
+        delete rt.thread;
+    }
 }
 
 MapImageManager *MapImageManager::instance()
@@ -190,11 +200,8 @@ MapImage *MapImageManager::getMapImage(const QString &mapName, const QString &re
                                       Q_ARG(MapImage*,mapImage));
             mNextThreadForJob = (mNextThreadForJob + 1) % mImageReaderWorkers.size();
         }
-        if (data.threadRender) {
-            QMetaObject::invokeMethod(mImageRenderWorker,
-                                      "addJob", Qt::QueuedConnection,
-                                      Q_ARG(MapImage*,mapImage));
-        }
+        if (data.threadRender)
+            addRenderJob(mapImage);
     }
 
     // Set up file modification tracking on each TMX that makes
@@ -481,34 +488,40 @@ void MapImageManager::writeImageData(const QFileInfo &imageDataFileInfo, const M
 
 void MapImageManager::mapAboutToChange(MapInfo *mapInfo)
 {
-    if (!mRenderMapComposite)
-        return;
-    // Caution: mRenderMapComposite is being used right now by the render thread.
-    foreach (MapComposite *mc, mRenderMapComposite->maps()) {
-        if (mc->mapInfo() == mapInfo) {
-            mImageRenderThread->interrupt(true);
-            MapImage *mapImage = mMapImages[mRenderMapComposite->mapInfo()->path()];
-            Q_ASSERT(mapImage);
-            mapImage->mLoaded = false;
-            break;
+    for (int i = 0; i < mRenderThreads.size(); i++) {
+        RenderThread &rt = mRenderThreads[i];
+        if (!rt.mapComposite)
+            continue;
+        // Caution: rt.mapComposite is being used right now by the render thread.
+        foreach (MapComposite *mc, rt.mapComposite->maps()) {
+            if (mc->mapInfo() == mapInfo) {
+                rt.thread->interrupt(true);
+                MapImage *mapImage = mMapImages[rt.mapComposite->mapInfo()->path()];
+                Q_ASSERT(mapImage);
+                mapImage->mLoaded = false;
+                break;
+            }
         }
     }
 }
 
 void MapImageManager::mapChanged(MapInfo *mapInfo)
 {
-    if (!mRenderMapComposite)
-        return;
-    // Caution: mRenderMapComposite is being used right now by the render thread.
-    foreach (MapComposite *mc, mRenderMapComposite->maps()) {
-        if (mc->mapInfo() == mapInfo) {
-            MapImage *mapImage = mMapImages[mRenderMapComposite->mapInfo()->path()];
-            Q_ASSERT(mapImage);
-            mImageRenderThread->resume();
-            QMetaObject::invokeMethod(mImageRenderWorker,
-                                      "resume", Qt::QueuedConnection,
-                                      Q_ARG(MapImage*,mapImage));
-            break;
+    for (int i = 0; i < mRenderThreads.size(); i++) {
+        RenderThread &rt = mRenderThreads[i];
+        if (!rt.mapComposite)
+            continue;
+        // Caution: rt.mapComposite is being used right now by the render thread.
+        foreach (MapComposite *mc, rt.mapComposite->maps()) {
+            if (mc->mapInfo() == mapInfo) {
+                MapImage *mapImage = mMapImages[rt.mapComposite->mapInfo()->path()];
+                Q_ASSERT(mapImage);
+                rt.thread->resume();
+                QMetaObject::invokeMethod(rt.worker,
+                                          "resume", Qt::QueuedConnection,
+                                          Q_ARG(MapImage*,mapImage));
+                break;
+            }
         }
     }
 }
@@ -534,9 +547,7 @@ void MapImageManager::mapFileChanged(MapInfo *mapInfo)
                 mapImage->mSources.clear();
                 mapImage->mSources += mapImage->mapInfo();
                 mapImage->mLoaded = false;
-                QMetaObject::invokeMethod(mImageRenderWorker,
-                                          "addJob", Qt::QueuedConnection,
-                                          Q_ARG(MapImage*,mapImage));
+                addRenderJob(mapImage);
                 emit mapImageChanged(mapImage);
             }
         }
@@ -555,28 +566,50 @@ void MapImageManager::imageLoadedByThread(QImage *image, MapImage *mapImage)
         emit mapImageChanged(mapImage);
 }
 
+MapImageManager::RenderThread *MapImageManager::renderThreadFor(QObject *worker)
+{
+    for (int i = 0; i < mRenderThreads.size(); i++) {
+        if (mRenderThreads[i].worker == worker)
+            return &mRenderThreads[i];
+    }
+    return 0;
+}
+
+void MapImageManager::addRenderJob(MapImage *mapImage)
+{
+    QMetaObject::invokeMethod(mRenderThreads[mNextRenderThreadForJob].worker,
+                              "addJob", Qt::QueuedConnection,
+                              Q_ARG(MapImage*,mapImage));
+    mNextRenderThreadForJob = (mNextRenderThreadForJob + 1) % mRenderThreads.size();
+}
+
 void MapImageManager::renderThreadNeedsMap(MapImage *mapImage)
 {
+    RenderThread *rt = renderThreadFor(sender());
+    Q_ASSERT(rt);
+    if (!rt)
+        return;
+
     bool asynch = true;
-    Q_ASSERT(mExpectMapImage == 0);
+    Q_ASSERT(rt->expectMapImage == 0);
     MapInfo *mapInfo = MapManager::instance()->loadMap(mapImage->mapInfo()->path(),
                                                        QString(), asynch,
                                                        MapManager::PriorityLow);
     if (!mapInfo) {
         // The map file went away since MapImage's MapInfo was created.
-        QMetaObject::invokeMethod(mImageRenderWorker,
+        QMetaObject::invokeMethod(rt->worker,
                                   "mapFailedToLoad", Qt::QueuedConnection);
         emit mapImageFailedToLoad(mapImage);
         return;
     }
-    mExpectMapImage = mapImage;
-    mExpectSubMaps.clear();
+    rt->expectMapImage = mapImage;
+    rt->expectSubMaps.clear();
 #ifdef WORLDED
-    mReferencedMaps.clear();
+    rt->referencedMaps.clear();
 #endif
     Q_ASSERT(mapInfo == mapImage->mapInfo());
     if (!mapInfo->isLoading())
-        mapLoaded(mapInfo);
+        renderThreadMapLoaded(*rt, mapInfo);
 }
 
 void MapImageManager::imageRenderedByThread(MapImageData imgData, MapImage *mapImage)
@@ -615,8 +648,10 @@ void MapImageManager::imageRenderedByThread(MapImageData imgData, MapImage *mapI
 
 void MapImageManager::renderJobDone(MapComposite *mapComposite)
 {
-    Q_ASSERT(mapComposite == mRenderMapComposite);
-    mRenderMapComposite = 0;
+    RenderThread *rt = renderThreadFor(sender());
+    Q_ASSERT(rt && (mapComposite == rt->mapComposite));
+    if (rt)
+        rt->mapComposite = 0;
     delete mapComposite;
 }
 
@@ -639,72 +674,78 @@ QStringList getSubMapFileNames(const MapInfo *mapInfo)
 
 void MapImageManager::mapLoaded(MapInfo *mapInfo)
 {
-    if (!mExpectMapImage)
+    for (int i = 0; i < mRenderThreads.size(); i++)
+        renderThreadMapLoaded(mRenderThreads[i], mapInfo);
+}
+
+void MapImageManager::renderThreadMapLoaded(RenderThread &rt, MapInfo *mapInfo)
+{
+    if (!rt.expectMapImage)
         return;
 
-    if (mExpectMapImage->mapInfo() == mapInfo) {
+    if (rt.expectMapImage->mapInfo() == mapInfo) {
 #ifdef WORLDED
-        MapManager::instance()->addReferenceToMap(mapInfo), mReferencedMaps += mapInfo;
+        MapManager::instance()->addReferenceToMap(mapInfo), rt.referencedMaps += mapInfo;
 #endif
         foreach (const QString &path, getSubMapFileNames(mapInfo)) {
             bool async = true;
             if (MapInfo *subMapInfo = MapManager::instance()->loadMap(path, QString(), async,
                                                                       MapManager::PriorityLow)) {
-                if (!mExpectSubMaps.contains(subMapInfo)) {
+                if (!rt.expectSubMaps.contains(subMapInfo)) {
                     if (subMapInfo->isLoading())
-                        mExpectSubMaps += subMapInfo;
+                        rt.expectSubMaps += subMapInfo;
 #ifdef WORLDED
                     else
-                        MapManager::instance()->addReferenceToMap(subMapInfo), mReferencedMaps += subMapInfo;
+                        MapManager::instance()->addReferenceToMap(subMapInfo), rt.referencedMaps += subMapInfo;
 #endif
                 }
             }
         }
-    } else if (mExpectSubMaps.contains(mapInfo)) {
+    } else if (rt.expectSubMaps.contains(mapInfo)) {
 #ifdef WORLDED
-        MapManager::instance()->addReferenceToMap(mapInfo), mReferencedMaps += mapInfo;
+        MapManager::instance()->addReferenceToMap(mapInfo), rt.referencedMaps += mapInfo;
 #endif
-        mExpectSubMaps.removeAll(mapInfo);
+        rt.expectSubMaps.removeAll(mapInfo);
         foreach (const QString &path, getSubMapFileNames(mapInfo)) {
             bool async = true;
             if (MapInfo *subMapInfo = MapManager::instance()->loadMap(
                         path, QString(), async, MapManager::PriorityLow)) {
-                if (!mExpectSubMaps.contains(subMapInfo)) {
+                if (!rt.expectSubMaps.contains(subMapInfo)) {
                     if (subMapInfo->isLoading())
-                        mExpectSubMaps += subMapInfo;
+                        rt.expectSubMaps += subMapInfo;
 #ifdef WORLDED
                     else
-                        MapManager::instance()->addReferenceToMap(subMapInfo), mReferencedMaps += subMapInfo;
+                        MapManager::instance()->addReferenceToMap(subMapInfo), rt.referencedMaps += subMapInfo;
 #endif
                 }
             }
         }
-        mapInfo = mExpectMapImage->mapInfo();
+        mapInfo = rt.expectMapImage->mapInfo();
     } else {
         return;
     }
 
-    if (mExpectSubMaps.size())
+    if (rt.expectSubMaps.size())
         return;
 
-    mExpectMapImage = 0;
+    rt.expectMapImage = 0;
 
-    mRenderMapComposite = new MapComposite(mapInfo);
-    Q_ASSERT(mRenderMapComposite->waitingForMapsToLoad() == false);
+    rt.mapComposite = new MapComposite(mapInfo);
+    Q_ASSERT(rt.mapComposite->waitingForMapsToLoad() == false);
 #ifdef WORLDED
     // Now that mapComposite is referencing the maps...
-    foreach (MapInfo *mapInfo, mReferencedMaps)
+    foreach (MapInfo *mapInfo, rt.referencedMaps)
         MapManager::instance()->removeReferenceToMap(mapInfo);
 #endif
     // Wait for TilesetManager's threads to finish loading the tilesets.
     // FIXME: this shouldn't block the gui.
 #if 1
-    QList<Tileset*> usedTilesets = mRenderMapComposite->usedTilesets();
+    QList<Tileset*> usedTilesets = rt.mapComposite->usedTilesets();
     usedTilesets.removeAll(TilesetManager::instance()->missingTileset());
     TilesetManager::instance()->waitForTilesets(usedTilesets);
 #else
     QSet<Tileset*> usedTilesets;
-    foreach (MapComposite *mc, mRenderMapComposite->maps())
+    foreach (MapComposite *mc, rt.mapComposite->maps())
         usedTilesets += mc->map()->usedTilesets();
     usedTilesets.remove(TilesetManager::instance()->missingTileset());
     TilesetManager::instance()->waitForTilesets(usedTilesets.toList());
@@ -712,34 +753,40 @@ void MapImageManager::mapLoaded(MapInfo *mapInfo)
 
     // BmpBlender sends a signal to the MapComposite when it has finished
     // blending.  That needs to happen in the render thread.
-    Q_ASSERT(mRenderMapComposite->bmpBlender()->parent() == mRenderMapComposite);
-    mRenderMapComposite->moveToThread(mImageRenderThread);
+    Q_ASSERT(rt.mapComposite->bmpBlender()->parent() == rt.mapComposite);
+    rt.mapComposite->moveToThread(rt.thread);
 
-    QMetaObject::invokeMethod(mImageRenderWorker,
+    QMetaObject::invokeMethod(rt.worker,
                               "mapLoaded", Qt::QueuedConnection,
-                              Q_ARG(MapComposite*,mRenderMapComposite));
+                              Q_ARG(MapComposite*,rt.mapComposite));
 }
 
 void MapImageManager::mapFailedToLoad(MapInfo *mapInfo)
+{
+    for (int i = 0; i < mRenderThreads.size(); i++)
+        renderThreadMapFailedToLoad(mRenderThreads[i], mapInfo);
+}
+
+void MapImageManager::renderThreadMapFailedToLoad(RenderThread &rt, MapInfo *mapInfo)
 {
     // Failing to load a submap of the one we want to paint doesn't stop us
     // creating the map image.
-    if (mExpectSubMaps.contains(mapInfo))
-        mExpectSubMaps.removeAll(mapInfo);
+    if (rt.expectSubMaps.contains(mapInfo))
+        rt.expectSubMaps.removeAll(mapInfo);
 
     // The render thread was waiting for a map to load, but that failed.
     // Tell the render thread to continue on with the next job.
-    if (mExpectMapImage && (mapInfo == mExpectMapImage->mapInfo())) {
+    if (rt.expectMapImage && (mapInfo == rt.expectMapImage->mapInfo())) {
 #ifdef WORLDED
-        foreach (MapInfo *mapInfo, mReferencedMaps)
+        foreach (MapInfo *mapInfo, rt.referencedMaps)
             MapManager::instance()->removeReferenceToMap(mapInfo);
-        mReferencedMaps.clear();
+        rt.referencedMaps.clear();
 #endif
-        MapImage *mapImage = mExpectMapImage;
+        MapImage *mapImage = rt.expectMapImage;
         mapImage->mImage.fill(Qt::transparent);
         mapImage->mLoaded = true; // FIXME: delete bogus MapImage???
-        mExpectMapImage = 0;
-        QMetaObject::invokeMethod(mImageRenderWorker,
+        rt.expectMapImage = 0;
+        QMetaObject::invokeMethod(rt.worker,
                                   "mapFailedToLoad", Qt::QueuedConnection);
         emit mapImageFailedToLoad(mapImage);
     }
@@ -909,11 +956,13 @@ void MapImage::chopIntoPieces()
     int columns = subImageColumns();
     int rows = subImageRows();
     mSubImages.resize(columns * rows);
-    QRect r(QPoint(), image().size());
+    // Thumbnails of BMP images are still 32 bits per pixel here.
+    const QImage source = ImageKernels::saturateAlphaToArgb4444(mImage);
+    QRect r(QPoint(), source.size());
     for (int x = 0; x < columns; x++) {
         for (int y = 0; y < rows; y++) {
             QRect subr = QRect(x * 512, y * 512, 512, 512) & r;
-            mSubImages[x + y * columns] = image().copy(subr).convertToFormat(QImage::Format_ARGB4444_Premultiplied);
+            mSubImages[x + y * columns] = source.copy(subr);
         }
     }
     mMiniMapImage = mImage.scaledToWidth(512);
@@ -939,16 +988,19 @@ void MapImageReaderWorker::work()
     while (mJobs.size()) {
 
         if (aborted()) {
+            TRACE_COUNTER_ADD("Map image reader jobs", -mJobs.size());
             mJobs.clear();
             return;
         }
 
         Job job = mJobs.takeAt(0);
+        TRACE_COUNTER_ADD("Map image reader jobs", -1);
+        TRACE_ZONE("MapImageReaderWorker::loadImage");
 
         QImage *image = new QImage(job.imageFileName);
 #ifdef WORLDED
         if (!image->isNull())
-            *image = image->convertToFormat(QImage::Format_ARGB4444_Premultiplied);
+            *image = ImageKernels::saturateAlphaToArgb4444(*image);
 #endif // WORLDED
 
 #ifndef QT_NO_DEBUG
@@ -963,6 +1015,7 @@ void MapImageReaderWorker::addJob(const QString &imageFileName, MapImage *mapIma
     IN_WORKER_THREAD
 
     mJobs += Job(imageFileName, mapImage);
+    TRACE_COUNTER_ADD("Map image reader jobs", 1);
     scheduleWork();
 }
 
@@ -993,6 +1046,7 @@ void MapImageRenderWorker::work()
         }
 
         Job job = mJobs.takeFirst();
+        TRACE_COUNTER_ADD("Map image render jobs", -1);
 
         noise() << "MapImageRenderWorker started" << job.mapImage->mapInfo()->path();
 #ifndef QT_NO_DEBUG
@@ -1013,6 +1067,7 @@ void MapImageRenderWorker::addJob(MapImage *mapImage)
     IN_WORKER_THREAD
 
     mJobs += Job(mapImage);
+    TRACE_COUNTER_ADD("Map image render jobs", 1);
     scheduleWork();
 }
 
@@ -1023,7 +1078,7 @@ void MapImageRenderWorker::mapLoaded(MapComposite *mapComposite)
     foreach (CompositeLayerGroup *layerGroup, mapComposite->sortedLayerGroups()) {
         foreach (TileLayer *tl, layerGroup->layers()) {
             bool isVisible = true;
-            if (tl->name().contains(QLatin1String("NoRender")))
+            if (tl->classification().hasRole(LayerClassification::NoRenderRole))
                 isVisible = false;
             layerGroup->setLayerVisibility(tl, isVisible);
             layerGroup->setLayerOpacity(tl, 1.0f);
@@ -1043,6 +1098,7 @@ void MapImageRenderWorker::mapFailedToLoad()
     IN_WORKER_THREAD
 
     mJobs.takeFirst();
+    TRACE_COUNTER_ADD("Map image render jobs", -1);
     allowWork();
     scheduleWork();
 }
@@ -1052,11 +1108,28 @@ void MapImageRenderWorker::resume(MapImage *mapImage)
     IN_WORKER_THREAD
 
     mJobs.prepend(Job(mapImage));
+    TRACE_COUNTER_ADD("Map image render jobs", 1);
     scheduleWork();
 }
 
+// Any pixel that isn't fully transparent is made fully opaque, keeping its
+// color.  WorldEd keeps thousands of these images in memory, so there they
+// are also reduced to 16 bits per pixel in the same pass.
+static QImage finishMapImage(QImage &image)
+{
+    TRACE_ZONE("finishMapImage");
+    Q_ASSERT(image.format() == QImage::Format_ARGB32);
+#ifdef WORLDED
+    return ImageKernels::saturateAlphaToArgb4444(image);
+#else
+    ImageKernels::saturateAlpha(image);
+    return image;
+#endif
+}
+
 MapImageData MapImageRenderWorker::generateMapImage(MapComposite *mapComposite)
 {
+    TRACE_ZONE("MapImageRenderWorker::generateMapImage");
     Map *map = mapComposite->map();
 
     MapRenderer *renderer = NULL;
@@ -1112,7 +1185,7 @@ MapImageData MapImageRenderWorker::generateMapImage(MapComposite *mapComposite)
         if (zo.group) {
             renderer->drawTileLayerGroup(&painter, zo.group);
         } else if (TileLayer *tl = zo.layer->asTileLayer()) {
-            if (tl->name().contains(QLatin1String("NoRender")))
+            if (tl->classification().hasRole(LayerClassification::NoRenderRole))
                 continue;
             renderer->drawTileLayer(&painter, tl);
         }
@@ -1125,22 +1198,8 @@ MapImageData MapImageRenderWorker::generateMapImage(MapComposite *mapComposite)
 
     painter.end();
 
-    for (int y = 0; y < image.height(); y++) {
-        QRgb *pixels = reinterpret_cast<QRgb*>(image.scanLine(y));
-        for (int x = 0; x < image.width(); x++) {
-            QRgb pixel = pixels[x];
-            if (qAlpha(pixel) > 0.01f) {
-                pixels[x] = qRgba(qRed(pixel), qGreen(pixel), qBlue(pixel), 255);
-            }
-        }
-    }
-
     MapImageData data;
-#ifdef WORLDED
-    data.image = image.convertToFormat(QImage::Format_ARGB4444_Premultiplied);
-#else
-    data.image = image;
-#endif
+    data.image = finishMapImage(image);
     data.scale = scale;
     data.levelZeroBounds = renderer->boundingRect(QRect(0, 0, map->width(), map->height()));
     data.levelZeroBounds.translate(-sceneRect.topLeft());
@@ -23,6 +23,7 @@
 #include <QMap>
 #include <QObject>
 #include <QStringList>
+#include <QVector>
 
 class MapComposite;
 class MapInfo;
@@ -292,14 +293,32 @@ private:
     QVector<MapImageReaderWorker*> mImageReaderWorkers;
     int mNextThreadForJob;
 
-    InterruptibleThread *mImageRenderThread;
-    MapImageRenderWorker *mImageRenderWorker;
-    MapImage *mExpectMapImage;
-    QList<MapInfo*> mExpectSubMaps;
+    // Each render thread works on its own MapComposite, so several map
+    // images can be rendered at once.
+    struct RenderThread
+    {
+        RenderThread() :
+            thread(0),
+            worker(0),
+            expectMapImage(0),
+            mapComposite(0)
+        {}
+        InterruptibleThread *thread;
+        MapImageRenderWorker *worker;
+        MapImage *expectMapImage;
+        QList<MapInfo*> expectSubMaps;
 #ifdef WORLDED
-    QList<MapInfo*> mReferencedMaps;
+        QList<MapInfo*> referencedMaps;
 #endif
-    MapComposite *mRenderMapComposite;
+        MapComposite *mapComposite;
+    };
+    QVector<RenderThread> mRenderThreads;
+    int mNextRenderThreadForJob;
+
+    RenderThread *renderThreadFor(QObject *worker);
+    void addRenderJob(MapImage *mapImage);
+    void renderThreadMapLoaded(RenderThread &rt, MapInfo *mapInfo);
+    void renderThreadMapFailedToLoad(RenderThread &rt, MapInfo *mapInfo);
 
     friend class MapImageManagerDeferral;
     void deferThreadResults(bool defer);
@@ -30,6 +30,7 @@
 #include "tile.h"
 #include "tilelayer.h"
 #include "tileset.h"
+#include "tracing.h"
 
 #include "qtlockedfile.h"
 using namespace SharedTools;
@@ -736,7 +737,7 @@ void MapManager::metaTilesetRemoved(Tileset *tileset)
     Q_UNUSED(tileset)
     foreach (MapInfo *mapInfo, mMapInfo) {
         if (mapInfo->map() && mapInfo->path().endsWith(QLatin1String(".tbx"))
-                && mapInfo->map()->usedTilesets().contains(tileset))
+                && mapInfo->map()->isTilesetUsed(tileset))
             fileChanged(mapInfo->path());
     }
 }
@@ -884,11 +885,13 @@ void MapReaderWorker::work()
 
     if (mJobs.size()) {
         if (aborted()) {
+            TRACE_COUNTER_ADD("Map reader jobs", -mJobs.size());
             mJobs.clear();
             return;
         }
 
         Job job = mJobs.takeFirst();
+        TRACE_COUNTER_ADD("Map reader jobs", -1);
         debugJobs("take job");
 
         if (job.mapInfo->path().endsWith(QLatin1String(".tbx"))) {
@@ -922,6 +925,7 @@ void MapReaderWorker::addJob(MapInfo *mapInfo, int priority)
         ++index;
 
     mJobs.insert(index, Job(mapInfo, priority));
+    TRACE_COUNTER_ADD("Map reader jobs", 1);
     debugJobs("add job");
     scheduleWork();
 }
@@ -961,6 +965,7 @@ protected:
 
 Map *MapReaderWorker::loadMap(MapInfo *mapInfo)
 {
+    TRACE_ZONE("MapReaderWorker::loadMap");
     MapReaderWorker_MapReader reader;
 //    reader.setTilesetImageCache(TilesetManager::instance()->imageCache()); // not thread-safe class
     Map *map = reader.readMap(mapInfo->path());
@@ -971,6 +976,7 @@ Map *MapReaderWorker::loadMap(MapInfo *mapInfo)
 
 Building *MapReaderWorker::loadBuilding(MapInfo *mapInfo)
 {
+    TRACE_ZONE("MapReaderWorker::loadBuilding");
     BuildingReader reader;
     Building *building = reader.read(mapInfo->path());
     if (!building)
@@ -27,6 +27,7 @@
 #include "mainwindow.h"
 #include "maprenderer.h"
 #include "tilelayerspanel.h"
+#include "tracing.h"
 #endif
 
 #include <QApplication>
@@ -130,6 +131,9 @@ void MapView::adjustScale(qreal scale)
     setTransform(QTransform::fromScale(scale, scale));
     setRenderHint(QPainter::SmoothPixmapTransform,
                   mZoomable->smoothTransform());
+#ifdef ZOMBOID
+    updateVisibleTileRect();
+#endif
 }
 
 #ifdef ZOMBOID
@@ -320,11 +324,18 @@ void MapView::mouseMoveEvent(QMouseEvent *event)
 
 #ifdef ZOMBOID
 
+void MapView::paintEvent(QPaintEvent *event)
+{
+    TRACE_FRAME("MapView::paintEvent");
+    QGraphicsView::paintEvent(event);
+}
+
 void MapView::resizeEvent(QResizeEvent *event)
 {
     QGraphicsView::resizeEvent(event);
     if (mMiniMap)
         mMiniMap->viewRectChanged();
+    updateVisibleTileRect();
 }
 
 void MapView::scrollContentsBy(int dx, int dy)
@@ -332,6 +343,27 @@ void MapView::scrollContentsBy(int dx, int dy)
     QGraphicsView::scrollContentsBy(dx, dy);
     if (mMiniMap)
         mMiniMap->viewRectChanged();
+    updateVisibleTileRect();
+}
+
+// Lets the document stream adjacent maps in and out as the view moves.
+void MapView::updateVisibleTileRect()
+{
+    MapScene *scene = mapScene();
+    MapDocument *doc = scene ? scene->mapDocument() : nullptr;
+    if (!doc)
+        return;
+
+    QPolygonF polygon = mapToScene(viewport()->rect());
+    QRectF tileBounds;
+    for (const QPointF &scenePos : qAsConst(polygon)) {
+        QPointF tilePos = doc->renderer()->pixelToTileCoords(scenePos, 0);
+        if (tileBounds.isNull())
+            tileBounds = QRectF(tilePos, QSizeF(1, 1));
+        else
+            tileBounds |= QRectF(tilePos, QSizeF(1, 1));
+    }
+    doc->setVisibleTileRect(tileBounds.toAlignedRect());
 }
 
 #endif // ZOMBOID
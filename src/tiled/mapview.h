@@ -73,6 +73,7 @@ protected:
     void mouseMoveEvent(QMouseEvent *event);
 
 #ifdef ZOMBOID
+    void paintEvent(QPaintEvent *event);
     void resizeEvent(QResizeEvent *event);
     void scrollContentsBy(int dx, int dy);
 #endif
@@ -85,6 +86,10 @@ private slots:
 #endif
 
 private:
+#ifdef ZOMBOID
+    void updateVisibleTileRect();
+#endif
+
     QPoint mLastMousePos;
     QPointF mLastMouseScenePos;
     bool mHandScrolling;
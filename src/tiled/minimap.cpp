@@ -18,6 +18,7 @@
 #include "minimap.h"
 
 #include "bmpblender.h"
+#include "imagekernels.h"
 #include "mapcomposite.h"
 #include "mapdocument.h"
 #include "mapmanager.h"
@@ -31,6 +32,7 @@
 #include "map.h"
 #include "tilelayer.h"
 #include "tileset.h"
+#include "tracing.h"
 #include "zlevelrenderer.h"
 
 #include "worlded/worldcell.h"
@@ -66,7 +68,7 @@ ShadowMap::ShadowMap(MapInfo *mapInfo)
     foreach (CompositeLayerGroup *layerGroup, mMapComposite->sortedLayerGroups()) {
         foreach (TileLayer *tl, layerGroup->layers()) {
             bool isVisible = true;
-            if (tl->name().contains(QLatin1String("NoRender")))
+            if (tl->classification().hasRole(LayerClassification::NoRenderRole))
                 isVisible = false;
             layerGroup->setLayerVisibility(tl, isVisible);
             layerGroup->setLayerOpacity(tl, 1.0f);
@@ -93,7 +95,7 @@ void ShadowMap::layerAdded(int index, Layer *layer)
     if (TileLayer *tl = layer->asTileLayer()) {
         if (CompositeLayerGroup *layerGroup = mMapComposite->layerGroupForLayer(tl)) {
             bool isVisible = true;
-            if (tl->name().contains(QLatin1String("NoRender")))
+            if (tl->classification().hasRole(LayerClassification::NoRenderRole))
                 isVisible = false;
             layerGroup->setLayerVisibility(tl, isVisible);
             layerGroup->setLayerOpacity(tl, 1.0f);
@@ -204,6 +206,7 @@ MiniMapRenderWorker::~MiniMapRenderWorker()
 void MiniMapRenderWorker::work()
 {
     IN_WORKER_THREAD
+    TRACE_ZONE("MiniMapRenderWorker::work");
 
     processChanges(mPendingChanges);
     qDeleteAll(mPendingChanges);
@@ -252,7 +255,7 @@ void MiniMapRenderWorker::work()
         if (zo.group)
             mRenderer->drawTileLayerGroup(&painter, zo.group, paintRect);
         else if (TileLayer *tl = zo.layer->asTileLayer()) {
-            if (tl->name().contains(QLatin1String("NoRender")))
+            if (tl->classification().hasRole(LayerClassification::NoRenderRole))
                 continue;
             mRenderer->drawTileLayer(&painter, tl, paintRect);
         }
@@ -267,15 +270,7 @@ void MiniMapRenderWorker::work()
     painter.end();
 
     if (!aborted) {
-        for (int y = 0; y < mImage.height(); y++) {
-            QRgb *pixels = reinterpret_cast<QRgb*>(mImage.scanLine(y));
-            for (int x = 0; x < mImage.width(); x++) {
-                QRgb pixel = pixels[x];
-                if (qAlpha(pixel) > 0.01f) {
-                    pixels[x] = qRgba(qRed(pixel), qGreen(pixel), qBlue(pixel), 255);
-                }
-            }
-        }
+        ImageKernels::saturateAlpha(mImage);
 
         noise() << "MiniMapRenderWorker: painting took" << timer.elapsed() << "ms" << this;
         mRedrawAll = false;
@@ -2,6 +2,7 @@
 
 #include "mapcomposite.h"
 #include "mapmanager.h"
+#include "roomgraph.h"
 #include "tilesetmanager.h"
 #include "tilemetainfomgr.h"
 
@@ -10,22 +11,85 @@
 #include "objectgroup.h"
 #include "tile.h"
 #include "tileset.h"
+#include "tracing.h"
 
+#include <QCryptographicHash>
+#include <QFile>
+#include <QSaveFile>
 #include <qmath.h>
 
 using namespace Tiled;
 using namespace Tiled::Internal;
 
-NewMapBinaryFile::NewMapBinaryFile()
+namespace {
+
+const quint32 MANIFEST_MAGIC = 0x4D425A50; // "PZBM"
+const qint32 MANIFEST_VERSION = 2;
+
+// What an incremental write needs to know about the last file written.
+class LotManifest
+{
+public:
+    LotManifest() :
+        fileSize(0),
+        chunkTableOffset(0)
+    {
+    }
+
+    qint64 fileSize;
+    qint64 chunkTableOffset; // The size of the header.
+    QVector<QByteArray> chunkHashes;
+};
+
+QString manifestPath(const QString &filePath)
+{
+    return filePath + QLatin1String(".manifest");
+}
+
+bool readManifest(const QString &fileName, LotManifest &manifest)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream in(&file);
+    in.setByteOrder(QDataStream::LittleEndian);
+    quint32 magic;
+    qint32 version;
+    in >> magic >> version;
+    if (magic != MANIFEST_MAGIC || version != MANIFEST_VERSION)
+        return false;
+    in >> manifest.fileSize >> manifest.chunkTableOffset >> manifest.chunkHashes;
+    return in.status() == QDataStream::Ok;
+}
+
+bool writeManifest(const QString &fileName, const LotManifest &manifest)
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out << MANIFEST_MAGIC << MANIFEST_VERSION;
+    out << manifest.fileSize << manifest.chunkTableOffset << manifest.chunkHashes;
+    return file.commit();
+}
+
+} // namespace
+
+NewMapBinaryFile::NewMapBinaryFile() :
+    mIncremental(false),
+    mReusedChunks(0)
 {
 
 }
 
 bool NewMapBinaryFile::write(MapComposite *mapComposite, const QString &filePath)
 {
+    TRACE_ZONE("NewMapBinaryFile::write");
     MapInfo* mapInfo = mapComposite->mapInfo();
 
     mStats = LotFile::Stats();
+    mReusedChunks = 0;
 
     MaxLevel = mapComposite->maxLevel();
 
@@ -97,7 +161,84 @@ bool NewMapBinaryFile::write(MapComposite *mapComposite, const QString &filePath
         }
     }
 
-    QFile file(filePath);
+    generateBuildingObjects(mapWidth, mapHeight);
+
+    QByteArray header;
+    QDataStream headerOut(&header, QIODevice::WriteOnly);
+    headerOut.setByteOrder(QDataStream::LittleEndian);
+    if (!generateHeaderAux(headerOut, mapComposite))
+        return false;
+
+    const int numChunks = NUM_CHUNKS_X * NUM_CHUNKS_Y;
+
+    LotManifest manifest;
+    manifest.chunkTableOffset = header.size();
+    manifest.chunkHashes.resize(numChunks);
+    {
+        TRACE_ZONE("NewMapBinaryFile::write chunk hashes");
+        for (int y = 0; y < NUM_CHUNKS_Y; y++) {
+            for (int x = 0; x < NUM_CHUNKS_X; x++) {
+                manifest.chunkHashes[x + y * NUM_CHUNKS_X] = chunkHash(x, y);
+            }
+        }
+    }
+
+    // The chunks refer to tiles and rooms by their index in the header, and
+    // chunkHash() hashes those indices, so an old chunk with the same hash has
+    // the same bytes even if the header changed.  The old header may be a
+    // different size, so the old chunk table is found using the manifest.
+    LotManifest oldManifest;
+    QFile oldFile(filePath);
+    QVector<qint64> oldPositions;
+    if (mIncremental && readManifest(manifestPath(filePath), oldManifest) &&
+            oldManifest.chunkHashes.size() == numChunks &&
+            oldFile.open(QIODevice::ReadOnly) &&
+            oldFile.size() == oldManifest.fileSize &&
+            oldFile.seek(oldManifest.chunkTableOffset)) {
+        QDataStream in(&oldFile);
+        in.setByteOrder(QDataStream::LittleEndian);
+        qint64 prev = oldManifest.chunkTableOffset + numChunks * qint64(sizeof(qint64));
+        for (int m = 0; m < numChunks; m++) {
+            qint64 pos;
+            in >> pos;
+            if (pos < prev || pos > oldFile.size())
+                break;
+            oldPositions += pos;
+            prev = pos;
+        }
+        oldPositions += oldFile.size();
+        if (in.status() != QDataStream::Ok || oldPositions.size() != numChunks + 1)
+            oldPositions.clear();
+    }
+
+    QVector<QByteArray> chunks(numChunks);
+    {
+        TRACE_ZONE("NewMapBinaryFile::write chunks");
+        for (int y = 0; y < NUM_CHUNKS_Y; y++) {
+            for (int x = 0; x < NUM_CHUNKS_X; x++) {
+                int m = x + y * NUM_CHUNKS_X;
+                if (!oldPositions.isEmpty() &&
+                        oldManifest.chunkHashes[m] == manifest.chunkHashes[m]) {
+                    const qint64 size = oldPositions[m + 1] - oldPositions[m];
+                    if (oldFile.seek(oldPositions[m])) {
+                        chunks[m] = oldFile.read(size);
+                        if (chunks[m].size() == size) {
+                            mReusedChunks++;
+                            continue;
+                        }
+                    }
+                    chunks[m].clear();
+                }
+                QDataStream out(&chunks[m], QIODevice::WriteOnly);
+                out.setByteOrder(QDataStream::LittleEndian);
+                if (!generateChunk(out, mapComposite, x, y))
+                    return false;
+            }
+        }
+    }
+    oldFile.close();
+
+    QSaveFile file(filePath);
     if (!file.open(QIODevice::WriteOnly /*| QIODevice::Text*/)) {
         mError = tr("Could not open file for writing.");
         return false;
@@ -106,43 +247,29 @@ bool NewMapBinaryFile::write(MapComposite *mapComposite, const QString &filePath
     QDataStream out(&file);
     out.setByteOrder(QDataStream::LittleEndian);
 
-    generateBuildingObjects(mapWidth, mapHeight);
-
-    if (!generateHeaderAux(out, mapComposite))
-        return false;
+    out.writeRawData(header.constData(), header.size());
 
-    qint64 chunkTablePosition = file.pos();
-
-//    out << qint32(NUM_CHUNKS_X * NUM_CHUNKS_Y);
-    for (int m = 0; m < NUM_CHUNKS_X * NUM_CHUNKS_Y; m++) {
-        out << qint64(m);
+    qint64 pos = header.size() + numChunks * qint64(sizeof(qint64));
+    for (int m = 0; m < numChunks; m++) {
+        out << qint64(pos);
+        pos += chunks[m].size();
     }
 
-    QList<qint64> PositionMap;
-
-    for (int y = 0; y < NUM_CHUNKS_Y; y++) {
-        for (int x = 0; x < NUM_CHUNKS_X; x++) {
-            PositionMap += file.pos();
-            if (!generateChunk(out, mapComposite, x, y))
-                return false;
-        }
+    for (int m = 0; m < numChunks; m++) {
+        out.writeRawData(chunks[m].constData(), chunks[m].size());
     }
 
-    file.close();
-    if (!file.open(QIODevice::ReadWrite | QIODevice::Append)) {
+    if (!file.commit()) {
         mError = tr("Could not open file for writing.");
         return false;
     }
-    file.seek(chunkTablePosition);
-
-    QDataStream out2(&file);
-    out2.setByteOrder(QDataStream::LittleEndian);
 
-    for (int m = 0; m < NUM_CHUNKS_X * NUM_CHUNKS_Y; m++) {
-        out2 << qint64(PositionMap[m]);
+    manifest.fileSize = pos;
+    if (!writeManifest(manifestPath(filePath), manifest)) {
+        // Only a later incremental write needs it.
+        QFile::remove(manifestPath(filePath));
     }
 
-    file.close();
 #if 0
     Navigate::ChunkDataFile cdf;
     cdf.fromMap(cell->x(), cell->y(), mapComposite, mRoomRectByLevel[0], lotSettings);
@@ -152,6 +279,7 @@ bool NewMapBinaryFile::write(MapComposite *mapComposite, const QString &filePath
 
 bool NewMapBinaryFile::generateHeader(MapComposite *mapComposite)
 {
+    TRACE_ZONE("NewMapBinaryFile::generateHeader");
     qDeleteAll(mRoomRects);
     qDeleteAll(roomList);
     qDeleteAll(buildingList);
@@ -193,83 +321,35 @@ bool NewMapBinaryFile::generateHeader(MapComposite *mapComposite)
         return false;
     }
 
-    // Merge adjacent RoomRects on the same level into rooms.
-    // Only RoomRects with matching names and with # in the name are merged.
-    for (int level : mRoomRectByLevel.keys()) {
-        QList<LotFile::RoomRect*> rrList = mRoomRectByLevel[level];
-        for (LotFile::RoomRect *rr : rrList) {
-            if (rr->room == nullptr) {
-                rr->room = new LotFile::Room(rr->nameWithoutSuffix(),
-                                             rr->floor);
-                rr->room->rects += rr;
-                roomList += rr->room;
-            }
-            if (!rr->name.contains(QLatin1Char('#'))) {
-                continue;
-            }
-            for (LotFile::RoomRect *comp : rrList) {
-                if (comp == rr)
-                    continue;
-                if (comp->room == rr->room)
-                    continue;
-                if (rr->inSameRoom(comp)) {
-                    if (comp->room != nullptr) {
-                        LotFile::Room *room = comp->room;
-                        for (LotFile::RoomRect *rr2 : room->rects) {
-                            Q_ASSERT(rr2->room == room);
-                            Q_ASSERT(!rr->room->rects.contains(rr2));
-                            rr2->room = rr->room;
-                        }
-                        rr->room->rects += room->rects;
-                        roomList.removeOne(room);
-                        delete room;
-                    } else {
-                        comp->room = rr->room;
-                        rr->room->rects += comp;
-                        Q_ASSERT(rr->room->rects.count(comp) == 1);
-                    }
-                }
-            }
+    // Merge adjacent RoomRects on the same level into rooms, and adjacent
+    // rooms into buildings.  MapBuildings groups them the same way.
+    RoomGraph graph;
+    for (LotFile::RoomRect *rr : mRoomRects)
+        graph.addRect(rr->bounds(), rr->floor, rr->name);
+    graph.build();
+
+    for (int i = 0; i < graph.roomCount(); i++) {
+        const QVector<int> &rects = graph.roomRects(i);
+        LotFile::RoomRect *first = mRoomRects[rects.first()];
+        LotFile::Room *room = new LotFile::Room(first->nameWithoutSuffix(),
+                                                first->floor);
+        room->ID = i;
+        for (int rect : rects) {
+            mRoomRects[rect]->room = room;
+            room->rects += mRoomRects[rect];
         }
-    }
-    for (int i = 0; i < roomList.size(); i++) {
-        roomList[i]->ID = i;
+        roomList += room;
     }
     mStats.numRoomRects += mRoomRects.size();
     mStats.numRooms += roomList.size();
 
-    // Merge adjacent rooms into buildings.
-    // Rooms on different levels that overlap in x/y are merged into the
-    // same buliding.
-    for (LotFile::Room *r : roomList) {
-        if (r->building == nullptr) {
-            r->building = new LotFile::Building();
-            buildingList += r->building;
-            r->building->RoomList += r;
-        }
-        for (LotFile::Room *comp : roomList) {
-            if (comp == r)
-                continue;
-            if (r->building == comp->building)
-                continue;
-            if (r->inSameBuilding(comp)) {
-                if (comp->building != nullptr) {
-                    LotFile::Building *b = comp->building;
-                    for (LotFile::Room *r2 : b->RoomList) {
-                        Q_ASSERT(r2->building == b);
-                        Q_ASSERT(!r->building->RoomList.contains(r2));
-                        r2->building = r->building;
-                    }
-                    r->building->RoomList += b->RoomList;
-                    buildingList.removeOne(b);
-                    delete b;
-                } else {
-                    comp->building = r->building;
-                    r->building->RoomList += comp;
-                    Q_ASSERT(r->building->RoomList.count(comp) == 1);
-                }
-            }
+    for (int i = 0; i < graph.buildingCount(); i++) {
+        LotFile::Building *building = new LotFile::Building();
+        for (int room : graph.buildingRooms(i)) {
+            roomList[room]->building = building;
+            building->RoomList += roomList[room];
         }
+        buildingList += building;
     }
     mStats.numBuildings += buildingList.size();
 
@@ -278,6 +358,7 @@ bool NewMapBinaryFile::generateHeader(MapComposite *mapComposite)
 
 bool NewMapBinaryFile::generateHeaderAux(QDataStream &out, MapComposite *mapComposite)
 {
+    TRACE_ZONE("NewMapBinaryFile::generateHeaderAux");
     Q_UNUSED(mapComposite)
 
 //    QString fileName = tr("%1_%2.lotheader")
@@ -364,6 +445,7 @@ bool NewMapBinaryFile::generateHeaderAux(QDataStream &out, MapComposite *mapComp
 
 bool NewMapBinaryFile::generateChunk(QDataStream &out, MapComposite *mapComposite, int cx, int cy)
 {
+    TRACE_ZONE("NewMapBinaryFile::generateChunk");
     Q_UNUSED(mapComposite)
 
     int notdonecount = 0;
@@ -517,6 +599,32 @@ bool NewMapBinaryFile::handleTileset(const Tiled::Tileset *tileset, uint &firstG
     return true;
 }
 
+// Hashes what generateChunk() writes for the chunk, without encoding it.
+QByteArray NewMapBinaryFile::chunkHash(int cx, int cy)
+{
+    QVector<qint32> data;
+    for (int z = 0; z < MaxLevel; z++)  {
+        for (int x = 0; x < CHUNK_WIDTH; x++) {
+            for (int y = 0; y < CHUNK_HEIGHT; y++) {
+                int gx = cx * CHUNK_WIDTH + x;
+                int gy = cy * CHUNK_HEIGHT + y;
+                const QList<LotFile::Entry*> &entries = mGridData[gx][gy][z].Entries;
+                data += entries.count();
+                if (entries.isEmpty())
+                    continue;
+                data += getRoomID(gx, gy, z);
+                for (LotFile::Entry *entry : entries) {
+                    data += mTileMap[entry->gid]->id;
+                }
+            }
+        }
+    }
+    return QCryptographicHash::hash(
+                QByteArray::fromRawData(reinterpret_cast<const char*>(data.constData()),
+                                        data.size() * int(sizeof(qint32))),
+                QCryptographicHash::Sha1);
+}
+
 int NewMapBinaryFile::getRoomID(int x, int y, int z)
 {
     return mGridData[x][y][z].roomID;
@@ -252,6 +252,22 @@ public:
 
     bool write(MapComposite* mapComposite, const QString& filePath);
 
+    /**
+     * When enabled, write() reuses the bytes of chunks that haven't changed
+     * since the file was last written.  A manifest of chunk hashes is kept
+     * next to the file for this.
+     */
+    void setIncremental(bool incremental)
+    { mIncremental = incremental; }
+    bool isIncremental() const
+    { return mIncremental; }
+
+    /**
+     * Returns how many chunks the last write() copied from the old file.
+     */
+    int reusedChunkCount() const
+    { return mReusedChunks; }
+
     bool generateHeader(MapComposite *mapComposite);
     bool generateHeaderAux(QDataStream& out, MapComposite *mapComposite);
     bool generateChunk(QDataStream &out, MapComposite *mapComposite, int cx, int cy);
@@ -269,6 +285,7 @@ signals:
 
 private:
     uint cellToGid(const Tiled::Cell *cell);
+    QByteArray chunkHash(int cx, int cy);
     bool processObjectGroups(MapComposite *mapComposite);
     bool processObjectGroup(Tiled::ObjectGroup *objectGroup,
                             int levelOffset, const QPoint &offset);
@@ -287,6 +304,8 @@ private:
     QList<LotFile::Room*> roomList;
     QList<LotFile::Building*> buildingList;
     LotFile::Stats mStats;
+    bool mIncremental;
+    int mReusedChunks;
     QString mError;
 };
 
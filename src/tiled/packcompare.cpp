@@ -74,17 +74,20 @@ void PackCompare::compare()
         return;
     }
 
-    QSet<QString> in1, in2, unique1, unique2;
-    foreach (PackPage page, mPackFile1.pages()) {
-        foreach (PackSubTexInfo tex, page.mInfo)
-            in1.insert(tex.name);
+    QSet<QString> unique1, unique2;
+    int pageIndex, entryIndex;
+    foreach (const PackPage &page, mPackFile1.pages()) {
+        foreach (const PackSubTexInfo &tex, page.mInfo) {
+            if (!mPackFile2.findSubTexture(tex.name, pageIndex, entryIndex))
+                unique1.insert(tex.name);
+        }
     }
-    foreach (PackPage page, mPackFile2.pages()) {
-        foreach (PackSubTexInfo tex, page.mInfo)
-            in2.insert(tex.name);
+    foreach (const PackPage &page, mPackFile2.pages()) {
+        foreach (const PackSubTexInfo &tex, page.mInfo) {
+            if (!mPackFile1.findSubTexture(tex.name, pageIndex, entryIndex))
+                unique2.insert(tex.name);
+        }
     }
-    unique1 = in1 - in2;
-    unique2 = in2 - in1;
 
     ui->textBrowser->clear();
 
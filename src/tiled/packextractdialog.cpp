@@ -65,13 +65,16 @@ void PackExtractDialog::accept()
     settings.endGroup();
 
     if (ui->radioMultiple->isChecked()) {
+        // Every page is needed, so decode them all at once on several threads.
+        if (prefix.isEmpty())
+            mPackFile.decodeAllPages();
         foreach (PackPage page, mPackFile.pages()) {
             foreach (PackSubTexInfo tex, page.mInfo) {
                 if (prefix.isEmpty() || tex.name.startsWith(prefix, Qt::CaseInsensitive)) {
                     QImage image(tex.fx, tex.fy, QImage::Format_ARGB32);
                     image.fill(Qt::transparent);
                     QPainter painter(&image);
-                    painter.drawImage(tex.ox, tex.oy, page.image, tex.x, tex.y, tex.w, tex.h);
+                    painter.drawImage(tex.ox, tex.oy, page.image(), tex.x, tex.y, tex.w, tex.h);
                     painter.end();
                     image.save(outputDir.filePath(tex.name + QLatin1String(".png")));
                 }
@@ -101,7 +104,7 @@ void PackExtractDialog::accept()
                         QImage image(tex.fx, tex.fy, QImage::Format_ARGB32);
                         image.fill(Qt::transparent);
                         QPainter painter(&image);
-                        painter.drawImage(tex.ox, tex.oy, page.image, tex.x, tex.y, tex.w, tex.h);
+                        painter.drawImage(tex.ox, tex.oy, page.image(), tex.x, tex.y, tex.w, tex.h);
                         painter.end();
 
                         TileInfo info;
@@ -122,7 +122,7 @@ void PackViewer::itemSelectionChanged()
     QList<QListWidgetItem*> items = ui->listWidget->selectedItems();
     if (items.size() == 1) {
         int row = ui->listWidget->row(items.first());
-        QPixmap pixmap = QPixmap::fromImage(mPackFile.pages().at(row).image);
+        QPixmap pixmap = QPixmap::fromImage(mPackFile.pages().at(row).image());
         mRectItem->setRect(QRectF(QPoint(-1, -1), pixmap.size() + QSize(1, 1)));
         mRectItem->show();
         mPixmapItem->setPackPage(mPackFile.pages().at(row));
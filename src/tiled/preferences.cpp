@@ -92,6 +92,8 @@ Preferences::Preferences()
     mBackgroundColor = QColor(mSettings->value(QLatin1String("BackgroundColor"),
                                                QColor(Qt::darkGray).name()).toString());
     mShowAdjacentMaps = mSettings->value(QLatin1String("ShowAdjacentMaps"), true).toBool();
+    mAdjacentMapsMemoryBudget = mSettings->value(QLatin1String("AdjacentMapsMemoryBudget"), 2048).toInt();
+    mMipmapCacheSize = mSettings->value(QLatin1String("MipmapCacheSize"), 64).toInt();
     mHighlightRoomUnderPointer = mSettings->value(QLatin1String("HighlightRoomUnderPointer"), false).toBool();
     mTilesetBackgroundColor = QColor(mSettings->value(QLatin1String("TilesetBackgroundColor"), QColor(Qt::white).name()).toString());
 #endif
@@ -588,6 +590,24 @@ void Preferences::setShowAdjacentMaps(bool show)
     emit showAdjacentMapsChanged(mShowAdjacentMaps);
 }
 
+void Preferences::setAdjacentMapsMemoryBudget(int megabytes)
+{
+    if (mAdjacentMapsMemoryBudget == megabytes)
+        return;
+    mAdjacentMapsMemoryBudget = megabytes;
+    mSettings->setValue(QLatin1String("Interface/AdjacentMapsMemoryBudget"), megabytes);
+    emit adjacentMapsMemoryBudgetChanged(mAdjacentMapsMemoryBudget);
+}
+
+void Preferences::setMipmapCacheSize(int megabytes)
+{
+    if (mMipmapCacheSize == megabytes)
+        return;
+    mMipmapCacheSize = megabytes;
+    mSettings->setValue(QLatin1String("Interface/MipmapCacheSize"), megabytes);
+    emit mipmapCacheSizeChanged(mMipmapCacheSize);
+}
+
 void Preferences::setWorldEdFiles(const QStringList &fileNames)
 {
     if (mWorldEdFiles == fileNames)
@@ -122,6 +122,12 @@ public:
     bool showAdjacentMaps() const
     { return mShowAdjacentMaps; }
 
+    int adjacentMapsMemoryBudget() const
+    { return mAdjacentMapsMemoryBudget; }
+
+    int mipmapCacheSize() const
+    { return mMipmapCacheSize; }
+
     QStringList worldedFiles() const
     { return mWorldEdFiles; }
 
@@ -163,6 +169,8 @@ public slots:
     void setShowTileLayersPanel(bool show);
     void setBackgroundColor(const QColor &bgColor);
     void setShowAdjacentMaps(bool show);
+    void setAdjacentMapsMemoryBudget(int megabytes);
+    void setMipmapCacheSize(int megabytes);
     void setWorldEdFiles(const QStringList &fileNames);
     void setHighlightRoomUnderPointer(bool highlight);
     void setEraserBrushSize(int newSize);
@@ -193,6 +201,8 @@ signals:
     void showTileLayersPanelChanged(bool show);
     void backgroundColorChanged(const QColor &color);
     void showAdjacentMapsChanged(bool show);
+    void adjacentMapsMemoryBudgetChanged(int megabytes);
+    void mipmapCacheSizeChanged(int megabytes);
     void worldEdFilesChanged(const QStringList &fileNames);
     void highlightRoomUnderPointerChanged(bool highlight);
     void eraserBrushSizeChanged(int newSize);
@@ -234,6 +244,8 @@ private:
     bool mShowTileLayersPanel;
     QColor mBackgroundColor;
     bool mShowAdjacentMaps;
+    int mAdjacentMapsMemoryBudget;
+    int mMipmapCacheSize;
     QStringList mWorldEdFiles;
     bool mHighlightRoomUnderPointer;
     int mEraserBrushSize;
@@ -0,0 +1,261 @@
+/*
+ * roomgraph.cpp
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "roomgraph.h"
+
+#include <algorithm>
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+namespace {
+
+// Buckets are 16x16 tiles.  Shifting rounds towards minus infinity, so
+// rectangles left of or above the origin work too.
+const int BUCKET_SHIFT = 4;
+
+quint64 bucketKey(int bx, int by)
+{
+    return (quint64(quint32(bx)) << 32) | quint32(by);
+}
+
+template<typename F>
+void forEachBucket(const QRect &r, F f)
+{
+    for (int by = r.top() >> BUCKET_SHIFT; by <= (r.bottom() >> BUCKET_SHIFT); ++by)
+        for (int bx = r.left() >> BUCKET_SHIFT; bx <= (r.right() >> BUCKET_SHIFT); ++bx)
+            f(bucketKey(bx, by));
+}
+
+int findRoot(QVector<int> &parent, int i)
+{
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+// Groups items the way the lot exporter used to, by walking a list and
+// merging lists, so rooms and buildings keep the numbers they had in the
+// lotheader.  Each item in turn starts a new group unless it is in one
+// already, then pulls each of its neighbours into its group, along with the
+// rest of the group the neighbour was in.  Surviving groups keep the place
+// of the item that started them, and their members are in the order they
+// were pulled in.  'neighbours' must be sorted.
+QVector<QVector<int> > mergeInListOrder(const QVector<QVector<int> > &neighbours)
+{
+    const int count = neighbours.size();
+    QVector<int> groupOf(count, -1);
+    QVector<int> parent; // group merged into, for findRoot()
+    QVector<int> head, tail; // first and last member of each group
+    QVector<int> next(count, -1); // next member of the same group
+
+    for (int i = 0; i < count; i++) {
+        if (groupOf[i] == -1) {
+            groupOf[i] = parent.size();
+            parent += parent.size();
+            head += i;
+            tail += i;
+        }
+        const int group = findRoot(parent, groupOf[i]);
+        for (int j : neighbours[i]) {
+            if (groupOf[j] == -1) {
+                groupOf[j] = group;
+                next[tail[group]] = j;
+                tail[group] = j;
+                continue;
+            }
+            const int other = findRoot(parent, groupOf[j]);
+            if (other == group)
+                continue;
+            next[tail[group]] = head[other];
+            tail[group] = tail[other];
+            parent[other] = group;
+        }
+    }
+
+    QVector<QVector<int> > groups;
+    for (int group = 0; group < parent.size(); group++) {
+        if (parent[group] != group)
+            continue;
+        QVector<int> members;
+        for (int i = head[group]; i != -1; i = next[i])
+            members += i;
+        groups += members;
+    }
+    return groups;
+}
+
+bool isTouchingCorners(const QRect &a, const QRect &b)
+{
+    const int ax2 = a.x() + a.width(), ay2 = a.y() + a.height();
+    const int bx2 = b.x() + b.width(), by2 = b.y() + b.height();
+    return (a.x() == bx2 && a.y() == by2) ||
+            (ax2 == b.x() && a.y() == by2) ||
+            (a.x() == bx2 && ay2 == b.y()) ||
+            (ax2 == b.x() && ay2 == b.y());
+}
+
+} // namespace
+
+RoomGraph::RoomGraph()
+{
+}
+
+void RoomGraph::clear()
+{
+    mRects.clear();
+    mRoomOfRect.clear();
+    mRoomRects.clear();
+    mBuildingOfRoom.clear();
+    mBuildingRooms.clear();
+    mBuckets.clear();
+    mBucketsByLevel.clear();
+}
+
+int RoomGraph::addRect(const QRect &bounds, int level, const QString &name)
+{
+    Rect rect;
+    rect.bounds = bounds;
+    rect.level = level;
+    rect.name = name;
+    mRects += rect;
+    return mRects.size() - 1;
+}
+
+void RoomGraph::build()
+{
+    const int count = mRects.size();
+
+    mBuckets.clear();
+    mBucketsByLevel.clear();
+    for (int i = 0; i < count; i++) {
+        QHash<quint64,QVector<int> > &levelBuckets = mBucketsByLevel[mRects[i].level];
+        forEachBucket(mRects[i].bounds, [&](quint64 key) {
+            mBuckets[key] += i;
+            levelBuckets[key] += i;
+        });
+    }
+
+    QVector<QVector<int> > sameRoom(count);
+    QVector<QPair<int,int> > touching;
+
+    // A rectangle spanning several buckets is met once per bucket, 'seen'
+    // remembers which rectangle it was last compared with.
+    QVector<int> seen(count, -1);
+    for (int i = 0; i < count; i++) {
+        const Rect &rr = mRects[i];
+        const QRect near = rr.bounds.adjusted(-1, -1, 1, 1);
+        forEachBucket(near, [&](quint64 key) {
+            QHash<quint64,QVector<int> >::const_iterator it = mBuckets.constFind(key);
+            if (it == mBuckets.constEnd())
+                return;
+            for (int j : it.value()) {
+                if (j <= i || seen[j] == i)
+                    continue;
+                seen[j] = i;
+                const Rect &comp = mRects[j];
+                if (!near.intersects(comp.bounds))
+                    continue;
+                // Rooms whose rectangles touch on any level are in the
+                // same building.
+                touching += qMakePair(i, j);
+                if (inSameRoom(rr, comp)) {
+                    sameRoom[i] += j;
+                    sameRoom[j] += i;
+                }
+            }
+        });
+    }
+
+    // The exporter went through the rectangles level by level, in the order
+    // they were added.
+    QVector<int> order(count);
+    for (int i = 0; i < count; i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return mRects[a].level < mRects[b].level;
+    });
+    QVector<int> position(count);
+    for (int i = 0; i < count; i++)
+        position[order[i]] = i;
+
+    QVector<QVector<int> > neighbours(count);
+    for (int i = 0; i < count; i++) {
+        QVector<int> &n = neighbours[position[i]];
+        for (int j : sameRoom[i])
+            n += position[j];
+        std::sort(n.begin(), n.end());
+    }
+
+    mRoomOfRect.fill(-1, count);
+    mRoomRects = mergeInListOrder(neighbours);
+    for (int room = 0; room < mRoomRects.size(); room++) {
+        for (int &rect : mRoomRects[room]) {
+            rect = order[rect];
+            mRoomOfRect[rect] = room;
+        }
+    }
+
+    // Then through the rooms in the order they were numbered.
+    neighbours.fill(QVector<int>(), mRoomRects.size());
+    for (const QPair<int,int> &pair : qAsConst(touching)) {
+        const int a = mRoomOfRect[pair.first], b = mRoomOfRect[pair.second];
+        if (a != b) {
+            neighbours[a] += b;
+            neighbours[b] += a;
+        }
+    }
+    for (QVector<int> &n : neighbours) {
+        std::sort(n.begin(), n.end());
+        n.erase(std::unique(n.begin(), n.end()), n.end());
+    }
+
+    mBuildingOfRoom.fill(-1, mRoomRects.size());
+    mBuildingRooms = mergeInListOrder(neighbours);
+    for (int building = 0; building < mBuildingRooms.size(); building++) {
+        for (int room : qAsConst(mBuildingRooms[building]))
+            mBuildingOfRoom[room] = building;
+    }
+}
+
+int RoomGraph::roomAt(const QPoint &pos, int level) const
+{
+    QHash<int,QHash<quint64,QVector<int> > >::const_iterator lit = mBucketsByLevel.constFind(level);
+    if (lit == mBucketsByLevel.constEnd())
+        return -1;
+    const quint64 key = bucketKey(pos.x() >> BUCKET_SHIFT, pos.y() >> BUCKET_SHIFT);
+    QHash<quint64,QVector<int> >::const_iterator it = lit.value().constFind(key);
+    if (it == lit.value().constEnd())
+        return -1;
+    for (int i : it.value()) {
+        if (mRects[i].bounds.contains(pos))
+            return mRoomOfRect[i];
+    }
+    return -1;
+}
+
+bool RoomGraph::inSameRoom(const Rect &a, const Rect &b) const
+{
+    if (a.level != b.level) return false;
+    if (a.name != b.name) return false;
+    if (!a.name.contains(QLatin1Char('#'))) return false;
+    return !isTouchingCorners(a.bounds, b.bounds);
+}
@@ -0,0 +1,125 @@
+/*
+ * roomgraph.h
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ROOMGRAPH_H
+#define ROOMGRAPH_H
+
+#include <QHash>
+#include <QRect>
+#include <QString>
+#include <QVector>
+
+namespace Tiled {
+namespace Internal {
+
+/**
+ * Groups RoomDef rectangles into rooms and rooms into buildings.
+ *
+ * Rectangles on the same level with the same name containing '#' that touch
+ * along an edge form one room.  Rooms whose rectangles touch on any level
+ * form one building.  Touching rectangles are found through a grid of
+ * buckets, and the groups are merged with union-find, so the cost grows with
+ * the number of rectangles rather than with its square.  MapBuildings and
+ * NewMapBinaryFile both use this, so the rooms highlighted in the editor are
+ * the rooms written to the lot files.
+ *
+ * Rooms and buildings, and the rectangles and rooms in them, come out in the
+ * order the lot exporter's old list merging gave them, so exported
+ * lotheaders don't change.
+ */
+class RoomGraph
+{
+public:
+    RoomGraph();
+
+    void clear();
+
+    /**
+     * Adds a rectangle and returns its index.  build() must be called before
+     * the rooms and buildings are used again.
+     */
+    int addRect(const QRect &bounds, int level, const QString &name);
+
+    void build();
+
+    int rectCount() const
+    { return mRects.size(); }
+
+    const QRect &rectBounds(int rect) const
+    { return mRects[rect].bounds; }
+
+    int rectLevel(int rect) const
+    { return mRects[rect].level; }
+
+    const QString &rectName(int rect) const
+    { return mRects[rect].name; }
+
+    int roomCount() const
+    { return mRoomRects.size(); }
+
+    int roomOfRect(int rect) const
+    { return mRoomOfRect[rect]; }
+
+    /**
+     * Returns the rectangles in \a room.  The first one is on the room's
+     * level and has its name.
+     */
+    const QVector<int> &roomRects(int room) const
+    { return mRoomRects[room]; }
+
+    int buildingCount() const
+    { return mBuildingRooms.size(); }
+
+    int buildingOfRoom(int room) const
+    { return mBuildingOfRoom[room]; }
+
+    const QVector<int> &buildingRooms(int building) const
+    { return mBuildingRooms[building]; }
+
+    /**
+     * Returns the room containing \a pos on \a level, or -1 if there is none.
+     */
+    int roomAt(const QPoint &pos, int level) const;
+
+private:
+    struct Rect
+    {
+        QRect bounds;
+        int level;
+        QString name;
+    };
+
+    bool inSameRoom(const Rect &a, const Rect &b) const;
+
+    QVector<Rect> mRects;
+    QVector<int> mRoomOfRect;
+    QVector<QVector<int> > mRoomRects;
+    QVector<int> mBuildingOfRoom;
+    QVector<QVector<int> > mBuildingRooms;
+
+    // Rectangle indices by grid bucket, for all levels.
+    QHash<quint64,QVector<int> > mBuckets;
+    // Rectangle indices by level and grid bucket, for roomAt().
+    QHash<int,QHash<quint64,QVector<int> > > mBucketsByLevel;
+};
+
+} // namespace Internal
+} // namespace Tiled
+
+#endif // ROOMGRAPH_H
@@ -24,6 +24,7 @@
 #include "map.h"
 #ifdef ZOMBOID
 #include "mapcomposite.h"
+#include "tilesetmanager.h"
 #endif
 #include "mapdocument.h"
 #include "mapobjectitem.h"
@@ -196,7 +197,7 @@ void SaveAsImageDialog::accept()
             foreach (TileLayer *tl, layerGroup->layers()) {
                 bool isVisible = !visibleLayersOnly ||
                         (layerGroup->isVisible() && layerGroup->isLayerVisible(tl));
-                if (!drawNoRender && tl->name().contains(QLatin1String("NoRender")))
+                if (!drawNoRender && tl->classification().hasRole(LayerClassification::NoRenderRole))
                     isVisible = false;
                 layerGroup->setLayerVisibility(tl, isVisible);
                 if (forceOpacity)
@@ -206,6 +207,12 @@ void SaveAsImageDialog::accept()
         layerGroup->synch();
     }
 
+    // Tileset images are read when first drawn, so read the ones that haven't
+    // been drawn yet now, instead of saving placeholders.
+    QList<Tileset*> usedTilesets = mapComposite->usedTilesets();
+    usedTilesets.removeAll(TilesetManager::instance()->missingTileset());
+    TilesetManager::instance()->waitForTilesets(usedTilesets);
+
     MapRenderer *renderer = mMapDocument->renderer();
 
     // Don't draw empty levels
@@ -247,7 +254,7 @@ void SaveAsImageDialog::accept()
         } else if (TileLayer *tl = zo.layer->asTileLayer()) {
             if (visibleLayersOnly && !tl->isVisible())
                 continue;
-            if (tl->name().contains(QLatin1String("NoRender")))
+            if (tl->classification().hasRole(LayerClassification::NoRenderRole))
                 continue;
             renderer->drawTileLayer(&painter, tl);
         } else if (ObjectGroup *objGroup = zo.layer->asObjectGroup()) {
@@ -146,7 +146,7 @@ bool TexturePacker::pack(const TexturePackSettings &settings)
 
         PackPage packPage;
         packPage.name = QFileInfo(mSettings.mPackFileName).baseName() + QString::number(pageNum);
-        packPage.image = outputImage;
+        packPage.setImage(outputImage);
         foreach (QString index, toPackPage) {
             QRect rectangle1(imagePlacement[index].topLeft(), imageTranslation[index].size);
             QRect rectangle2(imageTranslation[index].topLeft - imageTranslation[index].sheetOffset, imageTranslation[index].originalSize);
@@ -184,7 +184,7 @@ bool TexturePacker::pack(const TexturePackSettings &settings)
 
         PackPage packPage;
         packPage.name = QFileInfo(mSettings.mPackFileName).baseName() + QString::number(pageNum);
-        packPage.image = outputImage;
+        packPage.setImage(outputImage);
         foreach (QString index, toPackPage) {
             QRect rectangle1(imagePlacement[index].topLeft(), imageTranslation[index].size);
             QRect rectangle2(imageTranslation[index].topLeft - imageTranslation[index].sheetOffset, imageTranslation[index].originalSize);
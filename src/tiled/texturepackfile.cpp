@@ -18,13 +18,81 @@
 #include "texturepackfile.h"
 
 #include <QBuffer>
-#include <QDebug>
 #include <QDataStream>
 #include <QFile>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include <limits>
 
 static const int VERSION1 = 1;
 static const int VERSION_LATEST = VERSION1;
 
+// The whole .pack file, memory-mapped when possible.  Pages that haven't
+// been decoded yet hold a reference to this.
+class PackFileData
+{
+public:
+    PackFileData(const QString &fileName) :
+        file(fileName),
+        data(0),
+        size(0)
+    {
+    }
+
+    bool open()
+    {
+        if (!file.open(QIODevice::ReadOnly))
+            return false;
+        size = file.size();
+        data = file.map(0, size);
+        if (!data) {
+            bytes = file.readAll();
+            data = reinterpret_cast<const uchar*>(bytes.constData());
+        }
+        return true;
+    }
+
+    QFile file;
+    QByteArray bytes;
+    const uchar *data;
+    qint64 size;
+};
+
+PackPage::PackPage() :
+    mImage(new ImageData)
+{
+}
+
+QImage PackPage::image() const
+{
+    QMutexLocker locker(&mImage->mutex);
+    if (!mImage->decoded) {
+        mImage->image.loadFromData(mImage->file->data + mImage->offset,
+                                   int(mImage->length), "PNG");
+        mImage->file.clear();
+        mImage->decoded = true;
+    }
+    return mImage->image;
+}
+
+void PackPage::setImage(const QImage &image)
+{
+    QMutexLocker locker(&mImage->mutex);
+    mImage->image = image;
+    mImage->file.clear();
+    mImage->decoded = true;
+}
+
+bool PackPage::isImageDecoded() const
+{
+    QMutexLocker locker(&mImage->mutex);
+    return mImage->decoded;
+}
+
+/////
+
 PackFile::PackFile()
 {
 
@@ -42,38 +110,14 @@ static int readInt(QDataStream &in)
     return ret;
 }
 
-static int chl1 = 0;
-static int chl2 = 0;
-static int chl3 = 0;
-static int chl4 = 0;
-static int readIntByte(QDataStream &in)
-{
-    int ch1 = chl2;
-    int ch2 = chl3;
-    int ch3 = chl4;
-    quint8 ch;
-    in >> ch;
-    int ch4 = ch;
-    chl1 = ch1;
-    chl2 = ch2;
-    chl3 = ch3;
-    chl4 = ch4;
-//    if ((ch1 | ch2 | ch3 | ch4) < 0)
-//        throw new EOFException();
-
-    return ((ch1 << 0) + (ch2 << 8) + (ch3 << 16) + (ch4 << 24));
-}
-
 static QString ReadString(QDataStream &in)
 {
-    QString str;
     int len = readInt(in);
-    for (int n = 0; n < len; n++) {
-        quint8 c;
-        in >> c;
-        str += QLatin1Char(c);
-    }
-    return str;
+    if (len <= 0 || in.status() != QDataStream::Ok)
+        return QString();
+    QByteArray latin1(len, Qt::Uninitialized);
+    in.readRawData(latin1.data(), len);
+    return QString::fromLatin1(latin1);
 }
 
 static void SaveString(QDataStream &out, const QString &str)
@@ -86,16 +130,26 @@ static void SaveString(QDataStream &out, const QString &str)
 bool PackFile::read(const QString &fileName)
 {
     mPages.clear();
+    mSubTextureIndex.clear();
 
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly)) {
+    QSharedPointer<PackFileData> fileData(new PackFileData(fileName));
+    if (!fileData->open()) {
         mError = tr("Error opening file for reading.\n%1").arg(fileName);
         return false;
     }
 
-//    QDir dir = QFileInfo(fileName).absoluteDir();
+    // The offsets below are ints, as in the file format itself, and a
+    // QByteArray can't be bigger than that with Qt 5 either.
+    if (fileData->size > std::numeric_limits<int>::max()) {
+        mError = tr("The file is too big (%1 bytes).\n%2").arg(fileData->size).arg(fileName);
+        return false;
+    }
 
-    QDataStream in(&file);
+    // Only the page and sub-texture headers are read here.  The PNG data of
+    // each page is left in the mapped file until the page's image is used.
+    const QByteArray raw = QByteArray::fromRawData(reinterpret_cast<const char*>(fileData->data),
+                                                   int(fileData->size));
+    QDataStream in(raw);
     in.setByteOrder(QDataStream::LittleEndian);
 
     in.startTransaction();
@@ -119,17 +173,19 @@ bool PackFile::read(const QString &fileName)
         numPages = readInt(in);
     }
 
-    qDebug() << "PackFile: reading" << numPages << "pages";
+    // Version 0 pages have no length, the PNG data ends with 0xDEADBEEF.
+    static const char terminator[] = { char(0xEF), char(0xBE), char(0xAD), char(0xDE) };
+    const QByteArray pageEnd = QByteArray::fromRawData(terminator, 4);
+
     for (int i = 0; i < numPages; i++) {
         PackPage page;
         page.name = ReadString(in);
         int numEntries = readInt(in);
         bool mask = readInt(in) != 0;
-        qDebug() << "PackFile: page=" << page.name << "numEntries=" << numEntries;
+        Q_UNUSED(mask)
 
-        for (int n = 0; n < numEntries; n++) {
+        for (int n = 0; n < numEntries && in.status() == QDataStream::Ok; n++) {
             QString entryName = ReadString(in);
-            qDebug() << entryName;
             int x = readInt(in);
             int y = readInt(in);
             int w = readInt(in);
@@ -141,44 +197,96 @@ bool PackFile::read(const QString &fileName)
             page.mInfo += PackSubTexInfo(x, y, w, h, ox, oy, fx, fy, entryName);
         }
 
+        qint64 offset = in.device()->pos();
+        qint64 length;
         if (version == 0) {
-            QBuffer buf;
-            buf.buffer().reserve(250 * 1024);
-            buf.open(QBuffer::ReadWrite);
-            while (true) {
-                quint32 ii = readIntByte(in);
-                if (ii == 0xDEADBEEF)
-                    break;
-                char ch = ((ii >> 24) & 0xFF);
-                int n = buf.write(&ch, 1);
-                if (n != 1)
-                    break;
+            int end = raw.indexOf(pageEnd, int(offset));
+            if (end == -1) {
+                mError = tr("Missing end of page %1.\n%2").arg(page.name).arg(fileName);
+                mPages.clear();
+                return false;
             }
-
-            qDebug() << "Creating PNG" << page.name << "size=" << buf.size();
-            page.image.loadFromData(buf.buffer(), "PNG");
-
-//            quint32 magic = readInt(in);
-//            if (magic != 0xDEADBEEF) {
-//                mError = tr("Expected 0xDEADBEEF after PNG data");
-//                return false;
-//            }
+            length = end - offset;
+            in.skipRawData(int(length) + pageEnd.size());
         } else {
-            qint32 length = readInt(in);
-            uchar *data = new uchar[length];
-            in.readRawData((char*) data, length);
+            length = readInt(in);
+            offset = in.device()->pos();
+            if (in.skipRawData(int(length)) != length)
+                in.setStatus(QDataStream::ReadPastEnd);
+        }
 
-            qDebug() << "Creating PNG" << page.name << "size=" << length;
-            page.image.loadFromData(data, length, "PNG");
-            delete [] data;
+        if (in.status() != QDataStream::Ok) {
+            mError = tr("Unexpected end of file.\n%1").arg(fileName);
+            mPages.clear();
+            mSubTextureIndex.clear();
+            return false;
         }
 
-        mPages += page;
+        page.mImage->file = fileData;
+        page.mImage->offset = offset;
+        page.mImage->length = length;
+        page.mImage->decoded = false;
+
+        addPage(page);
     }
 
     return true;
 }
 
+void PackFile::addPage(PackPage &page)
+{
+    mPages += page;
+    addToIndex(mPages.size() - 1);
+}
+
+void PackFile::addToIndex(int pageIndex)
+{
+    const PackPage &page = mPages.at(pageIndex);
+    for (int i = 0; i < page.mInfo.size(); i++)
+        mSubTextureIndex.insert(page.mInfo.at(i).name, qMakePair(pageIndex, i));
+}
+
+bool PackFile::findSubTexture(const QString &name, int &pageIndex, int &entryIndex) const
+{
+    QHash<QString,QPair<int,int> >::const_iterator it = mSubTextureIndex.find(name);
+    if (it == mSubTextureIndex.end())
+        return false;
+    pageIndex = it->first;
+    entryIndex = it->second;
+    return true;
+}
+
+namespace {
+
+class DecodePageTask : public QRunnable
+{
+public:
+    DecodePageTask(const PackPage &page) :
+        mPage(page)
+    {
+    }
+
+    void run()
+    {
+        mPage.image();
+    }
+
+private:
+    PackPage mPage;
+};
+
+} // namespace
+
+void PackFile::decodeAllPages()
+{
+    QThreadPool pool;
+    for (const PackPage &page : qAsConst(mPages)) {
+        if (!page.isImageDecoded())
+            pool.start(new DecodePageTask(page));
+    }
+    pool.waitForDone();
+}
+
 bool PackFile::write(const QString &fileName)
 {
     QFile file(fileName);
@@ -214,21 +322,9 @@ bool PackFile::write(const QString &fileName)
         b.buffer().reserve(250 * 1024);
         b.open(QIODevice::WriteOnly);
 //        b.open(QIODevice::ReadWrite);
-        page.image.save(&b, "PNG");
+        page.image().save(&b, "PNG");
         out << qint32(b.buffer().length());
         out.writeRawData(b.buffer().data(), b.buffer().length());
-#if 0
-        b.seek(0L);
-        QDataStream in(&b);
-        long length = b.buffer().length();
-        long read = 0L;
-        while (read < length) {
-            quint32 ii = readIntByte(in);
-            if (ii == 0xDEADBEEF)
-                break;
-            read++;
-        }
-#endif
     }
 
     return true;
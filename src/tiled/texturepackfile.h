@@ -19,7 +19,10 @@
 #define TEXTUREPACKFILE_H
 
 #include <QCoreApplication>
+#include <QHash>
 #include <QImage>
+#include <QMutex>
+#include <QSharedPointer>
 
 class PackSubTexInfo
 {
@@ -40,14 +43,38 @@ public:
     QString name;
 };
 
+class PackFileData;
+
 class PackPage
 {
 public:
+    PackPage();
+
     const QList<PackSubTexInfo> &subTextures() { return mInfo; }
 
+    // Pages read from a .pack file are only decoded the first time their
+    // image is asked for.  Copies of a page share the decoded image.
+    QImage image() const;
+    void setImage(const QImage &image);
+    bool isImageDecoded() const;
+
     QString name;
     QList<PackSubTexInfo> mInfo;
-    QImage image;
+
+private:
+    struct ImageData
+    {
+        ImageData() : offset(0), length(0), decoded(true) {}
+        QMutex mutex;
+        QSharedPointer<PackFileData> file; // keeps the PNG bytes mapped
+        qint64 offset;
+        qint64 length;
+        bool decoded;
+        QImage image;
+    };
+    QSharedPointer<ImageData> mImage;
+
+    friend class PackFile;
 };
 
 class PackFile
@@ -62,11 +89,25 @@ public:
 
     QString errorString() { return mError; }
 
-    void addPage(PackPage &page) { mPages += page; }
+    void addPage(PackPage &page);
     const QList<PackPage> &pages() const { return mPages; }
 
+    /**
+     * Finds a sub-texture by name.  Returns false if there isn't one.
+     */
+    bool findSubTexture(const QString &name, int &pageIndex, int &entryIndex) const;
+
+    /**
+     * Decodes every page that hasn't been decoded yet, several at a time.
+     * Call this before doing something with all the images.
+     */
+    void decodeAllPages();
+
 private:
+    void addToIndex(int pageIndex);
+
     QList<PackPage> mPages;
+    QHash<QString,QPair<int,int> > mSubTextureIndex;
     QString mError;
 };
 
@@ -70,6 +70,7 @@ SOURCES += aboutdialog.cpp \
     automapper.cpp \
     automapperwrapper.cpp \
     automappingmanager.cpp \
+    automappingmatcher.cpp \
     automappingutils.cpp  \
     bmpclipboard.cpp \
     brushitem.cpp \
@@ -87,6 +88,7 @@ SOURCES += aboutdialog.cpp \
     commanddatamodel.cpp \
     commanddialog.cpp \
     commandlineparser.cpp \
+    connectedregions.cpp \
     createobjecttool.cpp \
     documentmanager.cpp \
     editpolygontool.cpp \
@@ -94,6 +96,7 @@ SOURCES += aboutdialog.cpp \
     erasetiles.cpp \
     filesystemwatcher.cpp \
     filltiles.cpp \
+    imagekernels.cpp \
     imagelayeritem.cpp \
     imagelayerpropertiesdialog.cpp \
     languagemanager.cpp \
@@ -139,6 +142,7 @@ SOURCES += aboutdialog.cpp \
     resizelayer.cpp \
     resizemap.cpp \
     resizemapobject.cpp \
+    roomgraph.cpp \
     saveasimagedialog.cpp \
     selectionrectangle.cpp \
     stampbrush.cpp \
@@ -154,6 +158,7 @@ SOURCES += aboutdialog.cpp \
     tilesetmodel.cpp \
     tilesetstxtfile.cpp \
     tilesetview.cpp \
+    tilethumbnailcache.cpp \
     tmxmapreader.cpp \
     tmxmapwriter.cpp \
     toolmanager.cpp \
@@ -219,6 +224,8 @@ SOURCES += aboutdialog.cpp \
     BuildingEditor/buildingtileentryview.cpp \
     bmptool.cpp \
     bmpblender.cpp \
+    bmptotmxconverter.cpp \
+    lotbenchmarks.cpp \
     bmptooldialog.cpp \
     bmpselectionitem.cpp \
     BuildingEditor/buildingpropertiesdialog.cpp \
@@ -287,6 +294,7 @@ HEADERS += aboutdialog.h \
     automapper.h \
     automapperwrapper.h \
     automappingmanager.h \
+    automappingmatcher.h \
     automappingutils.h \
     bmpclipboard.h \
     brushitem.h \
@@ -304,6 +312,7 @@ HEADERS += aboutdialog.h \
     commanddialog.h \
     command.h \
     commandlineparser.h \
+    connectedregions.h \
     createobjecttool.h \
     documentmanager.h \
     editpolygontool.h \
@@ -311,6 +320,7 @@ HEADERS += aboutdialog.h \
     erasetiles.h \
     filesystemwatcher.h \
     filltiles.h \
+    imagekernels.h \
     imagelayeritem.h \
     imagelayerpropertiesdialog.h \
     languagemanager.h \
@@ -359,6 +369,7 @@ HEADERS += aboutdialog.h \
     resizelayer.h \
     resizemap.h \
     resizemapobject.h \
+    roomgraph.h \
     saveasimagedialog.h \
     selectionrectangle.h \
     stampbrush.h \
@@ -374,6 +385,7 @@ HEADERS += aboutdialog.h \
     tilesetmodel.h \
     tilesetstxtfile.h \
     tilesetview.h \
+    tilethumbnailcache.h \
     tmxmapreader.h \
     tmxmapwriter.h \
     toolmanager.h \
@@ -439,6 +451,8 @@ HEADERS += aboutdialog.h \
     BuildingEditor/buildingtileentryview.h \
     bmptool.h \
     bmpblender.h \
+    bmptotmxconverter.h \
+    lotbenchmarks.h \
     bmptooldialog.h \
     bmpselectionitem.h \
     BuildingEditor/buildingpropertiesdialog.h \
@@ -560,6 +574,10 @@ FORMS += aboutdialog.ui \
 
 RESOURCES += tiled.qrc \
     BuildingEditor/buildingeditor.qrc
+tracing {
+    SOURCES += tracingdock.cpp
+    HEADERS += tracingdock.h
+}
 macx {
     TARGET = TileZed
     QMAKE_INFO_PLIST = Info.plist
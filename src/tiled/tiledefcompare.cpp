@@ -190,8 +190,8 @@ void TileDefCompare::saveMerged()
     foreach (TileDefTileset *ts, mMergedFile.tilesets()) {
         foreach (TileDefTile *tile, ts->mTiles) {
             // we copied these in use1()/use2()
-            // normally the UI updates mPropertyUI and then TileDefFile.write() does mPropertyUI.ToProperties()
-            tile->mPropertyUI.FromProperties(tile->mProperties);
+            // normally the UI updates propertyUI() and then TileDefFile.write() does propertyUI().ToProperties()
+            tile->discardPropertyUI();
         }
     }
 
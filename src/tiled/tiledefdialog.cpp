@@ -622,8 +622,8 @@ void TileDefDialog::removeTileset(int index, Tileset **tsPtr, TileDefTileset **d
 QVariant TileDefDialog::changePropertyValue(TileDefTile *defTile, const QString &name,
                                             const QVariant &value)
 {
-    QVariant old = defTile->mPropertyUI.mProperties[name]->value();
-    defTile->mPropertyUI.ChangePropertiesV(name, value);
+    QVariant old = defTile->propertyUI().mProperties[name]->value();
+    defTile->propertyUI().ChangePropertiesV(name, value);
     if (mCurrentDefTileset == defTile->tileset()) {
         setToolTipEtc(defTile->id());
         ui->tiles->update(ui->tiles->model()->index((void*)defTile));
@@ -901,7 +901,7 @@ void TileDefDialog::copyProperties()
         int x = defTile->id() % defTile->tileset()->mColumns;
         int y = defTile->id() / defTile->tileset()->mColumns;
         x -= selectedBounds.left(), y -= selectedBounds.top();
-        mClipboard->setEntry(x, y, defTile->mPropertyUI);
+        mClipboard->setEntry(x, y, defTile->propertyUI());
     }
 
     updateUI();
@@ -960,7 +960,7 @@ void TileDefDialog::resetDefaults()
 {
     QList<TileDefTile*> defTiles;
     foreach (TileDefTile *defTile, mSelectedTiles) {
-        if (defTile->mPropertyUI.nonDefaultProperties().size())
+        if (defTile->propertyUI().nonDefaultProperties().size())
             defTiles += defTile;
     }
     if (defTiles.size()) {
@@ -1267,14 +1267,14 @@ void TileDefDialog::changePropertyValues(const QList<TileDefTile *> &defTiles,
 {
     QList<TileDefTile *> change;
     foreach (TileDefTile *defTile, defTiles) {
-        if (defTile->mPropertyUI.mProperties[name]->value() != value)
+        if (defTile->propertyUI().mProperties[name]->value() != value)
             change += defTile;
     }
     if (change.size()) {
         mUndoStack->beginMacro(tr("Change Property Values"));
         foreach (TileDefTile *defTile, change)
             mUndoStack->push(new ChangePropertyValue(this, defTile,
-                                                     defTile->mPropertyUI.mProperties[name],
+                                                     defTile->propertyUI().mProperties[name],
                                                      value));
         mUndoStack->endMacro();
     }
@@ -1360,14 +1360,14 @@ void TileDefDialog::setToolTipEtc(int tileID)
         return;
     TileDefTile *defTile = mCurrentDefTileset->mTiles[tileID];
     QStringList tooltip;
-    foreach (UIProperties::UIProperty *p, defTile->mPropertyUI.nonDefaultProperties())
+    foreach (UIProperties::UIProperty *p, defTile->propertyUI().nonDefaultProperties())
         tooltip += tr("%1 = %2").arg(p->mName).arg(p->valueAsString());
 
     MixedTilesetModel *m = ui->tiles->model();
 
     // Show .tiles property/value pairs.
     QMap<QString,QString> properties;
-    defTile->mPropertyUI.ToProperties(properties);
+    defTile->propertyUI().ToProperties(properties);
     if (properties.size()) {
         tooltip += QLatin1String("\nOutput:");
         foreach (QString name, properties.keys()) {
@@ -1377,7 +1377,7 @@ void TileDefDialog::setToolTipEtc(int tileID)
 
     // Use a different background color for tiles that have unknown property names.
     QColor color; // invalid means use default color
-    QStringList knownPropertyNames = defTile->mPropertyUI.knownPropertyNames();
+    QStringList knownPropertyNames = defTile->propertyUI().knownPropertyNames();
     QSet<QString> known(knownPropertyNames.begin(), knownPropertyNames.end()); // FIXME: same for every tile
     QStringList unknown;
     foreach (QString name, defTile->mProperties.keys()) {
@@ -1437,7 +1437,7 @@ void TileDefDialog::highlightTilesWithMatchingProperties(TileDefTile *defTile)
 
     // Get the properties on the given tile.  Exit if properties is nil.
     QMap<QString,QString> props = defTile->mProperties;
-    defTile->mPropertyUI.ToProperties(props);
+    defTile->propertyUI().ToProperties(props);
     if (props.isEmpty())
         return;
     mTilesWithMatchingProperties += defTile;
@@ -1449,7 +1449,7 @@ void TileDefDialog::highlightTilesWithMatchingProperties(TileDefTile *defTile)
             continue;
 
         QMap<QString,QString> props2 = defTile2->mProperties;
-        defTile2->mPropertyUI.ToProperties(props2);
+        defTile2->propertyUI().ToProperties(props2);
         if (props == props2)
             mTilesWithMatchingProperties.insert(defTile2);
     }
@@ -1465,7 +1465,7 @@ void TileDefDialog::highlightTilesWithMatchingProperties(TileDefTile *defTile)
 
 void TileDefDialog::resetDefaults(TileDefTile *defTile)
 {
-    QList<UIProperties::UIProperty*> props = defTile->mPropertyUI.nonDefaultProperties();
+    QList<UIProperties::UIProperty*> props = defTile->propertyUI().nonDefaultProperties();
     if (props.size() == 0)
         return;
 
@@ -1570,7 +1570,7 @@ void TileDefDialog::initStringComboBoxValues()
 
     foreach (TileDefTileset *ts, mTileDefFile->tilesets()) {
         foreach (TileDefTile *t, ts->mTiles) {
-            foreach (UIProperties::UIProperty *p, t->mPropertyUI.mProperties) {
+            foreach (UIProperties::UIProperty *p, t->propertyUI().mProperties) {
                 if (p->getString().length())
                     values[p->mName].insert(p->getString());
             }
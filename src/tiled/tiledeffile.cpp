@@ -26,7 +26,9 @@
 #include <QDataStream>
 #include <QDir>
 #include <QFile>
+#include <QHash>
 #include <QImageReader>
+#include <QtEndian>
 
 using namespace Tiled;
 using namespace Tiled::Internal;
@@ -40,17 +42,72 @@ TileDefFile::~TileDefFile()
     qDeleteAll(mTilesets);
 }
 
-static QString ReadString(QDataStream &in)
+namespace {
+
+/**
+ * Reads a .tiles file that has been loaded into memory.  Property names and
+ * values repeat across thousands of tiles, so equal strings share one
+ * QString.  Reading past the end sets overrun() instead of returning garbage.
+ */
+class TileDefReader
 {
-    QString str;
-    quint8 c = ' ';
-    while (c != '\n') {
-        in >> c;
-        if (c != '\n')
-            str += QLatin1Char(c);
+public:
+    TileDefReader(const QByteArray &data) :
+        mPos(data.constData()),
+        mEnd(data.constData() + data.size()),
+        mOverrun(false)
+    {
+    }
+
+    bool readMagic(const char *magic)
+    {
+        if (mEnd - mPos < 4 || memcmp(mPos, magic, 4) != 0)
+            return false;
+        mPos += 4;
+        return true;
+    }
+
+    qint32 readInt()
+    {
+        if (mEnd - mPos < 4) {
+            mPos = mEnd;
+            mOverrun = true;
+            return 0;
+        }
+        qint32 value = qFromLittleEndian<qint32>(reinterpret_cast<const uchar*>(mPos));
+        mPos += 4;
+        return value;
+    }
+
+    QString readString()
+    {
+        const char *eol = static_cast<const char*>(memchr(mPos, '\n', mEnd - mPos));
+        if (!eol) {
+            mPos = mEnd;
+            mOverrun = true;
+            return QString();
+        }
+        QByteArray key = QByteArray::fromRawData(mPos, eol - mPos);
+        mPos = eol + 1;
+        QHash<QByteArray,QString>::const_iterator it = mStrings.constFind(key);
+        if (it != mStrings.constEnd())
+            return it.value();
+        QString str = QString::fromLatin1(key.constData(), key.size());
+        mStrings.insert(QByteArray(key.constData(), key.size()), str);
+        return str;
     }
-    return str;
-}
+
+    bool overrun() const
+    { return mOverrun; }
+
+private:
+    const char *mPos;
+    const char *mEnd;
+    bool mOverrun;
+    QHash<QByteArray,QString> mStrings;
+};
+
+} // namespace
 
 #define VERSION0 0
 #define VERSION1 1
@@ -70,69 +127,73 @@ bool TileDefFile::read(const QString &fileName)
 
     QDir dir = QFileInfo(fileName).absoluteDir();
 
-    QDataStream in(&file);
-    in.setByteOrder(QDataStream::LittleEndian);
+    QByteArray data = file.readAll();
+    file.close();
+    TileDefReader in(data);
 
-    quint8 tdef[4] = {0};
-    in >> tdef[0];
-    in >> tdef[1];
-    in >> tdef[2];
-    in >> tdef[3];
     int version = VERSION0;
-    if (memcmp(tdef, "tdef", 4) == 0) {
-        in >> version;
+    if (in.readMagic("tdef")) {
+        version = in.readInt();
         if (version < 0 || version > VERSION_LATEST) {
             mError = tr("Unknown version number %1 in .tiles file.\n%2")
                     .arg(version).arg(fileName);
             return false;
         }
-    } else
-        file.seek(0);
+    }
 
-    int numTilesets;
-    in >> numTilesets;
-    for (int i = 0; i < numTilesets; i++) {
+    int numTilesets = in.readInt();
+    for (int i = 0; i < numTilesets && !in.overrun(); i++) {
         TileDefTileset *ts = new TileDefTileset;
-        ts->mName = ReadString(in);
-        ts->mImageSource = ReadString(in); // no path, just file + extension
-        qint32 columns, rows;
-        in >> columns;
-        in >> rows;
+        ts->mName = in.readString();
+        ts->mImageSource = in.readString(); // no path, just file + extension
+        qint32 columns = in.readInt();
+        qint32 rows = in.readInt();
 
         qint32 id = i + 1;
         if (version > VERSION0)
-            in >> id;
+            id = in.readInt();
 
-        qint32 tileCount;
-        in >> tileCount;
+        qint32 tileCount = in.readInt();
 
         ts->mColumns = columns;
         ts->mRows = rows;
         ts->mID = id;
 
         QVector<TileDefTile*> tiles(columns * rows);
-        for (int j = 0; j < tileCount; j++) {
+        for (int j = 0; j < tileCount && !in.overrun(); j++) {
             TileDefTile *tile = new TileDefTile(ts, j);
-            qint32 numProperties;
-            in >> numProperties;
+            qint32 numProperties = in.readInt();
             QMap<QString,QString> properties;
-            for (int k = 0; k < numProperties; k++) {
-                QString propertyName = ReadString(in);
-                QString propertyValue = ReadString(in);
+            for (int k = 0; k < numProperties && !in.overrun(); k++) {
+                QString propertyName = in.readString();
+                QString propertyValue = in.readString();
                 properties[propertyName] = propertyValue;
             }
             TilePropertyMgr::instance()->modify(properties);
-            tile->mPropertyUI.FromProperties(properties);
+            // The UIProperties are created by TileDefTile::propertyUI() when needed.
             tile->mProperties = properties;
-            tiles[j] = tile;
+            if (j < tiles.size())
+                tiles[j] = tile;
+            else
+                delete tile;
         }
-        for (int j = tileCount; j < tiles.size(); j++) {
-            tiles[j] = new TileDefTile(ts, j);
+        for (int j = qMin(tileCount, tiles.size()); j < tiles.size(); j++) {
+            if (!tiles[j])
+                tiles[j] = new TileDefTile(ts, j);
         }
         ts->mTiles = tiles;
+        if (in.overrun()) {
+            delete ts;
+            break;
+        }
         insertTileset(mTilesets.size(), ts);
     }
 
+    if (in.overrun()) {
+        mError = tr("Unexpected end of .tiles file.\n%1").arg(fileName);
+        return false;
+    }
+
     mFileName = fileName;
 
     return true;
@@ -140,9 +201,9 @@ bool TileDefFile::read(const QString &fileName)
 
 static void SaveString(QDataStream& out, const QString& str)
 {
-    for (int i = 0; i < str.length(); i++)
-        out << quint8(str[i].toLatin1());
-    out << quint8('\n');
+    QByteArray latin1 = str.toLatin1();
+    latin1 += '\n';
+    out.writeRawData(latin1.constData(), latin1.size());
 }
 
 bool TileDefFile::write(const QString &fileName)
@@ -153,12 +214,18 @@ bool TileDefFile::write(const QString &fileName)
         return false;
     }
 
-    QDataStream out(&file);
+    // Build the whole file in memory and write it out in one go.
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
     out.setByteOrder(QDataStream::LittleEndian);
 
     out << quint8('t') << quint8('d') << quint8('e') << quint8('f');
     out << qint32(VERSION_LATEST);
 
+    // Tiles whose properties were never looked at still go through
+    // UIProperties so the saved properties are the same as before.
+    UIProperties scratchUI;
+
     out << qint32(mTilesets.size());
     foreach (TileDefTileset *ts, mTilesets) {
         SaveString(out, ts->mName);
@@ -169,15 +236,26 @@ bool TileDefFile::write(const QString &fileName)
         out << qint32(ts->mTiles.size());
         foreach (TileDefTile *tile, ts->mTiles) {
             QMap<QString,QString> &properties = tile->mProperties;
-            tile->mPropertyUI.ToProperties(properties);
+            if (tile->hasPropertyUI()) {
+                tile->propertyUI().ToProperties(properties);
+            } else {
+                scratchUI.FromProperties(properties);
+                scratchUI.ToProperties(properties);
+            }
             out << qint32(properties.size());
-            foreach (QString key, properties.keys()) {
-                SaveString(out, key);
-                SaveString(out, properties[key]);
+            QMap<QString,QString>::const_iterator it = properties.constBegin();
+            for (; it != properties.constEnd(); ++it) {
+                SaveString(out, it.key());
+                SaveString(out, it.value());
             }
         }
     }
 
+    if (file.write(data) != data.size()) {
+        mError = tr("Error writing .tiles file.\n%1").arg(file.errorString());
+        return false;
+    }
+
     return true;
 }
 
@@ -762,45 +762,80 @@ public:
     TileDefTile(TileDefTileset *tileset, int id) :
         mTileset(tileset),
         mID(id),
-        mPropertyUI()
+        mPropertyUI(0)
     {
     }
 
+    ~TileDefTile()
+    {
+        delete mPropertyUI;
+    }
+
     TileDefTileset *tileset() const { return mTileset; }
     int id() const { return mID; }
 
+    /**
+     * The editable form of this tile's properties.  A .tiles file has tens
+     * of thousands of tiles and most are never edited, so this is only
+     * created, from mProperties, the first time it is used.
+     */
+    UIProperties &propertyUI()
+    {
+        if (!mPropertyUI) {
+            mPropertyUI = new UIProperties;
+            mPropertyUI->FromProperties(mProperties);
+        }
+        return *mPropertyUI;
+    }
+
+    bool hasPropertyUI() const
+    { return mPropertyUI != 0; }
+
+    /**
+     * Call this after changing mProperties directly, so propertyUI() is
+     * recreated from the new properties.
+     */
+    void discardPropertyUI()
+    {
+        delete mPropertyUI;
+        mPropertyUI = 0;
+    }
+
     UIProperties::UIProperty *property(const QString &name)
-    { return mPropertyUI.property(name); }
+    { return propertyUI().property(name); }
 
     bool getBoolean(const QString &name)
     {
-        return mPropertyUI.getBoolean(name);
+        return propertyUI().getBoolean(name);
     }
 
     int getInteger(const QString &name)
     {
-        return mPropertyUI.getInteger(name);
+        return propertyUI().getInteger(name);
     }
 
     QString getString(const QString &name)
     {
-        return mPropertyUI.getString(name);
+        return propertyUI().getString(name);
     }
 
     QString getEnum(const QString &name)
     {
-        return mPropertyUI.getEnum(name);
+        return propertyUI().getEnum(name);
     }
 
     TileDefTileset *mTileset;
     int mID;
-    UIProperties mPropertyUI;
 
     // This is to preserve all the properties that were in the .tiles file
     // for this tile.  If TileProperties.txt changes so that these properties
     // can't be edited they will still persist in the .tiles file.
     // TODO: add a way to report/clean out obsolete properties.
     QMap<QString,QString> mProperties;
+
+private:
+    Q_DISABLE_COPY(TileDefTile)
+    UIProperties *mPropertyUI;
 };
 
 class TileDefTileset
@@ -31,6 +31,8 @@
 #include <QImage>
 #include <QImageReader>
 
+#include <algorithm>
+
 using namespace Tiled;
 using namespace Tiled::Internal;
 
@@ -193,8 +195,9 @@ bool TileMetaInfoMgr::readTxt()
 
         TilesetMetaInfo *info = new TilesetMetaInfo;
         for (const TilesetsTxtFile::Tile& fileTile : fileTileset->mTiles) {
-            QString coordString = QString(QLatin1String("%1,%2")).arg(fileTile.mX).arg(fileTile.mY);
-            info->mInfo[coordString].mMetaGameEnum = fileTile.mMetaEnum;
+            TileMetaInfo tileInfo;
+            tileInfo.mMetaGameEnum = fileTile.mMetaEnum;
+            info->setInfo(fileTile.mX, fileTile.mY, tileInfo);
         }
         mTilesetInfo[fileTileset->mName] = info;
     }
@@ -246,15 +249,12 @@ bool TileMetaInfoMgr::writeTxt()
         fileTileset->mColumns = columns;
         fileTileset->mRows = rows;
 
-        if (mTilesetInfo.contains(tileset->name())) {
-            QMap<QString,TileMetaInfo> &info = mTilesetInfo[tileset->name()]->mInfo;
-            for (const QString& key : info.keys()) {
-                Q_ASSERT(info[key].mMetaGameEnum.isEmpty() == false);
-                if (info[key].mMetaGameEnum.isEmpty())
-                    continue;
+        if (TilesetMetaInfo *info = mTilesetInfo.value(tileset->name())) {
+            for (const QPoint &pos : info->positions()) {
                 TilesetsTxtFile::Tile fileTile;
-                parse2Ints(key, &fileTile.mX, &fileTile.mY);
-                fileTile.mMetaEnum = info[key].mMetaGameEnum;
+                fileTile.mX = pos.x();
+                fileTile.mY = pos.y();
+                fileTile.mMetaEnum = info->info(pos.x(), pos.y())->mMetaGameEnum;
                 fileTileset->mTiles += fileTile;
             }
         }
@@ -373,24 +373,24 @@ bool TileMetaInfoMgr::readTxt()
             TilesetMetaInfo *info = new TilesetMetaInfo;
             foreach (SimpleFileBlock tileBlock, block.blocks) {
                 if (tileBlock.name == QLatin1String("tile")) {
-                    QString coordString;
+                    int column = -1, row = -1;
                     foreach (SimpleFileKeyValue kv, tileBlock.values) {
                         if (kv.name == QLatin1String("xy")) {
-                            int column, row;
                             if (!parse2Ints(kv.value, &column, &row) ||
                                     (column < 0) || (row < 0)) {
                                 mError = tr("Invalid %1 = %2").arg(kv.name).arg(kv.value);
                                 return false;
                             }
-                            coordString = kv.value;
                         } else if (kv.name == QLatin1String("meta-enum")) {
                             QString enumName = kv.value;
                             if (!mEnums.contains(enumName)) {
                                 mError = tr("Unknown enum '%1'").arg(enumName);
                                 return false;
                             }
-                            Q_ASSERT(!coordString.isEmpty());
-                            info->mInfo[coordString].mMetaGameEnum = enumName;
+                            Q_ASSERT(column != -1);
+                            TileMetaInfo tileInfo;
+                            tileInfo.mMetaGameEnum = enumName;
+                            info->setInfo(column, row, tileInfo);
                         } else {
                             mError = tr("Unknown value name '%1'.").arg(kv.name);
                             return false;
@@ -456,16 +456,12 @@ bool TileMetaInfoMgr::writeTxt()
         }
         tilesetBlock.addValue("size", QString(QLatin1String("%1,%2")).arg(columns).arg(rows));
 
-        if (mTilesetInfo.contains(tileset->name())) {
-            QMap<QString,TileMetaInfo> &info = mTilesetInfo[tileset->name()]->mInfo;
-            foreach (QString key, info.keys()) {
-                Q_ASSERT(info[key].mMetaGameEnum.isEmpty() == false);
-                if (info[key].mMetaGameEnum.isEmpty())
-                    continue;
+        if (TilesetMetaInfo *info = mTilesetInfo.value(tileset->name())) {
+            foreach (QPoint pos, info->positions()) {
                 SimpleFileBlock tileBlock;
                 tileBlock.name = QLatin1String("tile");
-                tileBlock.addValue("xy", key);
-                tileBlock.addValue("meta-enum", info[key].mMetaGameEnum);
+                tileBlock.addValue("xy", QString(QLatin1String("%1,%2")).arg(pos.x()).arg(pos.y()));
+                tileBlock.addValue("meta-enum", info->info(pos.x(), pos.y())->mMetaGameEnum);
                 tilesetBlock.blocks += tileBlock;
             }
         }
@@ -576,7 +572,7 @@ bool TileMetaInfoMgr::addNewTilesets()
     QFileInfoList fileInfoList = dir.entryInfoList(nameFilters);
     foreach (QFileInfo fileInfo, fileInfoList) {
         QString tilesetName = fileInfo.completeBaseName();
-        if (mTilesetByName.contains(tilesetName))
+        if (indexOf(tilesetName) != -1)
             continue;
         QImageReader ir(fileInfo.absoluteFilePath());
         if (!ir.size().isValid())
@@ -633,8 +629,14 @@ bool TileMetaInfoMgr::loadTilesetImage(Tileset *ts, const QString &source)
 
 void TileMetaInfoMgr::addTileset(Tileset *tileset)
 {
-    Q_ASSERT(mTilesetByName.contains(tileset->name()) == false);
-    mTilesetByName[tileset->name()] = tileset;
+    Q_ASSERT(indexOf(tileset->name()) == -1);
+    QList<Tileset*>::iterator it = std::lower_bound(mTilesets.begin(), mTilesets.end(), tileset,
+                                                    [](Tileset *a, Tileset *b) {
+        return a->name() < b->name();
+    });
+    int index = int(it - mTilesets.begin());
+    mTilesets.insert(index, tileset);
+    indexTilesets(index);
     if (!mRemovedTilesets.contains(tileset))
         TilesetManager::instance()->addReference(tileset);
     mRemovedTilesets.removeAll(tileset);
@@ -643,10 +645,14 @@ void TileMetaInfoMgr::addTileset(Tileset *tileset)
 
 void TileMetaInfoMgr::removeTileset(Tileset *tileset)
 {
-    Q_ASSERT(mTilesetByName.contains(tileset->name()));
+    Q_ASSERT(indexOf(tileset) != -1);
     Q_ASSERT(mRemovedTilesets.contains(tileset) == false);
     emit tilesetAboutToBeRemoved(tileset);
-    mTilesetByName.remove(tileset->name());
+    int index = indexOf(tileset);
+    mTilesets.removeAt(index);
+    mIndexByName.remove(tileset->name());
+    mIndexOfTileset.remove(tileset);
+    indexTilesets(index);
     emit tilesetRemoved(tileset);
 
     // Don't remove references now, that will delete the tileset, and the
@@ -694,29 +700,29 @@ void TileMetaInfoMgr::tilesetChanged(Tileset *ts)
 
 void TileMetaInfoMgr::setTileEnum(Tile *tile, const QString &enumName)
 {
-    QString key = TilesetMetaInfo::key(tile);
+    QPoint pos = TilesetMetaInfo::position(tile);
     QString tilesetName = tile->tileset()->name();
     if (enumName.isEmpty()) {
-        if (mTilesetInfo.contains(tilesetName))
-            mTilesetInfo[tilesetName]->mInfo.remove(key);
+        if (TilesetMetaInfo *info = mTilesetInfo.value(tilesetName))
+            info->removeInfo(pos.x(), pos.y());
         return;
     }
     if (!mTilesetInfo.contains(tilesetName))
         mTilesetInfo[tilesetName] = new TilesetMetaInfo;
-    TilesetMetaInfo *info = mTilesetInfo[tilesetName];
-    info->mInfo[key].mMetaGameEnum = enumName;
+    TileMetaInfo tileInfo;
+    tileInfo.mMetaGameEnum = enumName;
+    mTilesetInfo[tilesetName]->setInfo(pos.x(), pos.y(), tileInfo);
 }
 
 QString TileMetaInfoMgr::tileEnum(Tile *tile)
 {
-    QString tilesetName = tile->tileset()->name();
-    if (!mTilesetInfo.contains(tilesetName))
-        return QString();
-    QString key = TilesetMetaInfo::key(tile);
-    TilesetMetaInfo *info = mTilesetInfo[tilesetName];
-    if (!info->mInfo.contains(key))
+    TilesetMetaInfo *info = mTilesetInfo.value(tile->tileset()->name());
+    if (!info)
         return QString();
-    return info->mInfo[key].mMetaGameEnum;
+    QPoint pos = TilesetMetaInfo::position(tile);
+    if (const TileMetaInfo *tileInfo = info->info(pos.x(), pos.y()))
+        return tileInfo->mMetaGameEnum;
+    return QString();
 }
 
 int TileMetaInfoMgr::tileEnumValue(Tile *tile)
@@ -763,11 +769,84 @@ bool TileMetaInfoMgr::parse2Ints(const QString &s, int *pa, int *pb)
     return true;
 }
 
+// Updates the index of every tileset from position 'first' on, after one was
+// inserted or removed there.  Tilesets.txt is written sorted by name, so
+// while it is read each tileset is added at the end and nothing else moves.
+void TileMetaInfoMgr::indexTilesets(int first)
+{
+    for (int i = first; i < mTilesets.size(); i++) {
+        mIndexByName.insert(mTilesets[i]->name(), i);
+        mIndexOfTileset.insert(mTilesets[i], i);
+    }
+}
+
 /////
 
-QString TilesetMetaInfo::key(Tile *tile)
+TilesetMetaInfo::TilesetMetaInfo() :
+    mColumns(0),
+    mRows(0)
+{
+}
+
+const TileMetaInfo *TilesetMetaInfo::info(int column, int row) const
+{
+    if (column < 0 || column >= mColumns || row < 0 || row >= mRows)
+        return nullptr;
+    const TileMetaInfo &info = mInfo[row * mColumns + column];
+    return info.mMetaGameEnum.isEmpty() ? nullptr : &info;
+}
+
+void TilesetMetaInfo::setInfo(int column, int row, const TileMetaInfo &info)
+{
+    Q_ASSERT(column >= 0 && row >= 0);
+    if (column >= mColumns || row >= mRows) {
+        int columns = qMax(mColumns, column + 1);
+        int rows = qMax(mRows, row + 1);
+        QVector<TileMetaInfo> resized(columns * rows);
+        for (int y = 0; y < mRows; y++)
+            for (int x = 0; x < mColumns; x++)
+                resized[y * columns + x] = mInfo[y * mColumns + x];
+        mInfo = resized;
+        mColumns = columns;
+        mRows = rows;
+    }
+    mInfo[row * mColumns + column] = info;
+}
+
+void TilesetMetaInfo::removeInfo(int column, int row)
+{
+    if (column < 0 || column >= mColumns || row < 0 || row >= mRows)
+        return;
+    mInfo[row * mColumns + column] = TileMetaInfo();
+}
+
+QList<QPoint> TilesetMetaInfo::positions() const
+{
+    // Tilesets.txt used to be written from a map keyed by "column,row", keep
+    // that order so the file doesn't change for no reason.
+    QList<QPair<QString,QPoint> > keys;
+    for (int row = 0; row < mRows; row++) {
+        for (int column = 0; column < mColumns; column++) {
+            if (mInfo[row * mColumns + column].mMetaGameEnum.isEmpty())
+                continue;
+            keys += qMakePair(QString(QLatin1String("%1,%2")).arg(column).arg(row),
+                              QPoint(column, row));
+        }
+    }
+    std::sort(keys.begin(), keys.end(), [](const QPair<QString,QPoint> &a,
+              const QPair<QString,QPoint> &b) {
+        return a.first < b.first;
+    });
+
+    QList<QPoint> ret;
+    for (const QPair<QString,QPoint> &key : keys)
+        ret += key.second;
+    return ret;
+}
+
+QPoint TilesetMetaInfo::position(Tile *tile)
 {
     int column = tile->id() % tile->tileset()->columnCount();
     int row = tile->id() / tile->tileset()->columnCount();
-    return QString(QLatin1String("%1,%2")).arg(column).arg(row);
+    return QPoint(column, row);
 }
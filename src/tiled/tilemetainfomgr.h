@@ -20,9 +20,12 @@
 #ifndef TILEMETAINFOMGR_H
 #define TILEMETAINFOMGR_H
 
+#include <QHash>
 #include <QMap>
 #include <QObject>
+#include <QPoint>
 #include <QStringList>
+#include <QVector>
 
 namespace Tiled {
 
@@ -37,13 +40,39 @@ public:
     QString mMetaGameEnum;
 };
 
+/**
+ * The meta info of the tiles in one tileset, kept in one array, row by row.
+ * Tiles are identified by column and row, not by id, so the info stays with
+ * the right tiles when the tileset turns out to have a different width than
+ * Tilesets.txt said.
+ */
 class TilesetMetaInfo
 {
 public:
+    TilesetMetaInfo();
+
     QString mTilesetName;
-    QMap<QString,TileMetaInfo> mInfo; // index is "column,row"
 
-    static QString key(Tile *tile);
+    /**
+     * Returns the info of the tile at \a column, \a row, or null if it has
+     * none.
+     */
+    const TileMetaInfo *info(int column, int row) const;
+    void setInfo(int column, int row, const TileMetaInfo &info);
+    void removeInfo(int column, int row);
+
+    /**
+     * Returns the position of every tile with info, in the order they are
+     * written to Tilesets.txt.
+     */
+    QList<QPoint> positions() const;
+
+    static QPoint position(Tile *tile);
+
+private:
+    int mColumns;
+    int mRows;
+    QVector<TileMetaInfo> mInfo; // an empty mMetaGameEnum means no info
 };
 
 class TileMetaInfoMgr : public QObject
@@ -59,28 +88,26 @@ public:
     QString tilesDirectory() const;
     QString tiles2xDirectory() const;
 
-    QList<Tileset*> tilesets() const
-    { return mTilesetByName.values(); }
+    /**
+     * Returns the tilesets sorted by name.
+     */
+    const QList<Tileset*> &tilesets() const
+    { return mTilesets; }
 
     Tileset *tileset(int n) const
-    { return tilesets().at(n); }
+    { return mTilesets.at(n); }
 
     Tileset *tileset(const QString &tilesetName)
     {
-        if (mTilesetByName.contains(tilesetName))
-            return mTilesetByName[tilesetName];
-        return nullptr;
+        int index = indexOf(tilesetName);
+        return (index == -1) ? nullptr : mTilesets.at(index);
     }
 
     int indexOf(Tileset *ts)
-    { return tilesets().indexOf(ts); }
+    { return mIndexOfTileset.value(ts, -1); }
 
     int indexOf(const QString &tilesetName)
-    {
-        if (mTilesetByName.contains(tilesetName))
-            return tilesets().indexOf(mTilesetByName[tilesetName]);
-        return -1;
-    }
+    { return mIndexByName.value(tilesetName, -1); }
 
     QStringList tilesetNames() const;
 
@@ -134,18 +161,21 @@ private slots:
 
 private:
     bool parse2Ints(const QString &s, int *pa, int *pb);
+    void indexTilesets(int first);
 
 private:
     static TileMetaInfoMgr *mInstance;
     TileMetaInfoMgr(QObject *parent = nullptr);
     ~TileMetaInfoMgr();
 
-    QMap<QString,Tileset*> mTilesetByName;
+    QList<Tileset*> mTilesets; // sorted by name
+    QHash<QString,int> mIndexByName;
+    QHash<Tileset*,int> mIndexOfTileset;
     QList<Tiled::Tileset*> mRemovedTilesets;
 
     QStringList mEnumNames;
     QMap<QString,int> mEnums;
-    QMap<QString,TilesetMetaInfo*> mTilesetInfo;
+    QHash<QString,TilesetMetaInfo*> mTilesetInfo;
 
     int mRevision;
     int mSourceRevision;
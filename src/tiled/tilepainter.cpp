@@ -21,10 +21,13 @@
 
 #include "tilepainter.h"
 
+#include "connectedregions.h"
 #include "mapdocument.h"
 #include "tilelayer.h"
 #include "map.h"
 
+#include <QHash>
+
 using namespace Tiled;
 using namespace Tiled::Internal;
 
@@ -290,6 +293,45 @@ QRegion TilePainter::computeFillRegion(const QPoint &fillOrigin) const
     return fillRegion;
 }
 
+void TilePainter::computeFillRegions(ConnectedRegions &regions) const
+{
+    const int width = mTileLayer->width();
+    const int height = mTileLayer->height();
+
+    // Cells outside the selection aren't drawable.
+    QBitArray excluded;
+    const QRegion &selection = mMapDocument->tileSelection();
+    if (!selection.isEmpty()) {
+        excluded.fill(true, width * height);
+        const QRegion layerSelection = selection.translated(-mTileLayer->x(),
+                                                            -mTileLayer->y())
+                & QRect(0, 0, width, height);
+        for (const QRect &r : layerSelection) {
+            for (int y = r.top(); y <= r.bottom(); ++y)
+                excluded.fill(false, y * width + r.left(), y * width + r.right() + 1);
+        }
+    }
+
+    // Give each distinct cell a number.
+    QVector<quint32> values(width * height);
+    QHash<QPair<Tile*,int>,quint32> cellIds;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const Cell &cell = mTileLayer->cellAt(x, y);
+            const QPair<Tile*,int> key(cell.tile,
+                                       (cell.flippedHorizontally ? 1 : 0) |
+                                       (cell.flippedVertically ? 2 : 0) |
+                                       (cell.flippedAntiDiagonally ? 4 : 0));
+            QHash<QPair<Tile*,int>,quint32>::const_iterator it = cellIds.constFind(key);
+            if (it == cellIds.constEnd())
+                it = cellIds.insert(key, cellIds.size());
+            values[y * width + x] = it.value();
+        }
+    }
+
+    regions.compute(values, width, height, ConnectedRegions::FourWay, excluded);
+}
+
 bool TilePainter::isDrawable(int x, int y) const
 {
     const QRegion &selection = mMapDocument->tileSelection();
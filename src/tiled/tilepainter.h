@@ -31,6 +31,7 @@ class TileLayer;
 
 namespace Internal {
 
+class ConnectedRegions;
 class MapDocument;
 
 /**
@@ -100,6 +101,13 @@ public:
      */
     QRegion computeFillRegion(const QPoint &fillOrigin) const;
 
+    /**
+     * Labels every region computeFillRegion() could return at once, so the
+     * fill region for any cell can be looked up in \a regions.  The labels
+     * are in layer coordinates.
+     */
+    void computeFillRegions(ConnectedRegions &regions) const;
+
     /**
      * Returns true if the given cell is drawable.
      */
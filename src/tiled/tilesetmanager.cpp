@@ -23,13 +23,16 @@
 
 #include "filesystemwatcher.h"
 #include "tileset.h"
+#include "tracing.h"
 
 #include <QImage>
 #ifdef ZOMBOID
 #include "preferences.h"
 #include "tile.h"
+#include "tilethumbnailcache.h"
 #include <QDebug>
 #include <QDir>
+#include <QEventLoop>
 #include <QImageReader>
 #include <QMetaType>
 #endif
@@ -42,6 +45,7 @@ TilesetManager *TilesetManager::mInstance = 0;
 TilesetManager::TilesetManager():
 #ifdef ZOMBOID
     mTilesetImageCache(new TilesetImageCache),
+    mThumbnailCache(new TileThumbnailCache(this)),
 #endif
     mWatcher(new FileSystemWatcher(this)),
     mReloadTilesetsOnChange(false)
@@ -77,6 +81,8 @@ TilesetManager::TilesetManager():
 
     qRegisterMetaType<Tileset*>("Tileset*");
 
+    Tileset::setImageRequestHandler(&TilesetManager::imageRequested);
+
     mImageReaderThreads.resize(8);
     mImageReaderWorkers.resize(mImageReaderThreads.size());
     mNextThreadForJob = 0;
@@ -90,6 +96,9 @@ TilesetManager::TilesetManager():
     }
 
     mReloadTilesetsOnChange = Preferences::instance()->reloadTilesetsOnChange();
+
+    connect(this, &TilesetManager::tilesetChanged,
+            mThumbnailCache, &TileThumbnailCache::tilesetChanged);
 #endif
 
     connect(mWatcher, &FileSystemWatcher::fileChanged,
@@ -105,6 +114,7 @@ TilesetManager::TilesetManager():
 TilesetManager::~TilesetManager()
 {
 #ifdef ZOMBOID
+    Tileset::setImageRequestHandler(0);
     removeReference(mMissingTileset);
     removeReference(mNoBlendTileset);
     for (int i = 0; i < mImageReaderThreads.size(); i++) {
@@ -185,7 +195,9 @@ void TilesetManager::addReference(Tileset *tileset)
 #endif
 
 #ifdef ZOMBOID
-    loadTileset(tileset, tileset->imageSource());
+    // Every map loaded references its tilesets, including lots and adjacent
+    // cells that may never be drawn, so their images are read on demand.
+    loadTileset(tileset, tileset->imageSource(), true);
 #endif
 }
 
@@ -202,6 +214,9 @@ void TilesetManager::removeReference(Tileset *tileset)
             mWatcher->removePath(tileset->imageSource());
 #endif
 
+#ifdef ZOMBOID
+        mThumbnailCache->tilesetChanged(tileset);
+#endif
         delete tileset;
     }
 }
@@ -345,6 +360,7 @@ void TilesetManager::fileChangedTimeout()
 void TilesetManager::imageLoaded(QImage *image, Tileset *tileset)
 {
     Q_ASSERT(mTilesetImageCache->mTilesets.contains(tileset));
+    mLoadingImages.remove(tileset);
 
     // This updates a tileset in the cache.
     tileset->loadFromImage(*image, tileset->imageSource());
@@ -368,6 +384,8 @@ void TilesetManager::imageLoaded(QImage *image, Tileset *tileset)
         }
     }
     delete image;
+
+    emit imageLoadFinished(tileset);
 }
 
 void TilesetManager::imageLoaded(Tileset *fromThread, Tileset *tileset)
@@ -378,6 +396,7 @@ void TilesetManager::imageLoaded(Tileset *fromThread, Tileset *tileset)
     // HACK - 'fromThread' is not in the cache, 'tileset' is
     tileset->loadFromCache(fromThread);
     delete fromThread;
+    mLoadingImages.remove(tileset);
 
     // Watch the image file for changes.
     mWatcher->addPath(tileset->imageSource2x().isEmpty() ? tileset->imageSource() : tileset->imageSource2x());
@@ -397,9 +416,12 @@ void TilesetManager::imageLoaded(Tileset *fromThread, Tileset *tileset)
             emit tilesetChanged(candidate);
         }
     }
+
+    emit imageLoadFinished(tileset);
 }
 
-void TilesetManager::loadTileset(Tileset *tileset, const QString &imageSource_)
+void TilesetManager::loadTileset(Tileset *tileset, const QString &imageSource_,
+                                 bool deferred)
 {
     // Hack to ignore TileMetaInfoMgr's tilesets that haven't been loaded,
     // their paths are relative to the Tiles Directory.
@@ -421,6 +443,8 @@ void TilesetManager::loadTileset(Tileset *tileset, const QString &imageSource_)
             } else {
                 changeTilesetSource(tileset, imageSource, false);
                 tileset->setImageSource2x(cached->imageSource2x());
+                if (!deferred && mDeferredImages.remove(cached))
+                    readImageInBackground(cached);
             }
         } else if (QImageReader(imageSource2x).size().isValid()) {
             qDebug() << "2x YES " << imageSource;
@@ -428,10 +452,10 @@ void TilesetManager::loadTileset(Tileset *tileset, const QString &imageSource_)
             tileset->setImageSource2x(imageSource2x);
             cached = mTilesetImageCache->addTileset(tileset);
 #if 1 /* QT_POINTER_SIZE == 8 */
-            QMetaObject::invokeMethod(mImageReaderWorkers[mNextThreadForJob],
-                                      "addJob", Qt::QueuedConnection,
-                                      Q_ARG(Tileset*,cached));
-            mNextThreadForJob = (mNextThreadForJob + 1) % mImageReaderWorkers.size();
+            if (deferred)
+                mDeferredImages += cached;
+            else
+                readImageInBackground(cached);
 #else
             QImage *image = new QImage(tileset->imageSource2x());
             imageLoaded(image, cached);
@@ -442,11 +466,12 @@ void TilesetManager::loadTileset(Tileset *tileset, const QString &imageSource_)
             tileset->setImageSource2x(QString());
             cached = mTilesetImageCache->addTileset(tileset);
 #if 1 /* QT_POINTER_SIZE == 8 */
-            QMetaObject::invokeMethod(mImageReaderWorkers[mNextThreadForJob],
-                                      "addJob", Qt::QueuedConnection,
-                                      Q_ARG(Tileset*,cached));
-            mNextThreadForJob = (mNextThreadForJob + 1) % mImageReaderWorkers.size();
-            qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
+            if (deferred) {
+                mDeferredImages += cached;
+            } else {
+                readImageInBackground(cached);
+                qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
+            }
 #else
             QImage *image = new QImage(tileset->imageSource());
             imageLoaded(image, cached);
@@ -462,22 +487,76 @@ void TilesetManager::loadTileset(Tileset *tileset, const QString &imageSource_)
     }
 }
 
+void TilesetManager::readImageInBackground(Tileset *cached)
+{
+    TilesetImageReaderWorker *worker = mImageReaderWorkers[mNextThreadForJob];
+    mNextThreadForJob = (mNextThreadForJob + 1) % mImageReaderWorkers.size();
+    mLoadingImages.insert(cached, worker);
+    QMetaObject::invokeMethod(worker, "addJob", Qt::QueuedConnection,
+                              Q_ARG(Tileset*,cached));
+}
+
+void TilesetManager::requestTilesets(const QList<Tileset *> &tilesets)
+{
+    foreach (Tileset *ts, tilesets) {
+        if (ts->isLoaded() || ts->isMissing())
+            continue;
+        Tileset *cached = mTilesetImageCache->findMatch(ts, ts->imageSource(), ts->imageSource2x());
+        if (cached && mDeferredImages.remove(cached))
+            readImageInBackground(cached);
+    }
+}
+
+// Called by the renderers, possibly from another thread.
+void TilesetManager::imageRequested(Tileset *tileset)
+{
+    TilesetManager *manager = instance();
+    QMetaObject::invokeMethod(manager, [manager, tileset] {
+        // The tileset may have been deleted since it was drawn.
+        if (manager->mTilesets.contains(tileset))
+            manager->requestTilesets(QList<Tileset*>() << tileset);
+    }, Qt::QueuedConnection);
+}
+
 void TilesetManager::waitForTilesets(const QList<Tileset *> &tilesets)
 {
-    while (true) {
-        bool busy = false;
-        for (TilesetImageReaderWorker *worker : mImageReaderWorkers) {
-            if (worker->busy()) {
-                busy = true;
-                break;
+    TRACE_ZONE("TilesetManager::waitForTilesets");
+
+    if (tilesets.isEmpty()) {
+        foreach (Tileset *cached, mDeferredImages)
+            readImageInBackground(cached);
+        mDeferredImages.clear();
+    } else {
+        requestTilesets(tilesets);
+    }
+
+    QSet<Tileset*> waitFor;
+    if (tilesets.isEmpty()) {
+        for (auto it = mLoadingImages.constBegin(); it != mLoadingImages.constEnd(); ++it)
+            waitFor += it.key();
+    } else {
+        foreach (Tileset *ts, tilesets) {
+            if (ts->isLoaded() || ts->isMissing())
+                continue;
+            Tileset *cached = mTilesetImageCache->findMatch(ts, ts->imageSource(), ts->imageSource2x());
+            if (TilesetImageReaderWorker *worker = mLoadingImages.value(cached)) {
+                worker->prioritize(cached);
+                waitFor += cached;
             }
         }
-        if (!busy)
-            break;
-        Sleep::msleep(10);
-        qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
     }
-    qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
+
+    if (!waitFor.isEmpty()) {
+        // The images are handed over by queued signals, so none can arrive
+        // before the loop runs.
+        QEventLoop loop;
+        connect(this, &TilesetManager::imageLoadFinished, &loop, [&](Tileset *cached) {
+            waitFor.remove(cached);
+            if (waitFor.isEmpty())
+                loop.quit();
+        });
+        loop.exec(QEventLoop::ExcludeUserInputEvents);
+    }
 
     foreach (Tileset *ts, tilesets) {
         if (ts->isLoaded())
@@ -485,7 +564,7 @@ void TilesetManager::waitForTilesets(const QList<Tileset *> &tilesets)
         // Missing tilesets aren't in mTilesetImageCache
         if (ts->isMissing())
             continue;
-        // There may be a thread already reading or about to read this image.
+        // The image wasn't given to a thread, so read it here.
         QImage *image = new QImage(ts->imageSource2x().isEmpty() ? ts->imageSource() : ts->imageSource2x());
         Tileset *cached = mTilesetImageCache->findMatch(ts, ts->imageSource(), ts->imageSource2x());
         Q_ASSERT(cached != 0 && !cached->isLoaded());
@@ -796,8 +875,7 @@ void TilesetManager::syncTileLayerNames(Tileset *ts)
 
 TilesetImageReaderWorker::TilesetImageReaderWorker(int id, InterruptibleThread *thread) :
     BaseWorker(thread),
-    mID(id),
-    mHasJobs(false)
+    mID(id)
 {
 }
 
@@ -805,23 +883,37 @@ TilesetImageReaderWorker::~TilesetImageReaderWorker()
 {
 }
 
-bool TilesetImageReaderWorker::busy()
+void TilesetImageReaderWorker::prioritize(Tileset *tileset)
 {
     QMutexLocker locker(&mJobsMutex);
-    return mHasJobs;
+    for (int i = 0; i < mJobs.size(); i++) {
+        if (mJobs[i].tileset == tileset) {
+            mJobs.move(i, 0);
+            return;
+        }
+    }
+    // addJob() hasn't run yet.
+    mUrgent += tileset;
 }
 
 void TilesetImageReaderWorker::work()
 {
     IN_WORKER_THREAD
 
-    while (mJobs.size()) {
+    while (true) {
+        QMutexLocker locker(&mJobsMutex);
         if (aborted()) {
+            TRACE_COUNTER_ADD("Tileset image jobs", -mJobs.size());
             mJobs.clear();
             break;
         }
+        if (mJobs.isEmpty())
+            break;
 
         Job job = mJobs.takeAt(0);
+        locker.unlock();
+        TRACE_COUNTER_ADD("Tileset image jobs", -1);
+        TRACE_ZONE("TilesetImageReaderWorker::loadImage");
 
         QImage *image = new QImage(job.tileset->imageSource2x().isEmpty() ? job.tileset->imageSource() : job.tileset->imageSource2x());
 #if 0
@@ -834,9 +926,6 @@ void TilesetImageReaderWorker::work()
         delete image;
         emit imageLoaded(fromThread, job.tileset);
     }
-
-    QMutexLocker locker(&mJobsMutex);
-    mHasJobs = false;
 }
 
 void TilesetImageReaderWorker::addJob(Tileset *tileset)
@@ -844,10 +933,13 @@ void TilesetImageReaderWorker::addJob(Tileset *tileset)
     IN_WORKER_THREAD
 
     QMutexLocker locker(&mJobsMutex);
-    mHasJobs = true;
+    if (mUrgent.remove(tileset))
+        mJobs.prepend(Job(tileset));
+    else
+        mJobs += Job(tileset);
     locker.unlock();
 
-    mJobs += Job(tileset);
+    TRACE_COUNTER_ADD("Tileset image jobs", 1);
     scheduleWork();
 }
 #endif // ZOMBOID
@@ -25,6 +25,7 @@
 #ifdef ZOMBOID
 #include <QFileInfo>
 #endif
+#include <QHash>
 #include <QObject>
 #include <QList>
 #include <QMap>
@@ -47,9 +48,14 @@ public:
 
     ~TilesetImageReaderWorker();
 
-    bool busy();
-
     typedef Tiled::Tileset Tileset;
+
+    /**
+     * Moves the job for \a tileset ahead of the others.  May be called from
+     * any thread, and before the job is added.
+     */
+    void prioritize(Tileset *tileset);
+
 signals:
     void imageLoaded(Tiled::Tileset *tileset, Tiled::Tileset *fromThread);
 
@@ -68,10 +74,10 @@ private:
         Tiled::Tileset *tileset;
     };
     QList<Job> mJobs;
+    QSet<Tiled::Tileset*> mUrgent;
 
     int mID;
     QMutex mJobsMutex;
-    bool mHasJobs;
 };
 #endif // ZOMBOID
 
@@ -88,6 +94,7 @@ namespace Internal {
 class FileSystemWatcher;
 
 #ifdef ZOMBOID
+class TileThumbnailCache;
 struct ZTileLayerNames;
 #endif
 
@@ -194,7 +201,28 @@ public:
 
     TilesetImageCache *imageCache() const { return mTilesetImageCache; }
 
-    void loadTileset(Tileset *tileset, const QString &imageSource);
+    TileThumbnailCache *thumbnailCache() const { return mThumbnailCache; }
+
+    /**
+     * Starts reading the image of \a tileset in the background.  When
+     * \a deferred is true the image isn't read until a tile from the tileset
+     * is drawn or the tileset is asked for with requestTilesets().
+     */
+    void loadTileset(Tileset *tileset, const QString &imageSource,
+                     bool deferred = false);
+
+    /**
+     * Starts reading the images of any of \a tilesets whose loading was
+     * deferred.
+     */
+    void requestTilesets(const QList<Tileset*> &tilesets);
+
+    /**
+     * Returns once the images of \a tilesets, or of every tileset when the
+     * list is empty, are loaded.  Deferred images are read too.  Images being
+     * read in the background are waited for in a local event loop, the ones
+     * asked for are read first.
+     */
     void waitForTilesets(const QList<Tileset *> &tilesets = QList<Tileset*>());
 #endif
 
@@ -206,6 +234,12 @@ signals:
 
 #ifdef ZOMBOID
     void tileLayerNameChanged(Tiled::Tile *tile);
+
+    /**
+     * Emitted when an image read in the background has been loaded into
+     * \a cached, a tileset in the image cache.
+     */
+    void imageLoadFinished(Tiled::Tileset *cached);
 #endif
 
 private slots:
@@ -234,6 +268,7 @@ private:
 
 #ifdef ZOMBOID
     TilesetImageCache *mTilesetImageCache;
+    TileThumbnailCache *mThumbnailCache;
 
     Tileset *mMissingTileset;
     Tile *mMissingTile;
@@ -244,6 +279,13 @@ private:
     QVector<InterruptibleThread*> mImageReaderThreads;
     QVector<TilesetImageReaderWorker*> mImageReaderWorkers;
     int mNextThreadForJob;
+    // Cached tilesets whose image is being read, and by which worker.
+    QHash<Tileset*,TilesetImageReaderWorker*> mLoadingImages;
+    // Cached tilesets whose image isn't read until it is needed.
+    QSet<Tileset*> mDeferredImages;
+
+    void readImageInBackground(Tileset *cached);
+    static void imageRequested(Tileset *tileset);
 #endif
 
 #ifdef ZOMBOID
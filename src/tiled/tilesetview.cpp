@@ -32,6 +32,7 @@
 #include "mapcomposite.h"
 #include "tilelayer.h"
 #include "tilesetmanager.h"
+#include "tilethumbnailcache.h"
 #endif
 #include "utils.h"
 #include "zoomable.h"
@@ -70,6 +71,11 @@ public:
     QSize sizeHint(const QStyleOptionViewItem &option,
                    const QModelIndex &index) const;
 
+#ifdef ZOMBOID
+    QRect imageRect(const QRect &cellRect, Tile *tile,
+                    const QFontMetrics &fm) const;
+#endif
+
 private:
     TilesetView *mTilesetView;
 };
@@ -79,20 +85,23 @@ void TileDelegate::paint(QPainter *painter,
                          const QModelIndex &index) const
 {
     // Draw the tile image
-    const QVariant display = index.model()->data(index, Qt::DisplayRole);
-    const QPixmap tileImage = display.value<QPixmap>();
     const int extra = mTilesetView->drawGrid() ? 1 : 0;
 
-    if (mTilesetView->zoomable()->smoothTransform())
-        painter->setRenderHint(QPainter::SmoothPixmapTransform);
-
 #ifdef ZOMBOID
     const QFontMetrics fm = painter->fontMetrics();
     const int labelHeight = mTilesetView->showLayerNames() ? fm.lineSpacing() : 0;
     const TilesetModel *m = static_cast<const TilesetModel*>(index.model());
     if (Tile *tile = m->tileAt(index)) {
-        const QMargins margins = tile->drawMargins(mTilesetView->zoomable()->scale());
-        painter->drawPixmap(option.rect.adjusted(margins.left(), margins.top(), -extra - margins.right(), -extra - labelHeight - margins.bottom()), tileImage);
+        if (!tile->tileset()->isLoaded())
+            TilesetManager::instance()->requestTilesets(QList<Tileset*>() << tile->tileset());
+        const QRect r = imageRect(option.rect, tile, fm);
+        const QPixmap thumb = TilesetManager::instance()->thumbnailCache()->thumbnail(
+                    tile, r.size(), mTilesetView->zoomable()->smoothTransform());
+        // Until the thumbnail is ready draw the full image, unsmoothed.
+        if (thumb.isNull())
+            painter->drawImage(r, tile->image());
+        else
+            painter->drawPixmap(r.topLeft(), thumb);
     }
 
     if (mTilesetView->showLayerNames()) {
@@ -110,6 +119,12 @@ void TileDelegate::paint(QPainter *painter,
         painter->fillRect(option.rect.left(), option.rect.bottom(), option.rect.width(), 1, Qt::lightGray);
     }
 #else
+    const QVariant display = index.model()->data(index, Qt::DisplayRole);
+    const QPixmap tileImage = display.value<QPixmap>();
+
+    if (mTilesetView->zoomable()->smoothTransform())
+        painter->setRenderHint(QPainter::SmoothPixmapTransform);
+
     painter->drawPixmap(option.rect.adjusted(0, 0, -extra, -extra), tileImage);
 #endif
 
@@ -143,6 +158,19 @@ QSize TileDelegate::sizeHint(const QStyleOptionViewItem & option,
 #endif
 }
 
+#ifdef ZOMBOID
+QRect TileDelegate::imageRect(const QRect &cellRect, Tile *tile,
+                              const QFontMetrics &fm) const
+{
+    const int extra = mTilesetView->drawGrid() ? 1 : 0;
+    const int labelHeight = mTilesetView->showLayerNames() ? fm.lineSpacing() : 0;
+    const QMargins margins = tile->drawMargins(mTilesetView->zoomable()->scale());
+    return cellRect.adjusted(margins.left(), margins.top(),
+                             -extra - margins.right(),
+                             -extra - labelHeight - margins.bottom());
+}
+#endif
+
 
 
 } // anonymous namespace
@@ -193,6 +221,11 @@ TilesetView::TilesetView(QWidget *parent)
     mShowLayerNames = prefs->autoSwitchLayer();
     connect(prefs, &Preferences::autoSwitchLayerChanged,
             this, &TilesetView::autoSwitchLayerChanged);
+
+    connect(TilesetManager::instance()->thumbnailCache(), &TileThumbnailCache::thumbnailsReady,
+            viewport(), qOverload<>(&QWidget::update));
+    connect(verticalScrollBar(), &QScrollBar::valueChanged,
+            this, &TilesetView::prefetchThumbnails);
 #endif
 }
 
@@ -245,6 +278,11 @@ TilesetView::TilesetView(MapDocument *mapDocument, Zoomable *zoomable, QWidget *
     mShowLayerNames = prefs->autoSwitchLayer();
     connect(prefs, &Preferences::autoSwitchLayerChanged,
             this, &TilesetView::autoSwitchLayerChanged);
+
+    connect(TilesetManager::instance()->thumbnailCache(), &TileThumbnailCache::thumbnailsReady,
+            viewport(), qOverload<>(&QWidget::update));
+    connect(verticalScrollBar(), &QScrollBar::valueChanged,
+            this, &TilesetView::prefetchThumbnails);
 #endif
 }
 
@@ -492,4 +530,35 @@ void TilesetView::autoSwitchLayerChanged(bool enabled)
     mShowLayerNames = enabled;
     tilesetModel()->redisplay();
 }
+
+/**
+ * Starts scaling the thumbnails of the rows up to a page above and below the
+ * visible ones, so they are ready by the time they are scrolled to.
+ */
+void TilesetView::prefetchThumbnails()
+{
+    const TilesetModel *m = tilesetModel();
+    if (!m || !m->rowCount())
+        return;
+
+    const TileDelegate *delegate = static_cast<TileDelegate*>(itemDelegate());
+    TileThumbnailCache *thumbnails = TilesetManager::instance()->thumbnailCache();
+    const bool smooth = mZoomable->smoothTransform();
+    const int page = viewport()->height();
+    int first = rowAt(-page);
+    int last = rowAt(2 * page - 1);
+    if (first == -1)
+        first = 0;
+    if (last == -1)
+        last = m->rowCount() - 1;
+    for (int row = first; row <= last; row++) {
+        for (int column = 0; column < m->columnCount(); column++) {
+            const QModelIndex index = m->index(row, column);
+            if (Tile *tile = m->tileAt(index)) {
+                const QRect r = delegate->imageRect(visualRect(index), tile, fontMetrics());
+                thumbnails->prefetch(tile, r.size(), smooth);
+            }
+        }
+    }
+}
 #endif
@@ -76,6 +76,8 @@ private slots:
 #ifdef ZOMBOID
     // Preferences signal
     void autoSwitchLayerChanged(bool enabled);
+
+    void prefetchThumbnails();
 #endif
 
 private:
@@ -0,0 +1,179 @@
+/*
+ * tilethumbnailcache.cpp
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilethumbnailcache.h"
+
+#include "tile.h"
+#include "tileset.h"
+
+#include <QRunnable>
+#include <QThread>
+
+#include <functional>
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+namespace {
+
+const int DEFAULT_MAX_BYTES = 64 * 1024 * 1024;
+
+// Thumbnails asked for by a paint event go before prefetched ones.
+const int PAINT_PRIORITY = 1;
+const int PREFETCH_PRIORITY = 0;
+
+class ScaleTileTask : public QRunnable
+{
+public:
+    ScaleTileTask(const std::function<void()> &func) :
+        mFunc(func)
+    {
+    }
+
+    void run()
+    {
+        mFunc();
+    }
+
+private:
+    std::function<void()> mFunc;
+};
+
+int bytesFor(const QPixmap &pixmap)
+{
+    return pixmap.width() * pixmap.height() * qMax(pixmap.depth(), 8) / 8;
+}
+
+} // namespace
+
+TileThumbnailCache::TileThumbnailCache(QObject *parent) :
+    QObject(parent),
+    mCache(DEFAULT_MAX_BYTES)
+{
+    // Leave a thread for the tileset image readers.
+    mPool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+}
+
+TileThumbnailCache::~TileThumbnailCache()
+{
+    mPool.clear();
+    mPool.waitForDone();
+}
+
+QPixmap TileThumbnailCache::thumbnail(Tile *tile, const QSize &size, bool smooth)
+{
+    if (tile->image().isNull() || size.isEmpty())
+        return QPixmap();
+
+    const Key key = keyFor(tile, size, smooth);
+    if (QPixmap *pixmap = mCache.object(key))
+        return *pixmap;
+
+    // Nothing to scale, so just convert it now.
+    if (tile->image().size() == size) {
+        const QPixmap pixmap = QPixmap::fromImage(tile->image());
+        mCache.insert(key, new QPixmap(pixmap), bytesFor(pixmap));
+        return pixmap;
+    }
+
+    request(tile, key, PAINT_PRIORITY);
+    return QPixmap();
+}
+
+void TileThumbnailCache::prefetch(Tile *tile, const QSize &size, bool smooth)
+{
+    if (tile->image().isNull() || size.isEmpty())
+        return;
+
+    const Key key = keyFor(tile, size, smooth);
+    if (!mCache.contains(key))
+        request(tile, key, PREFETCH_PRIORITY);
+}
+
+void TileThumbnailCache::setMaxBytes(int bytes)
+{
+    mCache.setMaxCost(bytes);
+}
+
+int TileThumbnailCache::maxBytes() const
+{
+    return mCache.maxCost();
+}
+
+void TileThumbnailCache::tilesetChanged(Tileset *tileset)
+{
+    foreach (const Key &key, mCache.keys()) {
+        if (key.first == tileset)
+            mCache.remove(key);
+    }
+    QSet<Key>::iterator it = mPending.begin();
+    while (it != mPending.end()) {
+        if (it->first == tileset)
+            it = mPending.erase(it);
+        else
+            ++it;
+    }
+    mGeneration[tileset]++;
+}
+
+TileThumbnailCache::Key TileThumbnailCache::keyFor(Tile *tile, const QSize &size,
+                                                   bool smooth) const
+{
+    const quint64 packed = (quint64(quint32(tile->id())) << 33) |
+            (quint64(smooth) << 32) |
+            (quint64(size.width() & 0xFFFF) << 16) |
+            quint64(size.height() & 0xFFFF);
+    return Key(tile->tileset(), packed);
+}
+
+void TileThumbnailCache::request(Tile *tile, const Key &key, int priority)
+{
+    if (mPending.contains(key))
+        return;
+    mPending.insert(key);
+
+    // The worker gets its own reference to the image, the tile itself may be
+    // changed or deleted meanwhile.
+    const QImage image = tile->image();
+    const QSize size(int((key.second >> 16) & 0xFFFF), int(key.second & 0xFFFF));
+    const Qt::TransformationMode mode = (key.second & (quint64(1) << 32))
+            ? Qt::SmoothTransformation : Qt::FastTransformation;
+    const int generation = mGeneration.value(key.first);
+
+    mPool.start(new ScaleTileTask([this, key, generation, image, size, mode]() {
+        const QImage thumb = image.scaled(size, Qt::IgnoreAspectRatio, mode)
+                .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        QMetaObject::invokeMethod(this, [this, key, generation, thumb]() {
+            scaled(key, generation, thumb);
+        }, Qt::QueuedConnection);
+    }), priority);
+}
+
+void TileThumbnailCache::scaled(const Key &key, int generation, const QImage &image)
+{
+    if (generation != mGeneration.value(key.first))
+        return;
+    mPending.remove(key);
+
+    // QPixmaps can only be made on the GUI thread.
+    QPixmap *pixmap = new QPixmap(QPixmap::fromImage(image));
+    mCache.insert(key, pixmap, bytesFor(*pixmap));
+
+    emit thumbnailsReady();
+}
@@ -0,0 +1,101 @@
+/*
+ * tilethumbnailcache.h
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILETHUMBNAILCACHE_H
+#define TILETHUMBNAILCACHE_H
+
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QObject>
+#include <QPair>
+#include <QPixmap>
+#include <QSet>
+#include <QSize>
+#include <QThreadPool>
+
+namespace Tiled {
+
+class Tile;
+class Tileset;
+
+namespace Internal {
+
+/**
+ * Tile images scaled to the size they are drawn at in the tileset views.
+ *
+ * The tile images are often twice the size they are shown at, and scaling
+ * every visible tile on every repaint makes scrolling the large palettes slow.
+ * Thumbnails are scaled on a background thread and kept until the cache goes
+ * over its byte budget, when the least recently used ones are dropped.
+ */
+class TileThumbnailCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    TileThumbnailCache(QObject *parent = nullptr);
+    ~TileThumbnailCache();
+
+    /**
+     * Returns the image of \a tile scaled to \a size, or a null pixmap if it
+     * isn't ready yet.  In that case the thumbnail is scaled in the
+     * background and thumbnailsReady() is emitted once it is available.
+     */
+    QPixmap thumbnail(Tile *tile, const QSize &size, bool smooth);
+
+    /**
+     * Scales the thumbnail in the background, for tiles about to be shown.
+     * These wait until the thumbnails asked for by thumbnail() are done.
+     */
+    void prefetch(Tile *tile, const QSize &size, bool smooth);
+
+    void setMaxBytes(int bytes);
+    int maxBytes() const;
+
+signals:
+    void thumbnailsReady();
+
+public slots:
+    /**
+     * Forgets the thumbnails of the tiles in \a tileset, because its images
+     * changed or it is about to be deleted.
+     */
+    void tilesetChanged(Tiled::Tileset *tileset);
+
+private:
+    // The tileset, and the tile id, size and smoothing packed together.
+    typedef QPair<Tileset*,quint64> Key;
+
+    Key keyFor(Tile *tile, const QSize &size, bool smooth) const;
+    void request(Tile *tile, const Key &key, int priority);
+    void scaled(const Key &key, int generation, const QImage &image);
+
+    QCache<Key,QPixmap> mCache;
+    QSet<Key> mPending;
+    // Bumped when a tileset changes, so thumbnails of its old images that are
+    // still being scaled are thrown away.
+    QHash<Tileset*,int> mGeneration;
+    QThreadPool mPool;
+};
+
+} // namespace Internal
+} // namespace Tiled
+
+#endif // TILETHUMBNAILCACHE_H
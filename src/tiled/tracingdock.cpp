@@ -0,0 +1,224 @@
+/*
+ * tracingdock.cpp
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tracingdock.h"
+
+#include "tracing.h"
+
+#include <QCheckBox>
+#include <QEvent>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QMessageBox>
+#include <QPainter>
+#include <QPushButton>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+namespace Tiled {
+namespace Internal {
+
+/**
+ * Draws one bar per frame, scaled so a 60 fps frame is half the height.
+ */
+class FrameTimeGraph : public QWidget
+{
+public:
+    FrameTimeGraph(QWidget *parent = 0)
+        : QWidget(parent)
+    {
+        setMinimumHeight(64);
+        setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    }
+
+    void setFrameTimes(const QVector<qint64> &frameTimes)
+    {
+        mFrameTimes = frameTimes;
+        update();
+    }
+
+protected:
+    void paintEvent(QPaintEvent *)
+    {
+        QPainter painter(this);
+        painter.fillRect(rect(), Qt::black);
+
+        const qreal msPerHeight = 1000.0 / 30; // 33 ms at the top
+        const int h = height();
+        const int w = width();
+        int x = w - mFrameTimes.size();
+        for (qint64 ns : qAsConst(mFrameTimes)) {
+            qreal ms = ns / 1000000.0;
+            int barHeight = qMin(h, qRound(ms / msPerHeight * h));
+            QColor color = (ms <= 1000.0 / 60) ? Qt::green
+                                               : (ms <= 1000.0 / 30) ? Qt::yellow : Qt::red;
+            if (x >= 0)
+                painter.fillRect(x, h - barHeight, 1, barHeight, color);
+            ++x;
+        }
+
+        // 60 fps line
+        painter.setPen(Qt::darkGray);
+        painter.drawLine(0, h / 2, w, h / 2);
+    }
+
+private:
+    QVector<qint64> mFrameTimes;
+};
+
+} // namespace Internal
+} // namespace Tiled
+
+TracingDock::TracingDock(QWidget *parent)
+    : QDockWidget(parent)
+    , mGraph(new FrameTimeGraph(this))
+    , mSummary(new QLabel(this))
+    , mCounters(new QTreeWidget(this))
+    , mRecord(new QCheckBox(this))
+    , mClear(new QPushButton(this))
+    , mSave(new QPushButton(this))
+    , mRefreshTimer(new QTimer(this))
+{
+    setObjectName(QLatin1String("tracingDock"));
+
+    mCounters->setColumnCount(2);
+    mCounters->setRootIsDecorated(false);
+    mCounters->setUniformRowHeights(true);
+    mCounters->header()->setStretchLastSection(false);
+#if QT_VERSION >= 0x050000
+    mCounters->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    mCounters->header()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
+#else
+    mCounters->header()->setResizeMode(0, QHeaderView::Stretch);
+    mCounters->header()->setResizeMode(1, QHeaderView::ResizeToContents);
+#endif
+
+    mRecord->setChecked(Tracing::isEnabled());
+    connect(mRecord, &QAbstractButton::toggled, this, &TracingDock::recordToggled);
+    connect(mClear, &QAbstractButton::clicked, this, &TracingDock::clearTrace);
+    connect(mSave, &QAbstractButton::clicked, this, &TracingDock::saveTrace);
+
+    QHBoxLayout *buttons = new QHBoxLayout;
+    buttons->addWidget(mRecord);
+    buttons->addStretch();
+    buttons->addWidget(mClear);
+    buttons->addWidget(mSave);
+
+    QWidget *widget = new QWidget(this);
+    QVBoxLayout *layout = new QVBoxLayout(widget);
+    layout->setContentsMargins(5, 5, 5, 5);
+    layout->addWidget(mGraph);
+    layout->addWidget(mSummary);
+    layout->addWidget(mCounters);
+    layout->addLayout(buttons);
+    setWidget(widget);
+
+    mRefreshTimer->setInterval(250);
+    connect(mRefreshTimer, &QTimer::timeout, this, &TracingDock::refresh);
+    mRefreshTimer->start();
+
+    retranslateUi();
+}
+
+void TracingDock::changeEvent(QEvent *e)
+{
+    QDockWidget::changeEvent(e);
+    switch (e->type()) {
+    case QEvent::LanguageChange:
+        retranslateUi();
+        break;
+    default:
+        break;
+    }
+}
+
+void TracingDock::refresh()
+{
+    if (!isVisible())
+        return;
+
+    QVector<qint64> frameTimes = Tracing::frameTimes();
+    mGraph->setFrameTimes(frameTimes);
+
+    if (frameTimes.isEmpty()) {
+        mSummary->setText(tr("No frames recorded"));
+    } else {
+        qint64 total = 0, worst = 0;
+        for (qint64 ns : qAsConst(frameTimes)) {
+            total += ns;
+            worst = qMax(worst, ns);
+        }
+        mSummary->setText(tr("Last %1 ms, average %2 ms, worst %3 ms")
+                          .arg(frameTimes.last() / 1000000.0, 0, 'f', 1)
+                          .arg(total / frameTimes.size() / 1000000.0, 0, 'f', 1)
+                          .arg(worst / 1000000.0, 0, 'f', 1));
+    }
+
+    QList<QPair<QString,qint64> > counters = Tracing::counters();
+    while (mCounters->topLevelItemCount() > counters.size())
+        delete mCounters->takeTopLevelItem(mCounters->topLevelItemCount() - 1);
+    for (int i = 0; i < counters.size(); ++i) {
+        QTreeWidgetItem *item = mCounters->topLevelItem(i);
+        if (!item) {
+            item = new QTreeWidgetItem(mCounters);
+            item->setTextAlignment(1, Qt::AlignRight | Qt::AlignVCenter);
+        }
+        item->setText(0, counters[i].first);
+        item->setText(1, QString::number(counters[i].second));
+    }
+}
+
+void TracingDock::recordToggled(bool record)
+{
+    Tracing::setEnabled(record);
+}
+
+void TracingDock::clearTrace()
+{
+    Tracing::clear();
+    refresh();
+}
+
+void TracingDock::saveTrace()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Save Trace"),
+                                                    QLatin1String("trace.json"),
+                                                    tr("Chrome trace files (*.json)"));
+    if (fileName.isEmpty())
+        return;
+
+    QString error;
+    if (!Tracing::writeChromeTrace(fileName, &error))
+        QMessageBox::critical(this, tr("Error Saving Trace"), error);
+}
+
+void TracingDock::retranslateUi()
+{
+    setWindowTitle(tr("Profiler"));
+    mCounters->setHeaderLabels(QStringList() << tr("Counter") << tr("Value"));
+    mRecord->setText(tr("Record"));
+    mClear->setText(tr("Clear"));
+    mSave->setText(tr("Save Trace..."));
+}
@@ -0,0 +1,72 @@
+/*
+ * tracingdock.h
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACINGDOCK_H
+#define TRACINGDOCK_H
+
+#include <QDockWidget>
+
+class QCheckBox;
+class QLabel;
+class QPushButton;
+class QTimer;
+class QTreeWidget;
+
+namespace Tiled {
+namespace Internal {
+
+class FrameTimeGraph;
+
+/**
+ * A dock widget showing recent frame times and the worker-thread counters
+ * recorded by the tracing code, and letting the user save a Chrome trace.
+ * Only created when the application is built with CONFIG+=tracing.
+ */
+class TracingDock : public QDockWidget
+{
+    Q_OBJECT
+
+public:
+    TracingDock(QWidget *parent = 0);
+
+protected:
+    void changeEvent(QEvent *e);
+
+private slots:
+    void refresh();
+    void recordToggled(bool record);
+    void clearTrace();
+    void saveTrace();
+
+private:
+    void retranslateUi();
+
+    FrameTimeGraph *mGraph;
+    QLabel *mSummary;
+    QTreeWidget *mCounters;
+    QCheckBox *mRecord;
+    QPushButton *mClear;
+    QPushButton *mSave;
+    QTimer *mRefreshTimer;
+};
+
+} // namespace Internal
+} // namespace Tiled
+
+#endif // TRACINGDOCK_H
@@ -315,6 +315,10 @@ WorldEdDock::WorldEdDock(QWidget *parent) :
            this, &WorldEdDock::beforeWorldChanged);
     connect(WorldEd::WorldEdMgr::instance(), &WorldEd::WorldEdMgr::afterWorldChanged,
             this, &WorldEdDock::afterWorldChanged);
+    connect(WorldEd::WorldEdMgr::instance(), &WorldEd::WorldEdMgr::beforeCellChanged,
+            this, &WorldEdDock::beforeCellChanged);
+    connect(WorldEd::WorldEdMgr::instance(), &WorldEd::WorldEdMgr::afterCellChanged,
+            this, &WorldEdDock::afterCellChanged);
     connect(WorldEd::WorldEdMgr::instance(), &WorldEd::WorldEdMgr::selectedLotsChanged,
             this, &WorldEdDock::selectedLotsChanged);
 
@@ -404,6 +408,19 @@ void WorldEdDock::afterWorldChanged()
     }
 }
 
+void WorldEdDock::beforeCellChanged(WorldCell *cell)
+{
+    if (cell == ui->view->model()->cell())
+        beforeWorldChanged();
+}
+
+void WorldEdDock::afterCellChanged(WorldCell *cell)
+{
+    Q_UNUSED(cell)
+    if (mDocument && !ui->view->model()->cell())
+        afterWorldChanged();
+}
+
 void WorldEdDock::selectedLotsChanged()
 {
     const QSet<WorldCellLot*> &selected = WorldEd::WorldEdMgr::instance()->selectedLots();
@@ -147,6 +147,8 @@ private slots:
 
     void beforeWorldChanged();
     void afterWorldChanged();
+    void beforeCellChanged(WorldCell *cell);
+    void afterCellChanged(WorldCell *cell);
 
     void selectedLotsChanged();
 
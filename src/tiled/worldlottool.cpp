@@ -64,6 +64,10 @@ WorldLotTool::WorldLotTool(QObject *parent) :
             this, &WorldLotTool::beforeWorldChanged);
     connect(WorldEd::WorldEdMgr::instance(), &WorldEd::WorldEdMgr::afterWorldChanged,
             this, &WorldLotTool::afterWorldChanged);
+    connect(WorldEd::WorldEdMgr::instance(), &WorldEd::WorldEdMgr::beforeCellChanged,
+            this, &WorldLotTool::beforeCellChanged);
+    connect(WorldEd::WorldEdMgr::instance(), &WorldEd::WorldEdMgr::afterCellChanged,
+            this, &WorldLotTool::afterCellChanged);
     connect(WorldEd::WorldEdMgr::instance(), &WorldEd::WorldEdMgr::lotVisibilityChanged,
             this, &WorldLotTool::lotVisibilityChanged);
 }
@@ -277,6 +281,21 @@ void WorldLotTool::afterWorldChanged()
     mCell = WorldEd::WorldEdMgr::instance()->cellForMap(mScene->mapDocument()->fileName());
 }
 
+void WorldLotTool::beforeCellChanged(WorldCell *cell)
+{
+    if (mHoverLot && mHoverLot->cell() == cell) {
+        if (mHoverItem)
+            mHoverItem->setVisible(false);
+        mHoverLot = 0;
+    }
+}
+
+void WorldLotTool::afterCellChanged(WorldCell *cell)
+{
+    Q_UNUSED(cell)
+    afterWorldChanged();
+}
+
 void WorldLotTool::lotVisibilityChanged(WorldCellLot *lot)
 {
     if (!mScene)
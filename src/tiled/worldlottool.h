@@ -53,6 +53,8 @@ private:
 private slots:
     void beforeWorldChanged();
     void afterWorldChanged();
+    void beforeCellChanged(WorldCell *cell);
+    void afterCellChanged(WorldCell *cell);
     void lotVisibilityChanged(WorldCellLot *lot);
 
 private:
@@ -79,23 +79,17 @@ void ZLotManager::setMapDocument(MapDocument *mapDoc)
                 onObjectsAdded(og->objects());
 
 #if 1
-            if (WorldCell *cell = WorldEd::WorldEdMgr::instance()->cellForMap(mMapDocument->fileName())) {
-                foreach (WorldCellLot *lot, cell->lots()) {
-                    MapInfo *mapInfo = MapManager::instance()->loadMap(lot->mapName(), QString(),
-                                                                       true, MapManager::PriorityLow);
-                    if (mapInfo) {
-                        if (mapInfo->isLoading())
-                            mMapsLoading2 += MapLoading2(mapInfo, lot);
-                        else
-                            setMapInfo(lot, mapInfo);
-                    }
-                }
-            }
+            if (WorldCell *cell = WorldEd::WorldEdMgr::instance()->cellForMap(mMapDocument->fileName()))
+                addWorldCellLots(cell);
 
             connect(WorldEd::WorldEdMgr::instance(), &WorldEd::WorldEdMgr::beforeWorldChanged,
                     this, &ZLotManager::beforeWorldChanged);
             connect(WorldEd::WorldEdMgr::instance(), &WorldEd::WorldEdMgr::afterWorldChanged,
                     this, &ZLotManager::afterWorldChanged);
+            connect(WorldEd::WorldEdMgr::instance(), &WorldEd::WorldEdMgr::beforeCellChanged,
+                    this, &ZLotManager::beforeCellChanged);
+            connect(WorldEd::WorldEdMgr::instance(), &WorldEd::WorldEdMgr::afterCellChanged,
+                    this, &ZLotManager::afterCellChanged);
 #endif
         }
     }
@@ -427,16 +421,41 @@ void ZLotManager::beforeWorldChanged()
 
 void ZLotManager::afterWorldChanged()
 {
-    if (WorldCell *cell = WorldEd::WorldEdMgr::instance()->cellForMap(mMapDocument->fileName())) {
-        foreach (WorldCellLot *lot, cell->lots()) {
-            MapInfo *mapInfo = MapManager::instance()->loadMap(lot->mapName(), QString(),
-                                                               true, MapManager::PriorityLow);
-            if (mapInfo) {
-                if (mapInfo->isLoading())
-                    mMapsLoading2 += MapLoading2(mapInfo, lot);
-                else
-                    setMapInfo(lot, mapInfo);
-            }
+    if (WorldCell *cell = WorldEd::WorldEdMgr::instance()->cellForMap(mMapDocument->fileName()))
+        addWorldCellLots(cell);
+}
+
+// Only the lots of the changed cell are removed, if it is this map's cell.
+void ZLotManager::beforeCellChanged(WorldCell *cell)
+{
+    foreach (WorldCellLot *lot, mWorldCellLotToMI.keys()) {
+        if (lot->cell() == cell)
+            setMapInfo(lot, 0);
+    }
+    for (int i = 0; i < mMapsLoading2.size(); i++) {
+        if (mMapsLoading2[i].lot->cell() == cell) {
+            mMapsLoading2.removeAt(i);
+            --i;
+        }
+    }
+}
+
+void ZLotManager::afterCellChanged(WorldCell *cell)
+{
+    if (cell == WorldEd::WorldEdMgr::instance()->cellForMap(mMapDocument->fileName()))
+        addWorldCellLots(cell);
+}
+
+void ZLotManager::addWorldCellLots(WorldCell *cell)
+{
+    foreach (WorldCellLot *lot, cell->lots()) {
+        MapInfo *mapInfo = MapManager::instance()->loadMap(lot->mapName(), QString(),
+                                                           true, MapManager::PriorityLow);
+        if (mapInfo) {
+            if (mapInfo->isLoading())
+                mMapsLoading2 += MapLoading2(mapInfo, lot);
+            else
+                setMapInfo(lot, mapInfo);
         }
     }
 }
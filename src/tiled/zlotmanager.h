@@ -28,6 +28,7 @@
 
 class MapComposite;
 class MapInfo;
+class WorldCell;
 class WorldCellLot;
 
 namespace Tiled {
@@ -81,8 +82,11 @@ private slots:
 
     void beforeWorldChanged();
     void afterWorldChanged();
+    void beforeCellChanged(WorldCell *cell);
+    void afterCellChanged(WorldCell *cell);
 
 private:
+    void addWorldCellLots(WorldCell *cell);
     void handleMapObject(MapObject *mapObject);
     void setMapInfo(MapObject *mapObject, MapInfo *mapInfo);
     void setMapComposite(MapObject *mapObject, MapComposite *mapComposite);
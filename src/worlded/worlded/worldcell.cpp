@@ -90,14 +90,21 @@ void WorldCell::setMapFilePath(const QString &path)
 
 void WorldCell::insertLot(int index, WorldCellLot *lot)
 {
+    // Each level lists its own lots in the same order as mLots.
+    int levelIndex = 0;
+    for (int i = 0; i < index; i++) {
+        if (mLots[i]->level() == lot->level())
+            levelIndex++;
+    }
     mLots.insert(index, lot);
-    mLevels[lot->level()]->insertLot(index, lot);
+    mLevels[lot->level()]->insertLot(levelIndex, lot);
 }
 
 WorldCellLot *WorldCell::removeLot(int index)
 {
     WorldCellLot *lot = mLots.takeAt(index);
-    mLevels[lot->level()]->removeLot(index);
+    WorldCellLevel *level = mLevels[lot->level()];
+    level->removeLot(level->lots().indexOf(lot));
     return lot;
 }
 
@@ -21,11 +21,130 @@
 #include "worldcell.h"
 #include "worldreader.h"
 
+#include "tracing.h"
+
 #include <QDebug>
+#include <QDir>
 #include <QFileInfo>
 
 using namespace WorldEd;
 
+namespace {
+
+// WorldReader stores the canonical path of every map that exists, so paths
+// from a .pzw only need tidying up to be compared with each other.
+QString pathKey(const QString &path)
+{
+    return QDir::cleanPath(path);
+}
+
+bool sameLots(const WorldCellLotList &a, const WorldCellLotList &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (int i = 0; i < a.size(); i++) {
+        const WorldCellLot *lot = a[i], *lot2 = b[i];
+        if (lot->mapName() != lot2->mapName() ||
+                lot->bounds() != lot2->bounds() ||
+                lot->level() != lot2->level())
+            return false;
+    }
+    return true;
+}
+
+bool sameObjects(const WorldCellObjectList &a, const WorldCellObjectList &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (int i = 0; i < a.size(); i++) {
+        const WorldCellObject *obj = a[i], *obj2 = b[i];
+        if (obj->name() != obj2->name() ||
+                obj->group()->name() != obj2->group()->name() ||
+                obj->type()->name() != obj2->type()->name() ||
+                obj->bounds() != obj2->bounds() ||
+                obj->level() != obj2->level())
+            return false;
+    }
+    return true;
+}
+
+// Property::operator== compares enum pointers, which never match between two
+// worlds, so definitions and templates are compared by name here.
+bool sameProperties(const PropertyHolder *a, const PropertyHolder *b)
+{
+    if (a->properties().size() != b->properties().size() ||
+            a->templates().size() != b->templates().size())
+        return false;
+    for (int i = 0; i < a->properties().size(); i++) {
+        const Property *p = a->properties()[i], *p2 = b->properties()[i];
+        if (p->mDefinition->mName != p2->mDefinition->mName ||
+                p->mValue != p2->mValue ||
+                p->mNote != p2->mNote)
+            return false;
+    }
+    for (int i = 0; i < a->templates().size(); i++) {
+        if (a->templates()[i]->mName != b->templates()[i]->mName)
+            return false;
+    }
+    return true;
+}
+
+bool sameCell(WorldCell *a, WorldCell *b)
+{
+    return a->mapFilePath() == b->mapFilePath() &&
+            sameLots(a->lots(), b->lots()) &&
+            sameObjects(a->objects(), b->objects()) &&
+            sameProperties(a, b);
+}
+
+// Cell contents can only be moved between worlds whose definitions match up
+// by name, see WorldCellContents::swapWorld().
+bool sameDefinitions(World *a, World *b)
+{
+    if (a->objectGroups().names() != b->objectGroups().names() ||
+            a->objectTypes().names() != b->objectTypes().names())
+        return false;
+    if (a->propertyDefinitions().size() != b->propertyDefinitions().size() ||
+            a->propertyTemplates().size() != b->propertyTemplates().size())
+        return false;
+    for (int i = 0; i < a->propertyDefinitions().size(); i++) {
+        const PropertyDef *pd = a->propertyDefinitions()[i];
+        const PropertyDef *pd2 = b->propertyDefinitions()[i];
+        if (pd->mName != pd2->mName || pd->mDefaultValue != pd2->mDefaultValue)
+            return false;
+    }
+    for (int i = 0; i < a->propertyTemplates().size(); i++) {
+        const PropertyTemplate *pt = a->propertyTemplates()[i];
+        const PropertyTemplate *pt2 = b->propertyTemplates()[i];
+        if (pt->mName != pt2->mName || !sameProperties(pt, pt2))
+            return false;
+    }
+    return true;
+}
+
+void moveCellContents(WorldCell *from, WorldCell *to)
+{
+    // Lots are moved one at a time so the cells' levels stay in step.
+    while (!to->lots().isEmpty())
+        delete to->removeLot(to->lots().size() - 1);
+    {
+        WorldCellContents old(to, true);
+    }
+
+    WorldCellLotList lots;
+    while (!from->lots().isEmpty())
+        lots += from->removeLot(0);
+    WorldCellContents contents(from, true);
+    contents.swapWorld(to->world());
+    contents.setCellContents(to);
+    for (WorldCellLot *lot : lots) {
+        lot->setCell(to);
+        to->insertLot(to->lots().size(), lot);
+    }
+}
+
+} // namespace
+
 WorldEdMgr *WorldEdMgr::mInstance = 0;
 
 WorldEdMgr *WorldEdMgr::instance()
@@ -53,6 +172,8 @@ WorldEdMgr::~WorldEdMgr()
 
 void WorldEdMgr::addProject(const QString &fileName)
 {
+    TRACE_ZONE("WorldEdMgr::addProject");
+
     WorldReader reader;
     World *world = reader.readWorld(fileName);
     if (!world)
@@ -60,37 +181,30 @@ void WorldEdMgr::addProject(const QString &fileName)
 
     mWorlds += world;
     mWorldFileNames += fileName;
+    indexCells();
 
     mWatcher.addPath(fileName);
 }
 
 WorldCell *WorldEdMgr::cellForMap(const QString &fileName)
 {
-    QFileInfo info2(fileName);
-    QString canonicalPath = info2.canonicalFilePath();
-    if (mMapWithoutWorld.contains(canonicalPath)) {
+    if (fileName.isEmpty())
         return nullptr;
-    }
-    for (World *world : qAsConst(mWorlds)) {
-        if (mCheckedDocuments.contains(world) == false) {
-            auto& nameToCell = mCheckedDocuments[world];
-            for (int y = 0; y < world->height(); y++) {
-                for (int x = 0; x < world->width(); x++) {
-                    WorldCell *cell = world->cellAt(x, y);
-                    if (cell->mapFilePath().isEmpty())
-                        continue;
-                    QFileInfo info1(cell->mapFilePath());
-                    nameToCell.insert(info1.canonicalFilePath(), cell);
-                }
-            }
-        }
-        const auto& nameToCell = mCheckedDocuments[world];
-        if (nameToCell.contains(canonicalPath)) {
-            return nameToCell[canonicalPath];
-        }
-    }
-    mMapWithoutWorld.insert(fileName);
-    return nullptr;
+    const QString key = pathKey(fileName);
+    QHash<QString,WorldCell*>::const_iterator it = mCellForPath.constFind(key);
+    if (it != mCellForPath.constEnd())
+        return it.value();
+    if (mMapWithoutWorld.contains(key))
+        return nullptr;
+
+    // The caller's path may go through a symlink or differ in case.
+    QString canonicalPath = QFileInfo(fileName).canonicalFilePath();
+    WorldCell *cell = nullptr;
+    if (!canonicalPath.isEmpty())
+        cell = mCellForPath.value(pathKey(canonicalPath));
+    if (!cell)
+        mMapWithoutWorld.insert(key);
+    return cell;
 }
 
 void WorldEdMgr::setLevelVisible(WorldCellLevel *level, bool visible)
@@ -146,20 +260,98 @@ void WorldEdMgr::fileChangedTimeout()
     foreach (QString fileName, files) {
         QFileInfo info(fileName);
         for (int i = 0; i < mWorlds.size(); i++) {
-            if (info == QFileInfo(mWorldFileNames[i])) {
-                setSelectedLots(QSet<WorldCellLot*>());
-                emit beforeWorldChanged(mWorldFileNames[i]);
-                if (mCheckedDocuments.contains(mWorlds[i])) {
-                    mCheckedDocuments.remove(mWorlds[i]);
-                }
-                mMapWithoutWorld.clear();
-                delete mWorlds[i];
+            if (info != QFileInfo(mWorldFileNames[i]))
+                continue;
+            mWatcher.removePath(fileName);
+            World *newWorld = 0;
+            if (info.exists()) {
+                WorldReader reader;
+                newWorld = reader.readWorld(fileName);
+            }
+            if (newWorld)
+                mWatcher.addPath(fileName);
+
+            if (newWorld && updateCells(mWorlds[i], newWorld)) {
+                delete newWorld;
+                break;
+            }
+
+            setSelectedLots(QSet<WorldCellLot*>());
+            emit beforeWorldChanged(mWorldFileNames[i]);
+            delete mWorlds[i];
+            if (newWorld) {
+                mWorlds[i] = newWorld;
+            } else {
                 mWorlds.removeAt(i);
                 mWorldFileNames.removeAt(i);
-                mWatcher.removePath(fileName);
-                if (info.exists())
-                    addProject(fileName);
-                emit afterWorldChanged(fileName);
+            }
+            indexCells();
+            emit afterWorldChanged(fileName);
+            break;
+        }
+    }
+}
+
+/**
+ * Copies the cells of \a newWorld that differ into \a world, so the cells
+ * that didn't change keep their lots and anyone holding on to them needn't
+ * let go.  Only the settings of the world and the contents of its cells are
+ * copied, the roads and BMPs aren't used here.  Returns false when the two
+ * worlds are too different, and \a world is left alone.
+ */
+bool WorldEdMgr::updateCells(World *world, World *newWorld)
+{
+    if (world->size() != newWorld->size() || !sameDefinitions(world, newWorld))
+        return false;
+
+    world->setBMPToTMXSettings(newWorld->getBMPToTMXSettings());
+    world->setGenerateLotsSettings(newWorld->getGenerateLotsSettings());
+    world->setLuaSettings(newWorld->getLuaSettings());
+    world->setHeightMapFileName(newWorld->hmFileName());
+
+    QList<WorldCell*> changed;
+    for (int y = 0; y < world->height(); y++) {
+        for (int x = 0; x < world->width(); x++) {
+            WorldCell *cell = world->cellAt(x, y);
+            if (!sameCell(cell, newWorld->cellAt(x, y)))
+                changed += cell;
+        }
+    }
+    if (changed.isEmpty())
+        return true;
+
+    QSet<WorldCellLot*> selected = mSelectedLots;
+    for (WorldCell *cell : changed) {
+        for (WorldCellLot *lot : cell->lots())
+            selected.remove(lot);
+    }
+    setSelectedLots(selected);
+
+    for (WorldCell *cell : changed)
+        emit beforeCellChanged(cell);
+    for (WorldCell *cell : changed)
+        moveCellContents(newWorld->cellAt(cell->pos()), cell);
+    indexCells();
+    for (WorldCell *cell : changed)
+        emit afterCellChanged(cell);
+
+    return true;
+}
+
+void WorldEdMgr::indexCells()
+{
+    mCellForPath.clear();
+    mMapWithoutWorld.clear();
+    for (World *world : qAsConst(mWorlds)) {
+        for (int y = 0; y < world->height(); y++) {
+            for (int x = 0; x < world->width(); x++) {
+                WorldCell *cell = world->cellAt(x, y);
+                if (cell->mapFilePath().isEmpty())
+                    continue;
+                // The first world using a map wins.
+                const QString key = pathKey(cell->mapFilePath());
+                if (!mCellForPath.contains(key))
+                    mCellForPath.insert(key, cell);
             }
         }
     }
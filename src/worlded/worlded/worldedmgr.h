@@ -18,6 +18,7 @@
 #ifndef WORLDEDMGR_H
 #define WORLDEDMGR_H
 
+#include <QHash>
 #include <QObject>
 #include <QSet>
 #include <QStringList>
@@ -59,6 +60,14 @@ signals:
     void beforeWorldChanged(const QString &fileName);
     void afterWorldChanged(const QString &fileName);
 
+    /**
+     * When a reloaded world only differs in the contents of some cells,
+     * these are emitted for each of those cells instead of the signals
+     * above.  The cell's lots are deleted between the two.
+     */
+    void beforeCellChanged(WorldCell *cell);
+    void afterCellChanged(WorldCell *cell);
+
     void levelVisibilityChanged(WorldCellLevel *level);
     void lotVisibilityChanged(WorldCellLot *lot);
 
@@ -74,13 +83,18 @@ private:
     WorldEdMgr(QObject *parent = 0);
     ~WorldEdMgr();
 
+    bool updateCells(World *world, World *newWorld);
+    void indexCells();
+
     QList<World*> mWorlds;
     QStringList mWorldFileNames;
     Tiled::Internal::FileSystemWatcher mWatcher;
     QSet<QString> mChangedFiles;
     QTimer mChangedFilesTimer;
     QSet<WorldCellLot*> mSelectedLots;
-    QHash<World*,QMap<QString,WorldCell*>> mCheckedDocuments;
+    QHash<QString,WorldCell*> mCellForPath;
+    // Paths cellForMap() found in no world, so they aren't canonicalized
+    // again on every lookup.  Cleared whenever the cells are indexed again.
     QSet<QString> mMapWithoutWorld;
 };
 
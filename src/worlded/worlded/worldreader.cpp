@@ -20,13 +20,397 @@
 #include "world.h"
 #include "worldcell.h"
 
+#include "tracing.h"
+
 #include <QCoreApplication>
 #include <QDir>
 #include <QDebug>
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
 #include <QXmlStreamReader>
 
+#include <algorithm>
+
+namespace {
+
+// Worlds with fewer cells than this are read on the calling thread.
+const int MIN_CELLS_FOR_THREADS = 256;
+
+QString resolvePath(const QString &fileName, const QString &relativeTo)
+{
+//    qDebug() << "resolveReference" << fileName << "relative to" << relativeTo;
+    if (fileName.isEmpty())
+        return fileName;
+    if (fileName == QLatin1String("."))
+        return relativeTo;
+    if (QDir::isRelativePath(fileName)) {
+        QString path = relativeTo + QLatin1Char('/') + fileName;
+        QFileInfo info(path);
+        if (info.exists())
+            return info.canonicalFilePath();
+        return QDir::cleanPath(path);
+    }
+    return fileName;
+}
+
+/**
+ * What the cells of a world refer to: the definitions read before the cells,
+ * and the map files of cells and lots.  Once index() is called this may be
+ * used by several threads at once.
+ */
+class WorldContext
+{
+public:
+    WorldContext()
+        : mWorld(0)
+        , mIndexed(false)
+    {
+    }
+
+    void setWorld(World *world, const QString &path)
+    {
+        mWorld = world;
+        mPath = path;
+        mIndexed = false;
+        mPropertyDefs.clear();
+        mTemplates.clear();
+        mObjectGroups.clear();
+        mObjectTypes.clear();
+        mResolved.clear();
+    }
+
+    World *world() const { return mWorld; }
+
+    /**
+     * Replaces the linear searches through the world's lists with hashes.
+     * The first of several definitions with the same name wins, as with
+     * the lists' find() functions.
+     */
+    void index()
+    {
+        for (PropertyDef *pd : mWorld->propertyDefinitions())
+            if (!mPropertyDefs.contains(pd->mName))
+                mPropertyDefs.insert(pd->mName, pd);
+        for (PropertyTemplate *pt : mWorld->propertyTemplates())
+            if (!mTemplates.contains(pt->mName))
+                mTemplates.insert(pt->mName, pt);
+        for (WorldObjectGroup *og : mWorld->objectGroups())
+            if (!mObjectGroups.contains(og->name()))
+                mObjectGroups.insert(og->name(), og);
+        for (ObjectType *ot : mWorld->objectTypes())
+            if (!mObjectTypes.contains(ot->name()))
+                mObjectTypes.insert(ot->name(), ot);
+        mIndexed = true;
+    }
+
+    PropertyDef *propertyDef(const QString &name) const
+    {
+        if (mIndexed)
+            return mPropertyDefs.value(name);
+        return mWorld->propertyDefinitions().findPropertyDef(name);
+    }
+
+    PropertyTemplate *propertyTemplate(const QString &name) const
+    {
+        if (mIndexed)
+            return mTemplates.value(name);
+        return mWorld->propertyTemplates().find(name);
+    }
+
+    WorldObjectGroup *objectGroup(const QString &name) const
+    {
+        if (mIndexed)
+            return mObjectGroups.value(name);
+        return mWorld->objectGroups().find(name);
+    }
+
+    ObjectType *objectType(const QString &name) const
+    {
+        if (mIndexed)
+            return mObjectTypes.value(name);
+        return mWorld->objectTypes().find(name);
+    }
+
+    /**
+     * Most lots use a handful of maps, so each name is only looked up on
+     * disk once, and every lot using it shares the one resolved string.
+     */
+    QString resolveReference(const QString &fileName)
+    {
+        {
+            QMutexLocker locker(&mMutex);
+            QHash<QString,QString>::const_iterator it = mResolved.constFind(fileName);
+            if (it != mResolved.constEnd())
+                return it.value();
+        }
+        // Two threads may resolve the same name at once, the first one wins.
+        const QString resolved = resolvePath(fileName, mPath);
+        QMutexLocker locker(&mMutex);
+        QHash<QString,QString>::const_iterator it = mResolved.constFind(fileName);
+        if (it != mResolved.constEnd())
+            return it.value();
+        mResolved.insert(fileName, resolved);
+        return resolved;
+    }
+
+private:
+    World *mWorld;
+    QString mPath;
+    bool mIndexed;
+    QHash<QString,PropertyDef*> mPropertyDefs;
+    QHash<QString,PropertyTemplate*> mTemplates;
+    QHash<QString,WorldObjectGroup*> mObjectGroups;
+    QHash<QString,ObjectType*> mObjectTypes;
+    QMutex mMutex;
+    QHash<QString,QString> mResolved;
+};
+
+/**
+ * Reads one <cell> element.  Each cell is only changed by the reader reading
+ * it, so cells can be read on several threads at once.
+ */
+class CellReader
+{
+    Q_DECLARE_TR_FUNCTIONS(MapReader)
+
+public:
+    CellReader(WorldContext &context, QXmlStreamReader &xml)
+        : mContext(context)
+        , mWorld(context.world())
+        , xml(xml)
+    {
+    }
+
+    void readCell()
+    {
+        Q_ASSERT(xml.isStartElement() && xml.name() == QLatin1String("cell"));
+
+        const QXmlStreamAttributes atts = xml.attributes();
+        const int x =
+                atts.value(QLatin1String("x")).toString().toInt();
+        const int y =
+                atts.value(QLatin1String("y")).toString().toInt();
+        const QString mapName = atts.value(QLatin1String("map")).toString();
+
+        if (!mWorld->contains(x, y))
+            xml.raiseError(tr("Invalid cell coodinates %1,%2").arg(x).arg(y));
+        else {
+            WorldCell *cell = mWorld->cellAt(x, y);
+            cell->setMapFilePath(mContext.resolveReference(mapName));
+
+            while (xml.readNextStartElement()) {
+                if (xml.name() == QLatin1String("template"))
+                    readTemplateInstance(cell);
+                else if (xml.name() == QLatin1String("property"))
+                    readProperty(cell);
+                else if (xml.name() == QLatin1String("lot"))
+                    readLot(cell);
+                else if (xml.name() == QLatin1String("object"))
+                    readObject(cell);
+                else
+                    readUnknownElement();
+            }
+
+        }
+    }
+
+private:
+    void readLot(WorldCell *cell)
+    {
+        Q_ASSERT(xml.isStartElement() && xml.name() == QLatin1String("lot"));
+
+        const QXmlStreamAttributes atts = xml.attributes();
+        const int x =
+                atts.value(QLatin1String("x")).toString().toInt();
+        const int y =
+                atts.value(QLatin1String("y")).toString().toInt();
+        const int level =
+                atts.value(QLatin1String("level")).toString().toInt();
+        const QString mapName = atts.value(QLatin1String("map")).toString();
+        const int width =
+                atts.value(QLatin1String("width")).toString().toInt();
+        const int height =
+                atts.value(QLatin1String("height")).toString().toInt();
+
+        // No check wanted/needed on Lot coordinates
+        cell->addLot(mContext.resolveReference(mapName), x, y, level, width, height);
+
+        xml.skipCurrentElement();
+    }
+
+    void readObject(WorldCell *cell)
+    {
+        Q_ASSERT(xml.isStartElement() && xml.name() == QLatin1String("object"));
+
+        const QXmlStreamAttributes atts = xml.attributes();
+        const QString name = atts.value(QLatin1String("name")).toString();
+
+        const QString group = atts.value(QLatin1String("group")).toString();
+        WorldObjectGroup *objGroup = mContext.objectGroup(group);
+        if (!objGroup) {
+            xml.raiseError(tr("unknown object group \"%1\"").arg(group));
+            return;
+        }
+
+        const QString type = atts.value(QLatin1String("type")).toString();
+        ObjectType *objType = mContext.objectType(type);
+        if (!objType) {
+            xml.raiseError(tr("unknown object type \"%1\"").arg(type));
+            return;
+        }
+
+        const qreal x =
+                atts.value(QLatin1String("x")).toString().toDouble();
+        const qreal y =
+                atts.value(QLatin1String("y")).toString().toDouble();
+        int level =
+                atts.value(QLatin1String("level")).toString().toInt();
+        if (level < 0) level = 0;
+        if (level > 500) level = 500;
+        const qreal width =
+                atts.value(QLatin1String("width")).toString().toDouble();
+        const qreal height =
+                atts.value(QLatin1String("height")).toString().toDouble();
+
+        // No check wanted/needed on Object coordinates
+        WorldCellObject *obj = new WorldCellObject(cell, name, objType, objGroup,
+                                                   x, y, level, width, height);
+        cell->insertObject(cell->objects().size(), obj);
+
+        while (xml.readNextStartElement()) {
+            if (xml.name() == QLatin1String("template"))
+                readTemplateInstance(obj);
+            else if (xml.name() == QLatin1String("property"))
+                readProperty(obj);
+            else
+                readUnknownElement();
+        }
+    }
+
+    void readProperty(PropertyHolder *ph)
+    {
+        Q_ASSERT(xml.isStartElement() && xml.name() == QLatin1String("property"));
+
+        const QXmlStreamAttributes atts = xml.attributes();
+        const QString name = atts.value(QLatin1String("name")).toString();
+        const QString value = atts.value(QLatin1String("value")).toString();
+
+        PropertyDef *pd = mContext.propertyDef(name);
+        if (!pd) {
+            xml.raiseError(tr("property has unknown propertydef \"%1\"").arg(name));
+            return;
+        }
+
+        Property *p = new Property(pd, value);
+        ph->addProperty(ph->properties().size(), p);
+
+        xml.skipCurrentElement();
+    }
+
+    void readTemplateInstance(PropertyHolder *ph)
+    {
+        Q_ASSERT(xml.isStartElement() && xml.name() == QLatin1String("template"));
+
+        const QXmlStreamAttributes atts = xml.attributes();
+        const QString name = atts.value(QLatin1String("name")).toString();
+
+        PropertyTemplate *pt = mContext.propertyTemplate(name);
+        if (!pt) {
+            xml.raiseError(tr("unknown template \"%1\"").arg(name));
+            return;
+        }
+
+        ph->addTemplate(ph->templates().size(), pt);
+
+        xml.skipCurrentElement();
+    }
+
+    void readUnknownElement()
+    {
+        qDebug() << "Unknown element (fixme):" << xml.name();
+        xml.skipCurrentElement();
+    }
+
+    WorldContext &mContext;
+    World *mWorld;
+    QXmlStreamReader &xml;
+};
+
+/**
+ * Where a <cell> element is in the text of the world file, and what went
+ * wrong reading it, if anything.  The line and column are within the element.
+ */
+struct CellRecord
+{
+    int start;
+    int end;
+    QString error;
+    qint64 line;
+    qint64 column;
+};
+
+void readCellRecord(WorldContext &context, const QString &text, CellRecord &record)
+{
+    QXmlStreamReader xml(text.mid(record.start, record.end - record.start));
+    if (xml.readNextStartElement())
+        CellReader(context, xml).readCell();
+    if (xml.hasError()) {
+        record.error = xml.errorString();
+        record.line = xml.lineNumber();
+        record.column = xml.columnNumber();
+    }
+}
+
+class ReadCellsTask : public QRunnable
+{
+public:
+    ReadCellsTask(WorldContext &context, const QString &text,
+                  QVector<CellRecord> &records, int first, int last) :
+        mContext(context),
+        mText(text),
+        mRecords(records),
+        mFirst(first),
+        mLast(last)
+    {
+    }
+
+    void run()
+    {
+        for (int i = mFirst; i < mLast; i++)
+            readCellRecord(mContext, mText, mRecords[i]);
+    }
+
+private:
+    WorldContext &mContext;
+    const QString &mText;
+    QVector<CellRecord> &mRecords;
+    int mFirst;
+    int mLast;
+};
+
+// The cells are found by their offsets in the decoded text, which needs the
+// encoding known up front.  WorldEd always writes UTF-8.
+bool isUtf8(const QByteArray &data)
+{
+    if (!data.startsWith("<?xml"))
+        return true;
+    const int end = data.indexOf("?>");
+    if (end == -1)
+        return false;
+    const QByteArray decl = data.left(end).toLower();
+    const int pos = decl.indexOf("encoding");
+    if (pos == -1)
+        return true;
+    return decl.indexOf("utf-8", pos) != -1 || decl.indexOf("utf8", pos) != -1;
+}
+
+} // namespace
+
 class WorldReaderPrivate
 {
     Q_DECLARE_TR_FUNCTIONS(MapReader)
@@ -65,11 +449,27 @@ public:
 
     World *readWorld(QIODevice *device, const QString &path)
     {
+        TRACE_ZONE("WorldReader::readWorld");
+
         mError.clear();
         mPath = path;
+        mCells.clear();
+        mCellPos.clear();
+        xml.clear();
         World *world = 0;
 
-        xml.setDevice(device);
+        // Cells are found in a first pass and read afterwards, several at a
+        // time, which needs the whole text in memory.
+        QByteArray data = device->readAll();
+        if (data.startsWith("\xEF\xBB\xBF"))
+            data.remove(0, 3);
+        if (isUtf8(data)) {
+            mText = QString::fromUtf8(data);
+            xml.addData(mText);
+        } else {
+            mText.clear();
+            xml.addData(data);
+        }
 
         if (xml.readNextStartElement() && xml.name() == QLatin1String("world")) {
             world = readWorld();
@@ -92,6 +492,7 @@ private:
                 atts.value(QLatin1String("height")).toString().toInt();
 
         mWorld = new World(width, height);
+        mContext.setWorld(mWorld, mPath);
 
         while (xml.readNextStartElement()) {
             if (xml.name() == QLatin1String("propertyenum"))
@@ -107,7 +508,7 @@ private:
             else if (xml.name() == QLatin1String("road"))
                 readRoad();
             else if (xml.name() == QLatin1String("cell"))
-                readCell();
+                findCell();
             else if (xml.name() == QLatin1String("BMPToTMX"))
                 readBMPToTMX();
             else if (xml.name() == QLatin1String("GenerateLots"))
@@ -122,8 +523,11 @@ private:
                 readUnknownElement();
         }
 
+        if (!xml.hasError())
+            readCells();
+
         // Clean up in case of error
-        if (xml.hasError()) {
+        if (xml.hasError() || !mError.isEmpty()) {
             delete mWorld;
             mWorld = 0;
         }
@@ -340,108 +744,90 @@ private:
         }
     }
 
-    void readCell()
+    /**
+     * Notes where this cell is in the text, to be read by readCells().
+     * Without the text, the cell is read right away.
+     */
+    void findCell()
     {
         Q_ASSERT(xml.isStartElement() && xml.name() == QLatin1String("cell"));
 
-        const QXmlStreamAttributes atts = xml.attributes();
-        const int x =
-                atts.value(QLatin1String("x")).toString().toInt();
-        const int y =
-                atts.value(QLatin1String("y")).toString().toInt();
-        const QString mapName = atts.value(QLatin1String("map")).toString();
-
-        if (!mWorld->contains(x, y))
-            xml.raiseError(tr("Invalid cell coodinates %1,%2").arg(x).arg(y));
-        else {
-            WorldCell *cell = mWorld->cellAt(x, y);
-            cell->setMapFilePath(resolveReference(mapName, mPath));
-
-            while (xml.readNextStartElement()) {
-                if (xml.name() == QLatin1String("template"))
-                    readTemplateInstance(cell);
-                else if (xml.name() == QLatin1String("property"))
-                    readProperty(cell);
-                else if (xml.name() == QLatin1String("lot"))
-                    readLot(cell);
-                else if (xml.name() == QLatin1String("object"))
-                    readObject(cell);
-                else
-                    readUnknownElement();
-            }
-
+        if (mText.isEmpty()) {
+            CellReader(mContext, xml).readCell();
+            return;
         }
-    }
-
-    void readLot(WorldCell *cell)
-    {
-        Q_ASSERT(xml.isStartElement() && xml.name() == QLatin1String("lot"));
 
         const QXmlStreamAttributes atts = xml.attributes();
         const int x =
                 atts.value(QLatin1String("x")).toString().toInt();
         const int y =
                 atts.value(QLatin1String("y")).toString().toInt();
-        const int level =
-                atts.value(QLatin1String("level")).toString().toInt();
-        const QString mapName = atts.value(QLatin1String("map")).toString();
-        const int width =
-                atts.value(QLatin1String("width")).toString().toInt();
-        const int height =
-                atts.value(QLatin1String("height")).toString().toInt();
-
-        // No check wanted/needed on Lot coordinates
-        cell->addLot(resolveReference(mapName, mPath), x, y, level, width, height);
+        if (!mWorld->contains(x, y)) {
+            xml.raiseError(tr("Invalid cell coodinates %1,%2").arg(x).arg(y));
+            return;
+        }
 
+        // Attribute values can't contain '<', so the first one before the
+        // end of the start tag begins the element.
+        CellRecord record;
+        record.start = mText.lastIndexOf(QLatin1Char('<'), int(xml.characterOffset()) - 1);
         xml.skipCurrentElement();
+        record.end = int(xml.characterOffset());
+        record.line = record.column = 0;
+        mCells += record;
+        mCellPos += QPoint(x, y);
     }
 
-    void readObject(WorldCell *cell)
+    void readCells()
     {
-        Q_ASSERT(xml.isStartElement() && xml.name() == QLatin1String("object"));
+        if (mCells.isEmpty())
+            return;
 
-        const QXmlStreamAttributes atts = xml.attributes();
-        const QString name = atts.value(QLatin1String("name")).toString();
+        TRACE_ZONE("WorldReader::readCells");
 
-        const QString group = atts.value(QLatin1String("group")).toString();
-        WorldObjectGroup *objGroup = mWorld->objectGroups().find(group);
-        if (!objGroup) {
-            xml.raiseError(tr("unknown object group \"%1\"").arg(group));
-            return;
-        }
+        mContext.index();
 
-        const QString type = atts.value(QLatin1String("type")).toString();
-        ObjectType *objType = mWorld->objectTypes().find(type);
-        if (!objType) {
-            xml.raiseError(tr("unknown object type \"%1\"").arg(type));
-            return;
+        // Cells appearing more than once are added to in file order, which
+        // only one thread can do.
+        bool threads = mCells.size() >= MIN_CELLS_FOR_THREADS;
+        QVector<bool> seen(mWorld->width() * mWorld->height(), false);
+        for (const QPoint &pos : qAsConst(mCellPos)) {
+            bool &b = seen[pos.x() + pos.y() * mWorld->width()];
+            if (b) {
+                threads = false;
+                break;
+            }
+            b = true;
         }
 
-        const qreal x =
-                atts.value(QLatin1String("x")).toString().toDouble();
-        const qreal y =
-                atts.value(QLatin1String("y")).toString().toDouble();
-        int level =
-                atts.value(QLatin1String("level")).toString().toInt();
-        if (level < 0) level = 0;
-        if (level > 500) level = 500;
-        const qreal width =
-                atts.value(QLatin1String("width")).toString().toDouble();
-        const qreal height =
-                atts.value(QLatin1String("height")).toString().toDouble();
-
-        // No check wanted/needed on Object coordinates
-        WorldCellObject *obj = new WorldCellObject(cell, name, objType, objGroup,
-                                                   x, y, level, width, height);
-        cell->insertObject(cell->objects().size(), obj);
+        if (threads) {
+            const int bandCount = qBound(1, QThread::idealThreadCount() * 4, mCells.size());
+            const int cellsPerBand = (mCells.size() + bandCount - 1) / bandCount;
+            QThreadPool pool;
+            for (int first = 0; first < mCells.size(); first += cellsPerBand) {
+                const int last = qMin(first + cellsPerBand, mCells.size());
+                pool.start(new ReadCellsTask(mContext, mText, mCells, first, last));
+            }
+            pool.waitForDone();
+        } else {
+            for (CellRecord &record : mCells) {
+                readCellRecord(mContext, mText, record);
+                if (!record.error.isEmpty())
+                    break;
+            }
+        }
 
-        while (xml.readNextStartElement()) {
-            if (xml.name() == QLatin1String("template"))
-                readTemplateInstance(obj);
-            else if (xml.name() == QLatin1String("property"))
-                readProperty(obj);
-            else
-                readUnknownElement();
+        for (const CellRecord &record : qAsConst(mCells)) {
+            if (record.error.isEmpty())
+                continue;
+            const qint64 lines = std::count(mText.constBegin(),
+                                            mText.constBegin() + record.start,
+                                            QLatin1Char('\n'));
+            mError = tr("%3\n\nLine %1, column %2")
+                    .arg(lines + record.line)
+                    .arg(record.column)
+                    .arg(record.error);
+            break;
         }
     }
 
@@ -594,19 +980,7 @@ private:
 
     QString resolveReference(const QString &fileName, const QString &relativeTo)
     {
-//        qDebug() << "resolveReference" << fileName << "relative to" << relativeTo;
-        if (fileName.isEmpty())
-            return fileName;
-        if (fileName == QLatin1String("."))
-            return relativeTo;
-        if (QDir::isRelativePath(fileName)) {
-            QString path = relativeTo + QLatin1Char('/') + fileName;
-            QFileInfo info(path);
-            if (info.exists())
-                return info.canonicalFilePath();
-            return QDir::cleanPath(path);
-        }
-        return fileName;
+        return resolvePath(fileName, relativeTo);
     }
 
 private:
@@ -614,6 +988,10 @@ private:
     World *mWorld;
     QString mError;
     QXmlStreamReader xml;
+    QString mText;
+    WorldContext mContext;
+    QVector<CellRecord> mCells;
+    QVector<QPoint> mCellPos;
 };
 
 /////
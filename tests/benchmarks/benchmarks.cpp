@@ -0,0 +1,930 @@
+/*
+ * Benchmarks for libtiled.
+ *
+ * Every benchmark runs on synthetic maps built from a fixed seed, so results
+ * from different commits can be compared.  Results are written as JSON,
+ * either to stdout or to the file given with -o.  Run with --help to see the
+ * options.
+ */
+
+#include "automappingmatcher.h"
+#include "imagekernels.h"
+#include "map.h"
+#include "mapreader.h"
+#include "mapwriter.h"
+#include "roomgraph.h"
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+#include "zlevelrenderer.h"
+#include "ztilelayergroup.h"
+
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGuiApplication>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QPainter>
+#include <QRegion>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+namespace {
+
+struct Options
+{
+    int size = 300;
+    int layers = 8;
+    int iterations = 5;
+    qreal density = 0.6;
+    QString filter;
+};
+
+// A small LCG so every run (and every platform) sees the same maps.
+class Random
+{
+public:
+    explicit Random(quint32 seed) : mState(seed) {}
+
+    quint32 next()
+    {
+        mState = mState * 1664525u + 1013904223u;
+        return mState >> 8;
+    }
+
+    qreal nextReal() { return next() / qreal(1 << 24); }
+    int bounded(int n) { return int(next() % quint32(n)); }
+
+private:
+    quint32 mState;
+};
+
+// 8x8 tiles of 64x128 pixels.  Only the bottom half of each tile is drawn,
+// like most Project Zomboid floor tiles.
+Tileset *createTileset(const QString &name, const QString &imageFileName)
+{
+    QImage image(64 * 8, 128 * 8, QImage::Format_ARGB32);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    for (int i = 0; i < 64; ++i) {
+        int x = (i % 8) * 64, y = (i / 8) * 128;
+        painter.fillRect(x + 8, y + 64, 48, 64, QColor::fromHsv((i * 37) % 360, 200, 220));
+    }
+    painter.end();
+    if (!imageFileName.isEmpty())
+        image.save(imageFileName);
+
+    Tileset *tileset = new Tileset(name, 64, 128);
+    tileset->loadFromImage(image, imageFileName);
+    return tileset;
+}
+
+Map *generateMap(const Options &options, const QList<Tileset*> &tilesets)
+{
+    Map *map = new Map(Map::LevelIsometric, options.size, options.size, 64, 32);
+    for (Tileset *tileset : tilesets)
+        map->addTileset(tileset);
+
+    Random random(12345);
+    for (int i = 0; i < options.layers; ++i) {
+        TileLayer *tl = new TileLayer(QString(QLatin1String("0_Layer%1")).arg(i),
+                                      0, 0, options.size, options.size);
+        // Lower layers are denser, like floors compared with furniture.
+        qreal density = options.density / (1 + i / 2);
+        for (int y = 0; y < options.size; ++y) {
+            for (int x = 0; x < options.size; ++x) {
+                if (random.nextReal() >= density)
+                    continue;
+                Tileset *tileset = tilesets[random.bounded(tilesets.size())];
+                tl->setCell(x, y, Cell(tileset->tileAt(random.bounded(tileset->tileCount()))));
+            }
+        }
+        map->addLayer(tl);
+    }
+    return map;
+}
+
+void deleteMap(Map *map)
+{
+    QList<Tileset*> tilesets = map->tilesets();
+    delete map;
+    qDeleteAll(tilesets);
+}
+
+// The simplest possible layer group: every layer on level 0, fully opaque.
+class BenchLayerGroup : public ZTileLayerGroup
+{
+public:
+    BenchLayerGroup(Map *map)
+        : ZTileLayerGroup(map, 0)
+    {
+        int index = 0;
+        for (Layer *layer : map->layers()) {
+            if (TileLayer *tl = layer->asTileLayer())
+                addTileLayer(tl, index);
+            ++index;
+        }
+    }
+
+    bool orderedCellsAt(const QPoint &pos, QVector<const Cell*> &cells,
+                        QVector<qreal> &opacities) const
+    {
+        cells.resize(0);
+        opacities.resize(0);
+        for (TileLayer *tl : mLayers) {
+            if (!tl->contains(pos))
+                continue;
+            const Cell &cell = tl->cellAt(pos);
+            if (!cell.isEmpty()) {
+                cells += &cell;
+                opacities += 1.0;
+            }
+        }
+        return !cells.isEmpty();
+    }
+
+    void prepareDrawing(const MapRenderer *, const QRect &)
+    {
+    }
+};
+
+class Runner
+{
+public:
+    Runner(const Options &options)
+        : mOptions(options)
+    {
+    }
+
+    // Runs body once to warm up, then times it mOptions.iterations times.
+    void run(const QString &name, const std::function<void()> &body)
+    {
+        if (!mOptions.filter.isEmpty() && !name.contains(mOptions.filter))
+            return;
+
+        body();
+
+        QVector<qint64> samples;
+        QElapsedTimer timer;
+        for (int i = 0; i < mOptions.iterations; ++i) {
+            timer.start();
+            body();
+            samples += timer.nsecsElapsed();
+        }
+        std::sort(samples.begin(), samples.end());
+
+        qint64 total = 0;
+        for (qint64 ns : qAsConst(samples))
+            total += ns;
+
+        QJsonObject result;
+        result[QLatin1String("name")] = name;
+        result[QLatin1String("iterations")] = samples.size();
+        result[QLatin1String("min_ms")] = samples.first() / 1e6;
+        result[QLatin1String("median_ms")] = samples[samples.size() / 2] / 1e6;
+        result[QLatin1String("mean_ms")] = total / 1e6 / samples.size();
+        mResults.append(result);
+
+        QTextStream(stderr) << name << ": median "
+                            << QString::number(samples[samples.size() / 2] / 1e6, 'f', 3)
+                            << " ms\n";
+    }
+
+    // Records that a benchmark produced wrong results, which makes the
+    // program exit with an error.
+    void fail(const QString &message)
+    {
+        QTextStream(stderr) << "FAIL: " << message << "\n";
+        mFailed = true;
+    }
+
+    bool failed() const { return mFailed; }
+
+    QJsonDocument report() const
+    {
+        QJsonObject parameters;
+        parameters[QLatin1String("size")] = mOptions.size;
+        parameters[QLatin1String("layers")] = mOptions.layers;
+        parameters[QLatin1String("density")] = mOptions.density;
+        parameters[QLatin1String("iterations")] = mOptions.iterations;
+
+        QJsonObject root;
+        root[QLatin1String("qt")] = QLatin1String(qVersion());
+        root[QLatin1String("parameters")] = parameters;
+        root[QLatin1String("results")] = mResults;
+        return QJsonDocument(root);
+    }
+
+private:
+    Options mOptions;
+    QJsonArray mResults;
+    bool mFailed = false;
+};
+
+void benchmarkTileLayers(Runner &runner, const Options &options)
+{
+    QList<Tileset*> tilesets;
+    for (int i = 0; i < 4; ++i)
+        tilesets += createTileset(QString(QLatin1String("bench_%1")).arg(i), QString());
+
+    runner.run(QLatin1String("tilelayer/generate"), [&]() {
+        Map *map = generateMap(options, tilesets);
+        delete map;
+    });
+
+    Map *map = generateMap(options, tilesets);
+
+    runner.run(QLatin1String("tilelayer/usedTilesets"), [&]() {
+        for (TileLayer *tl : map->tileLayers())
+            (void) tl->usedTilesets();
+    });
+
+    TileLayer *layer = map->tileLayers().first();
+    TileLayer *changed = static_cast<TileLayer*>(layer->clone());
+    Random random(54321);
+    for (int i = 0; i < 100; ++i)
+        changed->setCell(random.bounded(options.size), random.bounded(options.size), Cell());
+    runner.run(QLatin1String("tilelayer/computeDiffRegion"), [&]() {
+        (void) layer->computeDiffRegion(changed);
+    });
+    delete changed;
+
+    delete map;
+    qDeleteAll(tilesets);
+}
+
+void benchmarkReadWrite(Runner &runner, const Options &options)
+{
+    QTemporaryDir dir;
+    QList<Tileset*> tilesets;
+    for (int i = 0; i < 4; ++i) {
+        QString name = QString(QLatin1String("bench_%1")).arg(i);
+        tilesets += createTileset(name, dir.path() + QLatin1Char('/') + name + QLatin1String(".png"));
+    }
+    Map *map = generateMap(options, tilesets);
+
+    struct Format {
+        const char *name;
+        MapWriter::LayerDataFormat format;
+    };
+    const Format formats[] = {
+        { "base64zlib", MapWriter::Base64Zlib },
+        { "csv", MapWriter::CSV },
+        { "xml", MapWriter::XML }
+    };
+
+    for (const Format &format : formats) {
+        QString fileName = dir.path() + QLatin1String("/bench_") + QLatin1String(format.name) + QLatin1String(".tmx");
+
+        runner.run(QLatin1String("mapwriter/writeMap/") + QLatin1String(format.name), [&]() {
+            MapWriter writer;
+            writer.setLayerDataFormat(format.format);
+            if (!writer.writeMap(map, fileName))
+                qWarning("writeMap failed: %s", qPrintable(writer.errorString()));
+        });
+
+        runner.run(QLatin1String("mapreader/readMap/") + QLatin1String(format.name), [&]() {
+            MapReader reader;
+            Map *result = reader.readMap(fileName);
+            if (!result) {
+                qWarning("readMap failed: %s", qPrintable(reader.errorString()));
+                return;
+            }
+            deleteMap(result);
+        });
+    }
+
+    delete map;
+    qDeleteAll(tilesets);
+}
+
+// A cell like the ones saved from the editor: many tile layers, both BMP
+// images painted and a few no-blend layers.
+void benchmarkWriteCell(Runner &runner, const Options &options)
+{
+    QTemporaryDir dir;
+    QList<Tileset*> tilesets;
+    for (int i = 0; i < 4; ++i) {
+        QString name = QString(QLatin1String("bench_%1")).arg(i);
+        tilesets += createTileset(name, dir.path() + QLatin1Char('/') + name + QLatin1String(".png"));
+    }
+    Options cellOptions = options;
+    cellOptions.layers = qMax(options.layers, 64);
+    Map *map = generateMap(cellOptions, tilesets);
+
+    Random random(13579);
+    const QRgb colors[] = { qRgb(255, 0, 0), qRgb(0, 255, 0), qRgb(0, 0, 255),
+                            qRgb(120, 70, 20), qRgb(90, 100, 35) };
+    for (int y = 0; y < options.size; ++y) {
+        for (int x = 0; x < options.size; ++x) {
+            map->rbmpMain().setPixel(x, y, colors[random.bounded(5)]);
+            if (random.nextReal() < 0.3)
+                map->rbmpVeg().setPixel(x, y, colors[random.bounded(5)]);
+        }
+    }
+    for (int i = 0; i < 4; ++i) {
+        MapNoBlend *noBlend = map->noBlend(QString(QLatin1String("0_Layer%1")).arg(i));
+        for (int n = 0; n < options.size * 4; ++n)
+            noBlend->set(random.bounded(options.size), random.bounded(options.size), true);
+    }
+
+    const QString fileName = dir.path() + QLatin1String("/bench_cell.tmx");
+    runner.run(QLatin1String("mapwriter/writeMap/cell"), [&]() {
+        MapWriter writer;
+        writer.setLayerDataFormat(MapWriter::Base64Gzip);
+        if (!writer.writeMap(map, fileName))
+            qWarning("writeMap failed: %s", qPrintable(writer.errorString()));
+    });
+
+    delete map;
+    qDeleteAll(tilesets);
+}
+
+void benchmarkRendering(Runner &runner, const Options &options)
+{
+    QList<Tileset*> tilesets;
+    for (int i = 0; i < 4; ++i)
+        tilesets += createTileset(QString(QLatin1String("bench_%1")).arg(i), QString());
+    Map *map = generateMap(options, tilesets);
+
+    ZLevelRenderer renderer(map);
+    BenchLayerGroup layerGroup(map);
+
+    // A 1080p view of the middle of the map.
+    QImage image(1920, 1080, QImage::Format_ARGB32_Premultiplied);
+    QPointF center = renderer.tileToPixelCoords(options.size / 2.0, options.size / 2.0);
+    QRectF exposed(center.x() - image.width() / 2, center.y() - image.height() / 2,
+                   image.width(), image.height());
+
+    runner.run(QLatin1String("zlevelrenderer/drawTileLayerGroup/1080p"), [&]() {
+        image.fill(Qt::transparent);
+        QPainter painter(&image);
+        painter.translate(-exposed.topLeft());
+        renderer.drawTileLayerGroup(&painter, &layerGroup, exposed);
+    });
+
+    // The same view zoomed out to 25%, as the editor draws it.
+    QRectF zoomedOut(center.x() - image.width() * 2, center.y() - image.height() * 2,
+                     image.width() * 4, image.height() * 4);
+    runner.run(QLatin1String("zlevelrenderer/drawTileLayerGroup/1080p-25%"), [&]() {
+        image.fill(Qt::transparent);
+        QPainter painter(&image);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        painter.scale(0.25, 0.25);
+        painter.translate(-zoomedOut.topLeft());
+        renderer.drawTileLayerGroup(&painter, &layerGroup, zoomedOut);
+    });
+
+    delete map;
+    qDeleteAll(tilesets);
+}
+
+// The rule matching AutoMapper did before AutoMappingMatcher, kept as the
+// reference its results are checked against.
+QVector<Cell> referenceCellsInRegion(const QVector<TileLayer*> &list, const QRegion &r)
+{
+    QVector<Cell> cells;
+    for (const TileLayer *tilelayer : list) {
+        for (const QRect &rect : r) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
+                for (int y = rect.top(); y <= rect.bottom(); ++y) {
+                    const Cell &cell = tilelayer->cellAt(x, y);
+                    if (!cells.contains(cell))
+                        cells.append(cell);
+                }
+            }
+        }
+    }
+    return cells;
+}
+
+bool referenceCompareLayerTo(const TileLayer *setLayer,
+                             const QVector<TileLayer*> &listYes,
+                             const QVector<TileLayer*> &listNo,
+                             const QRegion &ruleRegion, const QPoint &offset)
+{
+    if (listYes.isEmpty() && listNo.isEmpty())
+        return false;
+
+    QVector<Cell> cells;
+    if (listYes.isEmpty())
+        cells = referenceCellsInRegion(listNo, ruleRegion);
+    if (listNo.isEmpty())
+        cells = referenceCellsInRegion(listYes, ruleRegion);
+
+    for (const QRect &rect : ruleRegion) {
+        for (int x = rect.left(); x <= rect.right(); ++x) {
+            for (int y = rect.top(); y <= rect.bottom(); ++y) {
+                bool ruleDefinedListYes = false;
+                bool matchListYes = false;
+                bool matchListNo = false;
+
+                if (!setLayer->contains(x + offset.x(), y + offset.y()))
+                    return false;
+
+                const Cell &c1 = setLayer->cellAt(x + offset.x(), y + offset.y());
+                if (c1.isEmpty())
+                    return false;
+
+                for (const TileLayer *comparedTileLayer : listYes) {
+                    if (!comparedTileLayer->contains(x, y))
+                        return false;
+                    const Cell &c2 = comparedTileLayer->cellAt(x, y);
+                    if (!c2.isEmpty())
+                        ruleDefinedListYes = true;
+                    if (!c2.isEmpty() && c1 == c2)
+                        matchListYes = true;
+                }
+                for (const TileLayer *comparedTileLayer : listNo) {
+                    if (!comparedTileLayer->contains(x, y))
+                        return false;
+                    const Cell &c2 = comparedTileLayer->cellAt(x, y);
+                    if (!c2.isEmpty() && c1 == c2)
+                        matchListNo = true;
+                }
+
+                if (listYes.isEmpty()) {
+                    if (matchListNo)
+                        return false;
+                    continue;
+                }
+                if (listNo.isEmpty()) {
+                    if (matchListYes)
+                        continue;
+                    if (!ruleDefinedListYes && !cells.contains(c1))
+                        continue;
+                    return false;
+                }
+                if ((matchListYes || !ruleDefinedListYes) && !matchListNo)
+                    continue;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Rules shaped like the ones in tests/automapping: a 3x3 input region whose
+// centre must be one tile, with a tile that must not be on either side.
+void benchmarkAutomapping(Runner &runner, const Options &options)
+{
+    Tileset *tileset = createTileset(QLatin1String("bench_rules"), QString());
+    const int ruleCount = 16;
+
+    TileLayer setLayer(QLatin1String("set"), 0, 0, options.size, options.size);
+    Random random(24680);
+    for (int y = 0; y < options.size; ++y)
+        for (int x = 0; x < options.size; ++x)
+            setLayer.setCell(x, y, Cell(tileset->tileAt(random.bounded(8))));
+
+    TileLayer ruleSet(QLatin1String("rule_set"), 0, 0, ruleCount * 4, 4);
+    TileLayer ruleNotSet(QLatin1String("rule_notset"), 0, 0, ruleCount * 4, 4);
+    QList<AutoMappingMatcher*> matchers;
+    for (int i = 0; i < ruleCount; ++i) {
+        const QRect region(i * 4, 0, 3, 3);
+        ruleSet.setCell(region.center().x(), region.center().y(),
+                        Cell(tileset->tileAt(i % 8)));
+        ruleNotSet.setCell(region.left(), region.center().y(),
+                           Cell(tileset->tileAt((i + 1) % 8)));
+        ruleNotSet.setCell(region.right(), region.center().y(),
+                           Cell(tileset->tileAt((i + 2) % 8)));
+
+        AutoMappingMatcher *matcher = new AutoMappingMatcher(region);
+        matcher->addIndex();
+        matcher->addCondition(&setLayer,
+                              QVector<TileLayer*>() << &ruleSet,
+                              QVector<TileLayer*>() << &ruleNotSet);
+        matchers += matcher;
+    }
+
+    // Every offset where the rule overlaps the map, as AutoMapper::applyRule()
+    // checks them when the whole map is automapped.
+    auto offsetsFor = [&](int i) {
+        return QRect(-(i * 4) - 2, -2, options.size + 4, options.size + 4);
+    };
+
+    // Both ways of matching must give exactly what the old code did, also
+    // for rules with only "set" or only "notset" layers and on a map with
+    // empty cells.
+    TileLayer sparseLayer(QLatin1String("set"), 0, 0, options.size, options.size);
+    for (int y = 0; y < options.size; ++y)
+        for (int x = 0; x < options.size; ++x)
+            if (random.bounded(4))
+                sparseLayer.setCell(x, y, Cell(tileset->tileAt(random.bounded(8))));
+
+    const QVector<TileLayer*> noLayers;
+    struct Check {
+        const char *name;
+        const TileLayer *setLayer;
+        QVector<TileLayer*> listYes;
+        QVector<TileLayer*> listNo;
+    };
+    const Check checks[] = {
+        { "set+notset", &setLayer, QVector<TileLayer*>() << &ruleSet, QVector<TileLayer*>() << &ruleNotSet },
+        { "set+notset/sparse", &sparseLayer, QVector<TileLayer*>() << &ruleSet, QVector<TileLayer*>() << &ruleNotSet },
+        { "set/sparse", &sparseLayer, QVector<TileLayer*>() << &ruleSet, noLayers },
+        { "notset/sparse", &sparseLayer, noLayers, QVector<TileLayer*>() << &ruleNotSet }
+    };
+    for (const Check &check : checks) {
+        for (int i = 0; i < ruleCount; ++i) {
+            const QRegion region(QRect(i * 4, 0, 3, 3));
+            AutoMappingMatcher matcher(region);
+            matcher.addIndex();
+            matcher.addCondition(check.setLayer, check.listYes, check.listNo);
+
+            const QRect offsets = offsetsFor(i);
+            const QVector<uchar> matches = matcher.findMatches(offsets);
+            int n = 0, differences = 0;
+            for (int y = offsets.top(); y <= offsets.bottom(); ++y) {
+                for (int x = offsets.left(); x <= offsets.right(); ++x, ++n) {
+                    const bool expected = referenceCompareLayerTo(check.setLayer, check.listYes,
+                                                                  check.listNo, region, QPoint(x, y));
+                    if (matches[n] != uchar(expected) || matcher.matches(x, y) != expected)
+                        ++differences;
+                }
+            }
+            if (differences)
+                runner.fail(QString(QLatin1String("automapping: %1 rule %2 differs from the reference at %3 offsets"))
+                            .arg(QLatin1String(check.name)).arg(i).arg(differences));
+        }
+    }
+
+    runner.run(QLatin1String("automapping/match/serial"), [&]() {
+        for (int i = 0; i < ruleCount; ++i) {
+            const QRect offsets = offsetsFor(i);
+            for (int y = offsets.top(); y <= offsets.bottom(); ++y)
+                for (int x = offsets.left(); x <= offsets.right(); ++x)
+                    (void) matchers[i]->matches(x, y);
+        }
+    });
+
+    runner.run(QLatin1String("automapping/match/threaded"), [&]() {
+        for (int i = 0; i < ruleCount; ++i)
+            (void) matchers[i]->findMatches(offsetsFor(i));
+    });
+
+    qDeleteAll(matchers);
+    delete tileset;
+}
+
+// How the lot exporter grouped RoomDefs before RoomGraph, kept as the
+// reference the numbering of rooms and buildings is checked against.
+struct ReferenceRect
+{
+    QRect bounds;
+    int level;
+    QString name;
+};
+
+bool referenceIsAdjacent(const QRect &a, const QRect &b)
+{
+    return a.adjusted(-1, -1, 1, 1).intersects(b);
+}
+
+bool referenceInSameRoom(const ReferenceRect &a, const ReferenceRect &b)
+{
+    if (a.level != b.level) return false;
+    if (a.name != b.name) return false;
+    if (!a.name.contains(QLatin1Char('#'))) return false;
+    const QRect &ra = a.bounds, &rb = b.bounds;
+    const QPoint aBR(ra.x() + ra.width(), ra.y() + ra.height());
+    const QPoint bBR(rb.x() + rb.width(), rb.y() + rb.height());
+    const bool touchingCorners = ra.topLeft() == bBR ||
+            QPoint(aBR.x(), ra.y()) == QPoint(rb.x(), bBR.y()) ||
+            QPoint(ra.x(), aBR.y()) == QPoint(bBR.x(), rb.y()) ||
+            aBR == rb.topLeft();
+    return referenceIsAdjacent(ra, rb) && !touchingCorners;
+}
+
+void referenceGroupRooms(const QVector<ReferenceRect> &rects,
+                         QVector<QVector<int> > &rooms, QVector<QVector<int> > &buildings)
+{
+    QMap<int,QVector<int> > rectsByLevel;
+    for (int i = 0; i < rects.size(); ++i)
+        rectsByLevel[rects[i].level] += i;
+
+    QVector<int> roomOf(rects.size(), -1);
+    QMap<int,QVector<int> > roomRects; // by the id the room was created with
+    QVector<int> roomList;
+    int nextRoom = 0;
+    for (const QVector<int> &rrList : qAsConst(rectsByLevel)) {
+        for (int rr : rrList) {
+            if (roomOf[rr] == -1) {
+                roomOf[rr] = nextRoom++;
+                roomRects[roomOf[rr]] += rr;
+                roomList += roomOf[rr];
+            }
+            if (!rects[rr].name.contains(QLatin1Char('#')))
+                continue;
+            for (int comp : rrList) {
+                if (comp == rr || roomOf[comp] == roomOf[rr])
+                    continue;
+                if (!referenceInSameRoom(rects[rr], rects[comp]))
+                    continue;
+                if (roomOf[comp] != -1) {
+                    const int room = roomOf[comp];
+                    for (int rr2 : roomRects[room])
+                        roomOf[rr2] = roomOf[rr];
+                    roomRects[roomOf[rr]] += roomRects.take(room);
+                    roomList.removeOne(room);
+                } else {
+                    roomOf[comp] = roomOf[rr];
+                    roomRects[roomOf[rr]] += comp;
+                }
+            }
+        }
+    }
+    rooms.clear();
+    for (int room : qAsConst(roomList))
+        rooms += roomRects[room];
+
+    auto inSameBuilding = [&](int a, int b) {
+        for (int rr : rooms[a])
+            for (int rr2 : rooms[b])
+                if (referenceIsAdjacent(rects[rr].bounds, rects[rr2].bounds))
+                    return true;
+        return false;
+    };
+    QVector<int> buildingOf(rooms.size(), -1);
+    QMap<int,QVector<int> > buildingRooms;
+    QVector<int> buildingList;
+    int nextBuilding = 0;
+    for (int r = 0; r < rooms.size(); ++r) {
+        if (buildingOf[r] == -1) {
+            buildingOf[r] = nextBuilding++;
+            buildingRooms[buildingOf[r]] += r;
+            buildingList += buildingOf[r];
+        }
+        for (int comp = 0; comp < rooms.size(); ++comp) {
+            if (comp == r || buildingOf[comp] == buildingOf[r])
+                continue;
+            if (!inSameBuilding(r, comp))
+                continue;
+            if (buildingOf[comp] != -1) {
+                const int building = buildingOf[comp];
+                for (int r2 : buildingRooms[building])
+                    buildingOf[r2] = buildingOf[r];
+                buildingRooms[buildingOf[r]] += buildingRooms.take(building);
+                buildingList.removeOne(building);
+            } else {
+                buildingOf[comp] = buildingOf[r];
+                buildingRooms[buildingOf[r]] += comp;
+            }
+        }
+    }
+    buildings.clear();
+    for (int building : qAsConst(buildingList))
+        buildings += buildingRooms[building];
+}
+
+// Checks that RoomGraph numbers rooms and buildings like the reference, on
+// overlapping rectangles whose rooms get merged in awkward orders.
+void checkRoomGraph(Runner &runner)
+{
+    static const char *names[] = { "hall#1", "hall#1", "kitchen#2", "bedroom" };
+    Random random(777);
+    for (int round = 0; round < 200; ++round) {
+        QVector<ReferenceRect> rects;
+        RoomGraph graph;
+        const int count = 1 + random.bounded(40);
+        for (int i = 0; i < count; ++i) {
+            ReferenceRect rr;
+            rr.bounds = QRect(random.bounded(24), random.bounded(24),
+                              1 + random.bounded(5), 1 + random.bounded(5));
+            rr.level = random.bounded(3);
+            rr.name = QLatin1String(names[random.bounded(4)]);
+            rects += rr;
+            graph.addRect(rr.bounds, rr.level, rr.name);
+        }
+        graph.build();
+
+        QVector<QVector<int> > rooms, buildings;
+        referenceGroupRooms(rects, rooms, buildings);
+
+        bool same = graph.roomCount() == rooms.size() &&
+                graph.buildingCount() == buildings.size();
+        for (int i = 0; same && i < rooms.size(); ++i)
+            same = graph.roomRects(i) == rooms[i];
+        for (int i = 0; same && i < buildings.size(); ++i)
+            same = graph.buildingRooms(i) == buildings[i];
+        if (!same)
+            runner.fail(QString(QLatin1String("roomgraph: round %1 numbers rooms or buildings differently from the reference"))
+                        .arg(round));
+    }
+}
+
+void benchmarkRoomGraph(Runner &runner, const Options &options)
+{
+    checkRoomGraph(runner);
+
+    // A town of three-storey houses, 10x10 tiles apart, each floor with four
+    // rooms and the hallway drawn as two rectangles.
+    RoomGraph graph;
+    for (int hy = 0; hy + 8 <= options.size; hy += 10) {
+        for (int hx = 0; hx + 8 <= options.size; hx += 10) {
+            for (int level = 0; level < 3; ++level) {
+                graph.addRect(QRect(hx, hy, 4, 4), level, QLatin1String("kitchen"));
+                graph.addRect(QRect(hx + 4, hy, 4, 4), level, QLatin1String("bedroom"));
+                graph.addRect(QRect(hx, hy + 4, 4, 4), level, QLatin1String("bathroom"));
+                graph.addRect(QRect(hx + 4, hy + 4, 4, 2), level, QLatin1String("hall#1"));
+                graph.addRect(QRect(hx + 4, hy + 6, 4, 2), level, QLatin1String("hall#1"));
+            }
+        }
+    }
+
+    runner.run(QLatin1String("roomgraph/build"), [&]() {
+        graph.build();
+    });
+
+    runner.run(QLatin1String("roomgraph/roomAt"), [&]() {
+        for (int y = 0; y < options.size; ++y)
+            for (int x = 0; x < options.size; ++x)
+                (void) graph.roomAt(QPoint(x, y), 1);
+    });
+}
+
+// Compares the visible pixels of two images byte for byte, ignoring the
+// padding at the end of each scanline.
+bool sameBytes(const QImage &a, const QImage &b)
+{
+    if (a.size() != b.size() || a.format() != b.format())
+        return false;
+    const int bytes = a.width() * a.depth() / 8;
+    for (int y = 0; y < a.height(); ++y) {
+        if (memcmp(a.constScanLine(y), b.constScanLine(y), bytes) != 0)
+            return false;
+    }
+    return true;
+}
+
+// Checks every instruction set the CPU supports against the plain C++
+// kernels, with widths that leave the vector loops part of a row to the
+// simpler versions.
+void checkImageKernels(Runner &runner)
+{
+    static const int widths[] = { 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 23, 24, 31, 33, 47, 64, 65 };
+    static const ImageKernels::InstructionSet sets[] = { ImageKernels::SSE2, ImageKernels::AVX2 };
+    static const QImage::Format formats[] = { QImage::Format_ARGB32,
+                                              QImage::Format_ARGB32_Premultiplied };
+    Random random(4242);
+    for (int width : widths) {
+        for (QImage::Format format : formats) {
+            QImage image(width, 3, format);
+            for (int y = 0; y < image.height(); ++y) {
+                quint32 *pixels = reinterpret_cast<quint32*>(image.scanLine(y));
+                for (int x = 0; x < width; ++x) {
+                    // Transparent, partly transparent and opaque pixels, with
+                    // every color channel value.
+                    quint32 rgb = random.next() & 0xFFFFFF;
+                    int r = random.bounded(3);
+                    quint32 alpha = (r == 0) ? 0 : (r == 1) ? quint32(random.bounded(256)) : 255;
+                    if (format == QImage::Format_ARGB32_Premultiplied && alpha != 255)
+                        rgb = 0;
+                    pixels[x] = rgb | (alpha << 24);
+                }
+            }
+
+            QImage expected = image.copy();
+            ImageKernels::saturateAlpha(expected, ImageKernels::Scalar);
+            const QImage expected4444 =
+                    ImageKernels::saturateAlphaToArgb4444(image, ImageKernels::Scalar);
+
+            for (ImageKernels::InstructionSet set : sets) {
+                if (!ImageKernels::isSupported(set))
+                    continue;
+                const QString name = (set == ImageKernels::SSE2) ? QLatin1String("sse2")
+                                                                 : QLatin1String("avx2");
+                QImage result = image.copy();
+                ImageKernels::saturateAlpha(result, set);
+                if (!sameBytes(result, expected))
+                    runner.fail(QString(QLatin1String("imagekernels: saturateAlpha/%1 differs from scalar at width %2"))
+                                .arg(name).arg(width));
+                if (!sameBytes(ImageKernels::saturateAlphaToArgb4444(image, set), expected4444))
+                    runner.fail(QString(QLatin1String("imagekernels: saturateAlphaToArgb4444/%1 differs from scalar at width %2"))
+                                .arg(name).arg(width));
+            }
+        }
+    }
+}
+
+void benchmarkImageKernels(Runner &runner, const Options &options)
+{
+    checkImageKernels(runner);
+
+    // Roughly the size of a map thumbnail, with the tiles drawn as opaque
+    // diamonds over a transparent background and antialiased along the edges.
+    const int width = options.size * 8, height = options.size * 4;
+    QImage image(width, height, QImage::Format_ARGB32);
+    Random random(777);
+    for (int y = 0; y < height; ++y) {
+        quint32 *pixels = reinterpret_cast<quint32*>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            quint32 rgb = random.next() & 0xFFFFFF;
+            int r = random.bounded(10);
+            pixels[x] = (r < 4) ? 0 : (r < 6) ? (rgb | (quint32(random.bounded(255) + 1) << 24))
+                                              : (rgb | 0xFF000000);
+        }
+    }
+
+    struct Set {
+        const char *name;
+        ImageKernels::InstructionSet set;
+    };
+    const Set sets[] = {
+        { "scalar", ImageKernels::Scalar },
+        { "sse2", ImageKernels::SSE2 },
+        { "avx2", ImageKernels::AVX2 }
+    };
+
+    runner.run(QLatin1String("imagekernels/qt/convertToFormat"), [&]() {
+        (void) image.convertToFormat(QImage::Format_ARGB4444_Premultiplied);
+    });
+
+    for (const Set &set : sets) {
+        if (!ImageKernels::isSupported(set.set))
+            continue;
+        const QString suffix = QLatin1Char('/') + QLatin1String(set.name);
+        // A fresh copy every time, so each run does the full amount of work.
+        runner.run(QLatin1String("imagekernels/saturateAlpha") + suffix, [&]() {
+            QImage copy = image.copy();
+            ImageKernels::saturateAlpha(copy, set.set);
+        });
+        runner.run(QLatin1String("imagekernels/saturateAlphaToArgb4444") + suffix, [&]() {
+            (void) ImageKernels::saturateAlphaToArgb4444(image, set.set);
+        });
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QLatin1String("libtiled benchmarks"));
+    parser.addHelpOption();
+    QCommandLineOption outputOption(QStringList() << QLatin1String("o") << QLatin1String("output"),
+                                    QLatin1String("Write JSON results to <file>."),
+                                    QLatin1String("file"));
+    QCommandLineOption sizeOption(QLatin1String("size"),
+                                  QLatin1String("Map width and height (default 300)."),
+                                  QLatin1String("tiles"), QLatin1String("300"));
+    QCommandLineOption layersOption(QLatin1String("layers"),
+                                    QLatin1String("Number of tile layers (default 8)."),
+                                    QLatin1String("count"), QLatin1String("8"));
+    QCommandLineOption iterationsOption(QLatin1String("iterations"),
+                                        QLatin1String("Timed runs per benchmark (default 5)."),
+                                        QLatin1String("count"), QLatin1String("5"));
+    QCommandLineOption filterOption(QLatin1String("filter"),
+                                    QLatin1String("Only run benchmarks whose name contains <text>."),
+                                    QLatin1String("text"));
+    parser.addOption(outputOption);
+    parser.addOption(sizeOption);
+    parser.addOption(layersOption);
+    parser.addOption(iterationsOption);
+    parser.addOption(filterOption);
+    parser.process(app);
+
+    Options options;
+    options.size = qMax(1, parser.value(sizeOption).toInt());
+    options.layers = qMax(1, parser.value(layersOption).toInt());
+    options.iterations = qMax(1, parser.value(iterationsOption).toInt());
+    options.filter = parser.value(filterOption);
+
+    Runner runner(options);
+    benchmarkTileLayers(runner, options);
+    benchmarkReadWrite(runner, options);
+    benchmarkWriteCell(runner, options);
+    benchmarkRendering(runner, options);
+    benchmarkAutomapping(runner, options);
+    benchmarkRoomGraph(runner, options);
+    benchmarkImageKernels(runner, options);
+
+    QByteArray json = runner.report().toJson();
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly)) {
+            QTextStream(stderr) << file.errorString() << "\n";
+            return 1;
+        }
+        file.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+
+    return runner.failed() ? 1 : 0;
+}
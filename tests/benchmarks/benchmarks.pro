@@ -0,0 +1,30 @@
+include(../../tiled.pri)
+include(../../src/libtiled/libtiled.pri)
+
+TEMPLATE = app
+TARGET = benchmarks
+CONFIG += console
+CONFIG -= app_bundle
+DEPENDPATH += .
+INCLUDEPATH += ../../src/tiled
+DEFINES += QT_NO_CAST_FROM_ASCII
+
+macx {
+    LIBS += -L$$OUT_PWD/../../bin/Tiled.app/Contents/Frameworks
+} else {
+    LIBS += -L$$OUT_PWD/../../lib
+}
+
+!win32:!macx {
+    QMAKE_RPATHDIR += \$\$ORIGIN/../../lib
+
+    # It is not possible to use ORIGIN in QMAKE_RPATHDIR, so a bit manually
+    QMAKE_LFLAGS += -Wl,-z,origin \'-Wl,-rpath,$$join(QMAKE_RPATHDIR, ":")\'
+    QMAKE_RPATHDIR =
+}
+
+# Input
+SOURCES += benchmarks.cpp \
+    ../../src/tiled/automappingmatcher.cpp \
+    ../../src/tiled/imagekernels.cpp \
+    ../../src/tiled/roomgraph.cpp
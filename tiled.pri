@@ -17,3 +17,7 @@ macx {
 }
 
 DEFINES += ZOMBOID
+
+# Build with "qmake CONFIG+=tracing" to compile in the profiling zones (see
+# src/libtiled/tracing.h) and the Profiler dock.
+tracing: DEFINES += ZOMBOID_TRACING